@@ -0,0 +1,265 @@
+#include "compiler.h"
+#include "util/util.h"
+#include "util/diagnostic.h"
+#include "ast/flat.h"
+#include "syntax/lexer.h"
+#include "syntax/parser.h"
+#include "semantic/symtable.h"
+#include "semantic/typecheck.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Runs the front-end phases over each input and reports per-phase throughput as JSON,
+// along with the number of AST nodes and the bytes they take.
+// With --threads, also checks all inputs in 1, 2, 4... up to N threads at once,
+// each thread with its own compiler context, and reports how throughput scales.
+//
+//   cygnus-bench [--repeat=N] [--threads=N] [--output=FILE] inputs...
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr const char *phase_names[] = { "lexer", "parser", "symbol_table", "type_checker" };
+	constexpr size_t phase_count = std::size(phase_names);
+
+	struct Result
+	{
+		std::string name;
+		size_t bytes = 0, lines = 0, tokens = 0, diagnostics = 0;
+		// of the tree, not counting the vectors its nodes own
+		size_t nodes = 0, node_bytes = 0;
+		// milliseconds per repetition; empty if an earlier phase failed
+		std::vector<double> times[phase_count];
+	};
+
+	double elapsed(Clock::time_point begin, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+
+	Result run(std::string_view path, const std::string &source, unsigned repeat)
+	{
+		Result result;
+		auto slash = path.find_last_of('/');
+		result.name = path.substr(slash == std::string_view::npos ? 0 : slash + 1);
+		result.bytes = source.size();
+		result.lines = std::count(source.begin(), source.end(), '\n');
+
+		for(unsigned r = 0; r < repeat; r++)
+		{
+			std::vector<Token> tokens;
+			Util::DiagnosticEngine diagnostics(path, source, tokens);
+
+			auto t0 = Clock::now();
+			Lexer lexer(source, diagnostics);
+			tokens = lexer.tokenize();
+			auto t1 = Clock::now();
+			result.times[0].push_back(elapsed(t0, t1));
+			result.tokens = tokens.size();
+			if(lexer.failed() || tokens.empty())
+			{
+				result.diagnostics = diagnostics.diagnostics().size();
+				continue;
+			}
+
+			// recover from every syntax error so error-heavy inputs are parsed to the end
+			Parser parser(tokens, diagnostics, UINT_MAX);
+			auto ast = parser.parse();
+			auto t2 = Clock::now();
+			result.times[1].push_back(elapsed(t1, t2));
+			if(r == 0)
+			{
+				FlatTree tree(*ast, tokens);
+				result.nodes = tree.size();
+				for(auto kind : tree.kinds)
+					result.node_bytes += node_size(kind);
+			}
+			if(parser.failed())
+			{
+				result.diagnostics = diagnostics.diagnostics().size();
+				continue;
+			}
+
+			SymbolTable sym(diagnostics);
+			sym.dispatch(*ast);
+			auto t3 = Clock::now();
+			result.times[2].push_back(elapsed(t2, t3));
+			if(sym.failed())
+			{
+				result.diagnostics = diagnostics.diagnostics().size();
+				continue;
+			}
+
+			TypeChecker type_checker(diagnostics, lexer.constants);
+			type_checker.dispatch(*ast);
+			auto t4 = Clock::now();
+			result.times[3].push_back(elapsed(t3, t4));
+			result.diagnostics = diagnostics.diagnostics().size();
+		}
+
+		return result;
+	}
+
+	struct Scaling
+	{
+		unsigned threads;
+		double ms;
+		size_t checks;
+	};
+
+	// every thread checks every input repeat times
+	Scaling run_parallel(const std::vector<std::string_view> &paths, const std::vector<std::string> &sources, unsigned thread_count, unsigned repeat)
+	{
+		std::vector<std::thread> threads;
+		auto begin = Clock::now();
+		for(unsigned t = 0; t < thread_count; t++)
+		{
+			threads.emplace_back([&]
+			{
+				Compiler::Context context;
+				for(unsigned r = 0; r < repeat; r++)
+				{
+					for(size_t i = 0; i < sources.size(); i++)
+						context.check(paths[i], sources[i]);
+				}
+			});
+		}
+		for(auto &thread : threads)
+			thread.join();
+
+		return { thread_count, elapsed(begin, Clock::now()), thread_count * repeat * sources.size() };
+	}
+
+	void write_json(std::ostream &out, const std::vector<Result> &results, unsigned repeat, const std::vector<Scaling> &scaling)
+	{
+		out << std::fixed;
+		out << "{\n";
+		out << "  \"repeat\": " << repeat << ",\n";
+		out << "  \"workloads\": [\n";
+		for(size_t w = 0; w < results.size(); w++)
+		{
+			const auto &result = results[w];
+			out << "    {\n";
+			out << "      \"name\": \"" << result.name << "\",\n";
+			out << "      \"bytes\": " << result.bytes << ",\n";
+			out << "      \"lines\": " << result.lines << ",\n";
+			out << "      \"tokens\": " << result.tokens << ",\n";
+			out << "      \"diagnostics\": " << result.diagnostics << ",\n";
+			out << "      \"ast\": { \"nodes\": " << result.nodes << ", \"node_bytes\": " << result.node_bytes << " },\n";
+			out << "      \"phases\": {\n";
+
+			bool first = true;
+			for(size_t p = 0; p < phase_count; p++)
+			{
+				auto times = result.times[p];
+				if(times.empty()) continue;
+				std::sort(times.begin(), times.end());
+				// the fastest run is the least disturbed by the rest of the machine
+				double best = times.front();
+				double median = times[times.size() / 2];
+				double seconds = std::max(best, 1e-6) / 1000;
+
+				if(!first) out << ",\n";
+				first = false;
+				out << "        \"" << phase_names[p] << "\": { ";
+				out << std::setprecision(3);
+				out << "\"best_ms\": " << best << ", ";
+				out << "\"median_ms\": " << median << ", ";
+				out << std::setprecision(2);
+				out << "\"mb_per_s\": " << result.bytes / seconds / 1e6 << ", ";
+				out << std::setprecision(0);
+				out << "\"lines_per_s\": " << result.lines / seconds << " }";
+			}
+
+			out << "\n      }\n";
+			out << "    }" << (w + 1 < results.size() ? "," : "") << "\n";
+		}
+		out << "  ]";
+
+		if(!scaling.empty())
+		{
+			out << ",\n  \"scaling\": [\n";
+			double base = scaling.front().checks / scaling.front().ms;
+			for(size_t i = 0; i < scaling.size(); i++)
+			{
+				const auto &run = scaling[i];
+				double rate = run.checks / run.ms;
+				out << "    { \"threads\": " << run.threads << ", ";
+				out << std::setprecision(3);
+				out << "\"ms\": " << run.ms << ", ";
+				out << std::setprecision(0);
+				out << "\"checks_per_s\": " << rate * 1000 << ", ";
+				out << std::setprecision(2);
+				out << "\"speedup\": " << rate / base << " }";
+				out << (i + 1 < scaling.size() ? "," : "") << "\n";
+			}
+			out << "  ]";
+		}
+		out << "\n}\n";
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned repeat = 5, threads = 0;
+	std::string output;
+	std::vector<std::string_view> inputs;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		if(arg.substr(0, 9) == "--repeat=")
+			repeat = std::max(1, std::stoi(std::string(arg.substr(9))));
+		else if(arg.substr(0, 10) == "--threads=")
+			threads = std::max(1, std::stoi(std::string(arg.substr(10))));
+		else if(arg.substr(0, 9) == "--output=")
+			output = arg.substr(9);
+		else
+			inputs.push_back(arg);
+	}
+
+	if(inputs.empty())
+	{
+		std::cerr << "usage: cygnus-bench [--repeat=N] [--threads=N] [--output=FILE] inputs...\n";
+		return 1;
+	}
+
+	std::vector<Result> results;
+	std::vector<std::string> sources;
+	for(const auto &input : inputs)
+	{
+		std::cerr << "Running '" << input << "'\n";
+		sources.push_back(Util::read_file(input));
+		results.push_back(run(input, sources.back(), repeat));
+	}
+
+	std::vector<Scaling> scaling;
+	for(unsigned n = 1; threads > 0 && n <= threads; n = n * 2 > threads && n < threads ? threads : n * 2)
+	{
+		std::cerr << "Running in " << n << " threads\n";
+		scaling.push_back(run_parallel(inputs, sources, n, repeat));
+	}
+
+	if(output.empty())
+	{
+		write_json(std::cout, results, repeat, scaling);
+	}
+	else
+	{
+		std::ofstream file(output);
+		write_json(file, results, repeat, scaling);
+		std::cerr << "Wrote '" << output << "'\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,68 @@
+// generated by nodegen.py; do not edit
+
+#pragma once
+
+#include "node.h"
+
+// statically dispatched alternative to Visitor: switches on Node::kind
+// and calls Derived::visit directly, so visits can be inlined and may
+// return a value
+template<typename Derived, typename R = void>
+class StaticVisitor
+{
+public:
+	using Result = R;
+
+	Result dispatch(Node &node)
+	{
+		auto &self = static_cast<Derived &>(*this);
+		switch(node.kind)
+		{
+			case NodeKind::Program:
+				return self.visit(static_cast<Program &>(node));
+			case NodeKind::ExprStatement:
+				return self.visit(static_cast<ExprStatement &>(node));
+			case NodeKind::VariableDef:
+				return self.visit(static_cast<VariableDef &>(node));
+			case NodeKind::FunctionDef:
+				return self.visit(static_cast<FunctionDef &>(node));
+			case NodeKind::Import:
+				return self.visit(static_cast<Import &>(node));
+			case NodeKind::NumberLiteral:
+				return self.visit(static_cast<NumberLiteral &>(node));
+			case NodeKind::StringLiteral:
+				return self.visit(static_cast<StringLiteral &>(node));
+			case NodeKind::BooleanLiteral:
+				return self.visit(static_cast<BooleanLiteral &>(node));
+			case NodeKind::UnitLiteral:
+				return self.visit(static_cast<UnitLiteral &>(node));
+			case NodeKind::Identifier:
+				return self.visit(static_cast<Identifier &>(node));
+			case NodeKind::FunctionCall:
+				return self.visit(static_cast<FunctionCall &>(node));
+			case NodeKind::InfixOperator:
+				return self.visit(static_cast<InfixOperator &>(node));
+			case NodeKind::PrefixOperator:
+				return self.visit(static_cast<PrefixOperator &>(node));
+			case NodeKind::PostfixOperator:
+				return self.visit(static_cast<PostfixOperator &>(node));
+			case NodeKind::GroupExpr:
+				return self.visit(static_cast<GroupExpr &>(node));
+			case NodeKind::ReturnExpr:
+				return self.visit(static_cast<ReturnExpr &>(node));
+			case NodeKind::IfExpr:
+				return self.visit(static_cast<IfExpr &>(node));
+			case NodeKind::WhileExpr:
+				return self.visit(static_cast<WhileExpr &>(node));
+			case NodeKind::Invalid:
+				return self.visit(static_cast<Invalid &>(node));
+			case NodeKind::Block:
+				return self.visit(static_cast<Block &>(node));
+			case NodeKind::Parameter:
+				return self.visit(static_cast<Parameter &>(node));
+			case NodeKind::Type:
+				return self.visit(static_cast<Type &>(node));
+		}
+		__builtin_unreachable();
+	}
+};
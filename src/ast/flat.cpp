@@ -0,0 +1,243 @@
+// generated by nodegen.py; do not edit
+
+#include "flat.h"
+#include "dispatch.h"
+
+namespace
+{
+	class FlatBuilder : public StaticVisitor<FlatBuilder, NodeId>
+	{
+	public:
+#include "dispatchincl"
+
+		explicit FlatBuilder(FlatTree &tree)
+			: tree(tree)
+		{
+		}
+
+		// builds with an explicit stack so deep trees cannot overflow the native one
+		void build(Node &root)
+		{
+			struct Entry
+			{
+				NodeId id;
+				size_t mark, first, next;
+			};
+			std::vector<Entry> stack;
+
+			auto open = [&](Node &node)
+			{
+				auto mark = pending.size();
+				auto first = queued.size();
+				stack.push_back({ dispatch(node), mark, first, first });
+			};
+
+			open(root);
+			while(!stack.empty())
+			{
+				auto &top = stack.back();
+				if(top.next < queued.size())
+				{
+					auto child = queued[top.next++];
+					if(child) open(*child);
+					else pending.push_back(no_node);
+					continue;
+				}
+
+				// all children built
+				tree.first_child[top.id] = tree.children.size();
+				tree.child_count[top.id] = pending.size() - top.mark;
+				tree.children.insert(tree.children.end(), pending.begin() + top.mark, pending.end());
+				pending.resize(top.mark);
+				queued.resize(top.first);
+
+				auto id = top.id;
+				stack.pop_back();
+				if(!stack.empty()) pending.push_back(id);
+			}
+		}
+
+	private:
+		FlatTree &tree;
+		// child ids of the nodes currently being built
+		std::vector<NodeId> pending;
+		// children waiting to be built, in field order
+		std::vector<Node *> queued;
+
+		NodeId add(Node &node)
+		{
+			NodeId id = tree.kinds.size();
+			tree.kinds.push_back(node.kind);
+			tree.first_token.push_back(tree.tokens.size());
+			tree.first_child.push_back(0);
+			tree.child_count.push_back(0);
+			return id;
+		}
+		void queue(Node *node)
+		{
+			queued.push_back(node);
+		}
+	};
+
+	NodeId FlatBuilder::visit(Program &node)
+	{
+		auto id = add(node);
+		for(const auto &child : node.statements) queue(child.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(ExprStatement &node)
+	{
+		auto id = add(node);
+		queue(node.expr.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(VariableDef &node)
+	{
+		auto id = add(node);
+		queue(node.name.get());
+		queue(node.type.get());
+		queue(node.value.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(FunctionDef &node)
+	{
+		auto id = add(node);
+		queue(node.name.get());
+		for(const auto &child : node.parameters) queue(child.get());
+		queue(node.return_type.get());
+		queue(node.body.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(Import &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.import_keyword_index);
+		tree.tokens.push_back(node.name_index);
+		return id;
+	}
+	NodeId FlatBuilder::visit(NumberLiteral &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		return id;
+	}
+	NodeId FlatBuilder::visit(StringLiteral &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		return id;
+	}
+	NodeId FlatBuilder::visit(BooleanLiteral &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		return id;
+	}
+	NodeId FlatBuilder::visit(UnitLiteral &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		return id;
+	}
+	NodeId FlatBuilder::visit(Identifier &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		return id;
+	}
+	NodeId FlatBuilder::visit(FunctionCall &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.rparen_index);
+		queue(node.name.get());
+		for(const auto &child : node.arguments) queue(child.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(InfixOperator &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		queue(node.left.get());
+		queue(node.right.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(PrefixOperator &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		queue(node.operand.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(PostfixOperator &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		queue(node.operand.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(GroupExpr &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.lparen_index);
+		tree.tokens.push_back(node.rparen_index);
+		queue(node.expr.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(ReturnExpr &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.return_keyword_index);
+		queue(node.value.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(IfExpr &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.if_keyword_index);
+		tree.tokens.push_back(node.else_keyword_index);
+		queue(node.condition.get());
+		queue(node.if_branch.get());
+		queue(node.else_branch.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(WhileExpr &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.while_keyword_index);
+		queue(node.condition.get());
+		queue(node.body.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(Invalid &node)
+	{
+		auto id = add(node);
+		return id;
+	}
+	NodeId FlatBuilder::visit(Block &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.lbrace_index);
+		tree.tokens.push_back(node.rbrace_index);
+		for(const auto &child : node.statements) queue(child.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(Parameter &node)
+	{
+		auto id = add(node);
+		queue(node.name.get());
+		queue(node.type.get());
+		return id;
+	}
+	NodeId FlatBuilder::visit(Type &node)
+	{
+		auto id = add(node);
+		tree.tokens.push_back(node.token_index);
+		return id;
+	}
+}
+
+FlatTree::FlatTree(Node &root, const std::vector<Token> &source)
+	: source(&source)
+{
+	FlatBuilder(*this).build(root);
+}
@@ -0,0 +1,286 @@
+// generated by nodegen.py; do not edit
+
+#pragma once
+
+#include "node.h"
+#include "syntax/token.h"
+
+#include <cstdint>
+#include <climits>
+#include <vector>
+
+using NodeId = std::uint32_t;
+constexpr NodeId no_node = UINT32_MAX;
+
+struct NodeIdRange
+{
+	const NodeId *first, *last;
+	const NodeId *begin() const { return first; }
+	const NodeId *end() const { return last; }
+	size_t size() const { return last - first; }
+	bool empty() const { return first == last; }
+	NodeId operator[](size_t i) const { return first[i]; }
+};
+
+// struct-of-arrays form of an AST; node ids are assigned in pre-order,
+// so the root is always 0 and every subtree is a contiguous id range
+class FlatTree
+{
+public:
+	// source is the token list of the file the tree was parsed from, which
+	// must outlive the tree
+	FlatTree(Node &root, const std::vector<Token> &source);
+
+	NodeId root() const { return 0; }
+	size_t size() const { return kinds.size(); }
+
+	NodeId child(NodeId id, unsigned i) const { return children[first_child[id] + i]; }
+	NodeId child_from_end(NodeId id, unsigned i) const { return children[first_child[id] + child_count[id] - i]; }
+	NodeIdRange child_range(NodeId id, unsigned front, unsigned back) const
+	{
+		const NodeId *first = children.data() + first_child[id];
+		return { first + front, first + child_count[id] - back };
+	}
+	TokenIndex token_index(NodeId id, unsigned i) const { return tokens[first_token[id] + i]; }
+	const Token &token(NodeId id, unsigned i) const { return token_at(*source, token_index(id, i)); }
+
+	// per node
+	std::vector<NodeKind> kinds;
+	std::vector<std::uint32_t> first_token;
+	std::vector<std::uint32_t> first_child;
+	std::vector<std::uint32_t> child_count;
+
+	// shared
+	std::vector<NodeId> children;
+	// indices into source
+	std::vector<TokenIndex> tokens;
+	const std::vector<Token> *source;
+};
+
+namespace Flat
+{
+	struct Program
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeIdRange statements() const { return tree.child_range(id, 0, 0); }
+	};
+	struct ExprStatement
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId expr() const { return tree.child(id, 0); }
+	};
+	struct VariableDef
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId name() const { return tree.child(id, 0); }
+		NodeId type() const { return tree.child(id, 1); }
+		NodeId value() const { return tree.child(id, 2); }
+	};
+	struct FunctionDef
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId name() const { return tree.child(id, 0); }
+		NodeIdRange parameters() const { return tree.child_range(id, 1, 2); }
+		NodeId return_type() const { return tree.child_from_end(id, 2); }
+		NodeId body() const { return tree.child_from_end(id, 1); }
+	};
+	struct Import
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		const Token &import_keyword() const { return tree.token(id, 0); }
+		const Token &name() const { return tree.token(id, 1); }
+	};
+	struct NumberLiteral
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		const Token &token() const { return tree.token(id, 0); }
+	};
+	struct StringLiteral
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		const Token &token() const { return tree.token(id, 0); }
+	};
+	struct BooleanLiteral
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		const Token &token() const { return tree.token(id, 0); }
+	};
+	struct UnitLiteral
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		const Token &token() const { return tree.token(id, 0); }
+	};
+	struct Identifier
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		const Token &token() const { return tree.token(id, 0); }
+	};
+	struct FunctionCall
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId name() const { return tree.child(id, 0); }
+		NodeIdRange arguments() const { return tree.child_range(id, 1, 0); }
+		const Token &rparen() const { return tree.token(id, 0); }
+	};
+	struct InfixOperator
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId left() const { return tree.child(id, 0); }
+		NodeId right() const { return tree.child(id, 1); }
+		const Token &token() const { return tree.token(id, 0); }
+	};
+	struct PrefixOperator
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId operand() const { return tree.child(id, 0); }
+		const Token &token() const { return tree.token(id, 0); }
+	};
+	struct PostfixOperator
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId operand() const { return tree.child(id, 0); }
+		const Token &token() const { return tree.token(id, 0); }
+	};
+	struct GroupExpr
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId expr() const { return tree.child(id, 0); }
+		const Token &lparen() const { return tree.token(id, 0); }
+		const Token &rparen() const { return tree.token(id, 1); }
+	};
+	struct ReturnExpr
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId value() const { return tree.child(id, 0); }
+		const Token &return_keyword() const { return tree.token(id, 0); }
+	};
+	struct IfExpr
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId condition() const { return tree.child(id, 0); }
+		NodeId if_branch() const { return tree.child(id, 1); }
+		NodeId else_branch() const { return tree.child(id, 2); }
+		const Token &if_keyword() const { return tree.token(id, 0); }
+		const Token &else_keyword() const { return tree.token(id, 1); }
+	};
+	struct WhileExpr
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId condition() const { return tree.child(id, 0); }
+		NodeId body() const { return tree.child(id, 1); }
+		const Token &while_keyword() const { return tree.token(id, 0); }
+	};
+	struct Invalid
+	{
+		const FlatTree &tree;
+		const NodeId id;
+	};
+	struct Block
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeIdRange statements() const { return tree.child_range(id, 0, 0); }
+		const Token &lbrace() const { return tree.token(id, 0); }
+		const Token &rbrace() const { return tree.token(id, 1); }
+	};
+	struct Parameter
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		NodeId name() const { return tree.child(id, 0); }
+		NodeId type() const { return tree.child(id, 1); }
+	};
+	struct Type
+	{
+		const FlatTree &tree;
+		const NodeId id;
+		const Token &token() const { return tree.token(id, 0); }
+	};
+}
+
+// statically dispatched visitor over a FlatTree
+template<typename Derived, typename R = void>
+class FlatVisitor
+{
+public:
+	using Result = R;
+
+	explicit FlatVisitor(const FlatTree &tree)
+		: tree(tree)
+	{
+	}
+
+	Result dispatch(NodeId id)
+	{
+		auto &self = static_cast<Derived &>(*this);
+		switch(tree.kinds[id])
+		{
+			case NodeKind::Program:
+				return self.visit(Flat::Program { tree, id });
+			case NodeKind::ExprStatement:
+				return self.visit(Flat::ExprStatement { tree, id });
+			case NodeKind::VariableDef:
+				return self.visit(Flat::VariableDef { tree, id });
+			case NodeKind::FunctionDef:
+				return self.visit(Flat::FunctionDef { tree, id });
+			case NodeKind::Import:
+				return self.visit(Flat::Import { tree, id });
+			case NodeKind::NumberLiteral:
+				return self.visit(Flat::NumberLiteral { tree, id });
+			case NodeKind::StringLiteral:
+				return self.visit(Flat::StringLiteral { tree, id });
+			case NodeKind::BooleanLiteral:
+				return self.visit(Flat::BooleanLiteral { tree, id });
+			case NodeKind::UnitLiteral:
+				return self.visit(Flat::UnitLiteral { tree, id });
+			case NodeKind::Identifier:
+				return self.visit(Flat::Identifier { tree, id });
+			case NodeKind::FunctionCall:
+				return self.visit(Flat::FunctionCall { tree, id });
+			case NodeKind::InfixOperator:
+				return self.visit(Flat::InfixOperator { tree, id });
+			case NodeKind::PrefixOperator:
+				return self.visit(Flat::PrefixOperator { tree, id });
+			case NodeKind::PostfixOperator:
+				return self.visit(Flat::PostfixOperator { tree, id });
+			case NodeKind::GroupExpr:
+				return self.visit(Flat::GroupExpr { tree, id });
+			case NodeKind::ReturnExpr:
+				return self.visit(Flat::ReturnExpr { tree, id });
+			case NodeKind::IfExpr:
+				return self.visit(Flat::IfExpr { tree, id });
+			case NodeKind::WhileExpr:
+				return self.visit(Flat::WhileExpr { tree, id });
+			case NodeKind::Invalid:
+				return self.visit(Flat::Invalid { tree, id });
+			case NodeKind::Block:
+				return self.visit(Flat::Block { tree, id });
+			case NodeKind::Parameter:
+				return self.visit(Flat::Parameter { tree, id });
+			case NodeKind::Type:
+				return self.visit(Flat::Type { tree, id });
+		}
+		__builtin_unreachable();
+	}
+
+protected:
+	const FlatTree &tree;
+};
@@ -2,159 +2,346 @@
 
 #include "node.h"
 
+Node::Node(NodeKind kind)
+	: kind(kind)
+{
+}
+Node::~Node()
+{
+}
+Expression::Expression(NodeKind kind)
+	: Node(kind)
+{
+}
+Statement::Statement(NodeKind kind)
+	: Node(kind)
+{
+}
 Program::Program(std::vector<std::unique_ptr<Statement>> statements)
-	: statements(std::move(statements))
+	: Node(NodeKind::Program), statements(std::move(statements))
 {
 }
+Program::~Program()
+{
+	for(auto &child : statements)
+		release(std::move(child));
+}
 void Program::accept(Visitor &v)
 {
 	v.visit(*this);
 }
 ExprStatement::ExprStatement(std::unique_ptr<Expression> expr)
-	: expr(std::move(expr))
+	: Statement(NodeKind::ExprStatement), expr(std::move(expr))
+{
+}
+ExprStatement::~ExprStatement()
 {
+	release(std::move(expr));
 }
 void ExprStatement::accept(Visitor &v)
 {
 	v.visit(*this);
 }
 VariableDef::VariableDef(std::unique_ptr<Identifier> name, std::unique_ptr<Type> type, std::unique_ptr<Expression> value)
-	: name(std::move(name)), type(std::move(type)), value(std::move(value))
+	: Statement(NodeKind::VariableDef), name(std::move(name)), type(std::move(type)), value(std::move(value))
 {
 }
+VariableDef::~VariableDef()
+{
+	release(std::move(name));
+	release(std::move(type));
+	release(std::move(value));
+}
 void VariableDef::accept(Visitor &v)
 {
 	v.visit(*this);
 }
 FunctionDef::FunctionDef(std::unique_ptr<Identifier> name, std::vector<std::unique_ptr<Parameter>> parameters, std::unique_ptr<Type> return_type, std::unique_ptr<Block> body)
-	: name(std::move(name)), parameters(std::move(parameters)), return_type(std::move(return_type)), body(std::move(body))
+	: Statement(NodeKind::FunctionDef), name(std::move(name)), parameters(std::move(parameters)), return_type(std::move(return_type)), body(std::move(body))
 {
 }
+FunctionDef::~FunctionDef()
+{
+	release(std::move(name));
+	for(auto &child : parameters)
+		release(std::move(child));
+	release(std::move(return_type));
+	release(std::move(body));
+}
 void FunctionDef::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-Value::Value(Token token)
-	: token(token)
+Import::Import(TokenIndex import_keyword, TokenIndex name)
+	: Statement(NodeKind::Import), import_keyword_index(import_keyword), name_index(name)
+{
+}
+void Import::accept(Visitor &v)
+{
+	v.visit(*this);
+}
+Value::Value(NodeKind kind, TokenIndex token)
+	: Expression(kind), token_index(token)
+{
+}
+Literal::Literal(NodeKind kind, TokenIndex token)
+	: Value(kind, token)
+{
+}
+NumberLiteral::NumberLiteral(TokenIndex token)
+	: Literal(NodeKind::NumberLiteral, token)
 {
 }
 void NumberLiteral::accept(Visitor &v)
 {
 	v.visit(*this);
 }
+StringLiteral::StringLiteral(TokenIndex token)
+	: Literal(NodeKind::StringLiteral, token)
+{
+}
 void StringLiteral::accept(Visitor &v)
 {
 	v.visit(*this);
 }
+BooleanLiteral::BooleanLiteral(TokenIndex token)
+	: Literal(NodeKind::BooleanLiteral, token)
+{
+}
 void BooleanLiteral::accept(Visitor &v)
 {
 	v.visit(*this);
 }
+UnitLiteral::UnitLiteral(TokenIndex token)
+	: Literal(NodeKind::UnitLiteral, token)
+{
+}
 void UnitLiteral::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-Identifier::Identifier(Token token, std::shared_ptr<SymbolData> symbol)
-	: Value(token), symbol(symbol)
+Identifier::Identifier(TokenIndex token, std::shared_ptr<SymbolData> symbol)
+	: Value(NodeKind::Identifier, token), symbol(symbol)
 {
 }
 void Identifier::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-FunctionCall::FunctionCall(std::unique_ptr<Identifier> name, std::vector<std::unique_ptr<Expression>> arguments, Token rparen)
-	: name(std::move(name)), arguments(std::move(arguments)), rparen(rparen)
+FunctionCall::FunctionCall(std::unique_ptr<Identifier> name, std::vector<std::unique_ptr<Expression>> arguments, TokenIndex rparen)
+	: Expression(NodeKind::FunctionCall), name(std::move(name)), arguments(std::move(arguments)), rparen_index(rparen)
+{
+}
+FunctionCall::~FunctionCall()
 {
+	release(std::move(name));
+	for(auto &child : arguments)
+		release(std::move(child));
 }
 void FunctionCall::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-Operator::Operator(Token token)
-	: token(token)
+Operator::Operator(NodeKind kind, TokenIndex token)
+	: Expression(kind), token_index(token)
 {
 }
-InfixOperator::InfixOperator(Token token, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right)
-	: Operator(token), left(std::move(left)), right(std::move(right))
+InfixOperator::InfixOperator(TokenIndex token, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right)
+	: Operator(NodeKind::InfixOperator, token), left(std::move(left)), right(std::move(right))
 {
 }
+InfixOperator::~InfixOperator()
+{
+	release(std::move(left));
+	release(std::move(right));
+}
 void InfixOperator::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-PrefixOperator::PrefixOperator(Token token, std::unique_ptr<Expression> operand)
-	: Operator(token), operand(std::move(operand))
+PrefixOperator::PrefixOperator(TokenIndex token, std::unique_ptr<Expression> operand)
+	: Operator(NodeKind::PrefixOperator, token), operand(std::move(operand))
+{
+}
+PrefixOperator::~PrefixOperator()
 {
+	release(std::move(operand));
 }
 void PrefixOperator::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-PostfixOperator::PostfixOperator(Token token, std::unique_ptr<Expression> operand)
-	: Operator(token), operand(std::move(operand))
+PostfixOperator::PostfixOperator(TokenIndex token, std::unique_ptr<Expression> operand)
+	: Operator(NodeKind::PostfixOperator, token), operand(std::move(operand))
+{
+}
+PostfixOperator::~PostfixOperator()
 {
+	release(std::move(operand));
 }
 void PostfixOperator::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-GroupExpr::GroupExpr(Token lparen, std::unique_ptr<Expression> expr, Token rparen)
-	: lparen(lparen), expr(std::move(expr)), rparen(rparen)
+GroupExpr::GroupExpr(TokenIndex lparen, std::unique_ptr<Expression> expr, TokenIndex rparen)
+	: Expression(NodeKind::GroupExpr), lparen_index(lparen), expr(std::move(expr)), rparen_index(rparen)
 {
 }
+GroupExpr::~GroupExpr()
+{
+	release(std::move(expr));
+}
 void GroupExpr::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-ReturnExpr::ReturnExpr(Token return_keyword, std::unique_ptr<Expression> value)
-	: return_keyword(return_keyword), value(std::move(value))
+ReturnExpr::ReturnExpr(TokenIndex return_keyword, std::unique_ptr<Expression> value)
+	: Expression(NodeKind::ReturnExpr), return_keyword_index(return_keyword), value(std::move(value))
+{
+}
+ReturnExpr::~ReturnExpr()
 {
+	release(std::move(value));
 }
 void ReturnExpr::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-IfExpr::IfExpr(Token if_keyword, std::unique_ptr<Expression> condition, std::unique_ptr<Statement> if_branch, Token else_keyword, std::unique_ptr<Statement> else_branch)
-	: if_keyword(if_keyword), condition(std::move(condition)), if_branch(std::move(if_branch)), else_keyword(else_keyword), else_branch(std::move(else_branch))
+IfExpr::IfExpr(TokenIndex if_keyword, std::unique_ptr<Expression> condition, std::unique_ptr<Statement> if_branch, TokenIndex else_keyword, std::unique_ptr<Statement> else_branch)
+	: Expression(NodeKind::IfExpr), if_keyword_index(if_keyword), condition(std::move(condition)), if_branch(std::move(if_branch)), else_keyword_index(else_keyword), else_branch(std::move(else_branch))
 {
 }
+IfExpr::~IfExpr()
+{
+	release(std::move(condition));
+	release(std::move(if_branch));
+	release(std::move(else_branch));
+}
 void IfExpr::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-WhileExpr::WhileExpr(Token while_keyword, std::unique_ptr<Expression> condition, std::unique_ptr<Statement> body)
-	: while_keyword(while_keyword), condition(std::move(condition)), body(std::move(body))
+WhileExpr::WhileExpr(TokenIndex while_keyword, std::unique_ptr<Expression> condition, std::unique_ptr<Statement> body)
+	: Expression(NodeKind::WhileExpr), while_keyword_index(while_keyword), condition(std::move(condition)), body(std::move(body))
+{
+}
+WhileExpr::~WhileExpr()
 {
+	release(std::move(condition));
+	release(std::move(body));
 }
 void WhileExpr::accept(Visitor &v)
 {
 	v.visit(*this);
 }
+Invalid::Invalid()
+	: Node(NodeKind::Invalid)
+{
+}
 void Invalid::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-Block::Block(Token lbrace, std::vector<std::unique_ptr<Statement>> statements, Token rbrace)
-	: lbrace(lbrace), statements(std::move(statements)), rbrace(rbrace)
+Block::Block(TokenIndex lbrace, std::vector<std::unique_ptr<Statement>> statements, TokenIndex rbrace)
+	: Statement(NodeKind::Block), lbrace_index(lbrace), statements(std::move(statements)), rbrace_index(rbrace)
+{
+}
+Block::~Block()
 {
+	for(auto &child : statements)
+		release(std::move(child));
 }
 void Block::accept(Visitor &v)
 {
 	v.visit(*this);
 }
 Parameter::Parameter(std::unique_ptr<Identifier> name, std::unique_ptr<Type> type)
-	: name(std::move(name)), type(std::move(type))
+	: Node(NodeKind::Parameter), name(std::move(name)), type(std::move(type))
+{
+}
+Parameter::~Parameter()
 {
+	release(std::move(name));
+	release(std::move(type));
 }
 void Parameter::accept(Visitor &v)
 {
 	v.visit(*this);
 }
-Type::Type(Token token)
-	: token(token)
+Type::Type(TokenIndex token)
+	: Node(NodeKind::Type), token_index(token)
 {
 }
 void Type::accept(Visitor &v)
 {
 	v.visit(*this);
 }
+void Node::release(std::unique_ptr<Node> node)
+{
+	thread_local std::vector<std::unique_ptr<Node>> pending;
+	thread_local bool draining = false;
+
+	if(!node) return;
+	pending.push_back(std::move(node));
+	if(draining) return;
+
+	draining = true;
+	while(!pending.empty())
+	{
+		auto next = std::move(pending.back());
+		pending.pop_back();
+		next.reset();
+	}
+	draining = false;
+}
+size_t node_size(NodeKind kind)
+{
+	switch(kind)
+	{
+		case NodeKind::Program:
+			return sizeof(Program);
+		case NodeKind::ExprStatement:
+			return sizeof(ExprStatement);
+		case NodeKind::VariableDef:
+			return sizeof(VariableDef);
+		case NodeKind::FunctionDef:
+			return sizeof(FunctionDef);
+		case NodeKind::Import:
+			return sizeof(Import);
+		case NodeKind::NumberLiteral:
+			return sizeof(NumberLiteral);
+		case NodeKind::StringLiteral:
+			return sizeof(StringLiteral);
+		case NodeKind::BooleanLiteral:
+			return sizeof(BooleanLiteral);
+		case NodeKind::UnitLiteral:
+			return sizeof(UnitLiteral);
+		case NodeKind::Identifier:
+			return sizeof(Identifier);
+		case NodeKind::FunctionCall:
+			return sizeof(FunctionCall);
+		case NodeKind::InfixOperator:
+			return sizeof(InfixOperator);
+		case NodeKind::PrefixOperator:
+			return sizeof(PrefixOperator);
+		case NodeKind::PostfixOperator:
+			return sizeof(PostfixOperator);
+		case NodeKind::GroupExpr:
+			return sizeof(GroupExpr);
+		case NodeKind::ReturnExpr:
+			return sizeof(ReturnExpr);
+		case NodeKind::IfExpr:
+			return sizeof(IfExpr);
+		case NodeKind::WhileExpr:
+			return sizeof(WhileExpr);
+		case NodeKind::Invalid:
+			return sizeof(Invalid);
+		case NodeKind::Block:
+			return sizeof(Block);
+		case NodeKind::Parameter:
+			return sizeof(Parameter);
+		case NodeKind::Type:
+			return sizeof(Type);
+	}
+	__builtin_unreachable();
+}
@@ -3,33 +3,45 @@
 #pragma once
 
 #include "visitor.h"
+#include "nodekind.h"
 #include "syntax/token.h"
 #include "semantic/symdata.h"
 
+#include <cstddef>
 #include <string_view>
 #include <memory>
 #include <vector>
 
 struct Node
 {
+	const NodeKind kind;
+	explicit Node(NodeKind kind);
+	virtual ~Node();
 	virtual void accept(Visitor &v) = 0;
+
+protected:
+	static void release(std::unique_ptr<Node> node);
 };
 struct Expression : public Node
 {
+	explicit Expression(NodeKind kind);
 };
 struct Statement : public Node
 {
+	explicit Statement(NodeKind kind);
 };
 struct Program : public Node
 {
 	std::vector<std::unique_ptr<Statement>> statements;
-	Program(std::vector<std::unique_ptr<Statement>> statements);
+	explicit Program(std::vector<std::unique_ptr<Statement>> statements);
+	~Program() override;
 	void accept(Visitor &v) override;
 };
 struct ExprStatement : public Statement
 {
 	std::unique_ptr<Expression> expr;
-	ExprStatement(std::unique_ptr<Expression> expr);
+	explicit ExprStatement(std::unique_ptr<Expression> expr);
+	~ExprStatement() override;
 	void accept(Visitor &v) override;
 };
 struct VariableDef : public Statement
@@ -38,6 +50,7 @@ struct VariableDef : public Statement
 	std::unique_ptr<Type> type;
 	std::unique_ptr<Expression> value;
 	VariableDef(std::unique_ptr<Identifier> name, std::unique_ptr<Type> type, std::unique_ptr<Expression> value);
+	~VariableDef() override;
 	void accept(Visitor &v) override;
 };
 struct FunctionDef : public Statement
@@ -47,118 +60,149 @@ struct FunctionDef : public Statement
 	std::unique_ptr<Type> return_type;
 	std::unique_ptr<Block> body;
 	FunctionDef(std::unique_ptr<Identifier> name, std::vector<std::unique_ptr<Parameter>> parameters, std::unique_ptr<Type> return_type, std::unique_ptr<Block> body);
+	~FunctionDef() override;
+	void accept(Visitor &v) override;
+};
+struct Import : public Statement
+{
+	TokenIndex import_keyword_index;
+	TokenIndex name_index;
+	Import(TokenIndex import_keyword, TokenIndex name);
+	const Token &import_keyword(const std::vector<Token> &tokens) const { return token_at(tokens, import_keyword_index); }
+	const Token &name(const std::vector<Token> &tokens) const { return token_at(tokens, name_index); }
 	void accept(Visitor &v) override;
 };
 struct Value : public Expression
 {
-	Token token;
-	Value(Token token);
+	TokenIndex token_index;
+	Value(NodeKind kind, TokenIndex token);
+	const Token &token(const std::vector<Token> &tokens) const { return token_at(tokens, token_index); }
 };
 struct Literal : public Value
 {
-	using Value::Value;
+	Literal(NodeKind kind, TokenIndex token);
 };
 struct NumberLiteral : public Literal
 {
-	using Literal::Literal;
+	explicit NumberLiteral(TokenIndex token);
 	void accept(Visitor &v) override;
 };
 struct StringLiteral : public Literal
 {
-	using Literal::Literal;
+	explicit StringLiteral(TokenIndex token);
 	void accept(Visitor &v) override;
 };
 struct BooleanLiteral : public Literal
 {
-	using Literal::Literal;
+	explicit BooleanLiteral(TokenIndex token);
 	void accept(Visitor &v) override;
 };
 struct UnitLiteral : public Literal
 {
-	using Literal::Literal;
+	explicit UnitLiteral(TokenIndex token);
 	void accept(Visitor &v) override;
 };
 struct Identifier : public Value
 {
 	std::shared_ptr<SymbolData> symbol;
-	Identifier(Token token, std::shared_ptr<SymbolData> symbol);
+	Identifier(TokenIndex token, std::shared_ptr<SymbolData> symbol);
 	void accept(Visitor &v) override;
 };
 struct FunctionCall : public Expression
 {
 	std::unique_ptr<Identifier> name;
 	std::vector<std::unique_ptr<Expression>> arguments;
-	Token rparen;
-	FunctionCall(std::unique_ptr<Identifier> name, std::vector<std::unique_ptr<Expression>> arguments, Token rparen);
+	TokenIndex rparen_index;
+	FunctionCall(std::unique_ptr<Identifier> name, std::vector<std::unique_ptr<Expression>> arguments, TokenIndex rparen);
+	const Token &rparen(const std::vector<Token> &tokens) const { return token_at(tokens, rparen_index); }
+	~FunctionCall() override;
 	void accept(Visitor &v) override;
 };
 struct Operator : public Expression
 {
-	Token token;
-	Operator(Token token);
+	TokenIndex token_index;
+	Operator(NodeKind kind, TokenIndex token);
+	const Token &token(const std::vector<Token> &tokens) const { return token_at(tokens, token_index); }
 };
 struct InfixOperator : public Operator
 {
 	std::unique_ptr<Expression> left;
 	std::unique_ptr<Expression> right;
-	InfixOperator(Token token, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right);
+	InfixOperator(TokenIndex token, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right);
+	~InfixOperator() override;
 	void accept(Visitor &v) override;
 };
 struct PrefixOperator : public Operator
 {
 	std::unique_ptr<Expression> operand;
-	PrefixOperator(Token token, std::unique_ptr<Expression> operand);
+	PrefixOperator(TokenIndex token, std::unique_ptr<Expression> operand);
+	~PrefixOperator() override;
 	void accept(Visitor &v) override;
 };
 struct PostfixOperator : public Operator
 {
 	std::unique_ptr<Expression> operand;
-	PostfixOperator(Token token, std::unique_ptr<Expression> operand);
+	PostfixOperator(TokenIndex token, std::unique_ptr<Expression> operand);
+	~PostfixOperator() override;
 	void accept(Visitor &v) override;
 };
 struct GroupExpr : public Expression
 {
-	Token lparen;
+	TokenIndex lparen_index;
 	std::unique_ptr<Expression> expr;
-	Token rparen;
-	GroupExpr(Token lparen, std::unique_ptr<Expression> expr, Token rparen);
+	TokenIndex rparen_index;
+	GroupExpr(TokenIndex lparen, std::unique_ptr<Expression> expr, TokenIndex rparen);
+	const Token &lparen(const std::vector<Token> &tokens) const { return token_at(tokens, lparen_index); }
+	const Token &rparen(const std::vector<Token> &tokens) const { return token_at(tokens, rparen_index); }
+	~GroupExpr() override;
 	void accept(Visitor &v) override;
 };
 struct ReturnExpr : public Expression
 {
-	Token return_keyword;
+	TokenIndex return_keyword_index;
 	std::unique_ptr<Expression> value;
-	ReturnExpr(Token return_keyword, std::unique_ptr<Expression> value);
+	ReturnExpr(TokenIndex return_keyword, std::unique_ptr<Expression> value);
+	const Token &return_keyword(const std::vector<Token> &tokens) const { return token_at(tokens, return_keyword_index); }
+	~ReturnExpr() override;
 	void accept(Visitor &v) override;
 };
 struct IfExpr : public Expression
 {
-	Token if_keyword;
+	TokenIndex if_keyword_index;
 	std::unique_ptr<Expression> condition;
 	std::unique_ptr<Statement> if_branch;
-	Token else_keyword;
+	TokenIndex else_keyword_index;
 	std::unique_ptr<Statement> else_branch;
-	IfExpr(Token if_keyword, std::unique_ptr<Expression> condition, std::unique_ptr<Statement> if_branch, Token else_keyword, std::unique_ptr<Statement> else_branch);
+	IfExpr(TokenIndex if_keyword, std::unique_ptr<Expression> condition, std::unique_ptr<Statement> if_branch, TokenIndex else_keyword, std::unique_ptr<Statement> else_branch);
+	const Token &if_keyword(const std::vector<Token> &tokens) const { return token_at(tokens, if_keyword_index); }
+	const Token &else_keyword(const std::vector<Token> &tokens) const { return token_at(tokens, else_keyword_index); }
+	~IfExpr() override;
 	void accept(Visitor &v) override;
 };
 struct WhileExpr : public Expression
 {
-	Token while_keyword;
+	TokenIndex while_keyword_index;
 	std::unique_ptr<Expression> condition;
 	std::unique_ptr<Statement> body;
-	WhileExpr(Token while_keyword, std::unique_ptr<Expression> condition, std::unique_ptr<Statement> body);
+	WhileExpr(TokenIndex while_keyword, std::unique_ptr<Expression> condition, std::unique_ptr<Statement> body);
+	const Token &while_keyword(const std::vector<Token> &tokens) const { return token_at(tokens, while_keyword_index); }
+	~WhileExpr() override;
 	void accept(Visitor &v) override;
 };
 struct Invalid : public Node
 {
+	Invalid();
 	void accept(Visitor &v) override;
 };
 struct Block : public Statement
 {
-	Token lbrace;
+	TokenIndex lbrace_index;
 	std::vector<std::unique_ptr<Statement>> statements;
-	Token rbrace;
-	Block(Token lbrace, std::vector<std::unique_ptr<Statement>> statements, Token rbrace);
+	TokenIndex rbrace_index;
+	Block(TokenIndex lbrace, std::vector<std::unique_ptr<Statement>> statements, TokenIndex rbrace);
+	const Token &lbrace(const std::vector<Token> &tokens) const { return token_at(tokens, lbrace_index); }
+	const Token &rbrace(const std::vector<Token> &tokens) const { return token_at(tokens, rbrace_index); }
+	~Block() override;
 	void accept(Visitor &v) override;
 };
 struct Parameter : public Node
@@ -166,11 +210,16 @@ struct Parameter : public Node
 	std::unique_ptr<Identifier> name;
 	std::unique_ptr<Type> type;
 	Parameter(std::unique_ptr<Identifier> name, std::unique_ptr<Type> type);
+	~Parameter() override;
 	void accept(Visitor &v) override;
 };
 struct Type : public Node
 {
-	Token token;
-	Type(Token token);
+	TokenIndex token_index;
+	explicit Type(TokenIndex token);
+	const Token &token(const std::vector<Token> &tokens) const { return token_at(tokens, token_index); }
 	void accept(Visitor &v) override;
 };
+
+// bytes of a node of the given kind, not counting what its fields own
+size_t node_size(NodeKind kind);
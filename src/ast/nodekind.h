@@ -0,0 +1,29 @@
+// generated by nodegen.py; do not edit
+
+#pragma once
+
+enum class NodeKind : unsigned char
+{
+	Program,
+	ExprStatement,
+	VariableDef,
+	FunctionDef,
+	Import,
+	NumberLiteral,
+	StringLiteral,
+	BooleanLiteral,
+	UnitLiteral,
+	Identifier,
+	FunctionCall,
+	InfixOperator,
+	PrefixOperator,
+	PostfixOperator,
+	GroupExpr,
+	ReturnExpr,
+	IfExpr,
+	WhileExpr,
+	Invalid,
+	Block,
+	Parameter,
+	Type,
+};
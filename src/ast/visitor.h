@@ -6,6 +6,7 @@ struct Program;
 struct ExprStatement;
 struct VariableDef;
 struct FunctionDef;
+struct Import;
 struct NumberLiteral;
 struct StringLiteral;
 struct BooleanLiteral;
@@ -31,6 +32,7 @@ public:
 	virtual void visit(ExprStatement &node) = 0;
 	virtual void visit(VariableDef &node) = 0;
 	virtual void visit(FunctionDef &node) = 0;
+	virtual void visit(Import &node) = 0;
 	virtual void visit(NumberLiteral &node) = 0;
 	virtual void visit(StringLiteral &node) = 0;
 	virtual void visit(BooleanLiteral &node) = 0;
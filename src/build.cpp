@@ -0,0 +1,377 @@
+#include "build.h"
+
+#include "log.h"
+#include "util/util.h"
+#include "util/threadpool.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace Build
+{
+	namespace
+	{
+		struct Module
+		{
+			Module(std::string name, fs::path directory, const Compiler::Options &options)
+				: name(std::move(name)),
+				  directory(std::move(directory)),
+				  context(options)
+			{}
+
+			std::string name, source;
+			// where its imports are looked up
+			fs::path directory;
+			// read when the module is parsed; an input is read already
+			bool loaded = false;
+			// imported, but could not be read; the importer reports it
+			bool missing = false;
+
+			Compiler::Context context;
+			Compiler::Status status = Compiler::Status::Ok;
+			// the modules it imports, by the name it imports them with
+			std::vector<std::pair<std::string_view, size_t>> imports;
+
+			// longest chain of imports below it
+			size_t level = 0;
+			// the import cycle it is on, if any
+			std::string cycle;
+			bool cyclic = false;
+			// an imported module that failed
+			const Module *blocked_by = nullptr;
+
+			bool failed() const
+			{
+				return status != Compiler::Status::Ok || cyclic || blocked_by;
+			}
+		};
+
+		class Builder
+		{
+		public:
+			explicit Builder(const Compiler::Options &options)
+				: options(options)
+			{}
+
+			Report run(std::vector<Input> &inputs, const Backend &backend)
+			{
+				discover(inputs);
+				order();
+				check();
+
+				Report report;
+				for(const auto &module : modules)
+				{
+					if(module->missing) continue;
+					report.modules++;
+					if(module->failed()) report.failed++;
+				}
+
+				if(backend && report.failed == 0)
+					backend(units());
+				return report;
+			}
+
+		private:
+			Compiler::Options options;
+			std::unique_ptr<Util::ThreadPool> pool;
+
+			std::vector<std::unique_ptr<Module>> modules;
+			// module of every file, by canonical path
+			std::unordered_map<std::string, size_t> paths;
+			// the modules in the order they were checked
+			std::vector<size_t> checked;
+
+			// a module's own context gets the threads unless it is checked
+			// alongside others; the trace follows one module at a time
+			bool parallel(size_t count) const
+			{
+				return options.threads != 1 && count > 1 && !Logger::get().tracing();
+			}
+
+			void for_each(size_t count, const std::function<void(size_t)> &task)
+			{
+				if(!parallel(count))
+				{
+					for(size_t i = 0; i < count; i++)
+						task(i);
+					return;
+				}
+
+				if(!pool) pool = std::make_unique<Util::ThreadPool>(options.threads);
+				pool->for_each(count, task);
+			}
+
+			Compiler::Options module_options(size_t count) const
+			{
+				auto result = options;
+				if(parallel(count)) result.threads = 1;
+				return result;
+			}
+
+			// parses the inputs, then whatever they import, one level of
+			// imports at a time
+			void discover(std::vector<Input> &inputs)
+			{
+				std::vector<size_t> wave;
+				for(auto &input : inputs)
+				{
+					fs::path directory;
+					if(input.is_file)
+					{
+						std::error_code error;
+						auto path = fs::canonical(input.name, error);
+						if(!error && !paths.emplace(path.string(), modules.size()).second)
+							continue;
+						directory = fs::path(input.name).parent_path();
+					}
+
+					auto module = std::make_unique<Module>(input.name, directory, options);
+					module->source = std::move(input.source);
+					module->loaded = true;
+					wave.push_back(modules.size());
+					modules.push_back(std::move(module));
+				}
+
+				while(!wave.empty())
+				{
+					auto wave_options = module_options(wave.size());
+					for_each(wave.size(), [&](size_t i)
+					{
+						auto &module = *modules[wave[i]];
+						if(!module.loaded)
+						{
+							try
+							{
+								module.source = Util::read_file(module.name);
+							}
+							catch(std::ifstream::failure &e)
+							{
+								module.missing = true;
+								return;
+							}
+						}
+
+						Logger::Unit unit(module.name);
+						TRACE(Logger::get().debug("Compiling file '", module.name, "'"));
+						module.context.options = wave_options;
+						module.status = module.context.parse(module.name, module.source);
+					});
+
+					std::vector<size_t> next;
+					for(auto index : wave)
+					{
+						auto &module = *modules[index];
+						if(module.missing || module.status != Compiler::Status::Ok) continue;
+
+						for(auto import : module.context.imports())
+						{
+							auto name = import->name(module.context.token_list()).value;
+							auto path = module.directory / (std::string(name) + ".cy");
+
+							// a file that does not exist is reported by the importer
+							std::error_code error;
+							auto key = fs::canonical(path, error);
+							if(error) continue;
+
+							auto [it, added] = paths.emplace(key.string(), modules.size());
+							if(added)
+							{
+								next.push_back(modules.size());
+								modules.push_back(std::make_unique<Module>(path.lexically_normal().string(), path.parent_path(), options));
+							}
+							module.imports.emplace_back(name, it->second);
+						}
+					}
+					wave = std::move(next);
+				}
+			}
+
+			// finds the level of every module with a depth-first walk of its
+			// imports; an import back to a module still on the walk closes a
+			// cycle, and the modules on it are not checked
+			void order()
+			{
+				enum class Visit : char { None, Open, Done };
+				std::vector<Visit> visits(modules.size(), Visit::None);
+
+				struct Frame
+				{
+					size_t module, next_import;
+				};
+				std::vector<Frame> stack;
+
+				for(size_t root = 0; root < modules.size(); root++)
+				{
+					if(visits[root] != Visit::None) continue;
+					visits[root] = Visit::Open;
+					stack.push_back({ root, 0 });
+
+					while(!stack.empty())
+					{
+						auto index = stack.back().module;
+						auto &module = *modules[index];
+						if(stack.back().next_import < module.imports.size())
+						{
+							auto imported = module.imports[stack.back().next_import++].second;
+							if(visits[imported] == Visit::None)
+							{
+								visits[imported] = Visit::Open;
+								stack.push_back({ imported, 0 });
+							}
+							else if(visits[imported] == Visit::Open)
+							{
+								auto start = std::find_if(stack.begin(), stack.end(), [&](const Frame &frame)
+								{
+									return frame.module == imported;
+								});
+
+								// every module on the cycle reports it, starting from itself
+								std::vector<size_t> members;
+								for(auto frame = start; frame != stack.end(); frame++)
+									members.push_back(frame->module);
+								for(size_t i = 0; i < members.size(); i++)
+								{
+									auto &member = *modules[members[i]];
+									if(member.cyclic) continue;
+									member.cyclic = true;
+									member.cycle = "import cycle: ";
+									for(size_t j = 0; j < members.size(); j++)
+										member.cycle += "'" + modules[members[(i + j) % members.size()]]->name + "' -> ";
+									member.cycle += "'" + member.name + "'";
+								}
+							}
+							continue;
+						}
+
+						for(const auto &import : module.imports)
+						{
+							module.level = std::max(module.level, modules[import.second]->level + 1);
+						}
+						visits[index] = Visit::Done;
+						stack.pop_back();
+					}
+				}
+			}
+
+			// checks the modules level by level; everything a module imports
+			// is on a lower level, so its summary is ready
+			void check()
+			{
+				std::vector<std::vector<size_t>> levels;
+				for(size_t i = 0; i < modules.size(); i++)
+				{
+					const auto &module = *modules[i];
+					if(module.missing) continue;
+					if(module.level >= levels.size()) levels.resize(module.level + 1);
+					levels[module.level].push_back(i);
+				}
+
+				for(const auto &level : levels)
+				{
+					checked.insert(checked.end(), level.begin(), level.end());
+					std::vector<size_t> ready;
+					for(auto index : level)
+					{
+						auto &module = *modules[index];
+						if(module.status != Compiler::Status::Ok || module.cyclic) continue;
+
+						for(const auto &import : module.imports)
+						{
+							const auto &imported = *modules[import.second];
+							if(!imported.missing && imported.failed())
+							{
+								module.blocked_by = &imported;
+								break;
+							}
+						}
+						if(!module.blocked_by) ready.push_back(index);
+					}
+
+					auto wave_options = module_options(ready.size());
+					auto analyze = [&](size_t i)
+					{
+						auto &module = *modules[ready[i]];
+						ModuleImports imports;
+						for(const auto &import : module.imports)
+						{
+							const auto &imported = *modules[import.second];
+							if(!imported.missing)
+								imports.emplace(import.first, &imported.context.summary());
+						}
+
+						Logger::Unit unit(module.name);
+						module.context.options = wave_options;
+						module.status = module.context.analyze(imports);
+					};
+
+					// one at a time, each module is printed as soon as it is checked
+					if(!parallel(ready.size()))
+					{
+						size_t next = 0;
+						for(auto index : level)
+						{
+							if(next < ready.size() && ready[next] == index)
+								analyze(next++);
+							print(*modules[index]);
+						}
+						continue;
+					}
+
+					for_each(ready.size(), analyze);
+					for(auto index : level)
+					{
+						print(*modules[index]);
+					}
+				}
+			}
+
+			// the modules in the order they were checked, which puts every
+			// module after those it imports
+			std::vector<Unit> units() const
+			{
+				std::vector<size_t> position(modules.size());
+				for(size_t i = 0; i < checked.size(); i++)
+					position[checked[i]] = i;
+
+				std::vector<Unit> result;
+				for(auto index : checked)
+				{
+					auto &module = *modules[index];
+					result.push_back({ module.context, {} });
+					for(const auto &import : module.imports)
+						result.back().imports.emplace_back(import.first, position[import.second]);
+				}
+				return result;
+			}
+
+			void print(Module &module)
+			{
+				Logger::Unit unit(module.name);
+				if(!module.cycle.empty())
+					Logger::get().error(module.cycle);
+				if(module.blocked_by)
+					Logger::get().error("imported module '", module.blocked_by->name, "' was rejected");
+
+				module.context.print();
+				if(module.failed())
+				{
+					Logger::get().error("terminating compilation for file '", module.name, "'");
+					Logger::get().flush();
+				}
+			}
+		};
+	}
+
+	Report build(std::vector<Input> inputs, const Compiler::Options &options, const Backend &backend)
+	{
+		Builder builder(options);
+		return builder.run(inputs, backend);
+	}
+}
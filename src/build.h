@@ -0,0 +1,55 @@
+#pragma once
+
+#include "compiler.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Build
+{
+	// a source named on the command line
+	struct Input
+	{
+		// shown in diagnostics; a path if the source was read from a file
+		std::string name;
+		std::string source;
+		bool is_file;
+	};
+
+	struct Report
+	{
+		// inputs and the modules they import, each counted once
+		size_t modules = 0;
+		// rejected, or not checked because a module they import was
+		size_t failed = 0;
+	};
+
+	// a checked module, as a backend sees it; the optimizer changes its tree
+	// and adds tokens for the nodes it builds
+	struct Unit
+	{
+		Compiler::Context &context;
+		// the modules it imports, by the name it imports them with, as
+		// indices into the units
+		std::vector<std::pair<std::string_view, size_t>> imports;
+	};
+
+	// runs once every module passed, with each module after the modules it
+	// imports
+	using Backend = std::function<void(const std::vector<Unit> &units)>;
+
+	// Checks the inputs and every module they import, and prints their
+	// diagnostics. 'import name' refers to the file name.cy in the directory
+	// of the importing file, or the working directory for stdin; a file is
+	// one module however many times and however it is named.
+	//
+	// The modules are checked in dependency order, each against the exported
+	// signatures of the modules it imports, so no body is checked twice.
+	// With more than one thread, the modules that only depend on already
+	// checked ones are parsed and checked in parallel, wave after wave; the
+	// output is the same as with one thread.
+	Report build(std::vector<Input> inputs, const Compiler::Options &options, const Backend &backend = {});
+}
@@ -2,10 +2,25 @@
 
 #include "log.h"
 #include "util/util.h"
-#include "util/error.h"
 #include "compiler.h"
+#include "build.h"
+#include "server.h"
+#include "protocol.h"
+#include "codegen/cemitter.h"
+#include "optimize/optimize.h"
+#include "interp/lower.h"
+#include "interp/bytecode.h"
+#include "interp/interpreter.h"
+#include "interp/profiler.h"
+#include "interp/tier.h"
+#include "interp/perfmap.h"
 
 #include <fstream>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
 
 namespace CLI
 {
@@ -14,30 +29,161 @@ namespace CLI
 		std::vector<std::string_view> inputs;
 		bool debug;
 		bool help;
+		LogFormat log_format;
+		std::string_view log_file;
+		bool emit_c;
+		std::string_view output;
+		unsigned level;
+		bool stats;
+		bool run;
+		std::optional<Interp::ProfileMode> profile;
+		std::string_view profile_output;
+		std::optional<Interp::JitMode> jit;
+		std::optional<Interp::PerfFormat> perf;
+		bool bytecode;
+		Compiler::Options compiler;
 	};
 
 	void print_help()
 	{
 		Logger::get().info(
 		    R"(Usage: cygnus [options] inputs...
+       cygnus run [options] input
+       cygnus serve [--socket=<path>]
+Inputs:
+  A '.cy' file, or '-' to read the source from stdin; 'run' also takes a '.cyc' file
 Options:
   -h, --help: Print this help message
-  -d, --debug: Enable debug logging messages)"
+  -d, --debug: Enable debug logging messages
+  --flat-ast: Run semantic analysis over a struct-of-arrays AST
+  --emit-c: Compile the input and its imports to an executable through C, using $CC (default cc)
+  --output=<path>: Path of the executable; the C source is written next to it with '.c' appended (default the input without '.cy', or a.out)
+  -O0, -O1, -O2: Optimization level of '--emit-c' and 'run'; 0 turns the optimizer off, 2 inlines larger functions (default 1)
+  --stats: Print what the optimizer did
+  --profile[=<sample|instrument>]: With 'run', print where the program spent its time; 'instrument' times every call instead of sampling (default sample)
+  --profile-output=<path>: Where '--profile' writes the collapsed stacks for flame graphs (default the input without '.cy', with '.folded' appended)
+  --jit[=<tiered|eager>]: With 'run', compile functions that run often to native code with $CC while the program runs; 'eager' compiles every function before it starts (default tiered)
+  --perf[=<map|jitdump>]: With 'run', compile as '--jit' does and write /tmp/perf-<pid>.map, which names the native code for Linux perf; 'jitdump' also writes /tmp/jit-<pid>.dump for 'perf inject --jit' (default map)
+  --no-bytecode: With 'run', neither run nor write the '.cyc' file next to the input
+  --max-errors=<n>: Stop parsing a file after n syntax errors, 0 for no limit (default 100)
+  --threads=<n>: Check modules and function bodies on n threads, 0 for one per core (default 1)
+  --log-format=<terminal|plain|json>: Format of the log output (default terminal, plain with --log-file)
+  --log-file=<path>: Write the log to a file instead of stdout
+  --server[=<path>]: Compile in a running 'cygnus serve' instead of this process
+Serve options:
+  --socket=<path>: Unix socket to listen on (default $XDG_RUNTIME_DIR/cygnus.sock))"
 		);
 	}
 
+	void print_stats(const Optimize::Stats &stats)
+	{
+		const auto &inlined = stats.inlined;
+		const auto &loops = stats.loops;
+		const auto &removed = stats.removed;
+		Logger::get().info("Optimization level ", stats.level);
+		Logger::get().info("  inlined ", inlined.calls, " calls (", inlined.calls_in_loops, " in loops) to ", inlined.functions, " functions, ", inlined.nodes, " nodes added");
+		Logger::get().info("  left ", inlined.too_large, " calls to functions too large to inline, and those to ", inlined.recursive, " recursive functions");
+		Logger::get().info("  in ", loops.loops, " loops, hoisted ", loops.hoisted, " invariants and replaced ", loops.reduced, " operations on ", loops.induction, " induction variables with ", loops.counters, " counters");
+		Logger::get().info("  removed ", removed.functions, " functions, ", removed.variables, " variables and ", removed.statements, " unreachable statements (", removed.nodes, " nodes)");
+	}
+
+	// the profile goes to the log, the collapsed stacks to a file
+	void write_profile(const Interp::Profiler &profiler, const std::string &path)
+	{
+		for(const auto &line : profiler.report())
+			Logger::get().info(line);
+
+		std::ofstream stream(path, std::ios::binary);
+		stream << profiler.collapsed();
+		stream.close();
+		if(stream)
+			Logger::get().info("Wrote the collapsed stacks to '", path, "'");
+		else
+			Logger::get().error("unable to write '", path, "'");
+	}
+
+	// runs a lowered program, and prints its profile if asked to
+	int run_program(const Interp::Program &program, const Options &options, const Console &console)
+	{
+		std::string profile_output(options.profile_output);
+		if(profile_output.empty())
+		{
+			auto input = options.inputs[0];
+			profile_output = (input == "-" ? "cygnus" : std::string(input.substr(0, input.find_last_of('.')))) + ".folded";
+		}
+
+		std::optional<Interp::Profiler> profiler;
+		if(options.profile)
+			profiler.emplace(program, *options.profile);
+
+		// native code would run unseen by the profiler
+		auto jit = options.jit;
+		if(!jit && options.perf)
+			jit = Interp::JitMode::Tiered;
+		std::optional<Interp::PerfMap> perf;
+		std::optional<Interp::Tier> tier;
+		if(jit && profiler)
+			Logger::get().warn("'--jit' and '--perf' are not used with '--profile'");
+		else if(jit)
+		{
+			if(options.perf)
+			{
+				perf.emplace(*options.perf);
+				if(!perf->open())
+					perf.reset();
+			}
+			tier.emplace(program, *jit, perf ? &*perf : nullptr);
+			tier->start();
+		}
+
+		Interp::Interpreter interpreter(program, console.out, profiler ? &*profiler : nullptr, tier ? &*tier : nullptr);
+		int status = interpreter.run() ? 0 : 1;
+		if(profiler)
+			write_profile(*profiler, profile_output);
+		if(tier)
+		{
+			tier->stop();
+			if(options.stats)
+			{
+				const auto &stats = tier->stats();
+				Logger::get().info("Compiled ", stats.compiled, " functions to native code in ", stats.batches, " batches and ", stats.nanoseconds / 1000000, " ms; ", stats.failed, " failed");
+			}
+		}
+		return status;
+	}
+
+	// of a '.cy' input
+	std::string bytecode_path(std::string_view input)
+	{
+		return std::string(input.substr(0, input.size() - 3)) + ".cyc";
+	}
+
 	Options parse_options(const std::vector<std::string_view> &args)
 	{
 		Options options =
 		{
 			.inputs = {},
 			.debug = false,
-			.help = false
+			.help = false,
+			.log_format = LogFormat::Terminal,
+			.log_file = {},
+			.emit_c = false,
+			.output = {},
+			.level = Optimize::default_level,
+			.stats = false,
+			.run = false,
+			.profile = {},
+			.profile_output = {},
+			.jit = {},
+			.perf = {},
+			.bytecode = true,
+			.compiler = {}
 		};
 
+		bool log_format = false;
 		for(const auto &arg : args)
 		{
-			if(arg[0] == '-')
+			if(arg.size() > 1 && arg[0] == '-')
 			{
 				if(arg == "-d" || arg == "--debug")
 				{
@@ -47,6 +193,94 @@ Options:
 				{
 					options.help = true;
 				}
+				else if(arg == "--flat-ast")
+				{
+					options.compiler.flat_ast = true;
+				}
+				else if(arg == "--emit-c")
+				{
+					options.emit_c = true;
+				}
+				else if(arg.substr(0, 9) == "--output=")
+				{
+					options.output = arg.substr(9);
+				}
+				else if(arg == "-O0" || arg == "-O1" || arg == "-O2")
+				{
+					options.level = arg[2] - '0';
+				}
+				else if(arg == "--stats")
+				{
+					options.stats = true;
+				}
+				else if(arg == "--profile" || arg == "--profile=sample")
+				{
+					options.profile = Interp::ProfileMode::Sample;
+				}
+				else if(arg == "--profile=instrument")
+				{
+					options.profile = Interp::ProfileMode::Instrument;
+				}
+				else if(arg == "--jit" || arg == "--jit=tiered")
+				{
+					options.jit = Interp::JitMode::Tiered;
+				}
+				else if(arg == "--jit=eager")
+				{
+					options.jit = Interp::JitMode::Eager;
+				}
+				else if(arg == "--perf" || arg == "--perf=map")
+				{
+					options.perf = Interp::PerfFormat::Map;
+				}
+				else if(arg == "--perf=jitdump")
+				{
+					options.perf = Interp::PerfFormat::Jitdump;
+				}
+				else if(arg.substr(0, 17) == "--profile-output=")
+				{
+					options.profile_output = arg.substr(17);
+				}
+				else if(arg == "--no-bytecode")
+				{
+					options.bytecode = false;
+				}
+				else if(arg.substr(0, 13) == "--max-errors=")
+				{
+					auto value = std::string(arg.substr(13));
+					if(!value.empty() && std::all_of(value.begin(), value.end(), isdigit))
+						options.compiler.max_errors = std::stoul(value);
+					else
+						Logger::get().warn("invalid value for option '", arg, "'");
+				}
+				else if(arg.substr(0, 10) == "--threads=")
+				{
+					auto value = std::string(arg.substr(10));
+					if(!value.empty() && std::all_of(value.begin(), value.end(), isdigit))
+						options.compiler.threads = std::stoul(value);
+					else
+						Logger::get().warn("invalid value for option '", arg, "'");
+				}
+				else if(arg.substr(0, 13) == "--log-format=")
+				{
+					auto value = arg.substr(13);
+					log_format = true;
+					if(value == "terminal")
+						options.log_format = LogFormat::Terminal;
+					else if(value == "plain")
+						options.log_format = LogFormat::Plain;
+					else if(value == "json")
+						options.log_format = LogFormat::Json;
+					else
+					{
+						log_format = false;
+						Logger::get().warn("invalid value for option '", arg, "'");
+					}
+				}
+				else if(arg.substr(0, 11) == "--log-file=")
+				{
+					options.log_file = arg.substr(11);
+				}
 				else
 				{
 					Logger::get().warn("invalid option '", arg, "'");
@@ -58,37 +292,127 @@ Options:
 			}
 		}
 
+		// escape codes are only useful on a terminal
+		if(!options.log_file.empty() && !log_format)
+			options.log_format = LogFormat::Plain;
+
 		return options;
 	}
 
-	void execute(const std::vector<std::string_view> &args)
+	int serve(const std::vector<std::string_view> &args)
 	{
-		auto options = parse_options(args);
+		std::string socket = Server::default_socket();
+		for(const auto &arg : args)
+		{
+			if(arg.substr(0, 9) == "--socket=")
+				socket = arg.substr(9);
+			else
+				Logger::get().warn("invalid option '", arg, "'");
+		}
+
+		return Server::serve(socket);
+	}
+
+	int execute(const std::vector<std::string_view> &args, const Console &console)
+	{
+		if(!args.empty() && args[0] == "serve")
+			return serve({ args.begin() + 1, args.end() });
+
+		// forward everything else to a server if asked to
+		auto server = std::find_if(args.begin(), args.end(), [](auto arg)
+		{
+			return arg == "--server" || arg.substr(0, 9) == "--server=";
+		});
+		if(server != args.end())
+		{
+			std::string socket = *server == "--server" ? Server::default_socket() : std::string(server->substr(9));
+			std::vector<std::string_view> forwarded(args.begin(), server);
+			forwarded.insert(forwarded.end(), server + 1, args.end());
+
+			int status = Server::forward(socket.c_str(), forwarded.data(), forwarded.size());
+			if(status >= 0)
+				return status;
+			// no server is listening; compiling here gives the same result
+			return execute(forwarded, console);
+		}
+
+		bool run = !args.empty() && args[0] == "run";
+		auto options = parse_options(run ? std::vector<std::string_view>(args.begin() + 1, args.end()) : args);
+		options.run = run;
 
 		// process options
 
+		if(options.log_format != LogFormat::Terminal || !options.log_file.empty() || console.out != stdout)
+		{
+			if(!Logger::get().set_output(options.log_format, options.log_file, console.out))
+				Logger::get().error("unable to open log file '", options.log_file, "'");
+		}
+
 		if(options.help)
 		{
 			print_help();
-			std::exit(0);
+			return 0;
 		}
 
 		if(options.debug)
 		{
 			Logger::get().set_level(LogLevel::Debug);
 			Logger::get().info("Enabled debug logging");
+			if(!Logger::get().tracing())
+				Logger::get().warn("debug tracing was compiled out of this build (CYGNUS_TRACE=0)");
 		}
 
 		if(options.inputs.empty())
 		{
 			Logger::get().error("no inputs given");
 			Logger::get().info("Run 'cygnus --help' for usage");
-			std::exit(0);
+			return 0;
 		}
 
-		// compile inputs
+		// a '.cyc' input, or the file next to a '.cy' one if its sources did
+		// not change, runs without reading or checking them
+		if(options.run && options.inputs.size() == 1)
+		{
+			auto input = options.inputs[0];
+			bool compiled = input.size() > 4 && input.substr(input.size() - 4) == ".cyc";
+			bool source = input.size() > 3 && input.substr(input.size() - 3) == ".cy";
+			if(compiled || (source && options.bytecode))
+			{
+				auto path = compiled ? std::string(input) : bytecode_path(input);
+				Interp::Program program;
+				auto status = Interp::load(path, !compiled, options.level, program);
+				if(status == Interp::LoadStatus::Loaded)
+				{
+					Logger::get().debug("Running '", path, "'");
+					return run_program(program, options, console);
+				}
+
+				if(compiled)
+				{
+					if(status == Interp::LoadStatus::Missing)
+						Logger::get().error("unable to open file '", input, "'");
+					else
+						Logger::get().error("'", input, "' is not a bytecode file this version of cygnus can run");
+					return 1;
+				}
+				if(status == Interp::LoadStatus::Stale)
+					Logger::get().debug("'", path, "' is out of date");
+				else if(status == Interp::LoadStatus::Invalid)
+					Logger::get().debug("'", path, "' is not a bytecode file this version of cygnus can run");
+			}
+		}
+
+		// read inputs
+		std::vector<Build::Input> inputs;
 		for(const auto &input : options.inputs)
 		{
+			if(input == "-")
+			{
+				std::string source = console.in ? *console.in : std::string(std::istreambuf_iterator<char>(std::cin), {});
+				inputs.push_back({ "<stdin>", std::move(source), false });
+				continue;
+			}
+
 			auto dot_index = input.find_last_of(".");
 			std::string_view ext = input.substr(dot_index + 1);
 			if(dot_index == std::string_view::npos || ext == "")
@@ -102,25 +426,107 @@ Options:
 				continue;
 			}
 
+			Logger::Unit unit(input);
 			try
 			{
-				std::string source = Util::read_file(input);
-				Logger::get().debug("Compiling file '", input, "'");
-				try
-				{
-					Compiler::compile(input, source);
-				}
-				catch(Util::Error &e)
-				{
-					e.print(input, source);
-					Logger::get().error("terminating compilation for file '", input, "'");
-				}
+				inputs.push_back({ std::string(input), Util::read_file(input), true });
 			}
 			catch(std::ifstream::failure &e)
 			{
 				Logger::get().error("unable to open file '", input, "'");
+				Logger::get().flush();
 			}
 
 		}
+
+		if(options.profile && !options.run)
+			Logger::get().warn("'--profile' is only used by 'cygnus run'");
+		if((options.jit || options.perf) && !options.run)
+			Logger::get().warn("'--jit' and '--perf' are only used by 'cygnus run'");
+
+		if(options.run)
+		{
+			if(options.inputs.size() > 1)
+			{
+				Logger::get().error("'run' takes a single input, which imports the others");
+				return 1;
+			}
+			if(inputs.empty())
+				return 1;
+			if(options.emit_c)
+				Logger::get().warn("'--emit-c' is ignored with 'run'");
+
+			// the interpreter reads the symbols and types the tree passes leave
+			if(options.compiler.flat_ast)
+			{
+				Logger::get().warn("'--flat-ast' is ignored with 'run'");
+				options.compiler.flat_ast = false;
+			}
+
+			// the program is saved for the next run before it runs
+			std::string bytecode;
+			if(options.bytecode && inputs[0].is_file)
+				bytecode = bytecode_path(inputs[0].name);
+
+			int status = 1;
+			Build::build(std::move(inputs), options.compiler, [&](const std::vector<Build::Unit> &units)
+			{
+				auto stats = Optimize::optimize(units, options.level);
+				if(options.stats)
+					print_stats(stats);
+
+				Interp::Program program;
+				if(!Interp::lower(units, program))
+					return;
+
+				if(!bytecode.empty())
+				{
+					std::vector<std::string_view> sources;
+					for(const auto &unit : units)
+						sources.push_back(unit.context.diagnostics().source());
+					if(!Interp::save(program, sources, options.level, bytecode))
+						Logger::get().warn("unable to write '", bytecode, "'");
+				}
+				status = run_program(program, options, console);
+			});
+			return status;
+		}
+
+		if(options.emit_c)
+		{
+			if(options.inputs.size() > 1)
+			{
+				Logger::get().error("'--emit-c' takes a single input, which imports the others");
+				return 1;
+			}
+			if(inputs.empty())
+				return 1;
+
+			// the emitter reads the symbols and types the tree passes leave
+			if(options.compiler.flat_ast)
+			{
+				Logger::get().warn("'--flat-ast' is ignored with '--emit-c'");
+				options.compiler.flat_ast = false;
+			}
+
+			std::string output(options.output);
+			if(output.empty())
+				output = inputs[0].is_file ? inputs[0].name.substr(0, inputs[0].name.size() - 3) : "a.out";
+
+			bool built = false;
+			Build::build(std::move(inputs), options.compiler, [&](const std::vector<Build::Unit> &units)
+			{
+				auto stats = Optimize::optimize(units, options.level);
+				if(options.stats)
+					print_stats(stats);
+				built = CodeGen::build_executable(units, output);
+			});
+			return built ? 0 : 1;
+		}
+
+		// compile inputs and their imports
+		Build::build(std::move(inputs), options.compiler);
+
+		return 0;
 	}
 }
@@ -1,9 +1,21 @@
 #pragma once
 
+#include <cstdio>
+#include <optional>
+#include <string>
 #include <vector>
 #include <string_view>
 
 namespace CLI
 {
-	void execute(const std::vector<std::string_view> &args);
+	// where a run writes its log and reads the '-' input from
+	struct Console
+	{
+		std::FILE *out = stdout;
+		// source of the '-' input; read from stdin if not set
+		std::optional<std::string> in;
+	};
+
+	// returns the exit status
+	int execute(const std::vector<std::string_view> &args, const Console &console = {});
 }
@@ -0,0 +1,54 @@
+#include "protocol.h"
+
+#include <unistd.h>
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+// cygnus-client [--socket=<path>] <cygnus arguments>
+//
+// Forwards its arguments to a running 'cygnus serve'. Only libc is linked, so
+// starting it costs a fraction of starting the compiler; if no server is
+// listening, the cygnus next to this binary is run instead.
+int main(int argc, char *argv[])
+{
+	char socket[PATH_MAX];
+	Server::default_socket(socket, sizeof(socket));
+
+	int first = 1;
+	if(argc > 1 && std::strncmp(argv[1], "--socket=", 9) == 0)
+	{
+		std::snprintf(socket, sizeof(socket), "%s", argv[1] + 9);
+		first = 2;
+	}
+
+	auto count = static_cast<size_t>(argc - first);
+	auto args = static_cast<std::string_view *>(std::malloc((count + 1) * sizeof(std::string_view)));
+	if(!args) return 1;
+	for(size_t i = 0; i < count; i++)
+		args[i] = argv[first + i];
+
+	int status = Server::forward(socket, args, count);
+	std::free(args);
+	if(status >= 0) return status;
+
+	// no server is listening
+	char compiler[PATH_MAX];
+	auto length = ::readlink("/proc/self/exe", compiler, sizeof(compiler) - 1);
+	if(length < 0)
+	{
+		std::fputs("cygnus-client: no server is listening and cygnus can't be found\n", stderr);
+		return 1;
+	}
+	compiler[length] = '\0';
+	auto slash = std::strrchr(compiler, '/');
+	std::snprintf(slash + 1, sizeof(compiler) - (slash + 1 - compiler), "cygnus");
+
+	argv[first - 1] = compiler;
+	::execv(compiler, argv + first - 1);
+	std::fprintf(stderr, "cygnus-client: unable to run '%s'\n", compiler);
+	return 1;
+}
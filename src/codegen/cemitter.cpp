@@ -0,0 +1,1445 @@
+#include "cemitter.h"
+
+#include "log.h"
+#include "lang.h"
+
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+extern char **environ;
+
+namespace CodeGen
+{
+	namespace
+	{
+		// written at the top of every program
+		constexpr const char *runtime = R"c(/* generated by cygnus; do not edit */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t cy_unit;
+#define CY_UNIT ((cy_unit)0)
+
+/* immutable; the bytes are never freed */
+typedef struct
+{
+	const char *data;
+	int64_t length;
+} cy_string;
+#define CY_STRING(text, length) ((cy_string){ text, length })
+
+static void cy_fail(const char *message)
+{
+	fflush(stdout);
+	fprintf(stderr, "error: %s\n", message);
+	exit(1);
+}
+
+/* integers wrap around */
+static inline int64_t cy_add(int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }
+static inline int64_t cy_sub(int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }
+static inline int64_t cy_mul(int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }
+static inline int64_t cy_neg(int64_t a) { return (int64_t)(0 - (uint64_t)a); }
+
+static inline int64_t cy_div(int64_t a, int64_t b)
+{
+	if(b == 0) cy_fail("division by zero");
+	if(b == -1) return cy_neg(a);
+	return a / b;
+}
+
+static inline int64_t cy_mod(int64_t a, int64_t b)
+{
+	if(b == 0) cy_fail("division by zero");
+	if(b == -1) return 0;
+	return a % b;
+}
+
+static inline int64_t cy_postinc(int64_t *a)
+{
+	int64_t old = *a;
+	*a = cy_add(old, 1);
+	return old;
+}
+
+static inline int64_t cy_postdec(int64_t *a)
+{
+	int64_t old = *a;
+	*a = cy_sub(old, 1);
+	return old;
+}
+
+/*
+ * Strings are allocated from chunks that are never freed. The last string
+ * allocated ends at cy_top, and appending to it only copies what is
+ * appended, so a string built by repeated concatenation is copied about
+ * once in total.
+ */
+static char *cy_top, *cy_end;
+static const char *cy_last;
+
+static char *cy_alloc(int64_t size)
+{
+	if(cy_end - cy_top < size)
+	{
+		int64_t chunk = size < (1 << 19) ? (1 << 20) : 2 * size;
+		cy_top = malloc(chunk);
+		if(!cy_top) cy_fail("out of memory");
+		cy_end = cy_top + chunk;
+	}
+	cy_last = cy_top;
+	cy_top += size;
+	return (char *)cy_last;
+}
+
+static cy_string cy_append(cy_string a, const char *data, int64_t length)
+{
+	if(length == 0) return a;
+	if(a.length > 0 && a.data == cy_last && a.data + a.length == cy_top && cy_end - cy_top >= length)
+	{
+		memcpy(cy_top, data, length);
+		cy_top += length;
+		a.length += length;
+		return a;
+	}
+	char *result = cy_alloc(a.length + length);
+	if(a.length > 0) memcpy(result, a.data, a.length);
+	memcpy(result + a.length, data, length);
+	return CY_STRING(result, a.length + length);
+}
+
+static cy_string cy_concat(cy_string a, cy_string b)
+{
+	if(a.length == 0) return b;
+	return cy_append(a, b.data, b.length);
+}
+
+static inline bool cy_string_equal(cy_string a, cy_string b)
+{
+	return a.length == b.length && (a.length == 0 || memcmp(a.data, b.data, a.length) == 0);
+}
+
+static int cy_format_int(char *buffer, int64_t value)
+{
+	char digits[24];
+	int count = 0, length = 0;
+	uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+	do
+	{
+		digits[count++] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	}
+	while(magnitude);
+	if(value < 0) buffer[length++] = '-';
+	while(count) buffer[length++] = digits[--count];
+	return length;
+}
+
+/* the shortest text that reads back as the same value, with a '.0' if it would read as an integer */
+static int cy_format_float(char *buffer, double value)
+{
+	int length = 0;
+	for(int precision = 1; precision <= 17; precision++)
+	{
+		length = snprintf(buffer, 32, "%.*g", precision, value);
+		if(strtod(buffer, NULL) == value) break;
+	}
+	if(strspn(buffer, "-0123456789") == (size_t)length)
+	{
+		buffer[length++] = '.';
+		buffer[length++] = '0';
+	}
+	return length;
+}
+
+static cy_string cy_int_string(int64_t value)
+{
+	char buffer[24];
+	return cy_append(CY_STRING("", 0), buffer, cy_format_int(buffer, value));
+}
+
+static cy_string cy_float_string(double value)
+{
+	char buffer[40];
+	return cy_append(CY_STRING("", 0), buffer, cy_format_float(buffer, value));
+}
+
+static inline cy_string cy_bool_string(bool value)
+{
+	return value ? CY_STRING("true", 4) : CY_STRING("false", 5);
+}
+
+static inline cy_string cy_unit_string(cy_unit value)
+{
+	(void)value;
+	return CY_STRING("()", 2);
+}
+
+static cy_string cy_append_int(cy_string a, int64_t value)
+{
+	char buffer[24];
+	return cy_append(a, buffer, cy_format_int(buffer, value));
+}
+
+static cy_string cy_append_float(cy_string a, double value)
+{
+	char buffer[40];
+	return cy_append(a, buffer, cy_format_float(buffer, value));
+}
+
+/* built-in functions */
+
+static cy_unit cy_print(cy_string text)
+{
+	fwrite(text.data, 1, text.length, stdout);
+	putchar('\n');
+	return CY_UNIT;
+}
+)c";
+
+		// C string literal of the bytes; octal escapes, since a hex escape
+		// would run into a following digit
+		std::string c_string(std::string_view text)
+		{
+			std::string result = "\"";
+			for(unsigned char c : text)
+			{
+				if(c == '"' || c == '\\')
+				{
+					result += '\\';
+					result += c;
+				}
+				// no trigraphs
+				else if(c == '?')
+					result += "\\?";
+				else if(c == '\n')
+					result += "\\n";
+				else if(c == '\t')
+					result += "\\t";
+				else if(c >= 0x20 && c < 0x7f)
+					result += c;
+				else
+				{
+					char escape[8];
+					std::snprintf(escape, sizeof escape, "\\%03o", c);
+					result += escape;
+				}
+			}
+			return result + "\"";
+		}
+
+		// same text as cy_format_float prints at run time
+		std::string c_float(double value)
+		{
+			char buffer[40];
+			int length = 0;
+			for(int precision = 1; precision <= 17; precision++)
+			{
+				length = std::snprintf(buffer, 32, "%.*g", precision, value);
+				if(std::strtod(buffer, nullptr) == value) break;
+			}
+			std::string result(buffer, length);
+			if(result.find_first_not_of("-0123456789") == std::string::npos)
+				result += ".0";
+			return result;
+		}
+
+		// without the parentheses around all of it, if there are any
+		std::string_view bare(std::string_view text)
+		{
+			if(text.size() < 2 || text.front() != '(' || text.back() != ')') return text;
+
+			int depth = 0;
+			bool quoted = false;
+			for(size_t i = 0; i < text.size(); i++)
+			{
+				auto c = text[i];
+				if(quoted)
+				{
+					if(c == '\\') i++;
+					else if(c == '"') quoted = false;
+					continue;
+				}
+				if(c == '"') quoted = true;
+				else if(c == '(') depth++;
+				else if(c == ')' && --depth == 0 && i != text.size() - 1) return text;
+			}
+			return text.substr(1, text.size() - 2);
+		}
+
+		Expression &ungroup(Expression &node)
+		{
+			auto expr = &node;
+			while(expr->kind == NodeKind::GroupExpr)
+				expr = static_cast<GroupExpr *>(expr)->expr.get();
+			return *expr;
+		}
+
+		bool is_literal(Expression &node)
+		{
+			auto kind = ungroup(node).kind;
+			return kind == NodeKind::NumberLiteral || kind == NodeKind::StringLiteral || kind == NodeKind::BooleanLiteral || kind == NodeKind::UnitLiteral;
+		}
+
+		// the operands analyze and lower look into
+		template<typename F>
+		void for_each_operand(Expression &node, F &&function)
+		{
+			switch(node.kind)
+			{
+				case NodeKind::InfixOperator:
+					function(static_cast<InfixOperator &>(node).left.get());
+					function(static_cast<InfixOperator &>(node).right.get());
+					break;
+				case NodeKind::PrefixOperator:
+					function(static_cast<PrefixOperator &>(node).operand.get());
+					break;
+				case NodeKind::PostfixOperator:
+					function(static_cast<PostfixOperator &>(node).operand.get());
+					break;
+				case NodeKind::GroupExpr:
+					function(static_cast<GroupExpr &>(node).expr.get());
+					break;
+				case NodeKind::FunctionCall:
+					for(const auto &arg : static_cast<FunctionCall &>(node).arguments)
+						function(arg.get());
+					break;
+				default:
+					break;
+			}
+		}
+
+		bool is_logical(std::string_view op)
+		{
+			return op == "and" || op == "&&" || op == "or" || op == "||";
+		}
+	}
+
+	bool CEmitter::add(Program *program, Util::DiagnosticEngine &diagnostics, const ConstantPool &constants, const std::unordered_map<std::string_view, size_t> &imports)
+	{
+		this->diagnostics = &diagnostics;
+		this->tokens = &diagnostics.tokens();
+		this->constants = &constants;
+		this->imports = &imports;
+		error = false;
+
+		auto module = std::to_string(exports.size());
+		exports.emplace_back();
+
+		begin(program, CType::Unit);
+		if(program) dispatch(*program);
+		functions += "static void cy_module" + module + "(void)\n{\n" + body + "}\n\n";
+		main += "\tcy_module" + module + "();\n";
+
+		// nested functions are queued while their enclosing one is written
+		for(size_t i = 0; i < pending.size(); i++)
+		{
+			write_function(*pending[i]);
+		}
+		pending.clear();
+
+		return !error;
+	}
+
+	std::string CEmitter::finish() const
+	{
+		std::string source = runtime;
+		if(!prototypes.empty()) source += "\n" + prototypes;
+		if(!globals.empty()) source += "\n" + globals;
+		source += "\n" + functions;
+		source += "int main(void)\n{\n" + main + "\treturn 0;\n}\n";
+		return source;
+	}
+
+	void CEmitter::begin(const Node *function, CType returns)
+	{
+		owner = function;
+		return_type = returns;
+		info.clear();
+		temporaries = 0;
+		body.clear();
+		indent = 1;
+	}
+
+	void CEmitter::line(std::string_view text)
+	{
+		body.append(indent, '\t');
+		body += text;
+		body += '\n';
+	}
+
+	// every name gets a number, so C never sees two definitions of one name;
+	// generated names never end in one
+	std::string CEmitter::define(Identifier &node, const Node *function)
+	{
+		auto name = std::string(node.token(*tokens).value) + "_" + std::to_string(names++);
+		definitions[&node] = { name, function };
+		return name;
+	}
+
+	std::string CEmitter::declare(FunctionDef &node)
+	{
+		auto name = define(*node.name, nullptr);
+		const auto &signature = node.name->symbol->type;
+
+		std::string parameters;
+		for(const auto &type : signature.parameter_types)
+		{
+			if(!parameters.empty()) parameters += ", ";
+			parameters += c_type(ctype(type));
+		}
+		if(parameters.empty()) parameters = "void";
+
+		prototypes += std::string("static ") + c_type(value_type(signature.value)) + " " + name + "(" + parameters + ");\n";
+		pending.push_back(&node);
+		return name;
+	}
+
+	void CEmitter::write_function(FunctionDef &node)
+	{
+		const auto &signature = node.name->symbol->type;
+		begin(&node, value_type(signature.value));
+
+		std::string parameters;
+		for(const auto &param : node.parameters)
+		{
+			if(!parameters.empty()) parameters += ", ";
+			parameters += c_type(ctype(param->name->symbol->type));
+			parameters += " " + define(*param->name, &node);
+		}
+		if(parameters.empty()) parameters = "void";
+
+		for(const auto &stmt : node.body->statements)
+		{
+			dispatch(*stmt);
+		}
+
+		// a function that returns something always ends in a return
+		const auto &statements = node.body->statements;
+		bool returns = !statements.empty()
+		               && statements.back()->kind == NodeKind::ExprStatement
+		               && static_cast<ExprStatement &>(*statements.back()).expr->kind == NodeKind::ReturnExpr;
+		if(return_type == CType::Unit && !returns)
+			line("return CY_UNIT;");
+
+		functions += std::string("static ") + c_type(return_type) + " " + definitions.at(node.name.get()).name + "(" + parameters + ")\n{\n" + body + "}\n\n";
+	}
+
+	// the statements of a block without braces of their own
+	void CEmitter::write_body(Statement &node)
+	{
+		if(node.kind != NodeKind::Block)
+		{
+			dispatch(node);
+			return;
+		}
+
+		for(const auto &stmt : static_cast<Block &>(node).statements)
+		{
+			dispatch(*stmt);
+		}
+	}
+
+	void CEmitter::unsupported(Node *node, std::string what)
+	{
+		error = true;
+		diagnostics->report(node, Util::DiagnosticCode::Unsupported, what);
+	}
+
+	// symbols
+
+	// the symbol table leaves a reference with the symbol it found, which the
+	// type checker then replaced on the defining identifier with a typed one
+	const DataType &CEmitter::symbol_type(Identifier &node) const
+	{
+		const auto &symbol = *node.symbol;
+		if(symbol.type.is_function || symbol.type != DataType::Invalid || !symbol.node || symbol.node->kind != NodeKind::Identifier)
+			return symbol.type;
+		return static_cast<Identifier *>(symbol.node)->symbol->type;
+	}
+
+	std::string CEmitter::reference(Identifier &node)
+	{
+		auto id = node.token(*tokens).value;
+		const auto &symbol = *node.symbol;
+
+		// built-in function
+		if(!symbol.node)
+			return "cy_" + std::string(id);
+
+		if(symbol.node->kind == NodeKind::Import)
+		{
+			auto module = static_cast<Import *>(symbol.node)->name(*tokens).value;
+			return exports[imports->at(module)].at(id);
+		}
+
+		const auto &definition = definitions.at(static_cast<Identifier *>(symbol.node));
+		if(definition.owner && definition.owner != owner)
+			unsupported(&node, "using a variable of an enclosing function");
+		return definition.name;
+	}
+
+	// the variable an assignment or increment changes
+	std::string CEmitter::target(Expression &node)
+	{
+		auto &id = static_cast<Identifier &>(ungroup(node));
+		if(symbol_type(id).is_function)
+			unsupported(&id, "assigning to a function");
+		return reference(id);
+	}
+
+	// types and effects
+
+	// of root and the operators, groups and calls below it, walked with an
+	// explicit stack like in the type checker
+	const CEmitter::Info &CEmitter::analyze(Expression &root)
+	{
+		auto found = info.find(&root);
+		if(found != info.end()) return found->second;
+
+		std::vector<std::pair<Expression *, bool>> stack = { { &root, false } };
+		while(!stack.empty())
+		{
+			auto [node, ready] = stack.back();
+			if(ready)
+			{
+				stack.pop_back();
+				auto result = describe(*node);
+				for_each_operand(*node, [&](Expression *child)
+				{
+					result.depth = std::max(result.depth, info.at(child).depth + 1);
+				});
+				info[node] = result;
+				continue;
+			}
+
+			stack.back().second = true;
+			for_each_operand(*node, [&](Expression *child)
+			{
+				if(!info.count(child)) stack.push_back({ child, false });
+			});
+		}
+
+		return info.at(&root);
+	}
+
+	// the operands are described already
+	CEmitter::Info CEmitter::describe(Expression &node)
+	{
+		switch(node.kind)
+		{
+			case NodeKind::NumberLiteral:
+			{
+				auto constant = static_cast<NumberLiteral &>(node).token(*tokens).constant;
+				return { (*constants)[constant].kind == Constant::Kind::Float ? CType::Float : CType::Integer, false };
+			}
+			case NodeKind::StringLiteral:
+				return { CType::String, false };
+			case NodeKind::BooleanLiteral:
+				return { CType::Boolean, false };
+			case NodeKind::UnitLiteral:
+				return { CType::Unit, false };
+			case NodeKind::Identifier:
+				return { ctype(symbol_type(static_cast<Identifier &>(node))), false };
+			case NodeKind::FunctionCall:
+				return { value_type(symbol_type(*static_cast<FunctionCall &>(node).name).value), true };
+			case NodeKind::InfixOperator:
+			{
+				auto &op = static_cast<InfixOperator &>(node);
+				auto sym = op.token(*tokens).value;
+				const auto &left = info.at(op.left.get());
+				const auto &right = info.at(op.right.get());
+				bool effects = left.effects || right.effects;
+
+				if(Lang::is_assignment(sym))
+					return { left.type, true };
+				if(Lang::is_boolean_op(sym))
+					return { CType::Boolean, effects };
+				if(sym == "+" && (left.type == CType::String || right.type == CType::String))
+					return { CType::String, effects };
+				// integer division stops the program on a zero
+				return { left.type, effects || (left.type == CType::Integer && (sym == "/" || sym == "%")) };
+			}
+			case NodeKind::PrefixOperator:
+			{
+				auto &op = static_cast<PrefixOperator &>(node);
+				auto sym = op.token(*tokens).value;
+				const auto &operand = info.at(op.operand.get());
+
+				if(Lang::is_boolean_op(sym))
+					return { CType::Boolean, operand.effects };
+				return { operand.type, operand.effects || sym == "++" || sym == "--" };
+			}
+			case NodeKind::PostfixOperator:
+				return { CType::Integer, true };
+			case NodeKind::GroupExpr:
+				return info.at(static_cast<GroupExpr &>(node).expr.get());
+			case NodeKind::ReturnExpr:
+			{
+				auto &value = static_cast<ReturnExpr &>(node).value;
+				return { value ? analyze(*value).type : CType::Unit, true };
+			}
+			case NodeKind::IfExpr:
+				return { statement_type(*static_cast<IfExpr &>(node).if_branch), true };
+			case NodeKind::WhileExpr:
+				return { CType::Unit, true };
+			default:
+				return { CType::Unit, false };
+		}
+	}
+
+	// as the type checker types a branch of an if
+	CEmitter::CType CEmitter::statement_type(Statement &node)
+	{
+		switch(node.kind)
+		{
+			case NodeKind::ExprStatement:
+				return analyze(*static_cast<ExprStatement &>(node).expr).type;
+			case NodeKind::VariableDef:
+				return ctype(static_cast<VariableDef &>(node).name->symbol->type);
+			case NodeKind::FunctionDef:
+				return CType::Function;
+			case NodeKind::Block:
+			{
+				// the type of the first return directly in it
+				for(const auto &stmt : static_cast<Block &>(node).statements)
+				{
+					if(stmt->kind != NodeKind::ExprStatement) continue;
+					auto &expr = *static_cast<ExprStatement &>(*stmt).expr;
+					if(expr.kind == NodeKind::ReturnExpr)
+						return analyze(expr).type;
+				}
+				return CType::Unit;
+			}
+			default:
+				return CType::Unit;
+		}
+	}
+
+	// expressions
+
+	// operator chains, groups and calls can nest arbitrarily deep, so they are
+	// lowered with an explicit stack; a subtree without effects is written
+	// as it is
+	CEmitter::Value CEmitter::lower(Expression &root)
+	{
+		const auto &root_info = analyze(root);
+		if(!root_info.effects && root_info.depth <= max_depth) return lower_pure(root);
+
+		struct Frame
+		{
+			Expression *node;
+			size_t stage;
+		};
+		std::vector<Frame> stack = { { &root, 0 } };
+		std::vector<Value> values;
+
+		auto pop = [&values]()
+		{
+			auto value = std::move(values.back());
+			values.pop_back();
+			return value;
+		};
+
+		// queues the operand, or lowers it now if it has no effects and is
+		// shallow enough
+		auto operand = [&](Expression *node)
+		{
+			const auto &operand_info = info.at(node);
+			if(operand_info.effects || operand_info.depth > max_depth)
+				stack.push_back({ node, 0 });
+			else
+				values.push_back(lower_pure(*node));
+		};
+
+		// the last count values are operands left of next; they go to
+		// temporaries if next could change them, or if they have effects of
+		// their own and next reads something, so that C cannot evaluate them
+		// in another order
+		auto sequence = [&](size_t count, Expression *next)
+		{
+			bool needed = info.at(next).effects;
+			if(!needed && !is_literal(*next))
+			{
+				for(size_t i = values.size() - count; i < values.size(); i++)
+				{
+					needed = needed || values[i].kind == Value::Kind::Effect;
+				}
+			}
+			if(!needed) return;
+
+			for(size_t i = values.size() - count; i < values.size(); i++)
+			{
+				spill(values[i]);
+			}
+		};
+
+		auto combined = [](const Value &left, const Value &right, bool effects)
+		{
+			return effects || left.kind == Value::Kind::Effect || right.kind == Value::Kind::Effect
+			       ? Value::Kind::Effect
+			       : Value::Kind::Pure;
+		};
+
+		while(!stack.empty())
+		{
+			auto node = stack.back().node;
+			auto stage = stack.back().stage++;
+
+			switch(node->kind)
+			{
+				case NodeKind::InfixOperator:
+				{
+					auto &op = static_cast<InfixOperator &>(*node);
+					auto sym = op.token(*tokens).value;
+
+					if(Lang::is_assignment(sym))
+					{
+						if(stage == 0)
+						{
+							operand(op.right.get());
+							continue;
+						}
+
+						auto value = pop();
+						values.push_back({ "(" + target(*op.left) + " = " + std::string(bare(value.text)) + ")", value.type, Value::Kind::Effect, value.depth + 1 });
+						break;
+					}
+
+					// the right operand is only evaluated, statements and
+					// all, if the left one does not decide the result
+					if(is_logical(sym) && info.at(op.right.get()).effects)
+					{
+						if(stage == 0)
+						{
+							operand(op.left.get());
+							continue;
+						}
+						if(stage == 1)
+						{
+							auto left = pop();
+							auto result = temporary(CType::Boolean, std::string(bare(left.text)));
+							line((sym == "and" || sym == "&&" ? "if(" : "if(!") + result + ")");
+							line("{");
+							indent++;
+							values.push_back({ result, CType::Boolean, Value::Kind::Temporary });
+							operand(op.right.get());
+							continue;
+						}
+
+						auto right = pop();
+						line(values.back().text + " = " + std::string(bare(right.text)) + ";");
+						indent--;
+						line("}");
+						break;
+					}
+
+					if(stage == 0)
+					{
+						operand(op.left.get());
+						continue;
+					}
+					if(stage == 1)
+					{
+						sequence(1, op.right.get());
+						operand(op.right.get());
+						continue;
+					}
+
+					auto right = pop();
+					auto left = pop();
+					auto shape = infix_shape(sym, left.type, right.type);
+					bool stops = left.type == CType::Integer && right.type == CType::Integer && (sym == "/" || sym == "%");
+					values.push_back({ shape.prefix + left.text + shape.middle + right.text + shape.suffix, info.at(&op).type, combined(left, right, stops), std::max(left.depth, right.depth) + 1 });
+					break;
+				}
+				case NodeKind::PrefixOperator:
+				{
+					auto &op = static_cast<PrefixOperator &>(*node);
+					auto sym = op.token(*tokens).value;
+
+					if((sym == "++" || sym == "--") && ungroup(*op.operand).kind == NodeKind::Identifier)
+					{
+						auto name = target(*op.operand);
+						values.push_back({ "(" + name + " = " + (sym == "++" ? "cy_add(" : "cy_sub(") + name + ", 1))", CType::Integer, Value::Kind::Effect });
+						break;
+					}
+
+					if(stage == 0)
+					{
+						operand(op.operand.get());
+						continue;
+					}
+
+					auto value = pop();
+					auto shape = prefix_shape(sym, value.type);
+					values.push_back({ shape.prefix + value.text + shape.suffix, info.at(&op).type, combined(value, value, false), value.depth + 1 });
+					break;
+				}
+				case NodeKind::PostfixOperator:
+				{
+					auto &op = static_cast<PostfixOperator &>(*node);
+					auto sym = op.token(*tokens).value;
+
+					if(ungroup(*op.operand).kind == NodeKind::Identifier)
+					{
+						auto name = target(*op.operand);
+						values.push_back({ (sym == "++" ? "cy_postinc(&" : "cy_postdec(&") + name + ")", CType::Integer, Value::Kind::Effect });
+						break;
+					}
+
+					// nothing to change; the value is the operand's
+					if(stage == 0)
+					{
+						operand(op.operand.get());
+						continue;
+					}
+					break;
+				}
+				case NodeKind::GroupExpr:
+				{
+					if(stage == 0)
+					{
+						operand(static_cast<GroupExpr &>(*node).expr.get());
+						continue;
+					}
+					break;
+				}
+				case NodeKind::FunctionCall:
+				{
+					auto &call = static_cast<FunctionCall &>(*node);
+					auto count = call.arguments.size();
+					if(stage < count)
+					{
+						sequence(stage, call.arguments[stage].get());
+						operand(call.arguments[stage].get());
+						continue;
+					}
+
+					std::string arguments;
+					unsigned depth = 0;
+					for(auto arg = values.end() - count; arg != values.end(); arg++)
+					{
+						if(!arguments.empty()) arguments += ", ";
+						arguments += bare(arg->text);
+						depth = std::max(depth, arg->depth);
+					}
+					values.resize(values.size() - count);
+					values.push_back({ reference(*call.name) + "(" + arguments + ")", info.at(&call).type, Value::Kind::Effect, depth + 1 });
+					break;
+				}
+				case NodeKind::ReturnExpr:
+				{
+					auto &ret = static_cast<ReturnExpr &>(*node);
+					if(stage == 0 && ret.value)
+					{
+						operand(ret.value.get());
+						continue;
+					}
+
+					auto value = ret.value ? pop() : Value { "CY_UNIT", CType::Unit, Value::Kind::Constant };
+					lower_return(ret, value);
+					// never read; the code after a return is not reached
+					values.push_back({ zero(value.type), value.type, Value::Kind::Constant });
+					break;
+				}
+				case NodeKind::IfExpr:
+					values.push_back(lower_if(static_cast<IfExpr &>(*node), true));
+					break;
+				case NodeKind::WhileExpr:
+					lower_while(static_cast<WhileExpr &>(*node));
+					values.push_back({ "CY_UNIT", CType::Unit, Value::Kind::Constant });
+					break;
+				default:
+					values.push_back(lower_pure(*node));
+					break;
+			}
+
+			if(values.back().depth > max_depth)
+				spill(values.back());
+			stack.pop_back();
+		}
+
+		return values.back();
+	}
+
+	CEmitter::Value CEmitter::lower_pure(Expression &node)
+	{
+		auto &expr = ungroup(node);
+		auto kind = Value::Kind::Pure;
+		if(expr.kind == NodeKind::Identifier)
+			kind = Value::Kind::Variable;
+		else if(is_literal(expr))
+			kind = Value::Kind::Constant;
+
+		const auto &node_info = info.at(&node);
+		return { pure(node), node_info.type, kind, node_info.depth };
+	}
+
+	// writes an expression without effects in one pass, so a long chain of
+	// operators takes time in proportion to its length
+	std::string CEmitter::pure(Expression &root)
+	{
+		struct Frame
+		{
+			Expression *node;
+			unsigned stage;
+		};
+		std::vector<Frame> stack = { { &root, 0 } };
+		std::string text;
+
+		while(!stack.empty())
+		{
+			auto node = stack.back().node;
+			auto stage = stack.back().stage++;
+
+			switch(node->kind)
+			{
+				case NodeKind::InfixOperator:
+				{
+					auto &op = static_cast<InfixOperator &>(*node);
+					auto shape = infix_shape(op.token(*tokens).value, info.at(op.left.get()).type, info.at(op.right.get()).type);
+					if(stage == 0)
+					{
+						text += shape.prefix;
+						stack.push_back({ op.left.get(), 0 });
+						continue;
+					}
+					if(stage == 1)
+					{
+						text += shape.middle;
+						stack.push_back({ op.right.get(), 0 });
+						continue;
+					}
+					text += shape.suffix;
+					break;
+				}
+				case NodeKind::PrefixOperator:
+				{
+					auto &op = static_cast<PrefixOperator &>(*node);
+					auto shape = prefix_shape(op.token(*tokens).value, info.at(op.operand.get()).type);
+					if(stage == 0)
+					{
+						text += shape.prefix;
+						stack.push_back({ op.operand.get(), 0 });
+						continue;
+					}
+					text += shape.suffix;
+					break;
+				}
+				case NodeKind::GroupExpr:
+				{
+					if(stage == 0)
+					{
+						stack.push_back({ static_cast<GroupExpr &>(*node).expr.get(), 0 });
+						continue;
+					}
+					break;
+				}
+				case NodeKind::Identifier:
+				{
+					auto &id = static_cast<Identifier &>(*node);
+					if(symbol_type(id).is_function)
+						unsupported(&id, "using a function as a value");
+					text += reference(id);
+					break;
+				}
+				default:
+					text += literal(*node);
+					break;
+			}
+
+			stack.pop_back();
+		}
+
+		return text;
+	}
+
+	std::string CEmitter::literal(Expression &node) const
+	{
+		switch(node.kind)
+		{
+			case NodeKind::NumberLiteral:
+			{
+				const auto &constant = (*constants)[static_cast<NumberLiteral &>(node).token(*tokens).constant];
+				if(constant.kind == Constant::Kind::Float)
+					return c_float(constant.real);
+				if(constant.integer > INT32_MAX)
+					return "INT64_C(" + std::to_string(constant.integer) + ")";
+				return std::to_string(constant.integer);
+			}
+			case NodeKind::StringLiteral:
+			{
+				auto text = (*constants)[static_cast<StringLiteral &>(node).token(*tokens).constant].text;
+				return "CY_STRING(" + c_string(text) + ", " + std::to_string(text.size()) + ")";
+			}
+			case NodeKind::BooleanLiteral:
+				return std::string(static_cast<BooleanLiteral &>(node).token(*tokens).value);
+			default:
+				return "CY_UNIT";
+		}
+	}
+
+	CEmitter::Value CEmitter::lower_if(IfExpr &node, bool used)
+	{
+		auto type = analyze(node).type;
+		auto condition = lower(*node.condition);
+
+		// a value of () is the same whichever branch ran
+		std::string result;
+		if(used && type != CType::Unit)
+			result = temporary(type, zero(type));
+
+		line("if(" + std::string(bare(condition.text)) + ")");
+		line("{");
+		indent++;
+		lower_branch(*node.if_branch, result);
+		indent--;
+		line("}");
+
+		if(node.else_branch)
+		{
+			line("else");
+			line("{");
+			indent++;
+			lower_branch(*node.else_branch, result);
+			indent--;
+			line("}");
+		}
+
+		if(result.empty())
+			return { "CY_UNIT", CType::Unit, Value::Kind::Constant };
+		return { result, type, Value::Kind::Temporary };
+	}
+
+	// a block typed by its return never ends normally, so only a statement
+	// that is not a block gives the if a value
+	void CEmitter::lower_branch(Statement &node, const std::string &result)
+	{
+		if(result.empty())
+		{
+			write_body(node);
+			return;
+		}
+
+		switch(node.kind)
+		{
+			case NodeKind::ExprStatement:
+			{
+				auto value = lower(*static_cast<ExprStatement &>(node).expr);
+				line(result + " = " + std::string(bare(value.text)) + ";");
+				break;
+			}
+			case NodeKind::VariableDef:
+			{
+				dispatch(node);
+				line(result + " = " + definitions.at(static_cast<VariableDef &>(node).name.get()).name + ";");
+				break;
+			}
+			case NodeKind::FunctionDef:
+			{
+				unsupported(&node, "using a function as a value");
+				dispatch(node);
+				break;
+			}
+			default:
+				write_body(node);
+				break;
+		}
+	}
+
+	void CEmitter::lower_while(WhileExpr &node)
+	{
+		auto mark = body.size();
+		indent++;
+		auto condition = lower(*node.condition);
+		indent--;
+
+		if(body.size() == mark)
+		{
+			line("while(" + std::string(bare(condition.text)) + ")");
+			line("{");
+			indent++;
+			write_body(*node.body);
+			indent--;
+			line("}");
+			return;
+		}
+
+		// the statements the condition needs run before every check
+		auto statements = body.substr(mark);
+		body.resize(mark);
+		line("for(;;)");
+		line("{");
+		body += statements;
+		indent++;
+		line("if(!(" + std::string(bare(condition.text)) + ")) break;");
+		write_body(*node.body);
+		indent--;
+		line("}");
+	}
+
+	void CEmitter::lower_return(ReturnExpr &node, const Value &value)
+	{
+		// the top level of a module returns nothing
+		if(owner && owner->kind == NodeKind::Program)
+		{
+			if(value.kind == Value::Kind::Effect) line(std::string(bare(value.text)) + ";");
+			line("return;");
+			return;
+		}
+
+		// only the first return directly in the body is checked against the signature
+		if(value.type != return_type)
+			unsupported(&node, std::string("returning '") + type_name(value.type) + "' from a function that returns '" + type_name(return_type) + "'");
+		line("return " + std::string(bare(value.text)) + ";");
+	}
+
+	// an expression statement; only what it does is kept
+	void CEmitter::discard(Expression &node)
+	{
+		switch(node.kind)
+		{
+			case NodeKind::IfExpr:
+				lower_if(static_cast<IfExpr &>(node), false);
+				return;
+			case NodeKind::WhileExpr:
+				lower_while(static_cast<WhileExpr &>(node));
+				return;
+			default:
+				break;
+		}
+
+		auto value = lower(node);
+		if(value.kind == Value::Kind::Effect)
+			line(std::string(bare(value.text)) + ";");
+	}
+
+	std::string CEmitter::temporary(CType type, const std::string &text)
+	{
+		auto name = "t" + std::to_string(temporaries++);
+		line(std::string(c_type(type)) + " " + name + " = " + text + ";");
+		return name;
+	}
+
+	void CEmitter::spill(Value &value)
+	{
+		if(value.kind == Value::Kind::Constant || value.kind == Value::Kind::Temporary) return;
+		value.text = temporary(value.type, std::string(bare(value.text)));
+		value.kind = Value::Kind::Temporary;
+		value.depth = 1;
+	}
+
+	// C for an operator with operands of the given types; integer arithmetic
+	// goes through the runtime, so it wraps around instead of overflowing
+	CEmitter::Shape CEmitter::infix_shape(std::string_view op, CType left, CType right)
+	{
+		if(op == "and" || op == "&&")
+			return { "(", " && ", ")" };
+		if(op == "or" || op == "||")
+			return { "(", " || ", ")" };
+		if(op == "==" || op == "!=")
+		{
+			if(left == CType::String)
+				return { op == "==" ? "cy_string_equal(" : "!cy_string_equal(", ", ", ")" };
+			return { "(", " " + std::string(op) + " ", ")" };
+		}
+		if(Lang::is_boolean_op(op))
+			return { "(", " " + std::string(op) + " ", ")" };
+
+		if(left == CType::String || right == CType::String)
+		{
+			auto convert = [](CType type) -> std::string
+			{
+				switch(type)
+				{
+					case CType::Integer: return "cy_int_string(";
+					case CType::Float: return "cy_float_string(";
+					case CType::Boolean: return "cy_bool_string(";
+					case CType::Unit: return "cy_unit_string(";
+					default: return "(";
+				}
+			};
+
+			if(left == CType::String)
+			{
+				// appended without a string in between
+				if(right == CType::Integer)
+					return { "cy_append_int(", ", ", ")" };
+				if(right == CType::Float)
+					return { "cy_append_float(", ", ", ")" };
+				if(right == CType::String)
+					return { "cy_concat(", ", ", ")" };
+				return { "cy_concat(", ", " + convert(right), "))" };
+			}
+			return { "cy_concat(" + convert(left), "), ", ")" };
+		}
+
+		if(left == CType::Integer)
+		{
+			if(op == "+") return { "cy_add(", ", ", ")" };
+			if(op == "-") return { "cy_sub(", ", ", ")" };
+			if(op == "*") return { "cy_mul(", ", ", ")" };
+			if(op == "/") return { "cy_div(", ", ", ")" };
+			return { "cy_mod(", ", ", ")" };
+		}
+		return { "(", " " + std::string(op) + " ", ")" };
+	}
+
+	CEmitter::Shape CEmitter::prefix_shape(std::string_view op, CType operand)
+	{
+		if(op == "-")
+			return operand == CType::Integer ? Shape { "cy_neg(", "", ")" } : Shape { "(-", "", ")" };
+		if(op == "!" || op == "not")
+			return { "(!", "", ")" };
+		// of something that is not a variable, so nothing is changed
+		if(op == "++")
+			return { "cy_add(", "", ", 1)" };
+		if(op == "--")
+			return { "cy_sub(", "", ", 1)" };
+		return { "(", "", ")" };
+	}
+
+	// statements
+
+	void CEmitter::visit(Program &node)
+	{
+		// top-level variables are file-scope, since functions read them
+		for(const auto &stmt : node.statements)
+		{
+			if(stmt->kind == NodeKind::VariableDef)
+			{
+				auto &def = static_cast<VariableDef &>(*stmt);
+				auto type = ctype(def.name->symbol->type);
+				auto value = def.value ? std::string(bare(lower(*def.value).text)) : zero(type);
+				auto name = define(*def.name, nullptr);
+				globals += std::string("static ") + c_type(type) + " " + name + ";\n";
+				exports.back()[def.name->token(*tokens).value] = name;
+				line(name + " = " + value + ";");
+			}
+			else if(stmt->kind == NodeKind::FunctionDef)
+			{
+				auto &def = static_cast<FunctionDef &>(*stmt);
+				exports.back()[def.name->token(*tokens).value] = declare(def);
+			}
+			else dispatch(*stmt);
+		}
+	}
+
+	void CEmitter::visit(ExprStatement &node)
+	{
+		discard(*node.expr);
+	}
+	void CEmitter::visit(VariableDef &node)
+	{
+		auto type = ctype(node.name->symbol->type);
+		auto value = node.value ? std::string(bare(lower(*node.value).text)) : zero(type);
+		line(std::string(c_type(type)) + " " + define(*node.name, owner) + " = " + value + ";");
+	}
+	void CEmitter::visit(FunctionDef &node)
+	{
+		declare(node);
+	}
+	void CEmitter::visit(Import &node) {}
+
+	void CEmitter::visit(NumberLiteral &node) { discard(node); }
+	void CEmitter::visit(StringLiteral &node) { discard(node); }
+	void CEmitter::visit(BooleanLiteral &node) { discard(node); }
+	void CEmitter::visit(UnitLiteral &node) { discard(node); }
+	void CEmitter::visit(Identifier &node) { discard(node); }
+	void CEmitter::visit(FunctionCall &node) { discard(node); }
+	void CEmitter::visit(InfixOperator &node) { discard(node); }
+	void CEmitter::visit(PrefixOperator &node) { discard(node); }
+	void CEmitter::visit(PostfixOperator &node) { discard(node); }
+	void CEmitter::visit(GroupExpr &node) { discard(node); }
+	void CEmitter::visit(ReturnExpr &node) { discard(node); }
+	void CEmitter::visit(IfExpr &node) { discard(node); }
+	void CEmitter::visit(WhileExpr &node) { discard(node); }
+
+	void CEmitter::visit(Invalid &node) {}
+	void CEmitter::visit(Block &node)
+	{
+		line("{");
+		indent++;
+		write_body(node);
+		indent--;
+		line("}");
+	}
+	void CEmitter::visit(Parameter &node) {}
+	void CEmitter::visit(Type &node) {}
+
+	// types
+
+	CEmitter::CType CEmitter::ctype(const DataType &type)
+	{
+		return type.is_function ? CType::Function : value_type(type.value);
+	}
+
+	CEmitter::CType CEmitter::value_type(std::string_view name)
+	{
+		if(name == "Int") return CType::Integer;
+		else if(name == "Float") return CType::Float;
+		else if(name == "String") return CType::String;
+		else if(name == "Bool") return CType::Boolean;
+		else return CType::Unit;
+	}
+
+	const char *CEmitter::c_type(CType type)
+	{
+		switch(type)
+		{
+			case CType::Integer: return "int64_t";
+			case CType::Float: return "double";
+			case CType::String: return "cy_string";
+			case CType::Boolean: return "bool";
+			// only in programs that are rejected
+			case CType::Function: return "void *";
+			default: return "cy_unit";
+		}
+	}
+
+	const char *CEmitter::zero(CType type)
+	{
+		switch(type)
+		{
+			case CType::Integer: return "0";
+			case CType::Float: return "0.0";
+			case CType::String: return "CY_STRING(\"\", 0)";
+			case CType::Boolean: return "false";
+			case CType::Function: return "0";
+			default: return "CY_UNIT";
+		}
+	}
+
+	const char *CEmitter::type_name(CType type)
+	{
+		switch(type)
+		{
+			case CType::Integer: return "Int";
+			case CType::Float: return "Float";
+			case CType::String: return "String";
+			case CType::Boolean: return "Bool";
+			case CType::Function: return "function";
+			default: return "()";
+		}
+	}
+
+	// driver
+
+	std::string c_compiler()
+	{
+		auto cc = std::getenv("CC");
+		return cc && *cc ? cc : "cc";
+	}
+
+	namespace
+	{
+		std::vector<std::string> words(const std::string &text)
+		{
+			std::vector<std::string> result;
+			std::istringstream stream(text);
+			for(std::string word; stream >> word;)
+				result.push_back(word);
+			return result;
+		}
+	}
+
+	std::vector<std::string> compiler_command(const std::string &source, const std::string &output, const std::vector<std::string> &flags)
+	{
+		auto arguments = words(c_compiler());
+		for(auto flag : { "-std=c99", "-O2" })
+			arguments.push_back(flag);
+		arguments.insert(arguments.end(), flags.begin(), flags.end());
+		if(auto user = std::getenv("CFLAGS"))
+		{
+			for(auto &flag : words(user))
+				arguments.push_back(std::move(flag));
+		}
+		for(const auto &argument : { "-o", output.c_str(), source.c_str() })
+			arguments.push_back(argument);
+		return arguments;
+	}
+
+	namespace
+	{
+		bool compile(const std::string &source, const std::string &output)
+		{
+			auto arguments = compiler_command(source, output);
+
+			std::vector<char *> argv;
+			for(auto &argument : arguments)
+				argv.push_back(argument.data());
+			argv.push_back(nullptr);
+
+			Logger::get().flush();
+			pid_t pid;
+			if(argv.size() < 2 || posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+			{
+				Logger::get().error("unable to run the C compiler '", c_compiler(), "'");
+				return false;
+			}
+
+			int status = 0;
+			while(waitpid(pid, &status, 0) < 0)
+			{
+				if(errno != EINTR)
+				{
+					status = -1;
+					break;
+				}
+			}
+			if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			{
+				Logger::get().error("the C compiler '", c_compiler(), "' failed on '", source, "'");
+				return false;
+			}
+			return true;
+		}
+	}
+
+	bool build_executable(const std::vector<Build::Unit> &units, const std::string &output)
+	{
+		CEmitter emitter;
+		for(const auto &unit : units)
+		{
+			const auto &context = unit.context;
+			auto file = context.diagnostics().file();
+			Util::DiagnosticEngine diagnostics(file, context.diagnostics().source(), context.token_list());
+			std::unordered_map<std::string_view, size_t> imports(unit.imports.begin(), unit.imports.end());
+
+			if(!emitter.add(context.syntax_tree(), diagnostics, context.constant_pool(), imports))
+			{
+				Logger::Unit log(file);
+				diagnostics.print();
+				Logger::get().error("terminating compilation for file '", file, "'");
+				Logger::get().flush();
+				return false;
+			}
+		}
+
+		auto source = output + ".c";
+		std::ofstream stream(source, std::ios::binary);
+		stream << emitter.finish();
+		stream.close();
+		if(!stream)
+		{
+			Logger::get().error("unable to write '", source, "'");
+			return false;
+		}
+
+		return compile(source, output);
+	}
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "build.h"
+#include "ast/dispatch.h"
+#include "ast/node.h"
+#include "semantic/type.h"
+#include "syntax/constant.h"
+#include "util/diagnostic.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace CodeGen
+{
+	// Translates checked modules to one C99 program. Int becomes int64_t with
+	// wrapping arithmetic, Float double, Bool bool, () cy_unit and String an
+	// immutable cy_string of the runtime written at the top of the program.
+	// Every function becomes a static C function, nested ones included; the
+	// top level of a module becomes a function of its own, and main runs
+	// those in the order the modules were added.
+	//
+	// An expression becomes a single C expression where C evaluates it the
+	// same way. Before an operand with side effects, the operands left of it
+	// are stored in temporaries, so everything is still evaluated left to
+	// right; if and while expressions become statements, and an if whose
+	// value is used stores it in a temporary.
+	//
+	// The modules must have been checked by the tree passes: the emitter
+	// reads the symbols and types they leave on the identifiers.
+	class CEmitter : public StaticVisitor<CEmitter>
+	{
+	public:
+#include "ast/dispatchincl"
+
+		// imports maps every name the module imports to the index of a
+		// module added before it; reports what C cannot express and
+		// returns false if there was any
+		bool add(Program *program, Util::DiagnosticEngine &diagnostics, const ConstantPool &constants, const std::unordered_map<std::string_view, size_t> &imports);
+		// the program made of the modules added so far
+		std::string finish() const;
+
+	private:
+		enum class CType : std::uint8_t
+		{
+			Unit,
+			Integer,
+			Float,
+			String,
+			Boolean,
+			Function
+		};
+
+		// an expression lowered to the statements written so far and a C
+		// expression for its value
+		struct Value
+		{
+			enum class Kind : std::uint8_t
+			{
+				Constant,
+				// assigned once, before the value is used
+				Temporary,
+				// a variable, which an operand right of it may change
+				Variable,
+				// reads variables, but changes nothing
+				Pure,
+				// changes something or may stop the program
+				Effect
+			};
+
+			std::string text;
+			CType type;
+			Kind kind;
+			// of the calls and parentheses in text
+			unsigned depth = 1;
+		};
+
+		// of an expression; effects also counts the statements an if, while
+		// or return needs
+		struct Info
+		{
+			CType type;
+			bool effects;
+			// of the operators, groups and calls, counting this one
+			unsigned depth = 1;
+		};
+
+		// deeper C expressions are split into temporaries; C compilers
+		// recurse on the nesting
+		static constexpr unsigned max_depth = 128;
+
+		struct Definition
+		{
+			std::string name;
+			// the function whose variable it is; null for file-scope names
+			const Node *owner;
+		};
+
+		// the module being added
+		Util::DiagnosticEngine *diagnostics = nullptr;
+		const std::vector<Token> *tokens = nullptr;
+		const ConstantPool *constants = nullptr;
+		const std::unordered_map<std::string_view, size_t> *imports = nullptr;
+		bool error = false;
+
+		// C names, by defining identifier
+		std::unordered_map<const Identifier *, Definition> definitions;
+		// C names of the top-level definitions of every module, by name
+		std::vector<std::unordered_map<std::string_view, std::string>> exports;
+		size_t names = 0;
+
+		// the function being written, or the Program for the top level
+		const Node *owner = nullptr;
+		CType return_type = CType::Unit;
+		std::unordered_map<const Expression *, Info> info;
+		size_t temporaries = 0;
+		std::string body;
+		unsigned indent = 0;
+		// functions declared, but not written yet
+		std::vector<FunctionDef *> pending;
+
+		std::string prototypes, globals, functions, main;
+
+		void begin(const Node *function, CType returns);
+		void line(std::string_view text);
+		std::string define(Identifier &node, const Node *function);
+		std::string declare(FunctionDef &node);
+		void write_function(FunctionDef &node);
+		void write_body(Statement &node);
+		void unsupported(Node *node, std::string what);
+
+		const DataType &symbol_type(Identifier &node) const;
+		std::string reference(Identifier &node);
+		std::string target(Expression &node);
+
+		const Info &analyze(Expression &root);
+		Info describe(Expression &node);
+		CType statement_type(Statement &node);
+
+		Value lower(Expression &root);
+		Value lower_pure(Expression &node);
+		std::string pure(Expression &root);
+		std::string literal(Expression &node) const;
+		Value lower_if(IfExpr &node, bool used);
+		void lower_while(WhileExpr &node);
+		void lower_branch(Statement &node, const std::string &result);
+		void lower_return(ReturnExpr &node, const Value &value);
+		void discard(Expression &node);
+		std::string temporary(CType type, const std::string &text);
+		void spill(Value &value);
+
+		struct Shape
+		{
+			std::string prefix, middle, suffix;
+		};
+		static Shape infix_shape(std::string_view op, CType left, CType right);
+		static Shape prefix_shape(std::string_view op, CType operand);
+
+		static CType ctype(const DataType &type);
+		static CType value_type(std::string_view name);
+		static const char *c_type(CType type);
+		static const char *zero(CType type);
+		static const char *type_name(CType type);
+	};
+
+	// the command that compiles C: $CC, or cc
+	std::string c_compiler();
+	// the arguments of a run of the C compiler on source: the default flags,
+	// then flags, then $CFLAGS, so they can override them
+	std::vector<std::string> compiler_command(const std::string &source, const std::string &output, const std::vector<std::string> &flags = {});
+
+	// translates the units of a build to C, writes it to output + ".c" and
+	// compiles that to the executable output; prints what fails and returns
+	// false
+	bool build_executable(const std::vector<Build::Unit> &units, const std::string &output);
+}
@@ -1,54 +1,332 @@
 #include "compiler.h"
 
 #include "log.h"
+#include "util/error.h"
 #include "util/treeprinter.h"
 #include "syntax/lexer.h"
-#include "syntax/token.h"
 #include "syntax/parser.h"
-#include "ast/node.h"
+#include "ast/flat.h"
 #include "semantic/symtable.h"
 #include "semantic/typecheck.h"
+#include "semantic/flatsymtable.h"
+#include "semantic/flattypecheck.h"
+
+#include <algorithm>
 
 namespace Compiler
 {
-	void compile(std::string_view file, std::string_view source)
+	Context::Context(const Options &options)
+		: options(options)
+	{
+		engine.emplace(file, source, tokens);
+	}
+
+	Status Context::check(std::string_view file, std::string_view source, const ModuleImports &imports)
+	{
+		auto status = parse(file, source);
+		if(status != Status::Ok) return status;
+		return analyze(imports);
+	}
+
+	Status Context::parse(std::string_view file, std::string_view source)
 	{
+		// the previous tree goes first, its diagnostics point into it
+		engine.reset();
+		ast.reset();
+		tokens.clear();
+		constants = {};
+		added.clear();
+		exports.exports.clear();
+		this->file = file;
+		this->source = source;
+		engine.emplace(this->file, this->source, tokens);
+		auto &diagnostics = *engine;
+
+		start_pool();
+		if(parse_chunks())
+			return Status::Ok;
+
 		// lexer
-		Logger::get().debug("Tokenizing '", file, "'");
-		Lexer lexer(file, source);
-		auto tokens = lexer.tokenize();
-		if(lexer.failed()) throw Util::Error();
-		else if(tokens.empty()) return;
+		TRACE(Logger::get().debug("Tokenizing '", file, "'"));
+		Lexer lexer(this->source, diagnostics);
+		tokens = lexer.tokenize();
+		constants = std::move(lexer.constants);
+		if(lexer.failed()) return Status::LexError;
+		else if(tokens.empty()) return Status::Ok;
 
-		Logger::get().debug("Tokens:");
-		for(const auto &token : tokens)
+		if(Logger::get().tracing())
 		{
-			Logger::get().debug("  ", token);
+			Logger::get().debug("Tokens:");
+			for(const auto &token : tokens)
+			{
+				Logger::get().debug("  ", token);
+			}
+			Logger::get().debug();
 		}
-		Logger::get().debug();
 
 		// parser
-		Logger::get().debug("Parsing '", file, "'");
-		Parser parser(tokens, file, source);
-		auto ast = parser.parse();
-		if(parser.failed()) throw Util::Error();
+		TRACE(Logger::get().debug("Parsing '", file, "'"));
+		Parser parser(tokens, diagnostics, options.max_errors);
+		ast = parser.parse();
+		if(parser.failed()) return Status::SyntaxError;
+
+		if(Logger::get().tracing())
+		{
+			Logger::get().debug("AST:");
+			Util::TreePrinter printer(tokens);
+			printer.dispatch(*ast);
+			Logger::get().debug();
+		}
+
+		return Status::Ok;
+	}
+
+	Status Context::analyze(const ModuleImports &imports)
+	{
+		// an empty source has no tree
+		if(!ast) return Status::Ok;
+
+		start_pool();
+		return options.flat_ast ? analyze_flat(imports) : analyze_tree(imports);
+	}
+
+	void Context::start_pool()
+	{
+		if(options.threads == 1)
+			pool.reset();
+		else if(!pool || (options.threads && pool->size() != options.threads))
+			pool = std::make_unique<Util::ThreadPool>(options.threads);
+	}
+
+	// Lexes and parses the chunks between Lexer::split points in parallel and
+	// joins their tokens and statements, which gives the same result as a
+	// sequential parse of a file that has no errors. If any chunk reports an
+	// error nothing is kept, and the file is parsed again sequentially so the
+	// diagnostics and recovery are exactly those of a sequential parse.
+	//
+	// Each chunk is lexed with a constant pool of its own. The tokens and
+	// pools are merged in chunk order before parsing, and the chunk's literal
+	// tokens renumbered, so both are what a sequential lexer would build; each
+	// chunk is then parsed in its range of the file's tokens.
+	bool Context::parse_chunks()
+	{
+		if(!pool || pool->size() < 2 || Logger::get().tracing()) return false;
+		if(source.size() < 2 * std::max<size_t>(options.chunk_size, 1)) return false;
+
+		auto count = std::min<size_t>(pool->size() * 4, source.size() / std::max<size_t>(options.chunk_size, 1));
+		auto splits = Lexer::split(source, count);
+		if(splits.empty()) return false;
+		splits.insert(splits.begin(), { 0, 1 });
+
+		struct Chunk
+		{
+			std::vector<Token> tokens;
+			ConstantPool constants;
+			// its range of the file's tokens
+			size_t first = 0, last = 0;
+			std::unique_ptr<Program> ast;
+			bool failed = false;
+		};
+		std::vector<Chunk> chunks(splits.size());
+		pool->for_each(chunks.size(), [&](size_t i)
+		{
+			auto begin = splits[i].offset;
+			auto end = i + 1 < splits.size() ? splits[i + 1].offset : source.size();
+			Util::DiagnosticEngine diagnostics(file, source, tokens);
+
+			Lexer lexer(std::string_view(source).substr(begin, end - begin), diagnostics, splits[i].line);
+			auto &chunk = chunks[i];
+			chunk.tokens = lexer.tokenize();
+			chunk.constants = std::move(lexer.constants);
+			chunk.failed = lexer.failed();
+		});
+
+		size_t token_count = 0;
+		for(const auto &chunk : chunks)
+		{
+			if(chunk.failed)
+			{
+				constants = {};
+				return false;
+			}
+			token_count += chunk.tokens.size();
+		}
+
+		tokens.reserve(token_count);
+		for(auto &chunk : chunks)
+		{
+			auto ids = constants.merge(chunk.constants);
+			chunk.first = tokens.size();
+			for(const auto &token : chunk.tokens)
+			{
+				if(token.constant == no_constant)
+					tokens.push_back(token);
+				else
+					tokens.push_back({ token.type, token.newline, ids[token.constant], token.value, token.location });
+			}
+			chunk.last = tokens.size();
+			std::vector<Token>().swap(chunk.tokens);
+		}
+
+		pool->for_each(chunks.size(), [&](size_t i)
+		{
+			auto &chunk = chunks[i];
+			if(chunk.first == chunk.last) return;
+
+			Util::DiagnosticEngine diagnostics(file, source, tokens);
+			Parser parser(tokens, chunk.first, chunk.last, diagnostics, options.max_errors);
+			chunk.ast = parser.parse();
+			chunk.failed = parser.failed() || !diagnostics.empty();
+		});
+
+		size_t statement_count = 0;
+		for(const auto &chunk : chunks)
+		{
+			if(chunk.failed)
+			{
+				tokens.clear();
+				constants = {};
+				return false;
+			}
+			if(chunk.ast) statement_count += chunk.ast->statements.size();
+		}
+
+		std::vector<std::unique_ptr<Statement>> statements;
+		statements.reserve(statement_count);
+		for(auto &chunk : chunks)
+		{
+			if(!chunk.ast) continue;
+			for(auto &stmt : chunk.ast->statements)
+				statements.push_back(std::move(stmt));
+		}
+		ast = std::make_unique<Program>(std::move(statements));
+		return true;
+	}
+
+	Status Context::analyze_tree(const ModuleImports &imports)
+	{
+		auto &diagnostics = *engine;
+
+		// symbol table
+		TRACE(Logger::get().debug("Building symbol table for '", file, "'"));
+		SymbolTable sym(diagnostics, pool.get(), &imports);
+		sym.dispatch(*ast);
+		if(sym.failed()) return Status::SymbolError;
+		TRACE(Logger::get().debug());
+
+		// type checker
+		TRACE(Logger::get().debug("Checking types for '", file, "'"));
+		TypeChecker type_checker(diagnostics, constants, pool.get());
+		type_checker.dispatch(*ast);
+		if(type_checker.failed()) return Status::TypeError;
+
+		for(const auto &stmt : ast->statements)
+		{
+			Identifier *name = nullptr;
+			if(stmt->kind == NodeKind::VariableDef)
+				name = static_cast<VariableDef &>(*stmt).name.get();
+			else if(stmt->kind == NodeKind::FunctionDef)
+				name = static_cast<FunctionDef &>(*stmt).name.get();
+			if(name)
+				exports.exports.push_back({ std::string(name->token(tokens).value), name->symbol->type });
+		}
 
-		Logger::get().debug("AST:");
-		Util::TreePrinter printer;
-		ast->accept(printer);
-		Logger::get().debug();
+		return Status::Ok;
+	}
+
+	Status Context::analyze_flat(const ModuleImports &imports)
+	{
+		auto &diagnostics = *engine;
+		FlatTree tree(*ast, tokens);
 
 		// symbol table
-		Logger::get().debug("Building symbol table for '", file, "'");
-		SymbolTable sym(file, source);
-		ast->accept(sym);
-		if(sym.failed()) throw Util::Error();
-		Logger::get().debug();
+		TRACE(Logger::get().debug("Building symbol table for '", file, "'"));
+		FlatSymbolTable sym(tree, diagnostics, &imports);
+		sym.dispatch(tree.root());
+		if(sym.failed()) return Status::SymbolError;
+		TRACE(Logger::get().debug());
 
 		// type checker
-		Logger::get().debug("Checking types for '", file, "'");
-		TypeChecker type_checker(file, source);
-		ast->accept(type_checker);
-		if(type_checker.failed()) throw Util::Error();
+		TRACE(Logger::get().debug("Checking types for '", file, "'"));
+		FlatTypeChecker type_checker(tree, sym.symbols, diagnostics, constants, &sym.imported);
+		type_checker.dispatch(tree.root());
+		if(type_checker.failed()) return Status::TypeError;
+
+		for(auto stmt : Flat::Program { tree, tree.root() }.statements())
+		{
+			NodeId name = no_node;
+			if(tree.kinds[stmt] == NodeKind::VariableDef)
+				name = Flat::VariableDef { tree, stmt }.name();
+			else if(tree.kinds[stmt] == NodeKind::FunctionDef)
+				name = Flat::FunctionDef { tree, stmt }.name();
+			if(name != no_node)
+				exports.exports.push_back({ std::string(tree.token(name, 0).value), type_checker.symbol_types.at(name) });
+		}
+
+		return Status::Ok;
+	}
+
+	const Util::DiagnosticEngine &Context::diagnostics() const
+	{
+		return *engine;
+	}
+
+	const std::vector<Token> &Context::token_list() const
+	{
+		return tokens;
+	}
+
+	const ConstantPool &Context::constant_pool() const
+	{
+		return constants;
+	}
+
+	Program *Context::syntax_tree() const
+	{
+		return ast.get();
+	}
+
+	TokenIndex Context::add_token(TokenType type, std::string_view value, const Util::FileLocation &location, ConstantId constant)
+	{
+		const auto &text = added.emplace_back(value);
+		tokens.push_back({ type, false, constant, text, location });
+		return static_cast<TokenIndex>(tokens.size() - 1);
+	}
+
+	ConstantPool &Context::constant_pool()
+	{
+		return constants;
+	}
+
+	std::vector<const Import *> Context::imports() const
+	{
+		std::vector<const Import *> found;
+		if(!ast) return found;
+		for(const auto &stmt : ast->statements)
+		{
+			if(stmt->kind == NodeKind::Import)
+				found.push_back(static_cast<const Import *>(stmt.get()));
+		}
+		return found;
+	}
+
+	const ModuleSummary &Context::summary() const
+	{
+		return exports;
+	}
+
+	void Context::print()
+	{
+		if(engine) engine->print();
+	}
+
+	void compile(std::string_view file, std::string_view source, const Options &options)
+	{
+		Context context(options);
+		if(context.check(file, source) != Status::Ok)
+		{
+			context.print();
+			throw Util::Error();
+		}
 	}
 }
@@ -1,8 +1,108 @@
 #pragma once
 
+#include "syntax/token.h"
+#include "syntax/constant.h"
+#include "ast/node.h"
+#include "util/diagnostic.h"
+#include "util/threadpool.h"
+#include "semantic/module.h"
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace Compiler
 {
-	void compile(std::string_view file, std::string_view source);
+	struct Options
+	{
+		// run semantic analysis over a struct-of-arrays copy of the AST
+		bool flat_ast = false;
+		// syntax errors reported per file before parsing stops; 0 for no
+		// limit
+		unsigned max_errors = 100;
+		// threads that resolve and check function bodies; 0 means one per core
+		unsigned threads = 1;
+		// with more than one thread, files at least twice this size are lexed
+		// and parsed in chunks of about this size in parallel
+		size_t chunk_size = 1 << 20;
+	};
+
+	// the phase that rejected a file
+	enum class Status
+	{
+		Ok,
+		LexError,
+		SyntaxError,
+		SymbolError,
+		TypeError
+	};
+
+	// Checks one source at a time and keeps its diagnostics until the next one.
+	// A context owns everything a check allocates: its copy of the source, the
+	// tokens, the AST, the diagnostics and the threads it checks with. The
+	// passes share nothing mutable between contexts, so each thread can check
+	// files with its own context; only the debug trace goes through the
+	// process-wide logger.
+	class Context
+	{
+	public:
+		explicit Context(const Options &options = {});
+
+		Context(const Context &) = delete;
+		Context &operator=(const Context &) = delete;
+
+		// diagnostics of the previous check are dropped
+		Status check(std::string_view file, std::string_view source, const ModuleImports &imports = {});
+
+		// check in two steps, so a build can find out what a source imports
+		// before the modules it imports are checked: parse lexes and parses,
+		// and analyze, called only if that succeeded, runs semantic analysis
+		Status parse(std::string_view file, std::string_view source);
+		Status analyze(const ModuleImports &imports = {});
+
+		// of the last check
+		const Util::DiagnosticEngine &diagnostics() const;
+		const std::vector<Token> &token_list() const;
+		// values of the literals in token_list
+		const ConstantPool &constant_pool() const;
+		// null if the last check stopped before parsing
+		Program *syntax_tree() const;
+		// for passes that build new nodes after a check: appends a token that
+		// is in no source, with a copy of value, and returns its index
+		TokenIndex add_token(TokenType type, std::string_view value, const Util::FileLocation &location, ConstantId constant = no_constant);
+		ConstantPool &constant_pool();
+		// top-level imports, in source order
+		std::vector<const Import *> imports() const;
+		// top-level definitions, if the last check succeeded
+		const ModuleSummary &summary() const;
+		// prints the diagnostics of the last check through the logger
+		void print();
+
+		Options options;
+
+	private:
+		std::string file, source;
+		std::optional<Util::DiagnosticEngine> engine;
+		std::vector<Token> tokens;
+		ConstantPool constants;
+		// the values of added tokens
+		std::deque<std::string> added;
+		// diagnostics point into the tree, so it is kept until the next check
+		std::unique_ptr<Program> ast;
+		// started on the first check that asks for more than one thread
+		std::unique_ptr<Util::ThreadPool> pool;
+		ModuleSummary exports;
+
+		void start_pool();
+		bool parse_chunks();
+		Status analyze_tree(const ModuleImports &imports);
+		Status analyze_flat(const ModuleImports &imports);
+	};
+
+	// checks one file in a new context and prints its diagnostics;
+	// throws Util::Error if it is rejected
+	void compile(std::string_view file, std::string_view source, const Options &options = {});
 }
@@ -0,0 +1,132 @@
+#include "cygnus.h"
+
+#include "compiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+struct cygnus_context
+{
+	Compiler::Context context;
+};
+
+namespace
+{
+	size_t copy_out(const std::string &text, char *buffer, size_t size)
+	{
+		if(size > 0)
+		{
+			size_t length = std::min(text.size(), size - 1);
+			std::memcpy(buffer, text.data(), length);
+			buffer[length] = '\0';
+		}
+		return text.size();
+	}
+
+	const Util::Diagnostic *find(const cygnus_context *context, size_t index)
+	{
+		const auto &diagnostics = context->context.diagnostics().diagnostics();
+		return index < diagnostics.size() ? &diagnostics[index] : nullptr;
+	}
+}
+
+extern "C"
+{
+	cygnus_context *cygnus_context_new(void)
+	{
+		// the members of a context allocate too, which nothrow new does not
+		// cover
+		try
+		{
+			return new cygnus_context();
+		}
+		catch(...)
+		{
+			return nullptr;
+		}
+	}
+
+	void cygnus_context_free(cygnus_context *context)
+	{
+		delete context;
+	}
+
+	void cygnus_set_flat_ast(cygnus_context *context, int enabled)
+	{
+		context->context.options.flat_ast = enabled != 0;
+	}
+
+	void cygnus_set_max_errors(cygnus_context *context, unsigned count)
+	{
+		context->context.options.max_errors = count;
+	}
+
+	cygnus_status cygnus_check(cygnus_context *context, const char *file, const char *source, size_t length)
+	{
+		try
+		{
+			switch(context->context.check(file ? file : "", std::string_view(source, length)))
+			{
+				case Compiler::Status::Ok: return CYGNUS_OK;
+				case Compiler::Status::LexError: return CYGNUS_LEX_ERROR;
+				case Compiler::Status::SyntaxError: return CYGNUS_SYNTAX_ERROR;
+				case Compiler::Status::SymbolError: return CYGNUS_SYMBOL_ERROR;
+				case Compiler::Status::TypeError: return CYGNUS_TYPE_ERROR;
+			}
+		}
+		catch(...)
+		{
+		}
+		return CYGNUS_INTERNAL_ERROR;
+	}
+
+	size_t cygnus_diagnostic_count(const cygnus_context *context)
+	{
+		return context->context.diagnostics().diagnostics().size();
+	}
+
+	int cygnus_diagnostic_location(const cygnus_context *context, size_t index, unsigned *line, unsigned *column)
+	{
+		auto diagnostic = find(context, index);
+		if(!diagnostic) return 0;
+
+		try
+		{
+			auto location = context->context.diagnostics().location(*diagnostic);
+			if(line) *line = location.line;
+			if(column) *column = location.column;
+			return 1;
+		}
+		catch(...)
+		{
+			return -1;
+		}
+	}
+
+	size_t cygnus_diagnostic_message(const cygnus_context *context, size_t index, char *buffer, size_t size)
+	{
+		auto diagnostic = find(context, index);
+		try
+		{
+			return copy_out(diagnostic ? context->context.diagnostics().message(*diagnostic) : "", buffer, size);
+		}
+		catch(...)
+		{
+			return copy_out("", buffer, size);
+		}
+	}
+
+	size_t cygnus_diagnostic_excerpt(const cygnus_context *context, size_t index, char *buffer, size_t size)
+	{
+		auto diagnostic = find(context, index);
+		try
+		{
+			return copy_out(diagnostic ? context->context.diagnostics().excerpt(*diagnostic) : "", buffer, size);
+		}
+		catch(...)
+		{
+			// not tied to a location
+			return copy_out("", buffer, size);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef CYGNUS_H
+#define CYGNUS_H
+
+#include <stddef.h>
+
+/*
+ * C interface to the compiler front-end.
+ *
+ * A context checks one source at a time and keeps its diagnostics until the
+ * next check. Contexts share no mutable state, so each thread may use its
+ * own; a single context must not be used by two threads at once. No function
+ * lets a C++ exception escape.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cygnus_context cygnus_context;
+
+typedef enum cygnus_status
+{
+	CYGNUS_OK,
+	CYGNUS_LEX_ERROR,
+	CYGNUS_SYNTAX_ERROR,
+	CYGNUS_SYMBOL_ERROR,
+	CYGNUS_TYPE_ERROR,
+	/* out of memory or a bug in the compiler; the diagnostics may be incomplete */
+	CYGNUS_INTERNAL_ERROR
+} cygnus_status;
+
+/* returns NULL if out of memory */
+cygnus_context *cygnus_context_new(void);
+void cygnus_context_free(cygnus_context *context);
+
+/* run semantic analysis over a struct-of-arrays copy of the AST */
+void cygnus_set_flat_ast(cygnus_context *context, int enabled);
+/* syntax errors reported before parsing stops; 0 for no limit */
+void cygnus_set_max_errors(cygnus_context *context, unsigned count);
+
+/* file is only used in diagnostics; source is copied and need not be null-terminated */
+cygnus_status cygnus_check(cygnus_context *context, const char *file, const char *source, size_t length);
+
+/* diagnostics of the last check */
+size_t cygnus_diagnostic_count(const cygnus_context *context);
+/*
+ * line and column start at 1; both are 0 if the diagnostic has no location.
+ * Returns 1, 0 if there is no such diagnostic, or -1 if the location could
+ * not be computed, in which case line and column are unchanged.
+ */
+int cygnus_diagnostic_location(const cygnus_context *context, size_t index, unsigned *line, unsigned *column);
+/*
+ * Copy the message or the rendered source excerpt into buffer, truncated and
+ * null-terminated like snprintf, and return its full length. The excerpt is
+ * empty if the diagnostic has no location.
+ */
+size_t cygnus_diagnostic_message(const cygnus_context *context, size_t index, char *buffer, size_t size);
+size_t cygnus_diagnostic_excerpt(const cygnus_context *context, size_t index, char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,418 @@
+#include "bytecode.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace Interp
+{
+	namespace
+	{
+		constexpr char magic[4] = { 'C', 'Y', 'C', '\0' };
+		// changes whenever the layout does, or what the ops mean
+		constexpr std::uint32_t version = 2;
+		// reads back differently on a machine of the other byte order
+		constexpr std::uint32_t order = 0x01020304;
+
+		enum Section : std::uint32_t
+		{
+			Ops,
+			Lines,
+			Lists,
+			Numbers,
+			Strings,
+			Files,
+			Functions,
+			Loops,
+			Modules,
+			// of the strings, the names of the files and of the functions
+			Bytes,
+			Sections
+		};
+
+		// where a section starts, how many records it has, and the hash of
+		// them, checked before the section is used
+		struct Extent
+		{
+			std::uint64_t offset;
+			std::uint64_t count;
+			std::uint64_t checksum;
+		};
+
+		struct Header
+		{
+			char magic[4];
+			std::uint32_t version;
+			std::uint32_t order;
+			std::uint32_t level;
+			std::uint32_t globals;
+			std::uint32_t reserved;
+			// of the header, with this zero
+			std::uint64_t checksum;
+			Extent sections[Sections];
+		};
+
+		// in the bytes
+		struct Text
+		{
+			std::uint32_t offset;
+			std::uint32_t length;
+		};
+
+		struct SourceRecord
+		{
+			Text path;
+			std::uint64_t size;
+			std::uint64_t hash;
+		};
+
+		struct FunctionRecord
+		{
+			Text name;
+			std::uint32_t file;
+			std::uint32_t line, column;
+			std::uint32_t body;
+			std::uint32_t parameters;
+			std::uint32_t slots;
+			std::uint32_t returns;
+		};
+
+		// the sections that are copied as they are
+		static_assert(std::is_trivially_copyable_v<Op> && sizeof(Op) == 16 && offsetof(Op, a) == 4);
+		static_assert(std::is_trivially_copyable_v<Util::FileLocation> && sizeof(Util::FileLocation) == 8);
+		static_assert(std::is_trivially_copyable_v<Loop> && sizeof(Loop) == 12);
+		static_assert(sizeof(Header) % 8 == 0);
+
+		// not cryptographic; eight bytes at a time, mixed again at the end
+		std::uint64_t hash(const char *data, size_t size)
+		{
+			std::uint64_t state = 0xcbf29ce484222325 ^ size;
+			size_t i = 0;
+			for(; i + 8 <= size; i += 8)
+			{
+				std::uint64_t word;
+				std::memcpy(&word, data + i, 8);
+				state = (state ^ word) * 0x9e3779b97f4a7c15;
+				state ^= state >> 32;
+			}
+			for(; i < size; i++)
+				state = (state ^ static_cast<unsigned char>(data[i])) * 0x100000001b3;
+
+			state ^= state >> 33;
+			state *= 0xff51afd7ed558ccd;
+			state ^= state >> 33;
+			return state;
+		}
+
+		// a file mapped for reading, as long as this lives
+		class Mapping
+		{
+		public:
+			explicit Mapping(const std::string &path)
+			{
+				int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if(file < 0)
+				{
+					missing = errno == ENOENT;
+					return;
+				}
+
+				struct stat status;
+				if(fstat(file, &status) == 0 && S_ISREG(status.st_mode))
+				{
+					size = static_cast<size_t>(status.st_size);
+					if(size == 0)
+						opened = true;
+					else
+					{
+						auto address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+						if(address != MAP_FAILED)
+						{
+							data = static_cast<const char *>(address);
+							opened = true;
+						}
+					}
+				}
+				close(file);
+			}
+
+			~Mapping()
+			{
+				if(data)
+					munmap(const_cast<char *>(data), size);
+			}
+
+			Mapping(const Mapping &) = delete;
+			Mapping &operator=(const Mapping &) = delete;
+
+			bool opened = false, missing = false;
+			const char *data = nullptr;
+			size_t size = 0;
+		};
+
+		class Writer
+		{
+		public:
+			Writer()
+			{
+				buffer.resize(sizeof(Header));
+			}
+
+			Header header = {};
+			std::string buffer;
+
+			template<typename T>
+			void put(const T &value)
+			{
+				buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+			}
+
+			// a section starts at a multiple of eight, and ends where the
+			// next one begins
+			void begin(Section section, size_t count)
+			{
+				end();
+				buffer.resize((buffer.size() + 7) & ~size_t(7));
+				header.sections[section] = { buffer.size(), count, 0 };
+				current = section;
+			}
+
+			void end()
+			{
+				if(current == Sections)
+					return;
+				auto &extent = header.sections[current];
+				extent.checksum = hash(buffer.data() + extent.offset, buffer.size() - extent.offset);
+				current = Sections;
+			}
+
+			Text text(std::string_view value)
+			{
+				Text result = { static_cast<std::uint32_t>(bytes.size()), static_cast<std::uint32_t>(value.size()) };
+				bytes += value;
+				return result;
+			}
+
+			std::string bytes;
+
+		private:
+			Section current = Sections;
+		};
+
+		template<typename T>
+		bool fits(const Mapping &file, const Extent &extent)
+		{
+			return extent.offset % alignof(T) == 0 && extent.offset <= file.size && extent.count <= (file.size - extent.offset) / sizeof(T);
+		}
+
+		template<typename T>
+		bool intact(const Mapping &file, const Extent &extent)
+		{
+			return hash(file.data + extent.offset, extent.count * sizeof(T)) == extent.checksum;
+		}
+
+		template<typename T>
+		void copy(std::vector<T> &into, const Mapping &file, const Extent &extent)
+		{
+			into.resize(extent.count);
+			if(extent.count > 0)
+				std::memcpy(static_cast<void *>(into.data()), file.data + extent.offset, extent.count * sizeof(T));
+		}
+
+		// the records in place; the offset of a section is a multiple of
+		// eight, and the mapping of a page
+		template<typename T>
+		Records<T> view(const Mapping &file, const Extent &extent)
+		{
+			return Records<T>(reinterpret_cast<const T *>(file.data + extent.offset), extent.count);
+		}
+
+		template<typename T>
+		T record(const Mapping &file, const Extent &extent, size_t index)
+		{
+			T result;
+			std::memcpy(&result, file.data + extent.offset + index * sizeof(T), sizeof(T));
+			return result;
+		}
+	}
+
+	bool save(const Program &program, const std::vector<std::string_view> &sources, unsigned level, const std::string &path)
+	{
+		Writer writer;
+
+		// the padding of an op is written as zeros, so the same program
+		// always gives the same file
+		writer.begin(Ops, program.ops.size());
+		for(const auto &op : program.ops)
+		{
+			writer.put(op.code);
+			writer.put(op.type);
+			writer.put(std::uint16_t(0));
+			writer.put(op.a);
+			writer.put(op.b);
+			writer.put(op.c);
+		}
+		writer.begin(Lines, program.lines.size());
+		for(const auto &line : program.lines)
+			writer.put(line);
+		writer.begin(Lists, program.lists.size());
+		for(auto item : program.lists)
+			writer.put(item);
+		writer.begin(Numbers, program.numbers.size());
+		for(auto number : program.numbers)
+			writer.put(number);
+
+		writer.begin(Strings, program.strings.size());
+		for(const auto &text : program.strings)
+			writer.put(writer.text(text));
+		writer.begin(Files, program.files.size());
+		for(size_t i = 0; i < program.files.size(); i++)
+		{
+			auto source = i < sources.size() ? sources[i] : std::string_view();
+			writer.put(SourceRecord { writer.text(program.files[i]), source.size(), hash(source.data(), source.size()) });
+		}
+		writer.begin(Functions, program.functions.size());
+		for(const auto &function : program.functions)
+		{
+			writer.put(FunctionRecord
+			{
+				writer.text(function.name), function.file, function.location.line, function.location.column,
+				function.body, function.parameters, function.slots, static_cast<std::uint32_t>(function.returns)
+			});
+		}
+		writer.begin(Loops, program.loops.size());
+		for(const auto &loop : program.loops)
+			writer.put(loop);
+		writer.begin(Modules, program.modules.size());
+		for(auto module : program.modules)
+			writer.put(module);
+		writer.begin(Bytes, writer.bytes.size());
+		writer.buffer += writer.bytes;
+		writer.end();
+
+		auto &header = writer.header;
+		std::memcpy(header.magic, magic, sizeof magic);
+		header.version = version;
+		header.order = order;
+		header.level = level;
+		header.globals = program.globals;
+		header.checksum = 0;
+		header.checksum = hash(reinterpret_cast<const char *>(&header), sizeof(Header));
+		std::memcpy(writer.buffer.data(), &header, sizeof(Header));
+
+		// written next to the file and renamed over it, so a program that
+		// runs at the same time never reads half of it
+		auto temporary = path + "." + std::to_string(getpid()) + ".tmp";
+		std::ofstream stream(temporary, std::ios::binary);
+		stream.write(writer.buffer.data(), static_cast<std::streamsize>(writer.buffer.size()));
+		stream.close();
+		if(!stream || std::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	LoadStatus load(const std::string &path, bool check, unsigned level, Program &program)
+	{
+		// the program keeps the mapping, and runs its ops from it
+		auto mapping = std::make_shared<const Mapping>(path);
+		const auto &file = *mapping;
+		if(!file.opened)
+			return file.missing ? LoadStatus::Missing : LoadStatus::Invalid;
+		if(file.size < sizeof(Header))
+			return LoadStatus::Invalid;
+
+		Header header;
+		std::memcpy(&header, file.data, sizeof(Header));
+		if(std::memcmp(header.magic, magic, sizeof magic) != 0 || header.version != version || header.order != order)
+			return LoadStatus::Invalid;
+		auto checksum = header.checksum;
+		header.checksum = 0;
+		if(hash(reinterpret_cast<const char *>(&header), sizeof(Header)) != checksum)
+			return LoadStatus::Invalid;
+
+		const auto &sections = header.sections;
+		if(!fits<Op>(file, sections[Ops]) || !fits<Util::FileLocation>(file, sections[Lines]) || sections[Lines].count != sections[Ops].count
+		   || !fits<std::uint32_t>(file, sections[Lists]) || !fits<std::uint64_t>(file, sections[Numbers])
+		   || !fits<Text>(file, sections[Strings]) || !fits<SourceRecord>(file, sections[Files]) || !fits<FunctionRecord>(file, sections[Functions])
+		   || !fits<Loop>(file, sections[Loops]) || !fits<std::uint32_t>(file, sections[Modules]) || !fits<char>(file, sections[Bytes]))
+			return LoadStatus::Invalid;
+		// each section has its own checksum, so a stale file is found
+		// without reading the rest of it
+		if(!intact<SourceRecord>(file, sections[Files]) || !intact<char>(file, sections[Bytes]))
+			return LoadStatus::Invalid;
+
+		auto bytes = std::string_view(file.data + sections[Bytes].offset, sections[Bytes].count);
+		bool bad = false;
+		auto text = [&](const Text &text)
+		{
+			if(text.offset > bytes.size() || text.length > bytes.size() - text.offset)
+			{
+				bad = true;
+				return std::string_view();
+			}
+			return bytes.substr(text.offset, text.length);
+		};
+
+		// before anything is copied, whether the sources are the ones the
+		// program was built from
+		if(check)
+		{
+			if(header.level != level)
+				return LoadStatus::Stale;
+			for(size_t i = 0; i < sections[Files].count; i++)
+			{
+				auto source = record<SourceRecord>(file, sections[Files], i);
+				Mapping current(std::string(text(source.path)));
+				if(bad)
+					return LoadStatus::Invalid;
+				if(!current.opened || current.size != source.size || hash(current.data, current.size) != source.hash)
+					return LoadStatus::Stale;
+			}
+		}
+
+		if(!intact<Op>(file, sections[Ops]) || !intact<Util::FileLocation>(file, sections[Lines]) || !intact<std::uint32_t>(file, sections[Lists])
+		   || !intact<std::uint64_t>(file, sections[Numbers]) || !intact<Text>(file, sections[Strings]) || !intact<FunctionRecord>(file, sections[Functions])
+		   || !intact<Loop>(file, sections[Loops]) || !intact<std::uint32_t>(file, sections[Modules]))
+			return LoadStatus::Invalid;
+
+		// the ops, their lines and the numbers are used where they are in
+		// the file; the rest is copied
+		program.ops = view<Op>(file, sections[Ops]);
+		program.lines = view<Util::FileLocation>(file, sections[Lines]);
+		program.numbers = view<std::uint64_t>(file, sections[Numbers]);
+		program.storage = mapping;
+		copy(program.lists, file, sections[Lists]);
+		copy(program.loops, file, sections[Loops]);
+		copy(program.modules, file, sections[Modules]);
+
+		program.strings.clear();
+		program.strings.reserve(sections[Strings].count);
+		for(size_t i = 0; i < sections[Strings].count; i++)
+			program.strings.emplace_back(text(record<Text>(file, sections[Strings], i)));
+		program.files.clear();
+		program.files.reserve(sections[Files].count);
+		for(size_t i = 0; i < sections[Files].count; i++)
+			program.files.emplace_back(text(record<SourceRecord>(file, sections[Files], i).path));
+		program.functions.clear();
+		program.functions.reserve(sections[Functions].count);
+		for(size_t i = 0; i < sections[Functions].count; i++)
+		{
+			auto function = record<FunctionRecord>(file, sections[Functions], i);
+			program.functions.push_back({ std::string(text(function.name)), function.file, { function.line, function.column }, function.body, function.parameters, function.slots, static_cast<Type>(function.returns) });
+		}
+		program.globals = header.globals;
+
+		return bad ? LoadStatus::Invalid : LoadStatus::Loaded;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "program.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Interp
+{
+	enum class LoadStatus
+	{
+		Loaded,
+		// there is no file at the path
+		Missing,
+		// written for other sources, or at another optimization level
+		Stale,
+		// not a bytecode file, written by another version of the format, or
+		// damaged
+		Invalid
+	};
+
+	// Bytecode files ('.cyc') hold a lowered program so it can be run again
+	// without reading, checking and lowering its sources: the ops and their
+	// line table, the constants, and the functions, loops and modules. Along
+	// with them is the size and hash of every source file the program was
+	// built from, and the optimization level it was built at.
+	//
+	// The sections are laid out as the program holds them in memory, so a
+	// file is mapped and the program runs its ops, lines and numbers from
+	// the mapping, which it keeps; the other sections are copied out. A
+	// checksum for each section catches files that were damaged; like an
+	// executable, a file is otherwise trusted to be what the compiler wrote.
+
+	// sources are the text of the program's files, in the same order
+	bool save(const Program &program, const std::vector<std::string_view> &sources, unsigned level, const std::string &path);
+
+	// with check, every source file is read again, and the program is only
+	// loaded if none of them changed and it was built at level
+	LoadStatus load(const std::string &path, bool check, unsigned level, Program &program);
+}
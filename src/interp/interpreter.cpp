@@ -0,0 +1,700 @@
+#include "interpreter.h"
+
+#include "log.h"
+#include "tier.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace Interp
+{
+	namespace
+	{
+		// reserved, not committed; deep recursion in the program is deep
+		// recursion in the interpreter
+#if defined(__SANITIZE_THREAD__)
+		// the sanitizer keeps its own stack of calls, which is much smaller
+		constexpr size_t stack_size = size_t(2) << 20;
+#elif defined(__SANITIZE_ADDRESS__)
+		// the sanitizer only clears the stack it poisoned up to 64 MB when
+		// a failure unwinds, and reports what it leaves behind
+		constexpr size_t stack_size = size_t(32) << 20;
+#else
+		constexpr size_t stack_size = size_t(512) << 20;
+#endif
+		// left for what runs between two checks, and for printing the error
+		constexpr size_t stack_margin = size_t(1) << 20;
+
+		// a return out of an expression, caught by the call it returns from
+		struct Returned
+		{};
+
+		// stops the program
+		struct Failure
+		{
+			std::uint32_t op;
+			std::string message;
+		};
+
+		Value integer(std::int64_t value)
+		{
+			Value result;
+			result.integer = value;
+			return result;
+		}
+
+		Value real(double value)
+		{
+			Value result;
+			result.real = value;
+			return result;
+		}
+
+		// integers wrap around
+		std::int64_t add(std::int64_t a, std::int64_t b) { return static_cast<std::int64_t>(static_cast<std::uint64_t>(a) + static_cast<std::uint64_t>(b)); }
+		std::int64_t sub(std::int64_t a, std::int64_t b) { return static_cast<std::int64_t>(static_cast<std::uint64_t>(a) - static_cast<std::uint64_t>(b)); }
+		std::int64_t mul(std::int64_t a, std::int64_t b) { return static_cast<std::int64_t>(static_cast<std::uint64_t>(a) * static_cast<std::uint64_t>(b)); }
+		std::int64_t neg(std::int64_t a) { return static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(a)); }
+
+		int format_int(char *buffer, std::int64_t value)
+		{
+			char digits[24];
+			int count = 0, length = 0;
+			auto magnitude = value < 0 ? 0 - static_cast<std::uint64_t>(value) : static_cast<std::uint64_t>(value);
+			do
+			{
+				digits[count++] = static_cast<char>('0' + magnitude % 10);
+				magnitude /= 10;
+			}
+			while(magnitude);
+			if(value < 0) buffer[length++] = '-';
+			while(count) buffer[length++] = digits[--count];
+			return length;
+		}
+
+		// the shortest text that reads back as the same value, with a '.0'
+		// if it would read as an integer; as the C runtime writes it
+		int format_float(char *buffer, double value)
+		{
+			int length = 0;
+			for(int precision = 1; precision <= 17; precision++)
+			{
+				length = std::snprintf(buffer, 32, "%.*g", precision, value);
+				if(std::strtod(buffer, nullptr) == value) break;
+			}
+			if(std::strspn(buffer, "-0123456789") == static_cast<size_t>(length))
+			{
+				buffer[length++] = '.';
+				buffer[length++] = '0';
+			}
+			return length;
+		}
+
+		// leaves the profiler's site when a call or loop ends, however it
+		// ends
+		class Scope
+		{
+		public:
+			Scope(Profiler *profiler, std::uint32_t site)
+				: profiler(profiler)
+			{
+				if(profiler) profiler->enter(site);
+			}
+
+			~Scope()
+			{
+				if(profiler) profiler->leave();
+			}
+
+			Scope(const Scope &) = delete;
+			Scope &operator=(const Scope &) = delete;
+
+		private:
+			Profiler *profiler;
+		};
+	}
+
+	// the runtime's callbacks, for native code
+	struct Interpreter::Native
+	{
+		static Interpreter &of(Runtime *runtime)
+		{
+			return *static_cast<Interpreter *>(runtime->interpreter);
+		}
+
+		static Value *frame(Runtime *runtime)
+		{
+			auto &interpreter = of(runtime);
+			return &interpreter.values[interpreter.base];
+		}
+
+		// the stack was checked by the caller
+		static Value call(Runtime *runtime, std::uint32_t function, Value *arguments)
+		{
+			auto &interpreter = of(runtime);
+			const auto &callee = interpreter.program.functions[function];
+			auto frame = interpreter.top;
+			interpreter.top = frame + callee.slots;
+			auto &values = interpreter.values;
+			if(values.size() < interpreter.top)
+				values.resize(std::max(interpreter.top, values.size() * 2));
+			std::copy(arguments, arguments + callee.parameters, values.begin() + frame);
+			std::fill(values.begin() + frame + callee.parameters, values.begin() + interpreter.top, Value {});
+			return interpreter.enter(function, frame);
+		}
+
+		static void fail(Runtime *runtime, std::uint32_t function, std::uint32_t op, const char *message)
+		{
+			auto &interpreter = of(runtime);
+			interpreter.function = function;
+			interpreter.fail(op, message);
+		}
+
+		static Value concat(Runtime *runtime, Value left, Value right)
+		{
+			return of(runtime).concat(left, right);
+		}
+
+		static Value append_int(Runtime *runtime, Value left, std::int64_t right)
+		{
+			char buffer[24];
+			return of(runtime).append(left, buffer, format_int(buffer, right));
+		}
+
+		static Value append_float(Runtime *runtime, Value left, double right)
+		{
+			char buffer[40];
+			return of(runtime).append(left, buffer, format_float(buffer, right));
+		}
+
+		static Value text(Runtime *runtime, std::uint32_t type, Value value)
+		{
+			return of(runtime).text(static_cast<Type>(type), value);
+		}
+
+		static void print(Runtime *runtime, Value text)
+		{
+			auto out = of(runtime).out;
+			std::fwrite(text.data, 1, text.length, out);
+			std::fputc('\n', out);
+		}
+	};
+
+	Interpreter::Interpreter(const Program &program, std::FILE *out, Profiler *profiler, Tier *tier)
+		: program(program),
+		  out(out),
+		  profiler(profiler),
+		  tier(tier),
+		  globals(program.globals)
+	{
+		for(auto bits : program.numbers)
+			constants.push_back(integer(static_cast<std::int64_t>(bits)));
+		for(const auto &text : program.strings)
+		{
+			Value value;
+			value.data = text.data();
+			value.length = static_cast<std::int64_t>(text.size());
+			strings.push_back(value);
+		}
+
+		runtime.interpreter = this;
+		runtime.globals = globals.data();
+		runtime.strings = strings.data();
+		runtime.code = tier ? tier->code() : nullptr;
+		runtime.limit = 0;
+		runtime.frame = Native::frame;
+		runtime.call = Native::call;
+		runtime.fail = Native::fail;
+		runtime.concat = Native::concat;
+		runtime.append_int = Native::append_int;
+		runtime.append_float = Native::append_float;
+		runtime.text = Native::text;
+		runtime.print = Native::print;
+	}
+
+	Interpreter::~Interpreter() = default;
+
+	bool Interpreter::run()
+	{
+		struct Start
+		{
+			Interpreter *interpreter;
+			bool ok;
+		};
+		Start start = { this, false };
+
+		pthread_attr_t attributes;
+		pthread_attr_init(&attributes);
+		pthread_attr_setstacksize(&attributes, stack_size);
+
+		Logger::get().flush();
+		pthread_t thread;
+		int error = pthread_create(&thread, &attributes, [](void *argument) -> void *
+		{
+			auto &start = *static_cast<Start *>(argument);
+			char marker;
+			start.interpreter->limit = reinterpret_cast<std::uintptr_t>(&marker) - (stack_size - stack_margin);
+			start.interpreter->runtime.limit = start.interpreter->limit;
+			start.interpreter->execute();
+			start.ok = true;
+			return nullptr;
+		}, &start);
+		pthread_attr_destroy(&attributes);
+
+		if(error != 0)
+		{
+			Logger::get().error("unable to start a thread to run the program on");
+			return false;
+		}
+		pthread_join(thread, nullptr);
+		return start.ok && result.length >= 0;
+	}
+
+	// on the thread of run; a failure is logged and leaves result.length
+	// negative
+	void Interpreter::execute()
+	{
+		if(profiler) profiler->start();
+
+		try
+		{
+			for(auto index : program.modules)
+			{
+				const auto &module = program.functions[index];
+				Scope scope(profiler, index);
+				function = index;
+				base = 0;
+				top = module.slots;
+				values.assign(std::max<size_t>(top, 1024), {});
+				try
+				{
+					exec(module.body);
+				}
+				catch(const Returned &)
+				{}
+			}
+			result = {};
+		}
+		catch(const Failure &failure)
+		{
+			std::fflush(out);
+			const auto &file = program.files[program.functions[function].file];
+			Logger::get().error(failure.message, " at ", file, ":", program.lines[failure.op]);
+			Logger::get().flush();
+			result = {};
+			result.length = -1;
+		}
+
+		std::fflush(out);
+		if(profiler) profiler->stop();
+	}
+
+	void Interpreter::fail(std::uint32_t index, std::string message)
+	{
+		throw Failure { index, std::move(message) };
+	}
+
+	// runs a statement; true if it returned from the function
+	bool Interpreter::exec(std::uint32_t index)
+	{
+		const auto &op = program.ops[index];
+		switch(op.code)
+		{
+			case Code::Nop:
+				return false;
+			case Code::Block:
+			{
+				for(std::uint32_t i = 0; i < op.b; i++)
+				{
+					if(exec(program.lists[op.a + i])) return true;
+				}
+				return false;
+			}
+			case Code::If:
+			{
+				if(eval(op.a).integer)
+					return exec(op.b);
+				if(op.c != none)
+					return exec(op.c);
+				return false;
+			}
+			case Code::While:
+				return loop(op);
+			case Code::Return:
+			{
+				result = op.a == none ? Value {} : eval(op.a);
+				return true;
+			}
+			default:
+				eval(index);
+				return false;
+		}
+	}
+
+	bool Interpreter::loop(const Op &op)
+	{
+		// continues in native code once the loop has some, from the next
+		// evaluation of its condition
+		if(tier)
+		{
+			while(true)
+			{
+				if(auto native = tier->loop(op.c))
+				{
+					Value value;
+					if(!native(&runtime, &value)) return false;
+					result = value;
+					return true;
+				}
+				if(!eval(op.a).integer) return false;
+				tier->iterated(op.c);
+				if(exec(op.b)) return true;
+			}
+		}
+
+		if(!profiler)
+		{
+			while(eval(op.a).integer)
+			{
+				if(exec(op.b)) return true;
+			}
+			return false;
+		}
+
+		Scope scope(profiler, static_cast<std::uint32_t>(program.functions.size()) + op.c);
+		while(eval(op.a).integer)
+		{
+			profiler->iterate();
+			if(exec(op.b)) return true;
+		}
+		return false;
+	}
+
+	Value Interpreter::eval(std::uint32_t index)
+	{
+		const auto &op = program.ops[index];
+		switch(op.code)
+		{
+			// a statement as a value; a return out of it is a return from
+			// the function
+			case Code::Nop:
+			case Code::Block:
+			case Code::While:
+			{
+				if(exec(index)) throw Returned {};
+				return {};
+			}
+			case Code::Return:
+			{
+				result = op.a == none ? Value {} : eval(op.a);
+				throw Returned {};
+			}
+			case Code::If:
+			{
+				if(eval(op.a).integer)
+					return eval(op.b);
+				if(op.c != none)
+					return eval(op.c);
+				return {};
+			}
+
+			case Code::Zero:
+				return {};
+			case Code::Number:
+				return constants[op.a];
+			case Code::String:
+				return strings[op.a];
+			case Code::Local:
+				return values[base + op.a];
+			case Code::Global:
+				return globals[op.a];
+			case Code::SetLocal:
+			{
+				auto value = eval(op.b);
+				values[base + op.a] = value;
+				return value;
+			}
+			case Code::SetGlobal:
+			{
+				auto value = eval(op.b);
+				globals[op.a] = value;
+				return value;
+			}
+			case Code::StepLocal:
+			case Code::StepGlobal:
+			{
+				auto &variable = op.code == Code::StepLocal ? values[base + op.a] : globals[op.a];
+				auto old = variable.integer;
+				variable.integer = add(old, static_cast<std::int32_t>(op.b));
+				return integer(op.c ? old : variable.integer);
+			}
+
+			case Code::AddInt:
+			{
+				auto left = eval(op.a).integer;
+				return integer(add(left, eval(op.b).integer));
+			}
+			case Code::SubInt:
+			{
+				auto left = eval(op.a).integer;
+				return integer(sub(left, eval(op.b).integer));
+			}
+			case Code::MulInt:
+			{
+				auto left = eval(op.a).integer;
+				return integer(mul(left, eval(op.b).integer));
+			}
+			case Code::DivInt:
+			case Code::ModInt:
+			{
+				auto left = eval(op.a).integer;
+				auto right = eval(op.b).integer;
+				if(right == 0)
+					fail(index, "division by zero");
+				if(right == -1)
+					return integer(op.code == Code::DivInt ? neg(left) : 0);
+				return integer(op.code == Code::DivInt ? left / right : left % right);
+			}
+			case Code::AddFloat:
+			{
+				auto left = eval(op.a).real;
+				return real(left + eval(op.b).real);
+			}
+			case Code::SubFloat:
+			{
+				auto left = eval(op.a).real;
+				return real(left - eval(op.b).real);
+			}
+			case Code::MulFloat:
+			{
+				auto left = eval(op.a).real;
+				return real(left * eval(op.b).real);
+			}
+			case Code::DivFloat:
+			{
+				auto left = eval(op.a).real;
+				return real(left / eval(op.b).real);
+			}
+
+			case Code::EqInt:
+			case Code::NeInt:
+			case Code::LtInt:
+			case Code::LeInt:
+			case Code::GtInt:
+			case Code::GeInt:
+			{
+				auto left = eval(op.a).integer;
+				auto right = eval(op.b).integer;
+				switch(op.code)
+				{
+					case Code::EqInt: return integer(left == right);
+					case Code::NeInt: return integer(left != right);
+					case Code::LtInt: return integer(left < right);
+					case Code::LeInt: return integer(left <= right);
+					case Code::GtInt: return integer(left > right);
+					default: return integer(left >= right);
+				}
+			}
+			case Code::EqFloat:
+			case Code::NeFloat:
+			case Code::LtFloat:
+			case Code::LeFloat:
+			case Code::GtFloat:
+			case Code::GeFloat:
+			{
+				auto left = eval(op.a).real;
+				auto right = eval(op.b).real;
+				switch(op.code)
+				{
+					case Code::EqFloat: return integer(left == right);
+					case Code::NeFloat: return integer(left != right);
+					case Code::LtFloat: return integer(left < right);
+					case Code::LeFloat: return integer(left <= right);
+					case Code::GtFloat: return integer(left > right);
+					default: return integer(left >= right);
+				}
+			}
+			case Code::EqString:
+			case Code::NeString:
+			{
+				auto left = eval(op.a);
+				auto right = eval(op.b);
+				bool equal = left.length == right.length && (left.length == 0 || std::memcmp(left.data, right.data, left.length) == 0);
+				return integer(equal == (op.code == Code::EqString));
+			}
+			case Code::And:
+				return integer(eval(op.a).integer && eval(op.b).integer);
+			case Code::Or:
+				return integer(eval(op.a).integer || eval(op.b).integer);
+
+			case Code::Concat:
+			{
+				auto left = eval(op.a);
+				return concat(left, eval(op.b));
+			}
+			case Code::AppendInt:
+			{
+				auto left = eval(op.a);
+				char buffer[24];
+				return append(left, buffer, format_int(buffer, eval(op.b).integer));
+			}
+			case Code::AppendFloat:
+			{
+				auto left = eval(op.a);
+				char buffer[40];
+				return append(left, buffer, format_float(buffer, eval(op.b).real));
+			}
+
+			case Code::NegInt:
+				return integer(neg(eval(op.a).integer));
+			case Code::NegFloat:
+				return real(-eval(op.a).real);
+			case Code::Not:
+				return integer(!eval(op.a).integer);
+			case Code::ToString:
+				return text(program.ops[op.a].type, eval(op.a));
+
+			case Code::Call:
+				return call(op, index);
+			case Code::Print:
+			{
+				auto text = eval(op.a);
+				std::fwrite(text.data, 1, text.length, out);
+				std::fputc('\n', out);
+				return {};
+			}
+		}
+		return {};
+	}
+
+	Value Interpreter::call(const Op &op, std::uint32_t index)
+	{
+		char marker;
+		if(reinterpret_cast<std::uintptr_t>(&marker) < limit)
+			fail(index, "stack overflow");
+
+		const auto &callee = program.functions[op.a];
+
+		// the arguments go straight to the first slots of the callee's frame,
+		// which is above everything the arguments could call
+		auto frame = top;
+		top = frame + callee.slots;
+		if(values.size() < top)
+			values.resize(std::max(top, values.size() * 2));
+		for(std::uint32_t i = 0; i < op.c; i++)
+		{
+			auto value = eval(program.lists[op.b + i]);
+			values[frame + i] = value;
+		}
+		std::fill(values.begin() + frame + op.c, values.begin() + top, Value {});
+		return enter(op.a, frame);
+	}
+
+	// runs a function whose frame, with its arguments, is at the top
+	Value Interpreter::enter(std::uint32_t index, size_t frame)
+	{
+		if(tier)
+		{
+			if(auto native = tier->entry(index))
+			{
+				auto value = native(&runtime, &values[frame]);
+				top = frame;
+				return value;
+			}
+			tier->called(index);
+		}
+
+		Scope scope(profiler, index);
+		auto caller = base;
+		auto caller_function = function;
+		base = frame;
+		function = index;
+		Value value;
+		try
+		{
+			if(exec(program.functions[index].body))
+				value = result;
+		}
+		catch(const Returned &)
+		{
+			value = result;
+		}
+		base = caller;
+		function = caller_function;
+		top = frame;
+		return value;
+	}
+
+	// strings
+
+	char *Interpreter::allocate(std::int64_t size)
+	{
+		if(chunk_end - chunk < size)
+		{
+			auto length = size < (1 << 19) ? (1 << 20) : 2 * size;
+			chunks.push_back(std::make_unique<char[]>(length));
+			chunk = chunks.back().get();
+			chunk_end = chunk + length;
+		}
+		last = chunk;
+		chunk += size;
+		return const_cast<char *>(last);
+	}
+
+	Value Interpreter::append(Value string, const char *data, std::int64_t length)
+	{
+		if(length == 0) return string;
+		if(string.length > 0 && string.data == last && string.data + string.length == chunk && chunk_end - chunk >= length)
+		{
+			std::memcpy(chunk, data, length);
+			chunk += length;
+			string.length += length;
+			return string;
+		}
+
+		auto result = allocate(string.length + length);
+		if(string.length > 0) std::memcpy(result, string.data, string.length);
+		std::memcpy(result + string.length, data, length);
+		Value value;
+		value.data = result;
+		value.length = string.length + length;
+		return value;
+	}
+
+	Value Interpreter::concat(Value left, Value right)
+	{
+		if(left.length == 0) return right;
+		return append(left, right.data, right.length);
+	}
+
+	Value Interpreter::text(Type type, Value value)
+	{
+		char buffer[40];
+		switch(type)
+		{
+			case Type::Int:
+				return append({}, buffer, format_int(buffer, value.integer));
+			case Type::Float:
+				return append({}, buffer, format_float(buffer, value.real));
+			case Type::Bool:
+			{
+				Value result;
+				result.data = value.integer ? "true" : "false";
+				result.length = value.integer ? 4 : 5;
+				return result;
+			}
+			case Type::String:
+				return value;
+			default:
+			{
+				Value result;
+				result.data = "()";
+				result.length = 2;
+				return result;
+			}
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "native.h"
+#include "program.h"
+#include "profiler.h"
+#include "value.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Interp
+{
+	class Tier;
+
+	// Runs a lowered program the way the C backend's executable would: the
+	// same values, printed the same way, and the same errors, after which
+	// the program stops. Strings are allocated in chunks that live as long
+	// as the interpreter, and appending to the string allocated last copies
+	// only what is appended.
+	class Interpreter
+	{
+	public:
+		// with a profiler, every call and loop is reported to it; with a
+		// tier, functions and loops that have native code run it instead
+		Interpreter(const Program &program, std::FILE *out, Profiler *profiler = nullptr, Tier *tier = nullptr);
+		~Interpreter();
+
+		Interpreter(const Interpreter &) = delete;
+		Interpreter &operator=(const Interpreter &) = delete;
+
+		// runs the top level of every module, in order, on a thread with a
+		// stack large enough for deep recursion in the program; returns false
+		// if the program stopped on an error, which is logged
+		bool run();
+
+	private:
+		const Program &program;
+		std::FILE *out;
+		Profiler *profiler;
+		Tier *tier;
+		// what the tier's native code calls back into
+		Runtime runtime;
+
+		// numbers and strings of the program, as values
+		std::vector<Value> constants, strings;
+		std::vector<Value> globals;
+		// the frames of the calls, each the slots of its function
+		std::vector<Value> values;
+		size_t base = 0, top = 0;
+		// whose frame is at base
+		std::uint32_t function = 0;
+		// what the last return returned
+		Value result;
+		// calls fail once the stack gets below this
+		std::uintptr_t limit = 0;
+
+		char *chunk = nullptr, *chunk_end = nullptr;
+		const char *last = nullptr;
+		std::vector<std::unique_ptr<char[]>> chunks;
+
+		void execute();
+		bool exec(std::uint32_t index);
+		bool loop(const Op &op);
+		Value eval(std::uint32_t index);
+		Value call(const Op &op, std::uint32_t index);
+		Value enter(std::uint32_t index, size_t frame);
+		[[noreturn]] void fail(std::uint32_t index, std::string message);
+
+		char *allocate(std::int64_t size);
+		Value append(Value string, const char *data, std::int64_t length);
+		Value concat(Value left, Value right);
+		Value text(Type type, Value value);
+
+		struct Native;
+	};
+}
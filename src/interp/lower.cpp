@@ -0,0 +1,730 @@
+#include "lower.h"
+
+#include "log.h"
+#include "lang.h"
+#include "optimize/tree.h"
+#include "util/noderange.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace Interp
+{
+	namespace
+	{
+		Expression &ungroup(Expression &node)
+		{
+			auto expr = &node;
+			while(expr->kind == NodeKind::GroupExpr)
+				expr = static_cast<GroupExpr *>(expr)->expr.get();
+			return *expr;
+		}
+
+		// the symbol table leaves a reference with the symbol it found, which
+		// the type checker then replaced on the defining identifier with a
+		// typed one
+		const DataType &symbol_type(const Identifier &node)
+		{
+			const auto &symbol = *node.symbol;
+			if(symbol.type.is_function || symbol.type != DataType::Invalid || !symbol.node || symbol.node->kind != NodeKind::Identifier)
+				return symbol.type;
+			return static_cast<Identifier *>(symbol.node)->symbol->type;
+		}
+
+		Type value_type(std::string_view name)
+		{
+			if(name == "Int") return Type::Int;
+			else if(name == "Float") return Type::Float;
+			else if(name == "String") return Type::String;
+			else if(name == "Bool") return Type::Bool;
+			else return Type::Unit;
+		}
+
+		const char *type_name(Type type)
+		{
+			switch(type)
+			{
+				case Type::Int: return "Int";
+				case Type::Float: return "Float";
+				case Type::String: return "String";
+				case Type::Bool: return "Bool";
+				default: return "()";
+			}
+		}
+
+		// what a name refers to
+		struct Target
+		{
+			enum class Kind : std::uint8_t
+			{
+				Local,
+				Global,
+				Function,
+				Builtin
+			};
+
+			Kind kind;
+			std::uint32_t index;
+			// the function a local belongs to
+			const Node *owner = nullptr;
+		};
+
+		class Lowerer
+		{
+		public:
+			Lowerer(const std::vector<Build::Unit> &units, Program &program)
+				: units(units),
+				  program(program),
+				  exports(units.size())
+			{}
+
+			bool run()
+			{
+				for(size_t unit = 0; unit < units.size(); unit++)
+				{
+					const auto &context = units[unit].context;
+					auto file = context.diagnostics().file();
+					Util::DiagnosticEngine diagnostics(file, context.diagnostics().source(), context.token_list());
+					if(!add(unit, diagnostics))
+					{
+						Logger::Unit log(file);
+						diagnostics.print();
+						Logger::get().error("unable to run file '", file, "'");
+						Logger::get().flush();
+						return false;
+					}
+				}
+				return true;
+			}
+
+		private:
+			const std::vector<Build::Unit> &units;
+			Program &program;
+
+			// top-level definitions of every unit, by name
+			std::vector<std::unordered_map<std::string_view, Target>> exports;
+			// by defining identifier
+			std::unordered_map<const Identifier *, Target> targets;
+
+			// the unit being lowered
+			size_t unit = 0;
+			Util::DiagnosticEngine *diagnostics = nullptr;
+			const std::vector<Token> *tokens = nullptr;
+			const ConstantPool *constants = nullptr;
+			bool error = false;
+
+			// the function being lowered, and its definition, or the Program
+			// for the top level
+			std::uint32_t function = 0;
+			const Node *owner = nullptr;
+
+			bool add(size_t index, Util::DiagnosticEngine &engine)
+			{
+				unit = index;
+				diagnostics = &engine;
+				tokens = &engine.tokens();
+				constants = &units[unit].context.constant_pool();
+				error = false;
+
+				auto program_node = units[unit].context.syntax_tree();
+				auto file = static_cast<std::uint32_t>(program.files.size());
+				program.files.emplace_back(engine.file());
+
+				// every function gets its index before any body is lowered,
+				// so calls can come before definitions
+				std::vector<FunctionDef *> definitions;
+				if(program_node)
+				{
+					std::vector<Node *> stack = { program_node };
+					while(!stack.empty())
+					{
+						auto node = stack.back();
+						stack.pop_back();
+						if(node->kind == NodeKind::FunctionDef)
+						{
+							auto &def = static_cast<FunctionDef &>(*node);
+							targets[def.name.get()] = { Target::Kind::Function, static_cast<std::uint32_t>(program.functions.size() + 1 + definitions.size()) };
+							definitions.push_back(&def);
+						}
+						// children in reverse, so definitions are numbered in
+						// source order
+						auto mark = stack.size();
+						Optimize::for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+						std::reverse(stack.begin() + mark, stack.end());
+					}
+				}
+
+				auto slash = engine.file().find_last_of('/');
+				auto module = static_cast<std::uint32_t>(program.functions.size());
+				program.functions.push_back({ std::string(slash == std::string_view::npos ? engine.file() : engine.file().substr(slash + 1)), file, { 1, 1 }, none, 0, 0, Type::Unit });
+				program.modules.push_back(module);
+
+				for(auto def : definitions)
+				{
+					program.functions.push_back({ std::string(def->name->token(*tokens).value), file, def->name->token(*tokens).location, none, static_cast<std::uint32_t>(def->parameters.size()), 0, value_type(def->name->symbol->type.value) });
+				}
+
+				begin(module, program_node);
+				program.functions[module].body = program_node ? top_level(*program_node) : emit({ Code::Block, Type::Unit, static_cast<std::uint32_t>(program.lists.size()), 0 }, nullptr);
+
+				for(auto def : definitions)
+				{
+					auto index = targets.at(def->name.get()).index;
+					begin(index, def);
+					std::uint32_t slot = 0;
+					for(const auto &param : def->parameters)
+						targets[param->name.get()] = { Target::Kind::Local, slot++, def };
+					program.functions[index].slots = slot;
+					program.functions[index].body = block(*def->body);
+				}
+
+				return !error;
+			}
+
+			void begin(std::uint32_t index, const Node *node)
+			{
+				function = index;
+				owner = node;
+			}
+
+			void unsupported(Node *node, std::string what)
+			{
+				error = true;
+				diagnostics->report(node, Util::DiagnosticCode::NotRunnable, what);
+			}
+
+			// of the token an error at the node is shown at
+			Util::FileLocation location(Node *node) const
+			{
+				if(!node) return {};
+				switch(node->kind)
+				{
+					case NodeKind::NumberLiteral:
+					case NodeKind::StringLiteral:
+					case NodeKind::BooleanLiteral:
+					case NodeKind::UnitLiteral:
+					case NodeKind::Identifier:
+						return static_cast<::Value *>(node)->token(*tokens).location;
+					case NodeKind::InfixOperator:
+					case NodeKind::PrefixOperator:
+					case NodeKind::PostfixOperator:
+						return static_cast<Operator *>(node)->token(*tokens).location;
+					case NodeKind::FunctionCall:
+						return static_cast<FunctionCall *>(node)->name->token(*tokens).location;
+					case NodeKind::VariableDef:
+						return static_cast<VariableDef *>(node)->name->token(*tokens).location;
+					case NodeKind::FunctionDef:
+						return static_cast<FunctionDef *>(node)->name->token(*tokens).location;
+					case NodeKind::Import:
+						return static_cast<Import *>(node)->import_keyword(*tokens).location;
+					case NodeKind::ReturnExpr:
+						return static_cast<ReturnExpr *>(node)->return_keyword(*tokens).location;
+					case NodeKind::IfExpr:
+						return static_cast<IfExpr *>(node)->if_keyword(*tokens).location;
+					case NodeKind::WhileExpr:
+						return static_cast<WhileExpr *>(node)->while_keyword(*tokens).location;
+					case NodeKind::Block:
+						return static_cast<Block *>(node)->lbrace(*tokens).location;
+					default:
+						return Util::NodeRange(node, *tokens).begin;
+				}
+			}
+
+			std::uint32_t emit(const Op &op, Node *node)
+			{
+				program.ops.push_back(op);
+				program.lines.push_back(location(node));
+				return static_cast<std::uint32_t>(program.ops.size() - 1);
+			}
+
+			Type type(std::uint32_t op) const
+			{
+				return program.ops[op].type;
+			}
+
+			std::uint32_t list(const std::vector<std::uint32_t> &ops)
+			{
+				auto start = static_cast<std::uint32_t>(program.lists.size());
+				program.lists.insert(program.lists.end(), ops.begin(), ops.end());
+				return start;
+			}
+
+			std::uint32_t slot()
+			{
+				return program.functions[function].slots++;
+			}
+
+			// names
+
+			Target resolve(Identifier &node)
+			{
+				const auto &symbol = *node.symbol;
+
+				// built-in function
+				if(!symbol.node)
+					return { Target::Kind::Builtin, 0 };
+
+				if(symbol.node->kind == NodeKind::Import)
+				{
+					auto module = static_cast<Import *>(symbol.node)->name(*tokens).value;
+					for(const auto &[name, index] : units[unit].imports)
+					{
+						if(name == module)
+							return exports[index].at(node.token(*tokens).value);
+					}
+				}
+
+				auto found = targets.find(static_cast<Identifier *>(symbol.node));
+				if(found == targets.end() || (found->second.kind == Target::Kind::Local && found->second.owner != owner))
+				{
+					unsupported(&node, "using a variable of an enclosing function");
+					return { Target::Kind::Local, 0 };
+				}
+				return found->second;
+			}
+
+			// a variable an assignment or increment changes
+			Target variable(Expression &node)
+			{
+				auto &id = static_cast<Identifier &>(ungroup(node));
+				auto target = resolve(id);
+				if(target.kind == Target::Kind::Function || target.kind == Target::Kind::Builtin)
+				{
+					unsupported(&id, "assigning to a function");
+					return { Target::Kind::Local, 0 };
+				}
+				return target;
+			}
+
+			// statements
+
+			std::uint32_t top_level(::Program &node)
+			{
+				// top-level variables are globals, which functions read
+				for(const auto &stmt : node.statements)
+				{
+					if(stmt->kind == NodeKind::VariableDef)
+					{
+						auto &def = static_cast<VariableDef &>(*stmt);
+						Target target = { Target::Kind::Global, program.globals++ };
+						targets[def.name.get()] = target;
+						exports[unit][def.name->token(*tokens).value] = target;
+					}
+					else if(stmt->kind == NodeKind::FunctionDef)
+					{
+						auto &def = static_cast<FunctionDef &>(*stmt);
+						exports[unit][def.name->token(*tokens).value] = targets.at(def.name.get());
+					}
+				}
+
+				std::vector<std::uint32_t> statements;
+				for(const auto &stmt : node.statements)
+					statements.push_back(statement(*stmt));
+				return emit({ Code::Block, Type::Unit, list(statements), static_cast<std::uint32_t>(statements.size()) }, nullptr);
+			}
+
+			std::uint32_t block(Block &node)
+			{
+				std::vector<std::uint32_t> statements;
+				for(const auto &stmt : node.statements)
+					statements.push_back(statement(*stmt));
+				return emit({ Code::Block, Type::Unit, list(statements), static_cast<std::uint32_t>(statements.size()) }, &node);
+			}
+
+			std::uint32_t statement(Statement &node)
+			{
+				switch(node.kind)
+				{
+					case NodeKind::ExprStatement:
+						return expression(*static_cast<ExprStatement &>(node).expr, false);
+					case NodeKind::VariableDef:
+						return definition(static_cast<VariableDef &>(node));
+					case NodeKind::Block:
+						return block(static_cast<Block &>(node));
+					default:
+						// functions are lowered on their own, and imports
+						// were resolved by the build
+						return emit({ Code::Nop, Type::Unit }, &node);
+				}
+			}
+
+			std::uint32_t definition(VariableDef &node)
+			{
+				auto var_type = value_type(node.name->symbol->type.value);
+				auto value = node.value ? expression(*node.value, true) : emit({ Code::Zero, var_type }, &node);
+
+				auto found = targets.find(node.name.get());
+				if(found != targets.end() && found->second.kind == Target::Kind::Global)
+					return emit({ Code::SetGlobal, var_type, found->second.index, value }, &node);
+
+				Target target = { Target::Kind::Local, slot(), owner };
+				targets[node.name.get()] = target;
+				return emit({ Code::SetLocal, var_type, target.index, value }, &node);
+			}
+
+			// a branch of an if; as the emitter gives an if a value, a block
+			// typed by its return never ends normally, so only a statement
+			// that is not a block gives the value
+			std::uint32_t branch(Statement &node, bool used)
+			{
+				if(node.kind == NodeKind::ExprStatement)
+					return expression(*static_cast<ExprStatement &>(node).expr, used);
+				if(node.kind == NodeKind::FunctionDef && used)
+					unsupported(&node, "using a function as a value");
+				return statement(node);
+			}
+
+			// as the type checker types a branch of an if
+			Type branch_type(Statement &node, std::uint32_t op) const
+			{
+				switch(node.kind)
+				{
+					case NodeKind::ExprStatement:
+					case NodeKind::VariableDef:
+						return type(op);
+					case NodeKind::Block:
+					{
+						// the type of the first return directly in it
+						const auto &block = program.ops[op];
+						for(std::uint32_t i = 0; i < block.b; i++)
+						{
+							const auto &stmt = program.ops[program.lists[block.a + i]];
+							if(stmt.code == Code::Return)
+								return stmt.type;
+						}
+						return Type::Unit;
+					}
+					default:
+						return Type::Unit;
+				}
+			}
+
+			// expressions
+
+			// operator chains, groups and calls can nest arbitrarily deep, so
+			// they are lowered with an explicit stack; operands are lowered
+			// before what uses them, in the order they are evaluated
+			std::uint32_t expression(Expression &root, bool used)
+			{
+				struct Frame
+				{
+					Expression *node;
+					bool used;
+					// 0 before the operands are queued
+					size_t stage;
+				};
+				std::vector<Frame> stack = { { &root, used, 0 } };
+				std::vector<std::uint32_t> values;
+
+				auto pop = [&values]()
+				{
+					auto value = values.back();
+					values.pop_back();
+					return value;
+				};
+
+				while(!stack.empty())
+				{
+					auto node = stack.back().node;
+					auto node_used = stack.back().used;
+					auto stage = stack.back().stage++;
+					std::uint32_t value;
+
+					switch(node->kind)
+					{
+						case NodeKind::InfixOperator:
+						{
+							auto &op = static_cast<InfixOperator &>(*node);
+							// an assignment lowers only its value
+							auto assignment = Lang::is_assignment(op.token(*tokens).value);
+							if(stage == 0)
+							{
+								stack.push_back({ op.right.get(), true, 0 });
+								if(!assignment)
+									stack.push_back({ op.left.get(), true, 0 });
+								continue;
+							}
+
+							auto right = pop();
+							value = assignment ? assign(op, right) : infix(op, pop(), right);
+							break;
+						}
+						case NodeKind::PrefixOperator:
+						{
+							auto &op = static_cast<PrefixOperator &>(*node);
+							if(stage == 0)
+							{
+								if(steps(op))
+								{
+									value = step(op);
+									break;
+								}
+								stack.push_back({ op.operand.get(), true, 0 });
+								continue;
+							}
+
+							value = prefix(op, pop());
+							break;
+						}
+						case NodeKind::PostfixOperator:
+						{
+							auto &op = static_cast<PostfixOperator &>(*node);
+							// nothing to change; the value is the operand's
+							if(ungroup(*op.operand).kind != NodeKind::Identifier)
+							{
+								if(stage == 0)
+								{
+									stack.push_back({ op.operand.get(), true, 0 });
+									continue;
+								}
+								value = pop();
+								break;
+							}
+
+							auto target = variable(*op.operand);
+							auto delta = op.token(*tokens).value == "++" ? 1 : -1;
+							value = emit({ target.kind == Target::Kind::Global ? Code::StepGlobal : Code::StepLocal, Type::Int, target.index, static_cast<std::uint32_t>(delta), 1 }, &op);
+							break;
+						}
+						case NodeKind::GroupExpr:
+						{
+							if(stage == 0)
+							{
+								stack.push_back({ static_cast<GroupExpr &>(*node).expr.get(), node_used, 0 });
+								continue;
+							}
+							value = pop();
+							break;
+						}
+						case NodeKind::FunctionCall:
+						{
+							auto &call = static_cast<FunctionCall &>(*node);
+							if(stage == 0)
+							{
+								for(auto arg = call.arguments.rbegin(); arg != call.arguments.rend(); ++arg)
+									stack.push_back({ arg->get(), true, 0 });
+								continue;
+							}
+
+							std::vector<std::uint32_t> arguments(values.end() - call.arguments.size(), values.end());
+							values.resize(values.size() - call.arguments.size());
+							value = this->call(call, arguments);
+							break;
+						}
+						default:
+							value = term(*node, node_used);
+							break;
+					}
+
+					stack.pop_back();
+					values.push_back(value);
+				}
+				return values.back();
+			}
+
+			// an expression that is not an operator, group or call
+			std::uint32_t term(Expression &node, bool used)
+			{
+				switch(node.kind)
+				{
+					case NodeKind::NumberLiteral:
+					{
+						const auto &constant = (*constants)[static_cast<NumberLiteral &>(node).token(*tokens).constant];
+						std::uint64_t bits;
+						if(constant.kind == Constant::Kind::Float)
+							std::memcpy(&bits, &constant.real, sizeof bits);
+						else
+							bits = static_cast<std::uint64_t>(constant.integer);
+						program.numbers.push_back(bits);
+						return emit({ Code::Number, constant.kind == Constant::Kind::Float ? Type::Float : Type::Int, static_cast<std::uint32_t>(program.numbers.size() - 1) }, &node);
+					}
+					case NodeKind::StringLiteral:
+					{
+						program.strings.emplace_back((*constants)[static_cast<StringLiteral &>(node).token(*tokens).constant].text);
+						return emit({ Code::String, Type::String, static_cast<std::uint32_t>(program.strings.size() - 1) }, &node);
+					}
+					case NodeKind::BooleanLiteral:
+					{
+						program.numbers.push_back(static_cast<BooleanLiteral &>(node).token(*tokens).value == "true");
+						return emit({ Code::Number, Type::Bool, static_cast<std::uint32_t>(program.numbers.size() - 1) }, &node);
+					}
+					case NodeKind::UnitLiteral:
+						return emit({ Code::Zero, Type::Unit }, &node);
+					case NodeKind::Identifier:
+					{
+						auto &id = static_cast<Identifier &>(node);
+						auto target = resolve(id);
+						auto id_type = value_type(symbol_type(id).value);
+						if(target.kind == Target::Kind::Function || target.kind == Target::Kind::Builtin)
+						{
+							unsupported(&id, "using a function as a value");
+							return emit({ Code::Zero, Type::Unit }, &node);
+						}
+						return emit({ target.kind == Target::Kind::Global ? Code::Global : Code::Local, id_type, target.index }, &node);
+					}
+					case NodeKind::ReturnExpr:
+					{
+						auto &ret = static_cast<ReturnExpr &>(node);
+						auto value = ret.value ? expression(*ret.value, true) : none;
+						auto value_type = value == none ? Type::Unit : type(value);
+
+						// only the first return directly in the body is
+						// checked against the signature
+						auto returns = program.functions[function].returns;
+						if(owner->kind == NodeKind::FunctionDef && value_type != returns)
+							unsupported(&node, std::string("returning '") + type_name(value_type) + "' from a function that returns '" + type_name(returns) + "'");
+						return emit({ Code::Return, value_type, value }, &node);
+					}
+					case NodeKind::IfExpr:
+					{
+						auto &expr = static_cast<IfExpr &>(node);
+						auto condition = expression(*expr.condition, true);
+						auto if_branch = branch(*expr.if_branch, used);
+						auto else_branch = expr.else_branch ? branch(*expr.else_branch, used) : none;
+						return emit({ Code::If, branch_type(*expr.if_branch, if_branch), condition, if_branch, else_branch }, &node);
+					}
+					case NodeKind::WhileExpr:
+					{
+						auto &expr = static_cast<WhileExpr &>(node);
+						auto loop = static_cast<std::uint32_t>(program.loops.size());
+						program.loops.push_back({ function, expr.while_keyword(*tokens).location });
+						auto condition = expression(*expr.condition, true);
+						auto body = statement(*expr.body);
+						return emit({ Code::While, Type::Unit, condition, body, loop }, &node);
+					}
+					default:
+						return emit({ Code::Zero, Type::Unit }, &node);
+				}
+			}
+
+			// with its arguments lowered
+			std::uint32_t call(FunctionCall &node, const std::vector<std::uint32_t> &arguments)
+			{
+				auto target = resolve(*node.name);
+				auto returns = value_type(symbol_type(*node.name).value);
+				if(target.kind == Target::Kind::Builtin)
+				{
+					auto name = node.name->token(*tokens).value;
+					if(name == "print" && arguments.size() == 1)
+						return emit({ Code::Print, Type::Unit, arguments[0] }, &node);
+					unsupported(&node, "the built-in '" + std::string(name) + "'");
+					return emit({ Code::Zero, returns }, &node);
+				}
+				if(target.kind != Target::Kind::Function)
+				{
+					unsupported(node.name.get(), "calling a variable");
+					return emit({ Code::Zero, returns }, &node);
+				}
+				return emit({ Code::Call, returns, target.index, list(arguments), static_cast<std::uint32_t>(arguments.size()) }, &node);
+			}
+
+			// with its value lowered
+			std::uint32_t assign(InfixOperator &node, std::uint32_t value)
+			{
+				auto target = variable(*node.left);
+				return emit({ target.kind == Target::Kind::Global ? Code::SetGlobal : Code::SetLocal, type(value), target.index, value }, &node);
+			}
+
+			// with its operands lowered
+			std::uint32_t infix(InfixOperator &node, std::uint32_t left, std::uint32_t right)
+			{
+				auto sym = node.token(*tokens).value;
+				auto left_type = type(left), right_type = type(right);
+
+				auto binary = [&](Code code, Type result)
+				{
+					return emit({ code, result, left, right }, &node);
+				};
+
+				if(sym == "and" || sym == "&&")
+					return binary(Code::And, Type::Bool);
+				if(sym == "or" || sym == "||")
+					return binary(Code::Or, Type::Bool);
+
+				if(Lang::is_boolean_op(sym))
+				{
+					if(left_type == Type::String)
+						return binary(sym == "==" ? Code::EqString : Code::NeString, Type::Bool);
+
+					static const std::pair<std::string_view, Code> ints[] = { { "==", Code::EqInt }, { "!=", Code::NeInt }, { "<", Code::LtInt }, { "<=", Code::LeInt }, { ">", Code::GtInt }, { ">=", Code::GeInt } };
+					static const std::pair<std::string_view, Code> floats[] = { { "==", Code::EqFloat }, { "!=", Code::NeFloat }, { "<", Code::LtFloat }, { "<=", Code::LeFloat }, { ">", Code::GtFloat }, { ">=", Code::GeFloat } };
+					for(const auto &[op, code] : left_type == Type::Float ? floats : ints)
+					{
+						if(op == sym) return binary(code, Type::Bool);
+					}
+				}
+
+				if(left_type == Type::String || right_type == Type::String)
+				{
+					if(left_type != Type::String)
+						left = emit({ Code::ToString, Type::String, left }, node.left.get());
+					// appended without a string in between
+					else if(right_type == Type::Int)
+						return binary(Code::AppendInt, Type::String);
+					else if(right_type == Type::Float)
+						return binary(Code::AppendFloat, Type::String);
+
+					if(right_type != Type::String)
+						right = emit({ Code::ToString, Type::String, right }, node.right.get());
+					return binary(Code::Concat, Type::String);
+				}
+
+				if(left_type == Type::Float)
+				{
+					if(sym == "+") return binary(Code::AddFloat, Type::Float);
+					if(sym == "-") return binary(Code::SubFloat, Type::Float);
+					if(sym == "*") return binary(Code::MulFloat, Type::Float);
+					return binary(Code::DivFloat, Type::Float);
+				}
+
+				if(sym == "+") return binary(Code::AddInt, Type::Int);
+				if(sym == "-") return binary(Code::SubInt, Type::Int);
+				if(sym == "*") return binary(Code::MulInt, Type::Int);
+				if(sym == "/") return binary(Code::DivInt, Type::Int);
+				return binary(Code::ModInt, Type::Int);
+			}
+
+			// an increment or decrement of a variable, which lowers no operand
+			bool steps(PrefixOperator &node) const
+			{
+				auto sym = node.token(*tokens).value;
+				return (sym == "++" || sym == "--") && ungroup(*node.operand).kind == NodeKind::Identifier;
+			}
+
+			std::uint32_t step(PrefixOperator &node)
+			{
+				auto target = variable(*node.operand);
+				auto delta = node.token(*tokens).value == "++" ? 1 : -1;
+				return emit({ target.kind == Target::Kind::Global ? Code::StepGlobal : Code::StepLocal, Type::Int, target.index, static_cast<std::uint32_t>(delta), 0 }, &node);
+			}
+
+			// with its operand lowered
+			std::uint32_t prefix(PrefixOperator &node, std::uint32_t operand)
+			{
+				auto sym = node.token(*tokens).value;
+				if(sym == "-")
+					return emit({ type(operand) == Type::Float ? Code::NegFloat : Code::NegInt, type(operand), operand }, &node);
+				if(sym == "!" || sym == "not")
+					return emit({ Code::Not, Type::Bool, operand }, &node);
+
+				// of something that is not a variable, so nothing is changed
+				if(sym == "++" || sym == "--")
+				{
+					program.numbers.push_back(1);
+					auto one = emit({ Code::Number, Type::Int, static_cast<std::uint32_t>(program.numbers.size() - 1) }, &node);
+					return emit({ sym == "++" ? Code::AddInt : Code::SubInt, Type::Int, operand, one }, &node);
+				}
+				return operand;
+			}
+		};
+	}
+
+	bool lower(const std::vector<Build::Unit> &units, Program &program)
+	{
+		Lowerer lowerer(units, program);
+		return lowerer.run();
+	}
+}
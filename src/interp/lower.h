@@ -0,0 +1,16 @@
+#pragma once
+
+#include "build.h"
+#include "program.h"
+
+namespace Interp
+{
+	// Lowers the units of a build, in the order they run, to one program.
+	// What the interpreter cannot run is what C cannot express: functions
+	// used as values, and nested functions that read variables of the
+	// function around them. It is reported through the diagnostics of the
+	// unit, which are printed; then false is returned.
+	//
+	// The units must have been checked by the tree passes.
+	bool lower(const std::vector<Build::Unit> &units, Program &program);
+}
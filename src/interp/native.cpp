@@ -0,0 +1,686 @@
+#include "native.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <utility>
+
+namespace Interp
+{
+	namespace
+	{
+		static_assert(sizeof(Value) == 16 && offsetof(Value, length) == 8);
+
+		// the runtime as C sees it; the same layout as Runtime
+		constexpr const char *prelude = R"(#include <stdint.h>
+#include <string.h>
+
+typedef struct cy_value
+{
+	union
+	{
+		int64_t integer;
+		double real;
+		const char *data;
+	} u;
+	int64_t length;
+} cy_value;
+
+typedef struct cy_runtime cy_runtime;
+struct cy_runtime
+{
+	void *interpreter;
+	cy_value *globals;
+	const cy_value *strings;
+	void **code;
+	uintptr_t limit;
+	cy_value *(*frame)(cy_runtime *runtime);
+	cy_value (*call)(cy_runtime *runtime, uint32_t function, cy_value *arguments);
+	void (*fail)(cy_runtime *runtime, uint32_t function, uint32_t op, const char *message);
+	cy_value (*concat)(cy_runtime *runtime, cy_value left, cy_value right);
+	cy_value (*append_int)(cy_runtime *runtime, cy_value left, int64_t right);
+	cy_value (*append_float)(cy_runtime *runtime, cy_value left, double right);
+	cy_value (*text)(cy_runtime *runtime, uint32_t type, cy_value value);
+	void (*print)(cy_runtime *runtime, cy_value text);
+};
+
+static inline cy_value cy_int(int64_t value)
+{
+	cy_value result;
+	result.u.integer = value;
+	result.length = 0;
+	return result;
+}
+
+static inline cy_value cy_real(double value)
+{
+	cy_value result;
+	result.u.real = value;
+	result.length = 0;
+	return result;
+}
+
+static inline double cy_bits(uint64_t bits)
+{
+	double value;
+	memcpy(&value, &bits, sizeof value);
+	return value;
+}
+
+static inline int64_t cy_equal(cy_value left, cy_value right)
+{
+	return left.length == right.length && (left.length == 0 || memcmp(left.u.data, right.u.data, (size_t)left.length) == 0);
+}
+
+__attribute__((noreturn, cold)) static void cy_fail(cy_runtime *rt, uint32_t function, uint32_t op, const char *message)
+{
+	rt->fail(rt, function, op, message);
+	__builtin_unreachable();
+}
+
+#define CY_CHECK(function, op) do { if((uintptr_t)__builtin_frame_address(0) < rt->limit) cy_fail(rt, function, op, "stack overflow"); } while(0)
+
+)";
+
+		const char *c_type(Type type)
+		{
+			switch(type)
+			{
+				case Type::Float: return "double";
+				case Type::String: return "cy_value";
+				default: return "int64_t";
+			}
+		}
+
+		const char *zero(Type type)
+		{
+			switch(type)
+			{
+				case Type::Float: return "0.0";
+				case Type::String: return "cy_int(0)";
+				default: return "0";
+			}
+		}
+
+		// the same C type
+		bool same(Type a, Type b)
+		{
+			return std::strcmp(c_type(a), c_type(b)) == 0;
+		}
+
+		std::string pack(Type type, const std::string &value)
+		{
+			switch(type)
+			{
+				case Type::Float: return "cy_real(" + value + ")";
+				case Type::String: return value;
+				default: return "cy_int(" + value + ")";
+			}
+		}
+
+		std::string unpack(Type type, const std::string &value)
+		{
+			switch(type)
+			{
+				case Type::Float: return value + ".u.real";
+				case Type::String: return value;
+				default: return value + ".u.integer";
+			}
+		}
+
+		// calls visit with the operands of an op, in the order they are
+		// evaluated
+		template<typename F>
+		void for_each_operand(const Program &program, const Op &op, F &&visit)
+		{
+			switch(op.code)
+			{
+				case Code::Block:
+					for(std::uint32_t i = 0; i < op.b; i++)
+						visit(program.lists[op.a + i]);
+					break;
+				case Code::Call:
+					for(std::uint32_t i = 0; i < op.c; i++)
+						visit(program.lists[op.b + i]);
+					break;
+				case Code::If:
+					visit(op.a);
+					visit(op.b);
+					if(op.c != none) visit(op.c);
+					break;
+				case Code::Return:
+					if(op.a != none) visit(op.a);
+					break;
+				case Code::SetLocal:
+				case Code::SetGlobal:
+					visit(op.b);
+					break;
+				case Code::Nop:
+				case Code::Zero:
+				case Code::Number:
+				case Code::String:
+				case Code::Local:
+				case Code::Global:
+				case Code::StepLocal:
+				case Code::StepGlobal:
+					break;
+				case Code::NegInt:
+				case Code::NegFloat:
+				case Code::Not:
+				case Code::ToString:
+				case Code::Print:
+					visit(op.a);
+					break;
+				default:
+					visit(op.a);
+					visit(op.b);
+					break;
+			}
+		}
+
+		class Emitter
+		{
+		public:
+			Emitter(const Program &program, const std::vector<std::uint32_t> &functions)
+				: program(program),
+				  functions(functions),
+				  batch(program.functions.size()),
+				  types(program.functions.size())
+			{
+				for(auto function : functions)
+					batch[function] = true;
+			}
+
+			std::string emit()
+			{
+				for(auto function : functions)
+				{
+					write_function(function);
+					for(auto loop : loops(function))
+						write_loop(function, loop);
+				}
+
+				std::string result = prelude;
+				for(auto function : functions)
+					result += signature(function, typed_name(function)) + ";\n";
+				result += "\n";
+				for(auto callee : stubs)
+					write_stub(callee, result);
+				return result + definitions;
+			}
+
+		private:
+			const Program &program;
+			const std::vector<std::uint32_t> &functions;
+			std::vector<bool> batch;
+			// of the slots of every function, once needed
+			std::vector<std::vector<Type>> types;
+			// functions called from the batch that are not in it
+			std::set<std::uint32_t> stubs;
+			std::string definitions;
+
+			// the function being written, and whether as a loop entry
+			std::uint32_t function = 0;
+			bool loop_entry = false;
+			std::string body;
+			unsigned indent = 0;
+			size_t temporaries = 0;
+
+			// a slot that no op reads or writes is an Int, to C, and is
+			// never passed
+			const std::vector<Type> &slot_types(std::uint32_t index)
+			{
+				auto &slots = types[index];
+				if(!slots.empty() || program.functions[index].slots == 0) return slots;
+
+				slots.assign(program.functions[index].slots, Type::Unit);
+				std::vector<std::uint32_t> stack = { program.functions[index].body };
+				while(!stack.empty())
+				{
+					const auto &op = program.ops[stack.back()];
+					stack.pop_back();
+					if(op.code == Code::Local || op.code == Code::SetLocal)
+						slots[op.a] = op.type;
+					else if(op.code == Code::StepLocal)
+						slots[op.a] = Type::Int;
+					for_each_operand(program, op, [&](std::uint32_t operand) { stack.push_back(operand); });
+				}
+				return slots;
+			}
+
+			// the while ops of a function
+			std::vector<std::uint32_t> loops(std::uint32_t index)
+			{
+				std::vector<std::uint32_t> result;
+				std::vector<std::uint32_t> stack = { program.functions[index].body };
+				while(!stack.empty())
+				{
+					auto op = stack.back();
+					stack.pop_back();
+					if(program.ops[op].code == Code::While)
+						result.push_back(op);
+					for_each_operand(program, program.ops[op], [&](std::uint32_t operand) { stack.push_back(operand); });
+				}
+				return result;
+			}
+
+			std::string signature(std::uint32_t index, const std::string &name)
+			{
+				const auto &callee = program.functions[index];
+				const auto &slots = slot_types(index);
+				std::string result = std::string(c_type(callee.returns)) + " " + name + "(cy_runtime *rt";
+				for(std::uint32_t i = 0; i < callee.parameters; i++)
+					result += std::string(", ") + c_type(slots[i]) + " l" + std::to_string(i);
+				return result + ")";
+			}
+
+			void line(const std::string &text)
+			{
+				body.append(indent, '\t');
+				body += text;
+				body += '\n';
+			}
+
+			void open()
+			{
+				line("{");
+				indent++;
+			}
+
+			void close()
+			{
+				indent--;
+				line("}");
+			}
+
+			std::string temporary(Type type, const std::string &value)
+			{
+				auto name = "t" + std::to_string(temporaries++);
+				line(std::string(c_type(type)) + " " + name + " = " + value + ";");
+				return name;
+			}
+
+			void begin(std::uint32_t index, bool loop)
+			{
+				function = index;
+				loop_entry = loop;
+				body.clear();
+				indent = 1;
+				temporaries = 0;
+			}
+
+			void write_function(std::uint32_t index)
+			{
+				begin(index, false);
+				const auto &callee = program.functions[index];
+				const auto &slots = slot_types(index);
+				for(auto i = callee.parameters; i < callee.slots; i++)
+					line(std::string(c_type(slots[i])) + " l" + std::to_string(i) + " = " + zero(slots[i]) + ";");
+				statement(callee.body);
+				line(std::string("return ") + zero(callee.returns) + ";");
+
+				definitions += signature(index, typed_name(index)) + "\n{\n" + body + "}\n\n";
+
+				// the entry the interpreter calls
+				std::string arguments;
+				for(std::uint32_t i = 0; i < callee.parameters; i++)
+					arguments += ", " + unpack(slots[i], "a[" + std::to_string(i) + "]");
+				definitions += "cy_value " + entry_name(index) + "(cy_runtime *rt, cy_value *a)\n{\n";
+				definitions += "\treturn " + pack(callee.returns, typed_name(index) + "(rt" + arguments + ")") + ";\n}\n\n";
+			}
+
+			// the slots are loaded from the frame, and stored back once the
+			// loop is done
+			void write_loop(std::uint32_t index, std::uint32_t op)
+			{
+				begin(index, true);
+				const auto &slots = slot_types(index);
+				line("cy_value *frame = rt->frame(rt);");
+				for(size_t i = 0; i < slots.size(); i++)
+					line(std::string(c_type(slots[i])) + " l" + std::to_string(i) + " = " + unpack(slots[i], "frame[" + std::to_string(i) + "]") + ";");
+				statement(op);
+				line("frame = rt->frame(rt);");
+				for(size_t i = 0; i < slots.size(); i++)
+					line("frame[" + std::to_string(i) + "] = " + pack(slots[i], "l" + std::to_string(i)) + ";");
+				line("return 0;");
+
+				definitions += "int " + loop_name(program.ops[op].c) + "(cy_runtime *rt, cy_value *result)\n{\n" + body + "}\n\n";
+			}
+
+			// calls to a function outside the batch go through the runtime
+			void write_stub(std::uint32_t index, std::string &out)
+			{
+				const auto &callee = program.functions[index];
+				const auto &slots = slot_types(index);
+				std::string types = "cy_runtime *", arguments = "rt";
+				for(std::uint32_t i = 0; i < callee.parameters; i++)
+				{
+					types += std::string(", ") + c_type(slots[i]);
+					arguments += ", l" + std::to_string(i);
+				}
+
+				auto returns = std::string(c_type(callee.returns));
+				auto pointer = returns + " (*)(" + types + ")";
+				out += "static " + signature(index, "cy_c" + std::to_string(index)) + "\n{\n";
+				out += "\t" + returns + " (*f)(" + types + ") = (" + pointer + ")__atomic_load_n(&rt->code[" + std::to_string(index) + "], __ATOMIC_ACQUIRE);\n";
+				out += "\tif(f)\n\t\treturn f(" + arguments + ");\n";
+				out += "\tcy_value a[" + std::to_string(std::max<std::uint32_t>(callee.parameters, 1)) + "];\n";
+				for(std::uint32_t i = 0; i < callee.parameters; i++)
+					out += "\ta[" + std::to_string(i) + "] = " + pack(slots[i], "l" + std::to_string(i)) + ";\n";
+				out += "\treturn " + unpack(callee.returns, "rt->call(rt, " + std::to_string(index) + ", a)") + ";\n}\n\n";
+			}
+
+			// as in Interpreter::exec
+			void statement(std::uint32_t index)
+			{
+				const auto &op = program.ops[index];
+				switch(op.code)
+				{
+					case Code::Nop:
+						break;
+					case Code::Block:
+						for(std::uint32_t i = 0; i < op.b; i++)
+							statement(program.lists[op.a + i]);
+						break;
+					case Code::If:
+					{
+						auto condition = value(op.a);
+						line("if(" + condition + ")");
+						open();
+						statement(op.b);
+						close();
+						if(op.c != none)
+						{
+							line("else");
+							open();
+							statement(op.c);
+							close();
+						}
+						break;
+					}
+					case Code::While:
+					{
+						line("for(;;)");
+						open();
+						auto condition = value(op.a);
+						line("if(!" + condition + ") break;");
+						statement(op.b);
+						close();
+						break;
+					}
+					case Code::Return:
+					{
+						auto returns = program.functions[function].returns;
+						auto result = op.a == none ? std::string(zero(returns)) : value(op.a);
+						if(loop_entry)
+						{
+							line("*result = " + pack(returns, result) + ";");
+							line("return 1;");
+						}
+						else
+							line("return " + result + ";");
+						break;
+					}
+					default:
+						line("(void)" + value(index) + ";");
+						break;
+				}
+			}
+
+			// a branch, as the value of an if of the type
+			std::string branch(std::uint32_t index, Type type)
+			{
+				auto code = program.ops[index].code;
+				if(code == Code::Nop || code == Code::Block || code == Code::While)
+				{
+					statement(index);
+					return zero(type);
+				}
+				return value(index);
+			}
+
+			std::string number(const Op &op)
+			{
+				auto bits = program.numbers[op.a];
+				char buffer[64];
+				if(op.type == Type::Float)
+					std::snprintf(buffer, sizeof buffer, "cy_bits(UINT64_C(0x%016" PRIx64 "))", bits);
+				else if(static_cast<std::int64_t>(bits) >= 0)
+					std::snprintf(buffer, sizeof buffer, "INT64_C(%" PRId64 ")", static_cast<std::int64_t>(bits));
+				else
+					std::snprintf(buffer, sizeof buffer, "((int64_t)UINT64_C(%" PRIu64 "))", bits);
+				return buffer;
+			}
+
+			std::string local(std::uint32_t slot)
+			{
+				return "l" + std::to_string(slot);
+			}
+
+			std::string global(std::uint32_t slot)
+			{
+				return "rt->globals[" + std::to_string(slot) + "]";
+			}
+
+			// as in Interpreter::eval; the operands are stored before the
+			// operator is applied, so they are evaluated left to right
+			std::string value(std::uint32_t index)
+			{
+				const auto &op = program.ops[index];
+				auto type = op.type;
+				switch(op.code)
+				{
+					case Code::Nop:
+					case Code::Block:
+					case Code::While:
+					case Code::Return:
+						statement(index);
+						return zero(type);
+					case Code::If:
+					{
+						auto result = temporary(type, zero(type));
+						auto condition = value(op.a);
+						line("if(" + condition + ")");
+						open();
+						line(result + " = " + branch(op.b, type) + ";");
+						close();
+						if(op.c != none)
+						{
+							line("else");
+							open();
+							line(result + " = " + branch(op.c, type) + ";");
+							close();
+						}
+						return result;
+					}
+
+					case Code::Zero:
+						return zero(type);
+					case Code::Number:
+						return number(op);
+					case Code::String:
+						return "rt->strings[" + std::to_string(op.a) + "]";
+					case Code::Local:
+						return temporary(type, local(op.a));
+					case Code::Global:
+						return temporary(type, unpack(type, global(op.a)));
+					case Code::SetLocal:
+					{
+						auto result = value(op.b);
+						line(local(op.a) + " = " + result + ";");
+						return result;
+					}
+					case Code::SetGlobal:
+					{
+						auto result = value(op.b);
+						line(global(op.a) + " = " + pack(program.ops[op.b].type, result) + ";");
+						return result;
+					}
+					case Code::StepLocal:
+					case Code::StepGlobal:
+					{
+						auto variable = op.code == Code::StepLocal ? local(op.a) : global(op.a) + ".u.integer";
+						auto old = temporary(Type::Int, variable);
+						auto updated = temporary(Type::Int, old + " + " + std::to_string(static_cast<std::int32_t>(op.b)));
+						line(variable + " = " + updated + ";");
+						return op.c ? old : updated;
+					}
+
+					case Code::AddInt:
+					case Code::AddFloat:
+						return binary(op, "+");
+					case Code::SubInt:
+					case Code::SubFloat:
+						return binary(op, "-");
+					case Code::MulInt:
+					case Code::MulFloat:
+						return binary(op, "*");
+					case Code::DivFloat:
+						return binary(op, "/");
+					case Code::DivInt:
+					case Code::ModInt:
+					{
+						auto left = value(op.a);
+						auto right = value(op.b);
+						line("if(" + right + " == 0) cy_fail(rt, " + std::to_string(function) + ", " + std::to_string(index) + ", \"division by zero\");");
+						auto minus_one = op.code == Code::DivInt ? "-(" + left + ")" : std::string("0");
+						auto divided = left + (op.code == Code::DivInt ? " / " : " % ") + right;
+						return temporary(type, right + " == -1 ? " + minus_one + " : " + divided);
+					}
+
+					case Code::EqInt:
+					case Code::EqFloat:
+						return binary(op, "==");
+					case Code::NeInt:
+					case Code::NeFloat:
+						return binary(op, "!=");
+					case Code::LtInt:
+					case Code::LtFloat:
+						return binary(op, "<");
+					case Code::LeInt:
+					case Code::LeFloat:
+						return binary(op, "<=");
+					case Code::GtInt:
+					case Code::GtFloat:
+						return binary(op, ">");
+					case Code::GeInt:
+					case Code::GeFloat:
+						return binary(op, ">=");
+					case Code::EqString:
+					case Code::NeString:
+					{
+						auto left = value(op.a);
+						auto right = value(op.b);
+						return temporary(type, std::string(op.code == Code::NeString ? "!" : "") + "cy_equal(" + left + ", " + right + ")");
+					}
+					case Code::And:
+					case Code::Or:
+					{
+						// the right operand only if the left does not decide
+						bool is_and = op.code == Code::And;
+						auto result = temporary(type, is_and ? "0" : "1");
+						auto left = value(op.a);
+						line(std::string("if(") + (is_and ? "" : "!") + left + ")");
+						open();
+						line(result + " = " + value(op.b) + " != 0;");
+						close();
+						return result;
+					}
+
+					case Code::Concat:
+					{
+						auto left = value(op.a);
+						auto right = value(op.b);
+						return temporary(type, "rt->concat(rt, " + left + ", " + right + ")");
+					}
+					case Code::AppendInt:
+					case Code::AppendFloat:
+					{
+						auto left = value(op.a);
+						auto right = value(op.b);
+						auto append = op.code == Code::AppendInt ? "rt->append_int(rt, " : "rt->append_float(rt, ";
+						return temporary(type, append + left + ", " + right + ")");
+					}
+
+					case Code::NegInt:
+					case Code::NegFloat:
+						return temporary(type, "-(" + value(op.a) + ")");
+					case Code::Not:
+						return temporary(type, "!(" + value(op.a) + ")");
+					case Code::ToString:
+					{
+						auto operand = program.ops[op.a].type;
+						auto text = value(op.a);
+						return temporary(type, "rt->text(rt, " + std::to_string(static_cast<unsigned>(operand)) + ", " + pack(operand, text) + ")");
+					}
+
+					case Code::Call:
+						return call(op, index);
+					case Code::Print:
+					{
+						auto text = value(op.a);
+						line("rt->print(rt, " + text + ");");
+						return zero(type);
+					}
+				}
+				return zero(type);
+			}
+
+			std::string binary(const Op &op, const char *symbol)
+			{
+				auto left = value(op.a);
+				auto right = value(op.b);
+				return temporary(op.type, left + " " + symbol + " " + right);
+			}
+
+			std::string call(const Op &op, std::uint32_t index)
+			{
+				line("CY_CHECK(" + std::to_string(function) + ", " + std::to_string(index) + ");");
+
+				// an argument for a parameter the callee never uses is
+				// evaluated, but not passed
+				const auto &parameters = slot_types(op.a);
+				std::string arguments = "rt";
+				for(std::uint32_t i = 0; i < op.c; i++)
+				{
+					auto argument = program.lists[op.b + i];
+					auto text = value(argument);
+					arguments += ", " + (same(program.ops[argument].type, parameters[i]) ? text : std::string(zero(parameters[i])));
+				}
+
+				std::string callee;
+				if(batch[op.a])
+					callee = typed_name(op.a);
+				else
+				{
+					callee = "cy_c" + std::to_string(op.a);
+					stubs.insert(op.a);
+				}
+				return temporary(op.type, callee + "(" + arguments + ")");
+			}
+		};
+	}
+
+	std::string entry_name(std::uint32_t function)
+	{
+		return "cy_e" + std::to_string(function);
+	}
+
+	std::string typed_name(std::uint32_t function)
+	{
+		return "cy_f" + std::to_string(function);
+	}
+
+	std::string loop_name(std::uint32_t loop)
+	{
+		return "cy_l" + std::to_string(loop);
+	}
+
+	std::string emit_native(const Program &program, const std::vector<std::uint32_t> &functions)
+	{
+		return Emitter(program, functions).emit();
+	}
+}
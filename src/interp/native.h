@@ -0,0 +1,66 @@
+#pragma once
+
+#include "program.h"
+#include "value.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Interp
+{
+	// What native code sees of the interpreter that runs it; the C the
+	// emitter writes declares the same struct. Native code keeps the
+	// variables of its function in C variables and the rest in the
+	// interpreter, and calls back into it for strings, printing, errors and
+	// functions that are not native yet.
+	struct Runtime
+	{
+		void *interpreter;
+		Value *globals;
+		const Value *strings;
+		// the typed native function for each function, once there is one;
+		// read with an acquire load
+		void **code;
+		// calls fail once the stack gets below this
+		std::uintptr_t limit;
+
+		// the slots of the function the interpreter is running, which move
+		// when a call needs more
+		Value *(*frame)(Runtime *runtime);
+		// interprets a function with the arguments, as many as it has
+		// parameters
+		Value (*call)(Runtime *runtime, std::uint32_t function, Value *arguments);
+		// stops the program at the op, in the function; does not return
+		void (*fail)(Runtime *runtime, std::uint32_t function, std::uint32_t op, const char *message);
+		Value (*concat)(Runtime *runtime, Value left, Value right);
+		Value (*append_int)(Runtime *runtime, Value left, std::int64_t right);
+		Value (*append_float)(Runtime *runtime, Value left, double right);
+		Value (*text)(Runtime *runtime, std::uint32_t type, Value value);
+		void (*print)(Runtime *runtime, Value text);
+	};
+
+	// of a function, with the arguments in its first slots
+	using Entry = Value (*)(Runtime *runtime, Value *arguments);
+	// runs a loop of a function from its condition, with the slots of the
+	// function in the frame; returns 1 if the function returned, with what
+	// it returned in result, and 0 once the loop is done
+	using LoopEntry = int (*)(Runtime *runtime, Value *result);
+
+	// the names the native code of a function and its loops is found by
+	std::string entry_name(std::uint32_t function);
+	std::string typed_name(std::uint32_t function);
+	std::string loop_name(std::uint32_t loop);
+
+	// Writes C99 for the functions, each as a typed C function, an entry
+	// with the uniform signature and an entry for each of its loops. Every
+	// op becomes a statement that stores its value in a temporary, in the
+	// order the interpreter evaluates them, so the C is flat however deep
+	// the expressions are; the C compiler removes the temporaries. Integers
+	// wrap as they do in the interpreter, which needs -fwrapv.
+	//
+	// Calls to functions of the same batch are direct; other calls load the
+	// callee's native code from the runtime, and are interpreted while it
+	// has none.
+	std::string emit_native(const Program &program, const std::vector<std::uint32_t> &functions);
+}
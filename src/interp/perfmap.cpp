@@ -0,0 +1,193 @@
+#include "perfmap.h"
+
+#include "log.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <ctime>
+#include <utility>
+
+namespace Interp
+{
+	namespace
+	{
+		// the records of the jitdump format, as perf's
+		// Documentation/jitdump-specification.txt describes them
+		constexpr std::uint32_t jitdump_magic = 0x4A695444;
+		constexpr std::uint32_t jitdump_version = 1;
+
+		enum Record : std::uint32_t
+		{
+			CodeLoad = 0,
+			DebugInfo = 2,
+			CodeClose = 3
+		};
+
+		struct FileHeader
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint32_t size;
+			std::uint32_t machine;
+			std::uint32_t padding;
+			std::uint32_t pid;
+			std::uint64_t timestamp;
+			std::uint64_t flags;
+		};
+
+		struct RecordHeader
+		{
+			std::uint32_t id;
+			std::uint32_t size;
+			std::uint64_t timestamp;
+		};
+
+		// followed by the name and the code
+		struct LoadRecord
+		{
+			RecordHeader header;
+			std::uint32_t pid;
+			std::uint32_t tid;
+			std::uint64_t vma;
+			std::uint64_t address;
+			std::uint64_t size;
+			std::uint64_t index;
+		};
+
+		// followed by the entries, each a line and the file it is in
+		struct DebugRecord
+		{
+			RecordHeader header;
+			std::uint64_t address;
+			std::uint64_t entries;
+		};
+
+		struct DebugEntry
+		{
+			std::uint64_t address;
+			std::int32_t line;
+			std::int32_t discriminator;
+		};
+
+		static_assert(sizeof(FileHeader) == 40 && sizeof(LoadRecord) == 56 && sizeof(DebugRecord) == 32 && sizeof(DebugEntry) == 16);
+
+		constexpr std::uint32_t machine =
+#if defined(__x86_64__)
+		    EM_X86_64;
+#elif defined(__aarch64__)
+		    EM_AARCH64;
+#elif defined(__i386__)
+		    EM_386;
+#elif defined(__arm__)
+		    EM_ARM;
+#else
+		    EM_NONE;
+#endif
+
+		// the clock of 'perf record -k mono'
+		std::uint64_t timestamp()
+		{
+			timespec time;
+			clock_gettime(CLOCK_MONOTONIC, &time);
+			return static_cast<std::uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+		}
+	}
+
+	PerfMap::PerfMap(PerfFormat format, std::string directory)
+		: format(format),
+		  directory(std::move(directory))
+	{}
+
+	PerfMap::~PerfMap()
+	{
+		if(map)
+			std::fclose(map);
+		if(dump)
+		{
+			RecordHeader close = { CodeClose, sizeof(RecordHeader), timestamp() };
+			std::fwrite(&close, sizeof close, 1, dump);
+			std::fclose(dump);
+		}
+		if(marker)
+			munmap(marker, sysconf(_SC_PAGESIZE));
+	}
+
+	std::string PerfMap::map_path() const
+	{
+		return directory + "/perf-" + std::to_string(getpid()) + ".map";
+	}
+
+	std::string PerfMap::dump_path() const
+	{
+		return directory + "/jit-" + std::to_string(getpid()) + ".dump";
+	}
+
+	bool PerfMap::open()
+	{
+		auto path = map_path();
+		map = std::fopen(path.c_str(), "w");
+		if(!map)
+		{
+			Logger::get().error("unable to write '", path, "'");
+			return false;
+		}
+		if(format != PerfFormat::Jitdump) return true;
+
+		path = dump_path();
+		int fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+		if(fd < 0 || !(dump = fdopen(fd, "w+")))
+		{
+			if(fd >= 0) close(fd);
+			Logger::get().error("unable to write '", path, "'");
+			return false;
+		}
+
+		FileHeader header = { jitdump_magic, jitdump_version, sizeof(FileHeader), machine, 0, static_cast<std::uint32_t>(getpid()), timestamp(), 0 };
+		std::fwrite(&header, sizeof header, 1, dump);
+		std::fflush(dump);
+
+		// perf finds the dump through the executable mapping of it in the
+		// recording
+		marker = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+		if(marker == MAP_FAILED)
+		{
+			marker = nullptr;
+			Logger::get().warn("unable to map '", path, "'; perf will not find it");
+		}
+		return true;
+	}
+
+	void PerfMap::write(const std::vector<Code> &code)
+	{
+		auto pid = static_cast<std::uint32_t>(getpid());
+		auto tid = static_cast<std::uint32_t>(syscall(SYS_gettid));
+		for(const auto &piece : code)
+		{
+			auto address = reinterpret_cast<std::uintptr_t>(piece.address);
+			if(map)
+				std::fprintf(map, "%" PRIxPTR " %" PRIx64 " %s\n", address, piece.size, piece.name.c_str());
+			if(!dump) continue;
+
+			// the line of a piece of code comes before the code
+			DebugRecord debug = { { DebugInfo, 0, timestamp() }, address, 1 };
+			debug.header.size = static_cast<std::uint32_t>(sizeof debug + sizeof(DebugEntry) + piece.file.size() + 1);
+			DebugEntry entry = { address, static_cast<std::int32_t>(piece.line), 0 };
+			std::fwrite(&debug, sizeof debug, 1, dump);
+			std::fwrite(&entry, sizeof entry, 1, dump);
+			std::fwrite(piece.file.c_str(), 1, piece.file.size() + 1, dump);
+
+			LoadRecord load = { { CodeLoad, 0, timestamp() }, pid, tid, address, address, piece.size, loads++ };
+			load.header.size = static_cast<std::uint32_t>(sizeof load + piece.name.size() + 1 + piece.size);
+			std::fwrite(&load, sizeof load, 1, dump);
+			std::fwrite(piece.name.c_str(), 1, piece.name.size() + 1, dump);
+			std::fwrite(piece.address, 1, piece.size, dump);
+		}
+		if(map) std::fflush(map);
+		if(dump) std::fflush(dump);
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace Interp
+{
+	enum class PerfFormat : std::uint8_t
+	{
+		// perf-<pid>.map, which perf reads to name addresses in anonymous
+		// code
+		Map,
+		// the map, and jit-<pid>.dump with a copy of the code and the line
+		// of each function, which 'perf inject --jit' turns into ELF files
+		// that 'perf report' and 'perf annotate' read
+		Jitdump
+	};
+
+	// Describes native code that is loaded at run time to Linux perf, which
+	// otherwise sees it as addresses in a library that no longer exists.
+	// Perf reads the map only for anonymous code, which is why the tier moves
+	// the code of each library onto anonymous memory.
+	// The files are left for perf to read after the process has exited.
+	class PerfMap
+	{
+	public:
+		// a piece of code that was loaded
+		struct Code
+		{
+			const void *address;
+			std::uint64_t size;
+			std::string name;
+			// where it comes from in the program
+			std::string file;
+			unsigned line;
+		};
+
+		explicit PerfMap(PerfFormat format, std::string directory = "/tmp");
+		~PerfMap();
+
+		PerfMap(const PerfMap &) = delete;
+		PerfMap &operator=(const PerfMap &) = delete;
+
+		// creates the files, or logs why it cannot
+		bool open();
+		// appends the code to the files; on one thread at a time
+		void write(const std::vector<Code> &code);
+
+		std::string map_path() const;
+		std::string dump_path() const;
+
+	private:
+		PerfFormat format;
+		std::string directory;
+		std::FILE *map = nullptr;
+		std::FILE *dump = nullptr;
+		// where the dump is mapped, which tells perf where it is
+		void *marker = nullptr;
+		std::uint64_t loads = 0;
+	};
+}
@@ -0,0 +1,267 @@
+#include "profiler.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <utility>
+
+namespace Interp
+{
+	namespace
+	{
+		constexpr auto interval = std::chrono::milliseconds(1);
+
+		// deeper chains keep this many sites, the outermost and the innermost
+		// half, so a deep recursion does not make the output quadratic
+		constexpr size_t max_frames = 256;
+
+		std::int64_t nanoseconds(const timespec &time)
+		{
+			return static_cast<std::int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+		}
+
+		std::string_view base_name(std::string_view path)
+		{
+			auto slash = path.find_last_of('/');
+			return slash == std::string_view::npos ? path : path.substr(slash + 1);
+		}
+
+		double milliseconds(std::int64_t time)
+		{
+			return static_cast<double>(time) / 1e6;
+		}
+	}
+
+	Profiler::Profiler(const Program &program, ProfileMode mode)
+		: program(program),
+		  mode(mode)
+	{
+		nodes.push_back({ none, 0, nullptr });
+		current.store(&nodes.front());
+	}
+
+	Profiler::~Profiler()
+	{
+		if(sampler.joinable())
+		{
+			sampling.store(false, std::memory_order_release);
+			sampler.join();
+		}
+	}
+
+	void Profiler::start()
+	{
+		began = Clock::now();
+		if(mode != ProfileMode::Sample) return;
+
+		// the processor time of the thread that runs the program
+		if(pthread_getcpuclockid(pthread_self(), &clock) != 0)
+			clock = CLOCK_MONOTONIC;
+		sampling.store(true, std::memory_order_release);
+		sampler = std::thread(&Profiler::sample, this);
+	}
+
+	void Profiler::stop()
+	{
+		elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - began).count();
+		if(sampler.joinable())
+		{
+			sampling.store(false, std::memory_order_release);
+			sampler.join();
+		}
+	}
+
+	Profiler::Node *Profiler::add(Node *parent, std::uint32_t site)
+	{
+		nodes.push_back({ site, static_cast<std::uint32_t>(nodes.size()), parent });
+		auto node = &nodes.back();
+		parent->children.push_back(node);
+		return node;
+	}
+
+	void Profiler::sample()
+	{
+		timespec time;
+		clock_gettime(clock, &time);
+		auto last = nanoseconds(time);
+
+		while(sampling.load(std::memory_order_acquire))
+		{
+			std::this_thread::sleep_for(interval);
+			clock_gettime(clock, &time);
+			auto now = nanoseconds(time);
+
+			auto node = current.load(std::memory_order_acquire);
+			node->samples++;
+			node->sampled += now - last;
+			samples++;
+			last = now;
+		}
+	}
+
+	std::string Profiler::name(std::uint32_t site) const
+	{
+		if(site >= program.functions.size())
+		{
+			const auto &loop = program.loops[site - program.functions.size()];
+			auto file = base_name(program.files[program.functions[loop.function].file]);
+			return "while (" + std::string(file) + ":" + std::to_string(loop.location.line) + ")";
+		}
+
+		const auto &function = program.functions[site];
+		if(std::find(program.modules.begin(), program.modules.end(), site) != program.modules.end())
+			return function.name;
+		auto file = base_name(program.files[function.file]);
+		return function.name + " (" + std::string(file) + ":" + std::to_string(function.location.line) + ")";
+	}
+
+	void Profiler::times(std::vector<std::int64_t> &total, std::vector<std::int64_t> &self) const
+	{
+		total.assign(nodes.size(), 0);
+		self.assign(nodes.size(), 0);
+
+		// children come after their parents
+		for(size_t i = nodes.size(); i-- > 0;)
+		{
+			const auto &node = nodes[i];
+			if(mode == ProfileMode::Instrument)
+			{
+				total[i] = node.time;
+				self[i] += node.time;
+				if(node.parent)
+					self[node.parent->index] -= node.time;
+			}
+			else
+			{
+				self[i] = node.sampled;
+				total[i] += node.sampled;
+				if(node.parent)
+					total[node.parent->index] += total[i];
+			}
+		}
+	}
+
+	template<typename F>
+	void Profiler::walk(F &&function) const
+	{
+		std::vector<std::pair<const Node *, size_t>> stack = { { &nodes.front(), 0 } };
+		function(nodes.front(), true);
+		while(!stack.empty())
+		{
+			auto node = stack.back().first;
+			auto next = stack.back().second++;
+			if(next < node->children.size())
+			{
+				auto child = node->children[next];
+				function(*child, true);
+				stack.push_back({ child, 0 });
+				continue;
+			}
+			function(*node, false);
+			stack.pop_back();
+		}
+	}
+
+	std::vector<std::string> Profiler::report() const
+	{
+		std::vector<std::int64_t> total, self;
+		times(total, self);
+
+		auto sites = program.functions.size() + program.loops.size();
+		std::vector<Totals> totals(sites);
+		std::vector<unsigned> active(sites);
+		walk([&](const Node &node, bool enter)
+		{
+			if(node.site == none) return;
+			if(!enter)
+			{
+				active[node.site]--;
+				return;
+			}
+
+			auto &site = totals[node.site];
+			site.count += node.count;
+			site.iterations += node.iterations;
+			site.self += self[node.index];
+			if(active[node.site]++ == 0)
+				site.total += total[node.index];
+		});
+
+		std::vector<std::uint32_t> order;
+		for(std::uint32_t site = 0; site < sites; site++)
+		{
+			if(totals[site].count > 0)
+				order.push_back(site);
+		}
+		std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) { return totals[a].total > totals[b].total; });
+
+		std::vector<std::string> lines;
+		char buffer[128];
+		if(mode == ProfileMode::Sample)
+			std::snprintf(buffer, sizeof buffer, "Profile of %.3f ms, sampled %" PRIu64 " times", milliseconds(elapsed), samples);
+		else
+			std::snprintf(buffer, sizeof buffer, "Profile of %.3f ms, instrumented", milliseconds(elapsed));
+		lines.push_back(buffer);
+
+		lines.push_back("         calls      total ms       self ms  function");
+		for(auto site : order)
+		{
+			if(site >= program.functions.size()) continue;
+			const auto &entry = totals[site];
+			std::snprintf(buffer, sizeof buffer, "  %12" PRIu64 "  %12.3f  %12.3f  ", entry.count, milliseconds(entry.total), milliseconds(entry.self));
+			lines.push_back(buffer + name(site));
+		}
+
+		if(program.loops.empty()) return lines;
+		lines.push_back("       entries    iterations      total ms       self ms  loop");
+		for(auto site : order)
+		{
+			if(site < program.functions.size()) continue;
+			const auto &entry = totals[site];
+			std::snprintf(buffer, sizeof buffer, "  %12" PRIu64 "  %12" PRIu64 "  %12.3f  %12.3f  ", entry.count, entry.iterations, milliseconds(entry.total), milliseconds(entry.self));
+			lines.push_back(buffer + name(site));
+		}
+		return lines;
+	}
+
+	std::string Profiler::collapsed() const
+	{
+		std::vector<std::int64_t> total, self;
+		times(total, self);
+
+		std::vector<std::string> names;
+		for(std::uint32_t site = 0; site < program.functions.size() + program.loops.size(); site++)
+			names.push_back(name(site));
+
+		std::string result;
+		std::vector<std::uint32_t> path;
+		walk([&](const Node &node, bool enter)
+		{
+			if(node.site == none) return;
+			if(!enter)
+			{
+				path.pop_back();
+				return;
+			}
+
+			path.push_back(node.site);
+			auto microseconds = (self[node.index] + 500) / 1000;
+			if(microseconds <= 0) return;
+
+			for(size_t i = 0; i < path.size(); i++)
+			{
+				if(path.size() > max_frames && i == max_frames / 2)
+				{
+					result += "[...];";
+					i = path.size() - max_frames / 2;
+				}
+				result += names[path[i]];
+				result += i + 1 < path.size() ? ';' : ' ';
+			}
+			result += std::to_string(microseconds) + "\n";
+		});
+		return result;
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "program.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Interp
+{
+	enum class ProfileMode : std::uint8_t
+	{
+		// a thread looks at what runs about every millisecond and charges it
+		// the processor time the program used since; the times are estimates
+		Sample,
+		// the clock is read on every call and loop, so the times are exact,
+		// but calls take several times as long
+		Instrument
+	};
+
+	// Records where a program spends its time as it runs, for every chain of
+	// calls and loops that leads there. A site is a function of the program,
+	// its index, or a loop, the number of functions plus its index. Calls
+	// and iterations are counted exactly in both modes.
+	class Profiler
+	{
+	public:
+		Profiler(const Program &program, ProfileMode mode);
+		~Profiler();
+
+		Profiler(const Profiler &) = delete;
+		Profiler &operator=(const Profiler &) = delete;
+
+		// on the thread that runs the program, before and after it
+		void start();
+		void stop();
+
+		// a call of a function, or a loop starting
+		void enter(std::uint32_t site)
+		{
+			auto node = current.load(std::memory_order_relaxed);
+			Node *child = nullptr;
+			for(auto candidate : node->children)
+			{
+				if(candidate->site == site)
+				{
+					child = candidate;
+					break;
+				}
+			}
+			if(!child)
+				child = add(node, site);
+
+			child->count++;
+			if(mode == ProfileMode::Instrument)
+				child->start = Clock::now();
+			current.store(child, std::memory_order_release);
+		}
+
+		void leave()
+		{
+			auto node = current.load(std::memory_order_relaxed);
+			if(mode == ProfileMode::Instrument)
+				node->time += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - node->start).count();
+			current.store(node->parent, std::memory_order_release);
+		}
+
+		// of the loop entered last
+		void iterate()
+		{
+			current.load(std::memory_order_relaxed)->iterations++;
+		}
+
+		// a table of the functions and one of the loops, most time first
+		std::vector<std::string> report() const;
+		// the collapsed stacks flame graph tools read: a line for every chain
+		// of sites that used time, with the sites from the outermost in,
+		// separated by ';', and the microseconds it used
+		std::string collapsed() const;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		// a site as reached through one chain of sites
+		struct Node
+		{
+			std::uint32_t site;
+			// in nodes
+			std::uint32_t index;
+			Node *parent;
+			std::vector<Node *> children;
+			std::uint64_t count = 0;
+			std::uint64_t iterations = 0;
+			// nanoseconds spent in it and what it called, with instrumentation
+			std::int64_t time = 0;
+			Clock::time_point start;
+			// written only by the sampling thread: how often it was found
+			// running, and the processor time charged to it then
+			std::uint64_t samples = 0;
+			std::int64_t sampled = 0;
+		};
+
+		// of a site, over every chain
+		struct Totals
+		{
+			std::uint64_t count = 0;
+			std::uint64_t iterations = 0;
+			// without the time of a call inside another call of the same
+			// site
+			std::int64_t total = 0;
+			std::int64_t self = 0;
+		};
+
+		const Program &program;
+		ProfileMode mode;
+
+		// nodes are never moved, since the sampling thread reads them
+		std::deque<Node> nodes;
+		std::atomic<Node *> current;
+
+		std::thread sampler;
+		std::atomic<bool> sampling { false };
+		clockid_t clock = CLOCK_MONOTONIC;
+		std::uint64_t samples = 0;
+		Clock::time_point began;
+		std::int64_t elapsed = 0;
+
+		Node *add(Node *parent, std::uint32_t site);
+		void sample();
+
+		std::string name(std::uint32_t site) const;
+		// the time of every node and what it called, and of itself alone
+		void times(std::vector<std::int64_t> &total, std::vector<std::int64_t> &self) const;
+		// calls function with every node as it is entered and as it is left,
+		// depth first in the order the nodes were added
+		template<typename F>
+		void walk(F &&function) const;
+	};
+}
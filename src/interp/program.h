@@ -0,0 +1,261 @@
+#pragma once
+
+#include "util/util.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Interp
+{
+	// the types of the language; a Bool is held as the integer 0 or 1, and
+	// () as 0
+	enum class Type : std::uint8_t
+	{
+		Unit,
+		Int,
+		Float,
+		Bool,
+		String
+	};
+
+	enum class Code : std::uint8_t
+	{
+		// statements; a statement can also be any expression, whose value is
+		// dropped
+		Nop,
+		// the ops in lists[a, a + b), in order
+		Block,
+		// if ops[a] then ops[b], else ops[c] if c is not none; as a value,
+		// a branch that is a block gives the zero of the type
+		If,
+		// while ops[a] run ops[b]; loops[c] is its place in the source
+		While,
+		// ops[a], or () if a is none, from the function
+		Return,
+
+		// values
+		Zero,
+		// numbers[a]; an Int, a Float or a Bool, by type
+		Number,
+		// strings[a]
+		String,
+		Local,
+		Global,
+		// sets local or global a to ops[b], and is its value
+		SetLocal,
+		SetGlobal,
+		// adds the int32 b to local or global a; the value is the old one if
+		// c is set, the new one otherwise
+		StepLocal,
+		StepGlobal,
+
+		// ops[a] with ops[b]; integer arithmetic wraps around
+		AddInt,
+		SubInt,
+		MulInt,
+		DivInt,
+		ModInt,
+		AddFloat,
+		SubFloat,
+		MulFloat,
+		DivFloat,
+		// comparisons of Int, Bool or ()
+		EqInt,
+		NeInt,
+		LtInt,
+		LeInt,
+		GtInt,
+		GeInt,
+		EqFloat,
+		NeFloat,
+		LtFloat,
+		LeFloat,
+		GtFloat,
+		GeFloat,
+		EqString,
+		NeString,
+		// ops[b] is only evaluated if ops[a] does not decide the value
+		And,
+		Or,
+		Concat,
+		// a string and the text of a number
+		AppendInt,
+		AppendFloat,
+
+		// of ops[a]
+		NegInt,
+		NegFloat,
+		Not,
+		// the text of ops[a], of the type
+		ToString,
+
+		// functions[a] with the arguments lists[b, b + c)
+		Call,
+		// the built-in print with ops[a]
+		Print
+	};
+
+	constexpr std::uint32_t none = UINT32_MAX;
+
+	struct Op
+	{
+		Code code;
+		// of the value
+		Type type;
+		std::uint32_t a = none, b = none, c = none;
+	};
+
+	struct Function
+	{
+		// of the definition, or of the file for the top level of a module
+		std::string name;
+		// index into files
+		std::uint32_t file;
+		Util::FileLocation location;
+		// the body, a block
+		std::uint32_t body;
+		// the parameters are the first slots
+		std::uint32_t parameters;
+		std::uint32_t slots;
+		Type returns;
+	};
+
+	// a while loop, for the profile
+	struct Loop
+	{
+		std::uint32_t function;
+		Util::FileLocation location;
+	};
+
+	// Records of a program that are read as they are: either its own, as
+	// the lowerer adds them, or a view of the same records in memory that
+	// the program keeps alive, such as a mapped bytecode file.
+	template<typename T>
+	class Records
+	{
+	public:
+		Records() = default;
+
+		Records(const T *first, size_t count)
+			: first(first), count(count)
+		{}
+
+		Records(const Records &other)
+		{
+			if(other.owned.empty())
+			{
+				first = other.first;
+				count = other.count;
+			}
+			else
+			{
+				owned = other.owned;
+				first = owned.data();
+				count = owned.size();
+			}
+		}
+
+		// the vector's buffer moves with it, so a view of it stays valid
+		Records(Records &&other) noexcept
+		{
+			swap(other);
+		}
+
+		Records &operator=(Records other) noexcept
+		{
+			swap(other);
+			return *this;
+		}
+
+		void swap(Records &other) noexcept
+		{
+			owned.swap(other.owned);
+			std::swap(first, other.first);
+			std::swap(count, other.count);
+		}
+
+		// only to records of the program's own
+		void push_back(const T &value)
+		{
+			owned.push_back(value);
+			first = owned.data();
+			count = owned.size();
+		}
+
+		const T &operator[](size_t index) const
+		{
+			return first[index];
+		}
+
+		const T *data() const
+		{
+			return first;
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		bool empty() const
+		{
+			return count == 0;
+		}
+
+		const T *begin() const
+		{
+			return first;
+		}
+
+		const T *end() const
+		{
+			return first + count;
+		}
+
+		bool operator==(const Records &other) const
+		{
+			if(count != other.count)
+				return false;
+			for(size_t i = 0; i < count; i++)
+				if(!(first[i] == other.first[i]))
+					return false;
+			return true;
+		}
+
+	private:
+		std::vector<T> owned;
+		const T *first = nullptr;
+		size_t count = 0;
+	};
+
+	// A checked build lowered for the interpreter: the tree of every
+	// function as ops that refer to each other by index, with every name
+	// resolved to a slot of its function, a global or a function, and every
+	// operator to the one for the types of its operands.
+	struct Program
+	{
+		Records<Op> ops;
+		// where each op is in the source of its function's file
+		Records<Util::FileLocation> lines;
+		// operands of blocks and calls
+		std::vector<std::uint32_t> lists;
+		// bits of the Int, Float and Bool literals
+		Records<std::uint64_t> numbers;
+		std::vector<std::string> strings;
+
+		std::vector<std::string> files;
+		std::vector<Function> functions;
+		std::vector<Loop> loops;
+		// the top level of every module, in the order they run
+		std::vector<std::uint32_t> modules;
+		// variables at the top level of the modules
+		std::uint32_t globals = 0;
+
+		// what the records that are views refer to, for as long as the
+		// program or a copy of it lives
+		std::shared_ptr<const void> storage;
+	};
+}
@@ -0,0 +1,345 @@
+#include "tier.h"
+
+#include "log.h"
+#include "codegen/cemitter.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+extern char **environ;
+
+namespace Interp
+{
+	namespace
+	{
+		// position-independent, with integers that wrap, and with unwind
+		// tables so that a failure can be thrown through the native code;
+		// the emitter leaves stubs and variables that are not always used,
+		// and what would mean it emitted something wrong is an error
+		const std::vector<std::string> flags =
+		{
+			"-shared", "-fPIC", "-fwrapv", "-fexceptions", "-fno-semantic-interposition",
+			"-Wall", "-Wno-unused-function", "-Wno-unused-but-set-variable", "-Wno-unused-variable",
+			"-Werror=implicit-function-declaration", "-Werror=incompatible-pointer-types", "-Werror=int-conversion", "-Werror=return-type"
+		};
+
+		std::string temporary_directory()
+		{
+			auto base = std::getenv("TMPDIR");
+			std::string pattern = std::string(base && *base ? base : "/tmp") + "/cygnus-XXXXXX";
+			if(!mkdtemp(pattern.data())) return {};
+			return pattern;
+		}
+
+		std::string read_file(const std::string &path)
+		{
+			std::ifstream stream(path, std::ios::binary);
+			std::ostringstream text;
+			text << stream.rdbuf();
+			return text.str();
+		}
+
+		// moves the code of a loaded library onto anonymous memory at the
+		// same address, before any of it runs; perf names code in a file
+		// from the file, which is gone by the time perf reads it, and looks
+		// up only anonymous code in the perf map
+		bool anonymize(void *library)
+		{
+			link_map *map = nullptr;
+			if(dlinfo(library, RTLD_DI_LINKMAP, &map) != 0 || !map) return false;
+
+			struct Search
+			{
+				const link_map *map;
+				const ElfW(Phdr) *headers = nullptr;
+				size_t count = 0;
+			} search { map };
+			dl_iterate_phdr([](dl_phdr_info *info, size_t, void *data)
+			{
+				auto &search = *static_cast<Search *>(data);
+				if(info->dlpi_addr != search.map->l_addr || std::strcmp(info->dlpi_name, search.map->l_name) != 0) return 0;
+				search.headers = info->dlpi_phdr;
+				search.count = info->dlpi_phnum;
+				return 1;
+			}, &search);
+			if(!search.headers) return false;
+
+			auto page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+			auto pages = [&](const ElfW(Phdr) &header)
+			{
+				auto begin = map->l_addr + header.p_vaddr;
+				return std::make_pair(begin & ~(page - 1), (begin + header.p_memsz + page - 1) & ~(page - 1));
+			};
+			for(size_t i = 0; i < search.count; i++)
+			{
+				const auto &code = search.headers[i];
+				if(code.p_type != PT_LOAD || !(code.p_flags & PF_X)) continue;
+				auto [begin, end] = pages(code);
+
+				// data on the same pages would lose its protection
+				for(size_t j = 0; j < search.count; j++)
+				{
+					if(j == i || search.headers[j].p_type != PT_LOAD) continue;
+					auto [other_begin, other_end] = pages(search.headers[j]);
+					if(other_begin < end && begin < other_end) return false;
+				}
+
+				// writable until it replaces the file's pages, which keeps
+				// the code runnable whatever fails
+				auto size = end - begin;
+				auto copy = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if(copy == MAP_FAILED) return false;
+				std::memcpy(copy, reinterpret_cast<void *>(begin), size);
+				if(mremap(copy, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, reinterpret_cast<void *>(begin)) == MAP_FAILED)
+				{
+					munmap(copy, size);
+					return false;
+				}
+				// which perf records as a mapping of the code
+				mprotect(reinterpret_cast<void *>(begin), size, PROT_READ | PROT_EXEC);
+			}
+			return true;
+		}
+
+		// the code of a symbol of the library, if it has any
+		void add_symbol(std::vector<PerfMap::Code> &code, void *library, const std::string &symbol, std::string name, const std::string &file, unsigned line)
+		{
+			auto address = dlsym(library, symbol.c_str());
+			Dl_info info;
+			void *entry = nullptr;
+			if(!address || !dladdr1(address, &info, &entry, RTLD_DL_SYMENT) || !entry) return;
+			auto size = static_cast<const ElfW(Sym) *>(entry)->st_size;
+			if(size > 0)
+				code.push_back({ address, size, std::move(name), file, line });
+		}
+	}
+
+	Tier::Tier(const Program &program, JitMode mode, PerfMap *perf)
+		: program(program),
+		  mode(mode),
+		  perf(perf),
+		  typed(new std::atomic<void *>[program.functions.size()]()),
+		  entries(new std::atomic<Entry>[program.functions.size()]()),
+		  loops(new std::atomic<LoopEntry>[program.loops.size()]()),
+		  calls(program.functions.size()),
+		  iterations(program.loops.size()),
+		  queued(program.functions.size())
+	{}
+
+	Tier::~Tier()
+	{
+		stop();
+		for(auto library : libraries)
+			dlclose(library);
+		for(const auto &library : kept)
+			std::remove(library.c_str());
+		if(!directory.empty())
+			rmdir(directory.c_str());
+	}
+
+	bool Tier::start()
+	{
+		directory = temporary_directory();
+		if(directory.empty())
+		{
+			Logger::get().warn("unable to create a directory for native code; the program is interpreted");
+			return mode != JitMode::Eager;
+		}
+
+		if(mode == JitMode::Eager)
+		{
+			std::vector<std::uint32_t> functions(program.functions.size());
+			std::iota(functions.begin(), functions.end(), 0);
+			queued.assign(queued.size(), true);
+			return functions.empty() || compile(functions);
+		}
+		compiler = std::thread(&Tier::work, this);
+		return true;
+	}
+
+	void Tier::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			if(child > 0)
+				kill(child, SIGKILL);
+		}
+		wake.notify_all();
+		if(compiler.joinable())
+			compiler.join();
+	}
+
+	void Tier::promote(std::uint32_t function)
+	{
+		if(queued[function]) return;
+		queued[function] = true;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(function);
+		}
+		wake.notify_one();
+	}
+
+	// on the compiling thread; what was queued while a batch compiled is the
+	// next batch
+	void Tier::work()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(true)
+		{
+			wake.wait(lock, [&] { return stopping || !queue.empty(); });
+			if(stopping) return;
+			auto batch = std::move(queue);
+			queue.clear();
+			lock.unlock();
+			compile(batch);
+			lock.lock();
+		}
+	}
+
+	bool Tier::compile(const std::vector<std::uint32_t> &functions)
+	{
+		auto started = std::chrono::steady_clock::now();
+		auto name = directory + "/" + std::to_string(statistics.batches++);
+		auto source = name + ".c", library = name + ".so", output = name + ".log";
+		{
+			std::ofstream stream(source, std::ios::binary);
+			stream << emit_native(program, functions);
+		}
+
+		auto arguments = CodeGen::compiler_command(source, library, flags);
+		std::vector<char *> argv;
+		for(auto &argument : arguments)
+			argv.push_back(argument.data());
+		argv.push_back(nullptr);
+
+		// what the compiler prints is shown if it fails, and with --debug
+		// otherwise
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init(&actions);
+		posix_spawn_file_actions_addopen(&actions, 1, output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		posix_spawn_file_actions_adddup2(&actions, 1, 2);
+
+		bool built = false;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			pid_t pid;
+			if(!stopping && argv.size() > 1 && posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0)
+			{
+				child = pid;
+				lock.unlock();
+
+				// waited for without being reaped, so that stop cannot kill
+				// another process that got its pid
+				siginfo_t info {};
+				while(waitid(P_PID, pid, &info, WEXITED | WNOWAIT) < 0 && errno == EINTR)
+				{}
+
+				lock.lock();
+				child = -1;
+				lock.unlock();
+				int status = 0;
+				while(waitpid(pid, &status, 0) < 0 && errno == EINTR)
+				{}
+				built = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+			}
+		}
+		posix_spawn_file_actions_destroy(&actions);
+		statistics.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+
+		void *handle = built ? dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL) : nullptr;
+		if(!handle && !statistics.failed)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(!stopping)
+			{
+				Logger::get().warn("unable to compile functions to native code with '", CodeGen::c_compiler(), "'; they are interpreted");
+				Logger::get().debug(built ? dlerror() : read_file(output));
+			}
+		}
+		else if(handle)
+		{
+			auto warnings = read_file(output);
+			if(!warnings.empty())
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				Logger::get().debug(warnings);
+			}
+		}
+		std::remove(source.c_str());
+		std::remove(output.c_str());
+		// otherwise perf reads the library, which is kept until the tier is
+		// destroyed
+		if(handle && perf && !anonymize(handle))
+			kept.push_back(library);
+		else
+			std::remove(library.c_str());
+		if(!handle)
+		{
+			statistics.failed += functions.size();
+			return false;
+		}
+		libraries.push_back(handle);
+		if(perf)
+			perf->write(describe(handle, functions));
+
+		// the typed code first, which the entries call
+		for(auto function : functions)
+			typed[function].store(dlsym(handle, typed_name(function).c_str()), std::memory_order_release);
+		for(auto function : functions)
+			entries[function].store(reinterpret_cast<Entry>(dlsym(handle, entry_name(function).c_str())), std::memory_order_release);
+		std::vector<bool> batch(program.functions.size());
+		for(auto function : functions)
+			batch[function] = true;
+		for(std::uint32_t loop = 0; loop < program.loops.size(); loop++)
+		{
+			if(batch[program.loops[loop].function])
+				loops[loop].store(reinterpret_cast<LoopEntry>(dlsym(handle, loop_name(loop).c_str())), std::memory_order_release);
+		}
+		statistics.compiled += functions.size();
+		return true;
+	}
+
+	// named after the function or loop each symbol is the code of, with
+	// where it is defined
+	std::vector<PerfMap::Code> Tier::describe(void *library, const std::vector<std::uint32_t> &functions) const
+	{
+		std::vector<PerfMap::Code> code;
+		std::vector<bool> batch(program.functions.size());
+		for(auto index : functions)
+		{
+			batch[index] = true;
+			const auto &function = program.functions[index];
+			const auto &file = program.files[function.file];
+			auto where = " (" + file + ":" + std::to_string(function.location.line) + ":" + std::to_string(function.location.column) + ")";
+			add_symbol(code, library, typed_name(index), function.name + where, file, function.location.line);
+			add_symbol(code, library, entry_name(index), function.name + " [entry]" + where, file, function.location.line);
+		}
+		for(std::uint32_t index = 0; index < program.loops.size(); index++)
+		{
+			const auto &loop = program.loops[index];
+			if(!batch[loop.function]) continue;
+			const auto &function = program.functions[loop.function];
+			const auto &file = program.files[function.file];
+			auto where = " (" + file + ":" + std::to_string(loop.location.line) + ":" + std::to_string(loop.location.column) + ")";
+			add_symbol(code, library, loop_name(index), "while" + where + " in " + function.name, file, loop.location.line);
+		}
+		return code;
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "native.h"
+#include "perfmap.h"
+#include "program.h"
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Interp
+{
+	enum class JitMode : std::uint8_t
+	{
+		// functions are compiled on a thread once they are called often, or
+		// one of their loops runs long, while the interpreter goes on
+		Tiered,
+		// every function is compiled before the program starts
+		Eager
+	};
+
+	// Compiles functions of a program to native code with the C compiler and
+	// loads it into the process, for the interpreter to call instead of
+	// interpreting them. A function that is compiled while one of its loops
+	// is being interpreted continues in native code from the next time the
+	// loop's condition is evaluated.
+	//
+	// Without a C compiler, or where one fails, functions stay interpreted.
+	class Tier
+	{
+	public:
+		// calls of a function, and iterations of one of its loops, after
+		// which it is compiled
+		static constexpr std::uint32_t hot_calls = 1000;
+		static constexpr std::uint32_t hot_iterations = 10000;
+
+		struct Stats
+		{
+			// in the C compiler, on the compiling thread
+			std::int64_t nanoseconds = 0;
+			size_t batches = 0;
+			size_t compiled = 0;
+			size_t failed = 0;
+		};
+
+		// with a perf map, what is loaded is written to it
+		Tier(const Program &program, JitMode mode, PerfMap *perf = nullptr);
+		~Tier();
+
+		Tier(const Tier &) = delete;
+		Tier &operator=(const Tier &) = delete;
+
+		// before the program runs; eagerly, compiles every function and
+		// returns false if the C compiler failed
+		bool start();
+		// waits for a compilation that is running to be abandoned; what was
+		// loaded stays loaded until the tier is destroyed
+		void stop();
+
+		// the typed native functions, by function, for the runtime
+		void **code()
+		{
+			return reinterpret_cast<void **>(typed.get());
+		}
+
+		Entry entry(std::uint32_t function) const
+		{
+			return entries[function].load(std::memory_order_acquire);
+		}
+
+		LoopEntry loop(std::uint32_t loop) const
+		{
+			return loops[loop].load(std::memory_order_acquire);
+		}
+
+		// on the interpreter's thread
+		void called(std::uint32_t function)
+		{
+			if(++calls[function] == hot_calls)
+				promote(function);
+		}
+
+		void iterated(std::uint32_t loop)
+		{
+			if(++iterations[loop] == hot_iterations)
+				promote(program.loops[loop].function);
+		}
+
+		// once stopped
+		const Stats &stats() const
+		{
+			return statistics;
+		}
+
+	private:
+		const Program &program;
+		JitMode mode;
+		PerfMap *perf;
+
+		std::unique_ptr<std::atomic<void *>[]> typed;
+		std::unique_ptr<std::atomic<Entry>[]> entries;
+		std::unique_ptr<std::atomic<LoopEntry>[]> loops;
+		static_assert(sizeof(std::atomic<void *>) == sizeof(void *) && std::atomic<void *>::is_always_lock_free);
+
+		std::vector<std::uint32_t> calls, iterations;
+		// by function
+		std::vector<bool> queued;
+
+		std::thread compiler;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::vector<std::uint32_t> queue;
+		bool stopping = false;
+		// of the C compiler while it runs
+		pid_t child = -1;
+
+		// where the sources and libraries are written, until they are loaded
+		std::string directory;
+		std::vector<void *> libraries;
+		// libraries that perf cannot be shown the code of otherwise
+		std::vector<std::string> kept;
+		Stats statistics;
+
+		void promote(std::uint32_t function);
+		void work();
+		bool compile(const std::vector<std::uint32_t> &functions);
+		std::vector<PerfMap::Code> describe(void *library, const std::vector<std::uint32_t> &functions) const;
+	};
+}
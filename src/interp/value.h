@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Interp
+{
+	// a value of any type; which member is set is known from the op that
+	// gave it
+	struct Value
+	{
+		union
+		{
+			std::int64_t integer = 0;
+			double real;
+			// of a string, which is never changed
+			const char *data;
+		};
+		// of a string
+		std::int64_t length = 0;
+	};
+}
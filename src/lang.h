@@ -6,7 +6,7 @@
 
 namespace Lang
 {
-	constexpr std::string_view keywords[] = {"true", "false", "var", "func", "return", "if", "else", "while"};
+	constexpr std::string_view keywords[] = {"true", "false", "var", "func", "return", "if", "else", "while", "import"};
 	// descending length
 	constexpr std::string_view operators[] = {"++", "--", "==", "!=", ">=", "<=", "&&", "||", "!", ">", "<", "+", "-", "*", "/", "%", "="};
 	constexpr std::string_view word_operators[] = {"not", "and", "or"};
@@ -51,6 +51,12 @@ namespace Lang
 		return false;
 	}
 
+	// keywords that begin a statement; used to resynchronize after syntax errors
+	constexpr bool is_statement_keyword(std::string_view str)
+	{
+		return str == "var" || str == "func" || str == "if" || str == "while" || str == "return" || str == "import";
+	}
+
 	constexpr bool is_boolean(std::string_view str)
 	{
 		return str == "true" || str == "false";
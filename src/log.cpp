@@ -1,10 +1,393 @@
 #include "log.h"
 
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+	// records handed to the writer thread together
+	struct Batch
+	{
+		std::string unit;
+		std::vector<LogRecord> records;
+	};
+
+	// a thread hands its buffer over once it holds this many records
+	constexpr size_t batch_size = 512;
+	// sinks write to their file once this much text is pending
+	constexpr size_t sink_buffer_size = 1 << 16;
+
+	// removes ANSI escape sequences
+	std::string strip(std::string_view text)
+	{
+		std::string result;
+		result.reserve(text.size());
+		for(size_t i = 0; i < text.size(); i++)
+		{
+			if(text[i] == '\033' && i + 1 < text.size() && text[i + 1] == '[')
+			{
+				i += 2;
+				while(i < text.size() && !(text[i] >= '@' && text[i] <= '~')) i++;
+				continue;
+			}
+			result += text[i];
+		}
+		return result;
+	}
+
+	void escape(std::string &out, std::string_view text)
+	{
+		static constexpr char hex[] = "0123456789abcdef";
+		for(auto c : text)
+		{
+			switch(c)
+			{
+				case '"': out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\t': out += "\\t"; break;
+				case '\r': out += "\\r"; break;
+				default:
+					if(static_cast<unsigned char>(c) < 0x20)
+					{
+						out += "\\u00";
+						out += hex[(c >> 4) & 0xf];
+						out += hex[c & 0xf];
+					}
+					else out += c;
+					break;
+			}
+		}
+	}
+
+	const char *level_name(LogLevel level)
+	{
+		switch(level)
+		{
+			case LogLevel::Debug:
+				return "debug";
+			case LogLevel::Info:
+				return "info";
+			case LogLevel::Warning:
+				return "warning";
+			case LogLevel::Error:
+				return "error";
+			default:
+				return "";
+		}
+	}
+
+	// formats records into a buffer and writes it to a file in large chunks
+	class FileSink : public LogSink
+	{
+	public:
+		FileSink(std::FILE *file, bool owned)
+			: file(file), owned(owned)
+		{}
+		~FileSink() override
+		{
+			flush();
+			if(owned) std::fclose(file);
+		}
+
+		void write(std::string_view unit, const LogRecord &record) override
+		{
+			format(unit, record);
+			if(buffer.size() >= sink_buffer_size)
+			{
+				std::fwrite(buffer.data(), 1, buffer.size(), file);
+				buffer.clear();
+			}
+		}
+
+		void flush() override
+		{
+			std::fwrite(buffer.data(), 1, buffer.size(), file);
+			buffer.clear();
+			std::fflush(file);
+		}
+
+	protected:
+		std::string buffer;
+
+		virtual void format(std::string_view unit, const LogRecord &record) = 0;
+
+	private:
+		std::FILE *file;
+		bool owned;
+	};
+
+	class TerminalSink : public FileSink
+	{
+	public:
+		using FileSink::FileSink;
+
+	protected:
+		void format(std::string_view, const LogRecord &record) override
+		{
+			buffer += prefix(record.level);
+			buffer += record.text;
+			buffer += "\033[0m\n";
+			buffer += record.detail;
+		}
+
+	private:
+		static const char *prefix(LogLevel level)
+		{
+			switch(level)
+			{
+				case LogLevel::Debug:
+					return "";
+				case LogLevel::Info:
+					return "";
+				case LogLevel::Warning:
+					return "\033[33;1mWarning: \033[0m";
+				case LogLevel::Error:
+					return "\033[31;1mError: \033[0m";
+				default:
+					return "";
+			}
+		}
+	};
+
+	class PlainSink : public FileSink
+	{
+	public:
+		using FileSink::FileSink;
+
+	protected:
+		void format(std::string_view, const LogRecord &record) override
+		{
+			if(record.level == LogLevel::Warning) buffer += "Warning: ";
+			else if(record.level == LogLevel::Error) buffer += "Error: ";
+			buffer += strip(record.text);
+			buffer += '\n';
+			buffer += strip(record.detail);
+		}
+	};
+
+	class JsonSink : public FileSink
+	{
+	public:
+		using FileSink::FileSink;
+
+	protected:
+		void format(std::string_view unit, const LogRecord &record) override
+		{
+			buffer += "{\"level\":\"";
+			buffer += level_name(record.level);
+			buffer += '"';
+			if(!unit.empty())
+			{
+				buffer += ",\"unit\":\"";
+				escape(buffer, unit);
+				buffer += '"';
+			}
+			buffer += ",\"message\":\"";
+			escape(buffer, strip(record.text));
+			buffer += '"';
+			if(!record.detail.empty())
+			{
+				buffer += ",\"detail\":\"";
+				escape(buffer, strip(record.detail));
+				buffer += '"';
+			}
+			buffer += "}\n";
+		}
+	};
+}
+
+// the calling thread's pending records
+struct LogBuffer
+{
+	Logger *owner = nullptr;
+	std::string unit;
+	std::vector<LogRecord> records;
+	std::ostringstream stream;
+
+	~LogBuffer()
+	{
+		submit();
+		owner = nullptr;
+	}
+
+	void submit();
+};
+
+static thread_local LogBuffer buffer;
+
+struct Logger::Writer
+{
+	std::mutex mutex;
+	std::condition_variable wake, drained;
+	std::deque<Batch> queue;
+	// batches handed over and batches written, for flush()
+	size_t submitted = 0, written = 0;
+	bool stopping = false;
+	std::thread thread;
+
+	// held while the sink is written to or replaced
+	std::mutex sink_mutex;
+	std::unique_ptr<LogSink> sink = std::make_unique<TerminalSink>(stdout, false);
+
+	void submit(Batch batch)
+	{
+		std::lock_guard lock(mutex);
+		queue.push_back(std::move(batch));
+		submitted++;
+		// started on first use, so a logger that only filters never spawns it
+		if(!thread.joinable())
+			thread = std::thread(&Writer::run, this);
+		wake.notify_one();
+	}
+
+	void run()
+	{
+		std::unique_lock lock(mutex);
+		while(true)
+		{
+			wake.wait(lock, [&] { return stopping || !queue.empty(); });
+			if(queue.empty()) return;
+
+			auto batches = std::move(queue);
+			queue.clear();
+			lock.unlock();
+			{
+				std::lock_guard sink_lock(sink_mutex);
+				for(const auto &batch : batches)
+				{
+					for(const auto &record : batch.records)
+					{
+						sink->write(batch.unit, record);
+					}
+				}
+			}
+			lock.lock();
+			written += batches.size();
+			drained.notify_all();
+		}
+	}
+
+	// waits for every batch submitted before the call
+	void drain()
+	{
+		std::unique_lock lock(mutex);
+		auto target = submitted;
+		drained.wait(lock, [&] { return written >= target; });
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+			wake.notify_one();
+		}
+		if(thread.joinable()) thread.join();
+	}
+};
+
+void LogBuffer::submit()
+{
+	if(records.empty()) return;
+	owner->writer->submit({ unit, std::move(records) });
+	records.clear();
+}
+
 Logger::Logger(LogLevel level)
-	: level(level)
+	: level(level), writer(std::make_unique<Writer>())
 {}
 
+// runs after the exiting thread's buffer was handed over; records still
+// buffered by other running threads are lost
+Logger::~Logger()
+{
+	writer->stop();
+	std::lock_guard lock(writer->sink_mutex);
+	writer->sink->flush();
+}
+
 void Logger::set_level(LogLevel level)
 {
-	this->level = level;
+	this->level.store(level, std::memory_order_relaxed);
+}
+
+bool Logger::enabled(LogLevel level) const
+{
+	return this->level.load(std::memory_order_relaxed) <= level;
+}
+
+void Logger::set_sink(std::unique_ptr<LogSink> sink)
+{
+	flush();
+	std::lock_guard lock(writer->sink_mutex);
+	writer->sink = std::move(sink);
+}
+
+bool Logger::set_output(LogFormat format, std::string_view path, std::FILE *console)
+{
+	std::FILE *file = console;
+	if(!path.empty())
+	{
+		file = std::fopen(std::string(path).c_str(), "w");
+		if(!file) return false;
+	}
+
+	bool owned = file != console;
+	switch(format)
+	{
+		case LogFormat::Terminal:
+			set_sink(std::make_unique<TerminalSink>(file, owned));
+			break;
+		case LogFormat::Plain:
+			set_sink(std::make_unique<PlainSink>(file, owned));
+			break;
+		case LogFormat::Json:
+			set_sink(std::make_unique<JsonSink>(file, owned));
+			break;
+	}
+	return true;
+}
+
+void Logger::flush()
+{
+	if(buffer.owner == this) buffer.submit();
+	writer->drain();
+	std::lock_guard lock(writer->sink_mutex);
+	writer->sink->flush();
+}
+
+Logger::Unit::Unit(std::string_view name)
+	: previous(buffer.unit)
+{
+	if(buffer.owner) buffer.submit();
+	buffer.unit = name;
+}
+
+Logger::Unit::~Unit()
+{
+	if(buffer.owner) buffer.submit();
+	buffer.unit = std::move(previous);
+}
+
+std::ostream &Logger::begin_record()
+{
+	if(buffer.owner != this)
+	{
+		if(buffer.owner) buffer.submit();
+		buffer.owner = this;
+	}
+	buffer.stream.str("");
+	buffer.stream.clear();
+	return buffer.stream;
+}
+
+void Logger::end_record(LogLevel level, std::string detail)
+{
+	buffer.records.push_back({ level, buffer.stream.str(), std::move(detail) });
+	if(buffer.records.size() >= batch_size) buffer.submit();
 }
@@ -1,16 +1,67 @@
 #pragma once
 
-#include <iostream>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// set to 0 to compile debug tracing out of the build
+#ifndef CYGNUS_TRACE
+#define CYGNUS_TRACE 1
+#endif
+
+// runs a tracing statement only when debug output is on, so its arguments
+// are never built otherwise; with CYGNUS_TRACE=0 the statement is dead code
+#define TRACE(...) do { if(Logger::get().tracing()) { __VA_ARGS__; } } while(false)
 
 enum class LogLevel
 {
 	Debug, Info, Warning, Error
 };
 
+enum class LogFormat
+{
+	// ANSI colored, the default on stdout
+	Terminal,
+	// no escape codes
+	Plain,
+	// one JSON object per record
+	Json
+};
+
+struct LogRecord
+{
+	LogLevel level;
+	std::string text;
+	// printed verbatim below the text, e.g. a source excerpt
+	std::string detail;
+};
+
+// receives records from the writer thread, in order
+class LogSink
+{
+public:
+	virtual ~LogSink() = default;
+
+	// unit is the compilation unit the record was logged for, or empty
+	virtual void write(std::string_view unit, const LogRecord &record) = 0;
+	virtual void flush() = 0;
+};
+
+// Messages are collected in a buffer per thread and handed to a background
+// writer thread in batches: when a thread's buffer fills up, when its
+// compilation unit ends, or on flush(). Batches are written in the order
+// they were handed over, so the output of one unit stays in order and is
+// not interleaved line by line with other threads. The sink is flushed
+// only by flush() and when the logger is destroyed at exit.
 class Logger
 {
 public:
 	explicit Logger(LogLevel level);
+	~Logger();
 	static Logger &get()
 	{
 		static Logger logger(LogLevel::Info);
@@ -18,56 +69,94 @@ public:
 	}
 
 	void set_level(LogLevel level);
+	bool enabled(LogLevel level) const;
+	bool tracing() const
+	{
+		return CYGNUS_TRACE && level.load(std::memory_order_relaxed) <= LogLevel::Debug;
+	}
+
+	// replaces the sink after writing everything logged so far to the old one
+	void set_sink(std::unique_ptr<LogSink> sink);
+	// writes to the file at path, or to console if path is empty;
+	// returns false if the file can't be opened
+	bool set_output(LogFormat format, std::string_view path = "", std::FILE *console = stdout);
+
+	// waits until everything logged so far, by any thread, is written out
+	void flush();
+
+	// tags the calling thread's messages with a compilation unit while alive
+	class Unit
+	{
+	public:
+		explicit Unit(std::string_view name);
+		~Unit();
+
+		Unit(const Unit &) = delete;
+		Unit &operator=(const Unit &) = delete;
+
+	private:
+		std::string previous;
+	};
 
 	template<typename... Args>
-	inline void debug(Args &&... args) const
+	inline void debug(Args &&... args)
 	{
 		log(LogLevel::Debug, std::forward<Args>(args)...);
 	}
 	template<typename... Args>
-	inline void info(Args &&... args) const
+	inline void info(Args &&... args)
 	{
 		log(LogLevel::Info, std::forward<Args>(args)...);
 	}
 	template<typename... Args>
-	inline void warn(Args &&... args) const
+	inline void warn(Args &&... args)
 	{
 		log(LogLevel::Warning, std::forward<Args>(args)...);
 	}
 	template<typename... Args>
-	inline void error(Args &&... args) const
+	inline void error(Args &&... args)
 	{
 		log(LogLevel::Error, std::forward<Args>(args)...);
 	}
+	// an error followed by verbatim detail text
+	template<typename... Args>
+	inline void error_with(std::string detail, Args &&... args)
+	{
+		log_detail(LogLevel::Error, std::move(detail), std::forward<Args>(args)...);
+	}
 
 private:
-	LogLevel level;
+	struct Writer;
+
+	// read by every compiling thread, set by the command line or the server
+	std::atomic<LogLevel> level;
+	std::unique_ptr<Writer> writer;
 
-	constexpr const char *prefix(LogLevel level) const
+	// the calling thread's cleared formatting stream
+	std::ostream &begin_record();
+	void end_record(LogLevel level, std::string detail = "");
+
+	template<typename... Args>
+	void log(LogLevel level, Args &&... args)
 	{
-		switch(level)
+		if(enabled(level))
 		{
-			case LogLevel::Debug:
-				return "";
-			case LogLevel::Info:
-				return "";
-			case LogLevel::Warning:
-				return "\033[33;1mWarning: \033[0m";
-			case LogLevel::Error:
-				return "\033[31;1mError: \033[0m";
-			default:
-				return "";
+			auto &stream = begin_record();
+			((stream << args), ...);
+			end_record(level);
 		}
 	}
 
 	template<typename... Args>
-	void log(LogLevel level, Args &&... args) const
+	void log_detail(LogLevel level, std::string detail, Args &&... args)
 	{
-		if(this->level <= level)
+		if(enabled(level))
 		{
-			std::cout << prefix(level);
-			// ((std::cout << args << " "), ...) << std::endl;
-			(std::cout << ... << args) << "\033[0m" << std::endl;
+			auto &stream = begin_record();
+			((stream << args), ...);
+			end_record(level, std::move(detail));
 		}
 	}
+
+	friend struct LogBuffer;
 };
@@ -7,7 +7,5 @@
 int main(int argc, char *argv[])
 {
 	std::vector<std::string_view> args(argv + 1, argv + argc);
-	CLI::execute(args);
-
-	return 0;
+	return CLI::execute(args);
 }
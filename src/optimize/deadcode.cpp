@@ -0,0 +1,263 @@
+#include "deadcode.h"
+
+#include "tree.h"
+
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Optimize
+{
+	namespace
+	{
+		bool is_definition(const Statement &stmt)
+		{
+			return stmt.kind == NodeKind::FunctionDef || stmt.kind == NodeKind::VariableDef;
+		}
+
+		Identifier &defined_name(Statement &stmt)
+		{
+			if(stmt.kind == NodeKind::FunctionDef)
+				return *static_cast<FunctionDef &>(stmt).name;
+			return *static_cast<VariableDef &>(stmt).name;
+		}
+
+		class Eliminator
+		{
+		public:
+			explicit Eliminator(const std::vector<Build::Unit> &units)
+				: units(units),
+				  exports(units.size())
+			{}
+
+			DeadCodeStats run()
+			{
+				for(size_t unit = 0; unit < units.size(); unit++)
+				{
+					if(auto program = units[unit].context.syntax_tree())
+						collect(*program, unit);
+				}
+
+				// the top level of every module runs
+				for(size_t unit = 0; unit < units.size(); unit++)
+				{
+					auto program = units[unit].context.syntax_tree();
+					if(!program) continue;
+					for(const auto &stmt : program->statements)
+					{
+						if(stmt->kind != NodeKind::FunctionDef)
+							pending.push_back({ stmt.get(), unit });
+					}
+				}
+				scan();
+
+				for(size_t unit = 0; unit < units.size(); unit++)
+				{
+					if(auto program = units[unit].context.syntax_tree())
+						prune(*program);
+				}
+				return stats;
+			}
+
+		private:
+			const std::vector<Build::Unit> &units;
+			DeadCodeStats stats;
+
+			// the definition of every defining identifier
+			std::unordered_map<const Identifier *, Statement *> definitions;
+			// top-level definitions of every unit, by name
+			std::vector<std::unordered_map<std::string_view, Identifier *>> exports;
+
+			std::unordered_set<const Identifier *> live;
+			// code that runs, and the unit it is in
+			std::vector<std::pair<Node *, size_t>> pending;
+
+			const std::vector<Token> &tokens(size_t unit) const
+			{
+				return units[unit].context.token_list();
+			}
+
+			// drops the statements after a return and finds the definitions
+			void collect(Program &program, size_t unit)
+			{
+				for(const auto &stmt : program.statements)
+				{
+					if(is_definition(*stmt))
+						exports[unit][defined_name(*stmt).token(tokens(unit)).value] = &defined_name(*stmt);
+				}
+
+				std::vector<Node *> stack = { &program };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+
+					if(node->kind == NodeKind::Block)
+						truncate(static_cast<Block &>(*node).statements);
+					else if(node->kind == NodeKind::FunctionDef || node->kind == NodeKind::VariableDef)
+						definitions[&defined_name(static_cast<Statement &>(*node))] = static_cast<Statement *>(node);
+
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+				}
+			}
+
+			void truncate(std::vector<std::unique_ptr<Statement>> &statements)
+			{
+				for(size_t i = 0; i < statements.size(); i++)
+				{
+					const auto &stmt = *statements[i];
+					if(stmt.kind != NodeKind::ExprStatement || static_cast<const ExprStatement &>(stmt).expr->kind != NodeKind::ReturnExpr)
+						continue;
+
+					for(size_t j = i + 1; j < statements.size(); j++)
+					{
+						stats.statements++;
+						stats.nodes += count_nodes(*statements[j]);
+					}
+					statements.resize(i + 1);
+					break;
+				}
+			}
+
+			void mark(Identifier &name, size_t unit)
+			{
+				if(!live.insert(&name).second) return;
+
+				auto found = definitions.find(&name);
+				if(found == definitions.end()) return;
+				auto &def = *found->second;
+				if(def.kind == NodeKind::FunctionDef)
+					pending.push_back({ static_cast<FunctionDef &>(def).body.get(), unit });
+				else if(auto value = static_cast<VariableDef &>(def).value.get())
+					pending.push_back({ value, unit });
+			}
+
+			// marks what the identifier refers to
+			void reference(Identifier &node, size_t unit)
+			{
+				if(!node.symbol || !node.symbol->node) return;
+
+				auto target = node.symbol->node;
+				if(target->kind == NodeKind::Identifier)
+				{
+					mark(static_cast<Identifier &>(*target), unit);
+					return;
+				}
+				if(target->kind != NodeKind::Import) return;
+
+				auto module = static_cast<Import &>(*target).name(tokens(unit)).value;
+				for(const auto &[name, index] : units[unit].imports)
+				{
+					if(name != module) continue;
+					auto exported = exports[index].find(node.token(tokens(unit)).value);
+					if(exported != exports[index].end())
+						mark(*exported->second, index);
+					return;
+				}
+			}
+
+			// a definition that is not in a list of statements cannot be
+			// removed, so it is live wherever it is
+			void branch(Statement *stmt, size_t unit)
+			{
+				if(!stmt) return;
+				if(is_definition(*stmt))
+					mark(defined_name(*stmt), unit);
+				else
+					pending.push_back({ stmt, unit });
+			}
+
+			void scan()
+			{
+				while(!pending.empty())
+				{
+					auto [node, unit] = pending.back();
+					pending.pop_back();
+
+					switch(node->kind)
+					{
+						// a function runs only when it is called
+						case NodeKind::FunctionDef:
+							continue;
+						case NodeKind::VariableDef:
+						{
+							auto &def = static_cast<VariableDef &>(*node);
+							if(def.value && has_effects(*def.value, tokens(unit), units[unit].context.constant_pool()))
+								mark(*def.name, unit);
+							continue;
+						}
+						case NodeKind::Identifier:
+							reference(static_cast<Identifier &>(*node), unit);
+							continue;
+						case NodeKind::IfExpr:
+						{
+							auto &expr = static_cast<IfExpr &>(*node);
+							pending.push_back({ expr.condition.get(), unit });
+							branch(expr.if_branch.get(), unit);
+							branch(expr.else_branch.get(), unit);
+							continue;
+						}
+						case NodeKind::WhileExpr:
+						{
+							auto &expr = static_cast<WhileExpr &>(*node);
+							pending.push_back({ expr.condition.get(), unit });
+							branch(expr.body.get(), unit);
+							continue;
+						}
+						default:
+							break;
+					}
+
+					for_each_child(*node, [&, unit = unit](Node &child) { pending.push_back({ &child, unit }); });
+				}
+			}
+
+			// removes the definitions that are not live from the lists of
+			// statements, and looks into the rest
+			void prune(Program &program)
+			{
+				std::vector<Node *> stack = { &program };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+
+					if(node->kind == NodeKind::Program)
+						remove_dead(static_cast<Program &>(*node).statements);
+					else if(node->kind == NodeKind::Block)
+						remove_dead(static_cast<Block &>(*node).statements);
+
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+				}
+			}
+
+			void remove_dead(std::vector<std::unique_ptr<Statement>> &statements)
+			{
+				size_t kept = 0;
+				for(auto &stmt : statements)
+				{
+					if(is_definition(*stmt) && !live.count(&defined_name(*stmt)))
+					{
+						if(stmt->kind == NodeKind::FunctionDef)
+							stats.functions++;
+						else
+							stats.variables++;
+						stats.nodes += count_nodes(*stmt);
+						stmt.reset();
+						continue;
+					}
+					statements[kept++] = std::move(stmt);
+				}
+				statements.resize(kept);
+			}
+		};
+	}
+
+	DeadCodeStats eliminate_dead_code(const std::vector<Build::Unit> &units)
+	{
+		Eliminator eliminator(units);
+		return eliminator.run();
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "build.h"
+
+#include <cstddef>
+
+namespace Optimize
+{
+	// what eliminate_dead_code removed
+	struct DeadCodeStats
+	{
+		size_t functions = 0;
+		size_t variables = 0;
+		// after a return in the same block
+		size_t statements = 0;
+		// in all of the above, with everything below them
+		size_t nodes = 0;
+	};
+
+	// Removes what can never run or be read from the trees of a build: the
+	// statements after a return in a block, the functions no live code
+	// calls, and the variables no live code refers to whose initializer has
+	// no effects. Live code is the top level of every module and whatever
+	// it refers to, across imports, as the symbol table resolved it.
+	//
+	// Only definitions in a list of statements are removed; one that is the
+	// branch of an if or the body of a while stays. The units must have
+	// been checked by the tree passes.
+	DeadCodeStats eliminate_dead_code(const std::vector<Build::Unit> &units);
+}
@@ -0,0 +1,663 @@
+#include "inliner.h"
+
+#include "tree.h"
+#include "lang.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Optimize
+{
+	namespace
+	{
+		// nodes a callee may have at each level; a call in a loop takes one
+		// this many times bigger again for each loop around it, up to
+		// max_loops
+		constexpr size_t callee_limit[] = { 0, 12, 40 };
+		constexpr unsigned max_loops = 3;
+		// the trees of a module may grow by this many nodes, or by as many
+		// as they have, whichever is more
+		constexpr size_t min_budget = 1000;
+		// an argument with no effects is copied to every use of its
+		// parameter if it has at most this many nodes
+		constexpr size_t max_copied = 5;
+
+		Expression &ungroup(Expression &node)
+		{
+			auto expr = &node;
+			while(expr->kind == NodeKind::GroupExpr)
+				expr = static_cast<GroupExpr *>(expr)->expr.get();
+			return *expr;
+		}
+
+		bool is_literal(const Expression &node)
+		{
+			auto kind = node.kind;
+			return kind == NodeKind::NumberLiteral || kind == NodeKind::StringLiteral || kind == NodeKind::BooleanLiteral || kind == NodeKind::UnitLiteral;
+		}
+
+		class Inliner
+		{
+		public:
+			Inliner(const Build::Unit &unit, unsigned level, InlineStats &stats)
+				: tokens(unit.context.token_list()),
+				  constants(unit.context.constant_pool()),
+				  program(*unit.context.syntax_tree()),
+				  level(std::min<unsigned>(level, std::size(callee_limit) - 1)),
+				  stats(stats)
+			{}
+
+			void run()
+			{
+				budget = std::max(min_budget, count_nodes(program));
+				collect();
+				order_functions();
+
+				for(auto function : order)
+				{
+					process(*function->body);
+				}
+				for(const auto &stmt : program.statements)
+				{
+					process(*stmt);
+				}
+			}
+
+		private:
+			const std::vector<Token> &tokens;
+			const ConstantPool &constants;
+			Program &program;
+			unsigned level;
+			InlineStats &stats;
+			size_t budget = 0;
+
+			// every function of the module, by its defining identifier
+			std::unordered_map<const Node *, FunctionDef *> functions;
+			// defining identifiers of the top level
+			std::unordered_set<const Node *> globals;
+			// callees before their callers
+			std::vector<FunctionDef *> order;
+			std::unordered_set<const FunctionDef *> recursive;
+			std::unordered_set<const FunctionDef *> inlined;
+
+			// what a call site needs to know about a callee
+			struct Callee
+			{
+				bool eligible = false;
+				Expression *value = nullptr;
+				size_t size = 0;
+				bool effects = false;
+				// reads a variable that is not a parameter
+				bool reads_globals = false;
+				// references to each parameter, and whether any of them is
+				// evaluated only sometimes
+				std::vector<unsigned> uses;
+				std::vector<bool> conditional;
+			};
+			std::unordered_map<const FunctionDef *, Callee> callees;
+
+			void collect()
+			{
+				for(const auto &stmt : program.statements)
+				{
+					if(stmt->kind == NodeKind::FunctionDef)
+						globals.insert(static_cast<FunctionDef &>(*stmt).name.get());
+					else if(stmt->kind == NodeKind::VariableDef)
+						globals.insert(static_cast<VariableDef &>(*stmt).name.get());
+				}
+
+				std::vector<Node *> stack = { &program };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+					if(node->kind == NodeKind::FunctionDef)
+					{
+						auto function = static_cast<FunctionDef *>(node);
+						functions[function->name.get()] = function;
+					}
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+				}
+			}
+
+			FunctionDef *called(const FunctionCall &call) const
+			{
+				const auto &symbol = call.name->symbol;
+				if(!symbol || !symbol->node) return nullptr;
+				auto found = functions.find(symbol->node);
+				return found == functions.end() ? nullptr : found->second;
+			}
+
+			// the functions a body calls, not counting those nested in it
+			std::vector<FunctionDef *> calls_in(FunctionDef &function) const
+			{
+				std::vector<FunctionDef *> result;
+				std::vector<Node *> stack = { function.body.get() };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+					if(node->kind == NodeKind::FunctionDef) continue;
+					if(node->kind == NodeKind::FunctionCall)
+					{
+						if(auto callee = called(static_cast<FunctionCall &>(*node)))
+							result.push_back(callee);
+					}
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+				}
+				return result;
+			}
+
+			// orders the functions by the strongly connected components of
+			// the call graph, which Tarjan's algorithm finds callees first;
+			// a function in a component of its own that does not call
+			// itself is not recursive
+			void order_functions()
+			{
+				std::vector<FunctionDef *> nodes;
+				for(const auto &[name, function] : functions)
+					nodes.push_back(function);
+				// in source order, so the result does not depend on hashing
+				std::sort(nodes.begin(), nodes.end(), [](const FunctionDef *a, const FunctionDef *b)
+				{
+					return a->name->token_index < b->name->token_index;
+				});
+				std::unordered_map<const FunctionDef *, size_t> index_of;
+				for(size_t i = 0; i < nodes.size(); i++)
+					index_of[nodes[i]] = i;
+
+				std::vector<std::vector<size_t>> edges(nodes.size());
+				std::vector<bool> calls_itself(nodes.size(), false);
+				for(size_t i = 0; i < nodes.size(); i++)
+				{
+					for(auto callee : calls_in(*nodes[i]))
+					{
+						auto j = index_of.at(callee);
+						if(j == i) calls_itself[i] = true;
+						edges[i].push_back(j);
+					}
+				}
+
+				constexpr size_t unvisited = SIZE_MAX;
+				std::vector<size_t> index(nodes.size(), unvisited), low(nodes.size());
+				std::vector<bool> on_stack(nodes.size(), false);
+				std::vector<size_t> component;
+				size_t next = 0;
+
+				struct Frame
+				{
+					size_t node, edge;
+				};
+				std::vector<Frame> stack;
+
+				for(size_t root = 0; root < nodes.size(); root++)
+				{
+					if(index[root] != unvisited) continue;
+					stack.push_back({ root, 0 });
+					index[root] = low[root] = next++;
+					component.push_back(root);
+					on_stack[root] = true;
+
+					while(!stack.empty())
+					{
+						auto &frame = stack.back();
+						auto v = frame.node;
+						if(frame.edge < edges[v].size())
+						{
+							auto w = edges[v][frame.edge++];
+							if(index[w] == unvisited)
+							{
+								index[w] = low[w] = next++;
+								component.push_back(w);
+								on_stack[w] = true;
+								stack.push_back({ w, 0 });
+							}
+							else if(on_stack[w])
+								low[v] = std::min(low[v], index[w]);
+							continue;
+						}
+
+						stack.pop_back();
+						if(!stack.empty())
+							low[stack.back().node] = std::min(low[stack.back().node], low[v]);
+						if(low[v] != index[v]) continue;
+
+						// v is the root of a component; it is everything above it
+						auto start = std::find(component.begin(), component.end(), v);
+						bool cycle = component.end() - start > 1 || calls_itself[v];
+						for(auto member = start; member != component.end(); member++)
+						{
+							on_stack[*member] = false;
+							order.push_back(nodes[*member]);
+							if(cycle)
+							{
+								recursive.insert(nodes[*member]);
+								stats.recursive++;
+							}
+						}
+						component.erase(start, component.end());
+					}
+				}
+			}
+
+			const Callee &callee(FunctionDef &function)
+			{
+				auto found = callees.find(&function);
+				if(found != callees.end()) return found->second;
+
+				auto &result = callees[&function];
+				const auto &statements = function.body->statements;
+				if(statements.size() != 1 || statements[0]->kind != NodeKind::ExprStatement) return result;
+				auto &ret = *static_cast<ExprStatement &>(*statements[0]).expr;
+				if(ret.kind != NodeKind::ReturnExpr || !static_cast<ReturnExpr &>(ret).value) return result;
+				auto &value = *static_cast<ReturnExpr &>(ret).value;
+
+				std::unordered_map<const Node *, size_t> parameters;
+				for(size_t i = 0; i < function.parameters.size(); i++)
+					parameters[function.parameters[i]->name.get()] = i;
+				result.uses.assign(parameters.size(), 0);
+				result.conditional.assign(parameters.size(), false);
+
+				std::vector<std::pair<Node *, bool>> stack = { { &value, false } };
+				while(!stack.empty())
+				{
+					auto [node, conditional] = stack.back();
+					stack.pop_back();
+
+					switch(node->kind)
+					{
+						case NodeKind::ReturnExpr:
+						case NodeKind::WhileExpr:
+						case NodeKind::VariableDef:
+						case NodeKind::FunctionDef:
+						case NodeKind::Invalid:
+							return result;
+						case NodeKind::Identifier:
+						{
+							const auto &symbol = static_cast<Identifier &>(*node).symbol;
+							if(!symbol) return result;
+							// built-in function
+							if(!symbol->node) break;
+
+							auto parameter = parameters.find(symbol->node);
+							if(parameter != parameters.end())
+							{
+								result.uses[parameter->second]++;
+								if(conditional) result.conditional[parameter->second] = true;
+							}
+							else if(globals.count(symbol->node))
+							{
+								if(!functions.count(symbol->node)) result.reads_globals = true;
+							}
+							// variables of an enclosing function, imports and
+							// nested functions stay where they are
+							else
+								return result;
+							break;
+						}
+						case NodeKind::InfixOperator:
+						{
+							auto &op = static_cast<InfixOperator &>(*node);
+							auto sym = op.token(tokens).value;
+							if(Lang::is_assignment(sym) && assigns_parameter(*op.left, parameters)) return result;
+							bool logical = sym == "and" || sym == "&&" || sym == "or" || sym == "||";
+							stack.push_back({ op.left.get(), conditional });
+							stack.push_back({ op.right.get(), conditional || logical });
+							continue;
+						}
+						case NodeKind::PrefixOperator:
+						case NodeKind::PostfixOperator:
+						{
+							auto &op = static_cast<Operator &>(*node);
+							auto sym = op.token(tokens).value;
+							auto &operand = node->kind == NodeKind::PrefixOperator
+							                ? *static_cast<PrefixOperator &>(*node).operand
+							                : *static_cast<PostfixOperator &>(*node).operand;
+							if((sym == "++" || sym == "--") && assigns_parameter(operand, parameters)) return result;
+							break;
+						}
+						case NodeKind::IfExpr:
+						{
+							auto &expr = static_cast<IfExpr &>(*node);
+							if(!plain_branch(expr.if_branch.get()) || !plain_branch(expr.else_branch.get())) return result;
+							stack.push_back({ expr.condition.get(), conditional });
+							stack.push_back({ expr.if_branch.get(), true });
+							if(expr.else_branch) stack.push_back({ expr.else_branch.get(), true });
+							continue;
+						}
+						default:
+							break;
+					}
+					for_each_child(*node, [&, conditional = conditional](Node &child) { stack.push_back({ &child, conditional }); });
+				}
+
+				result.eligible = true;
+				result.value = &value;
+				result.size = count_nodes(value);
+				result.effects = has_effects(value, tokens, constants);
+				return result;
+			}
+
+			static bool assigns_parameter(Expression &target, const std::unordered_map<const Node *, size_t> &parameters)
+			{
+				auto &expr = ungroup(target);
+				if(expr.kind != NodeKind::Identifier) return true;
+				const auto &symbol = static_cast<Identifier &>(expr).symbol;
+				return !symbol || parameters.count(symbol->node);
+			}
+
+			// a branch made only of expressions, which can be copied as it is
+			static bool plain_branch(Statement *branch)
+			{
+				if(!branch || branch->kind == NodeKind::ExprStatement) return true;
+				if(branch->kind != NodeKind::Block) return false;
+				for(const auto &stmt : static_cast<Block &>(*branch).statements)
+				{
+					if(stmt->kind != NodeKind::ExprStatement) return false;
+				}
+				return true;
+			}
+
+			// a variable of a function, which no callee can change
+			bool is_local(const Identifier &node) const
+			{
+				return node.symbol && node.symbol->node && node.symbol->node->kind == NodeKind::Identifier
+				       && !globals.count(node.symbol->node) && !functions.count(node.symbol->node);
+			}
+
+			bool reads_only_locals(Expression &root) const
+			{
+				std::vector<Node *> stack = { &root };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+					if(node->kind == NodeKind::Identifier && !is_local(static_cast<Identifier &>(*node)))
+						return false;
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+				}
+				return true;
+			}
+
+			// inlines the calls in a statement or expression, innermost first
+			void process(Node &root)
+			{
+				struct Frame
+				{
+					Node *node;
+					// where the node is held, if it is an expression
+					std::unique_ptr<Expression> *slot;
+					unsigned loops;
+					bool expanded;
+				};
+				std::vector<Frame> stack = { { &root, nullptr, 0, false } };
+
+				while(!stack.empty())
+				{
+					auto frame = stack.back();
+					stack.pop_back();
+					auto node = frame.node;
+
+					if(frame.expanded)
+					{
+						if(node->kind == NodeKind::FunctionCall)
+							try_inline(*frame.slot, frame.loops);
+						continue;
+					}
+
+					// a nested function is inlined into on its own
+					if(node->kind == NodeKind::FunctionDef) continue;
+					stack.push_back({ node, frame.slot, frame.loops, true });
+
+					auto statement = [&](Statement *child, unsigned loops)
+					{
+						if(child) stack.push_back({ child, nullptr, loops, false });
+					};
+					auto expression = [&](std::unique_ptr<Expression> &child, unsigned loops)
+					{
+						if(child) stack.push_back({ child.get(), &child, loops, false });
+					};
+
+					auto loops = frame.loops;
+					switch(node->kind)
+					{
+						case NodeKind::Program:
+							for(auto &stmt : static_cast<Program &>(*node).statements)
+								statement(stmt.get(), loops);
+							break;
+						case NodeKind::Block:
+							for(auto &stmt : static_cast<Block &>(*node).statements)
+								statement(stmt.get(), loops);
+							break;
+						case NodeKind::ExprStatement:
+							expression(static_cast<ExprStatement &>(*node).expr, loops);
+							break;
+						case NodeKind::VariableDef:
+							expression(static_cast<VariableDef &>(*node).value, loops);
+							break;
+						case NodeKind::IfExpr:
+						{
+							auto &expr = static_cast<IfExpr &>(*node);
+							expression(expr.condition, loops);
+							statement(expr.if_branch.get(), loops);
+							statement(expr.else_branch.get(), loops);
+							break;
+						}
+						case NodeKind::WhileExpr:
+						{
+							auto &expr = static_cast<WhileExpr &>(*node);
+							expression(expr.condition, loops + 1);
+							statement(expr.body.get(), loops + 1);
+							break;
+						}
+						case NodeKind::ReturnExpr:
+							expression(static_cast<ReturnExpr &>(*node).value, loops);
+							break;
+						case NodeKind::InfixOperator:
+							expression(static_cast<InfixOperator &>(*node).left, loops);
+							expression(static_cast<InfixOperator &>(*node).right, loops);
+							break;
+						case NodeKind::PrefixOperator:
+							expression(static_cast<PrefixOperator &>(*node).operand, loops);
+							break;
+						case NodeKind::PostfixOperator:
+							expression(static_cast<PostfixOperator &>(*node).operand, loops);
+							break;
+						case NodeKind::GroupExpr:
+							expression(static_cast<GroupExpr &>(*node).expr, loops);
+							break;
+						case NodeKind::FunctionCall:
+							for(auto &arg : static_cast<FunctionCall &>(*node).arguments)
+								expression(arg, loops);
+							break;
+						default:
+							break;
+					}
+				}
+			}
+
+			void try_inline(std::unique_ptr<Expression> &slot, unsigned loops)
+			{
+				auto &call = static_cast<FunctionCall &>(*slot);
+				auto function = called(call);
+				if(!function || recursive.count(function)) return;
+
+				const auto &info = callee(*function);
+				if(!info.eligible || info.uses.size() != call.arguments.size()) return;
+
+				auto limit = callee_limit[level] * (1 + std::min(loops, max_loops));
+				if(info.size > limit || info.size > budget)
+				{
+					if(level > 0) stats.too_large++;
+					return;
+				}
+
+				// how each argument gets to where its parameter is used
+				enum class Pass { Drop, Copy, Move };
+				std::vector<Pass> passes(call.arguments.size());
+				size_t effectful = call.arguments.size();
+				for(size_t i = 0; i < call.arguments.size(); i++)
+				{
+					auto &arg = *call.arguments[i];
+					auto &bare = ungroup(arg);
+					auto uses = info.uses[i];
+
+					if(is_literal(bare))
+						passes[i] = uses ? Pass::Copy : Pass::Drop;
+					else if(bare.kind == NodeKind::Identifier)
+					{
+						auto &id = static_cast<Identifier &>(bare);
+						// a function used as a value is left to the backend to reject
+						if(!id.symbol || functions.count(id.symbol->node)) return;
+						// read later than the call would have read it
+						if(uses && info.effects && !is_local(id)) return;
+						passes[i] = uses ? Pass::Copy : Pass::Drop;
+					}
+					else if(!has_effects(arg, tokens, constants))
+					{
+						if(uses > 1 && count_nodes(arg) > max_copied) return;
+						if(uses && info.effects && !reads_only_locals(arg)) return;
+						passes[i] = uses > 1 ? Pass::Copy : uses ? Pass::Move : Pass::Drop;
+					}
+					else
+					{
+						// evaluated where the parameter is used, so only once
+						// and with nothing evaluated before it that it could
+						// change
+						if(effectful != call.arguments.size() || uses != 1 || info.conditional[i] || info.effects || info.reads_globals) return;
+						effectful = i;
+						passes[i] = Pass::Move;
+					}
+				}
+				if(effectful != call.arguments.size())
+				{
+					for(size_t i = 0; i < call.arguments.size(); i++)
+					{
+						if(i == effectful) continue;
+						auto &bare = ungroup(*call.arguments[i]);
+						if(!is_literal(bare) && !(bare.kind == NodeKind::Identifier && is_local(static_cast<Identifier &>(bare))))
+							return;
+					}
+				}
+
+				std::unordered_map<const Node *, size_t> parameters;
+				for(size_t i = 0; i < function->parameters.size(); i++)
+					parameters[function->parameters[i]->name.get()] = i;
+
+				auto before = count_nodes(call);
+				auto copy = clone(*info.value, [&](Identifier &id) -> std::unique_ptr<Expression>
+				{
+					auto parameter = parameters.find(id.symbol ? id.symbol->node : nullptr);
+					if(parameter == parameters.end()) return nullptr;
+					auto &arg = call.arguments[parameter->second];
+					if(passes[parameter->second] == Pass::Move) return std::move(arg);
+					return clone(*arg, [](Identifier &) -> std::unique_ptr<Expression> { return nullptr; });
+				});
+
+				auto after = count_nodes(*copy);
+				slot = std::move(copy);
+
+				stats.calls++;
+				if(loops > 0) stats.calls_in_loops++;
+				if(inlined.insert(function).second) stats.functions++;
+				stats.nodes += static_cast<long long>(after) - static_cast<long long>(before);
+				if(after > before) budget -= std::min(budget, after - before);
+			}
+
+			// a copy of an expression the callee analysis accepted, with the
+			// identifiers substitute replaces; callees are small, so the
+			// recursion is shallow
+			template<typename F>
+			std::unique_ptr<Expression> clone(Expression &node, const F &substitute)
+			{
+				switch(node.kind)
+				{
+					case NodeKind::NumberLiteral:
+						return std::make_unique<NumberLiteral>(static_cast<NumberLiteral &>(node).token_index);
+					case NodeKind::StringLiteral:
+						return std::make_unique<StringLiteral>(static_cast<StringLiteral &>(node).token_index);
+					case NodeKind::BooleanLiteral:
+						return std::make_unique<BooleanLiteral>(static_cast<BooleanLiteral &>(node).token_index);
+					case NodeKind::UnitLiteral:
+						return std::make_unique<UnitLiteral>(static_cast<UnitLiteral &>(node).token_index);
+					case NodeKind::Identifier:
+					{
+						auto &id = static_cast<Identifier &>(node);
+						if(auto replacement = substitute(id)) return replacement;
+						return std::make_unique<Identifier>(id.token_index, id.symbol);
+					}
+					case NodeKind::FunctionCall:
+					{
+						auto &call = static_cast<FunctionCall &>(node);
+						std::vector<std::unique_ptr<Expression>> arguments;
+						for(const auto &arg : call.arguments)
+							arguments.push_back(clone(*arg, substitute));
+						auto name = std::make_unique<Identifier>(call.name->token_index, call.name->symbol);
+						return std::make_unique<FunctionCall>(std::move(name), std::move(arguments), call.rparen_index);
+					}
+					case NodeKind::InfixOperator:
+					{
+						auto &op = static_cast<InfixOperator &>(node);
+						auto left = clone(*op.left, substitute);
+						auto right = clone(*op.right, substitute);
+						return std::make_unique<InfixOperator>(op.token_index, std::move(left), std::move(right));
+					}
+					case NodeKind::PrefixOperator:
+					{
+						auto &op = static_cast<PrefixOperator &>(node);
+						return std::make_unique<PrefixOperator>(op.token_index, clone(*op.operand, substitute));
+					}
+					case NodeKind::PostfixOperator:
+					{
+						auto &op = static_cast<PostfixOperator &>(node);
+						return std::make_unique<PostfixOperator>(op.token_index, clone(*op.operand, substitute));
+					}
+					case NodeKind::GroupExpr:
+					{
+						auto &group = static_cast<GroupExpr &>(node);
+						return std::make_unique<GroupExpr>(group.lparen_index, clone(*group.expr, substitute), group.rparen_index);
+					}
+					case NodeKind::IfExpr:
+					{
+						auto &expr = static_cast<IfExpr &>(node);
+						auto condition = clone(*expr.condition, substitute);
+						auto if_branch = clone_branch(*expr.if_branch, substitute);
+						auto else_branch = expr.else_branch ? clone_branch(*expr.else_branch, substitute) : nullptr;
+						return std::make_unique<IfExpr>(expr.if_keyword_index, std::move(condition), std::move(if_branch), expr.else_keyword_index, std::move(else_branch));
+					}
+					default:
+						return nullptr;
+				}
+			}
+
+			template<typename F>
+			std::unique_ptr<Statement> clone_branch(Statement &branch, const F &substitute)
+			{
+				if(branch.kind == NodeKind::ExprStatement)
+					return std::make_unique<ExprStatement>(clone(*static_cast<ExprStatement &>(branch).expr, substitute));
+
+				auto &block = static_cast<Block &>(branch);
+				std::vector<std::unique_ptr<Statement>> statements;
+				for(const auto &stmt : block.statements)
+					statements.push_back(clone_branch(*stmt, substitute));
+				return std::make_unique<Block>(block.lbrace_index, std::move(statements), block.rbrace_index);
+			}
+		};
+	}
+
+	InlineStats inline_functions(const std::vector<Build::Unit> &units, unsigned level)
+	{
+		InlineStats stats;
+		if(level == 0) return stats;
+
+		for(const auto &unit : units)
+		{
+			if(!unit.context.syntax_tree()) continue;
+			Inliner inliner(unit, level, stats);
+			inliner.run();
+		}
+		return stats;
+	}
+}
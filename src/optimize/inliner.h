@@ -0,0 +1,38 @@
+#pragma once
+
+#include "build.h"
+
+#include <cstddef>
+
+namespace Optimize
+{
+	// what inline_functions did
+	struct InlineStats
+	{
+		// call sites replaced, and how many of them were in a loop
+		size_t calls = 0;
+		size_t calls_in_loops = 0;
+		// distinct functions inlined at least once
+		size_t functions = 0;
+		// functions that call themselves through some chain of calls,
+		// which are never inlined
+		size_t recursive = 0;
+		// call sites whose callee could be inlined but was too big for them
+		size_t too_large = 0;
+		// the trees grew by
+		long long nodes = 0;
+	};
+
+	// Replaces calls to small functions with a copy of the expression they
+	// return, its parameters replaced with the arguments. Only a function
+	// whose body is a single return is inlined, only into its own module,
+	// and only where doing so evaluates everything as often and in the same
+	// order as the call did.
+	//
+	// A callee may have at most a level dependent number of nodes, more
+	// for every loop around the call site; recursive functions are never
+	// inlined. Callees are inlined into before their callers, so a chain
+	// of small functions collapses into its outermost caller. Level 0
+	// inlines nothing. The units must have been checked by the tree passes.
+	InlineStats inline_functions(const std::vector<Build::Unit> &units, unsigned level);
+}
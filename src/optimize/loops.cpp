@@ -0,0 +1,690 @@
+#include "loops.h"
+
+#include "tree.h"
+#include "lang.h"
+#include "semantic/rules.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Optimize
+{
+	namespace
+	{
+		Expression &ungroup(Expression &node)
+		{
+			auto expr = &node;
+			while(expr->kind == NodeKind::GroupExpr)
+				expr = static_cast<GroupExpr *>(expr)->expr.get();
+			return *expr;
+		}
+
+		// as the emitter reads it: the symbol table leaves a reference with
+		// the symbol it found, and the type checker types the defining one
+		const DataType &symbol_type(const Identifier &node)
+		{
+			const auto &symbol = *node.symbol;
+			if(symbol.type.is_function || symbol.type != DataType::Invalid || !symbol.node || symbol.node->kind != NodeKind::Identifier)
+				return symbol.type;
+			return static_cast<Identifier *>(symbol.node)->symbol->type;
+		}
+
+		// a while loop that is a statement of its own
+		struct Site
+		{
+			std::vector<std::unique_ptr<Statement>> *list;
+			size_t index;
+			WhileExpr *loop;
+		};
+
+		class LoopOptimizer
+		{
+		public:
+			LoopOptimizer(Compiler::Context &context, LoopStats &stats)
+				: context(context),
+				  tokens(context.token_list()),
+				  constants(context.constant_pool()),
+				  stats(stats)
+			{}
+
+			void run(Program &program)
+			{
+				for(const auto &stmt : program.statements)
+				{
+					if(stmt->kind == NodeKind::FunctionDef)
+						globals.insert(static_cast<FunctionDef &>(*stmt).name.get());
+					else if(stmt->kind == NodeKind::VariableDef)
+						globals.insert(static_cast<VariableDef &>(*stmt).name.get());
+				}
+
+				// a loop is found before the loops in it, and the loops of a
+				// list in order, so going backwards does inner loops first and
+				// never moves a loop that is still to be done
+				std::vector<Site> sites;
+				std::vector<Node *> stack = { &program };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+
+					std::vector<std::unique_ptr<Statement>> *list = nullptr;
+					if(node->kind == NodeKind::Program)
+						list = &static_cast<Program &>(*node).statements;
+					else if(node->kind == NodeKind::Block)
+						list = &static_cast<Block &>(*node).statements;
+					for(size_t i = 0; list && i < list->size(); i++)
+					{
+						auto &stmt = *(*list)[i];
+						if(stmt.kind == NodeKind::ExprStatement && static_cast<ExprStatement &>(stmt).expr->kind == NodeKind::WhileExpr)
+							sites.push_back({ list, i, static_cast<WhileExpr *>(static_cast<ExprStatement &>(stmt).expr.get()) });
+					}
+
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+				}
+
+				for(auto site = sites.rbegin(); site != sites.rend(); site++)
+				{
+					optimize(*site);
+				}
+			}
+
+		private:
+			Compiler::Context &context;
+			const std::vector<Token> &tokens;
+			ConstantPool &constants;
+			LoopStats &stats;
+
+			// defining identifiers of the top level
+			std::unordered_set<const Node *> globals;
+
+			// what a loop does to the variables it could read
+			struct Loop
+			{
+				WhileExpr *node = nullptr;
+				// assignments and increments, by the definition they change
+				std::unordered_map<const Node *, unsigned> assigned;
+				// defining identifiers in the loop
+				std::unordered_set<const Node *> defined;
+				// calls a function of the program
+				bool calls = false;
+				bool has_function = false;
+				// where the nodes it builds are reported
+				Util::FileLocation location;
+			};
+
+			// an induction variable
+			struct Induction
+			{
+				// the reference its step assigns
+				Identifier *variable;
+				std::int64_t step;
+				// index of the step in the body
+				size_t index;
+			};
+
+			void optimize(const Site &site)
+			{
+				stats.loops++;
+				auto loop = analyze(*site.loop);
+				if(loop.has_function) return;
+
+				std::vector<std::unique_ptr<Statement>> before;
+				hoist_definitions(loop, before);
+				hoist_expressions(loop, before);
+				reduce(loop, before);
+
+				auto &list = *site.list;
+				list.insert(list.begin() + site.index, std::make_move_iterator(before.begin()), std::make_move_iterator(before.end()));
+			}
+
+			Loop analyze(WhileExpr &node)
+			{
+				Loop loop;
+				loop.node = &node;
+				loop.location = node.while_keyword(tokens).location;
+
+				auto assign = [&](Expression &target)
+				{
+					auto &expr = ungroup(target);
+					if(expr.kind != NodeKind::Identifier) return;
+					const auto &symbol = static_cast<Identifier &>(expr).symbol;
+					if(symbol && symbol->node) loop.assigned[symbol->node]++;
+				};
+
+				std::vector<Node *> stack = { node.condition.get(), node.body.get() };
+				while(!stack.empty())
+				{
+					auto current = stack.back();
+					stack.pop_back();
+
+					switch(current->kind)
+					{
+						case NodeKind::FunctionDef:
+							loop.has_function = true;
+							continue;
+						case NodeKind::VariableDef:
+							loop.defined.insert(static_cast<VariableDef &>(*current).name.get());
+							break;
+						case NodeKind::FunctionCall:
+						{
+							const auto &symbol = static_cast<FunctionCall &>(*current).name->symbol;
+							if(symbol && symbol->node) loop.calls = true;
+							break;
+						}
+						case NodeKind::InfixOperator:
+						{
+							auto &op = static_cast<InfixOperator &>(*current);
+							if(Lang::is_assignment(op.token(tokens).value)) assign(*op.left);
+							break;
+						}
+						case NodeKind::PrefixOperator:
+						{
+							auto &op = static_cast<PrefixOperator &>(*current);
+							auto sym = op.token(tokens).value;
+							if(sym == "++" || sym == "--") assign(*op.operand);
+							break;
+						}
+						case NodeKind::PostfixOperator:
+							assign(*static_cast<PostfixOperator &>(*current).operand);
+							break;
+						default:
+							break;
+					}
+					for_each_child(*current, [&](Node &child) { stack.push_back(&child); });
+				}
+				return loop;
+			}
+
+			// has the same value in every iteration of the loop
+			bool invariant(const Identifier &node, const Loop &loop) const
+			{
+				if(!node.symbol || !node.symbol->node) return false;
+
+				auto target = node.symbol->node;
+				if(loop.assigned.count(target) || loop.defined.count(target)) return false;
+				// a function of an imported module may change its variables
+				if(target->kind == NodeKind::Import) return !loop.calls;
+				if(target->kind != NodeKind::Identifier || symbol_type(node).is_function) return false;
+				return !loop.calls || !globals.count(target);
+			}
+
+			// evaluates to the same value in every iteration, and could be
+			// evaluated anywhere
+			bool invariant(Expression &expr, const Loop &loop) const
+			{
+				if(has_effects(expr, tokens, constants)) return false;
+
+				std::vector<Node *> stack = { &expr };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+					if(node->kind == NodeKind::Identifier && !invariant(static_cast<Identifier &>(*node), loop))
+						return false;
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+				}
+				return true;
+			}
+
+			DataType type_of(Expression &expr) const
+			{
+				switch(expr.kind)
+				{
+					case NodeKind::NumberLiteral:
+					{
+						const auto &constant = constants[static_cast<NumberLiteral &>(expr).token(tokens).constant];
+						return constant.kind == Constant::Kind::Float ? DataType::Float : DataType::Integer;
+					}
+					case NodeKind::StringLiteral:
+						return DataType::String;
+					case NodeKind::BooleanLiteral:
+						return DataType::Boolean;
+					case NodeKind::Identifier:
+						return symbol_type(static_cast<Identifier &>(expr));
+					case NodeKind::GroupExpr:
+						return type_of(*static_cast<GroupExpr &>(expr).expr);
+					case NodeKind::InfixOperator:
+					{
+						auto &op = static_cast<InfixOperator &>(expr);
+						return Rules::infix(op.token(tokens).value, type_of(*op.left), type_of(*op.right));
+					}
+					case NodeKind::PrefixOperator:
+					{
+						auto &op = static_cast<PrefixOperator &>(expr);
+						return Rules::prefix(op.token(tokens).value, type_of(*op.operand));
+					}
+					default:
+						return DataType::Invalid;
+				}
+			}
+
+			// definitions directly in the body that the loop never assigns
+			void hoist_definitions(Loop &loop, std::vector<std::unique_ptr<Statement>> &before)
+			{
+				if(loop.node->body->kind != NodeKind::Block) return;
+				auto &statements = static_cast<Block &>(*loop.node->body).statements;
+
+				size_t kept = 0;
+				for(auto &stmt : statements)
+				{
+					if(stmt->kind == NodeKind::VariableDef)
+					{
+						auto &def = static_cast<VariableDef &>(*stmt);
+						if(def.value && !loop.assigned.count(def.name.get()) && invariant(*def.value, loop))
+						{
+							loop.defined.erase(def.name.get());
+							before.push_back(std::move(stmt));
+							stats.hoisted++;
+							continue;
+						}
+					}
+					statements[kept++] = std::move(stmt);
+				}
+				statements.resize(kept);
+			}
+
+			// the largest invariant operations in the loop, each into a new
+			// variable named after the first variable it reads
+			void hoist_expressions(Loop &loop, std::vector<std::unique_ptr<Statement>> &before)
+			{
+				// the same expression twice is computed once
+				std::unordered_map<std::string, Identifier *> hoisted;
+
+				for_each_slot(loop, [&](std::unique_ptr<Expression> &slot)
+				{
+					auto &expr = *slot;
+					if(expr.kind != NodeKind::InfixOperator && expr.kind != NodeKind::PrefixOperator) return true;
+					if(!invariant(expr, loop)) return true;
+
+					auto name_token = first_identifier(expr);
+					auto type = type_of(expr);
+					if(name_token == no_token || !(type == DataType::Integer || type == DataType::Float || type == DataType::Boolean || type == DataType::String))
+						return true;
+
+					auto &existing = hoisted[shape(expr)];
+					if(existing)
+					{
+						slot = reference(*existing);
+						stats.hoisted++;
+						return false;
+					}
+
+					auto name = std::make_unique<Identifier>(name_token, nullptr);
+					name->symbol = std::make_shared<SymbolData>(nullptr, 0, name.get(), type);
+					existing = name.get();
+					auto replacement = reference(*name);
+					before.push_back(std::make_unique<VariableDef>(std::move(name), nullptr, std::move(slot)));
+					slot = std::move(replacement);
+					stats.hoisted++;
+					return false;
+				});
+			}
+
+			// the same for two expressions that compute the same thing the
+			// same way: every node in order, with the number of its children
+			std::string shape(Expression &expr) const
+			{
+				std::string key;
+				std::vector<Node *> stack = { &expr };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+
+					key += std::to_string(static_cast<int>(node->kind));
+					if(node->kind == NodeKind::Identifier)
+						key += "@" + std::to_string(reinterpret_cast<std::uintptr_t>(static_cast<Identifier &>(*node).symbol->node));
+					else if(node->kind == NodeKind::InfixOperator || node->kind == NodeKind::PrefixOperator)
+						key += std::string(static_cast<Operator &>(*node).token(tokens).value);
+					else if(node->kind == NodeKind::NumberLiteral || node->kind == NodeKind::StringLiteral || node->kind == NodeKind::BooleanLiteral)
+						key += "#" + std::string(static_cast<Literal &>(*node).token(tokens).value);
+
+					auto start = stack.size();
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+					key += "/" + std::to_string(stack.size() - start) + ";";
+				}
+				return key;
+			}
+
+			static TokenIndex first_identifier(Expression &expr)
+			{
+				std::vector<Node *> stack = { &expr };
+				while(!stack.empty())
+				{
+					auto node = stack.back();
+					stack.pop_back();
+					if(node->kind == NodeKind::Identifier)
+						return static_cast<Identifier &>(*node).token_index;
+
+					// children in source order
+					auto start = stack.size();
+					for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+					std::reverse(stack.begin() + start, stack.end());
+				}
+				return no_token;
+			}
+
+			// calls visit with the holder of every expression in the loop,
+			// parents first; visit returns whether to look into the expression
+			template<typename F>
+			void for_each_slot(Loop &loop, F &&visit)
+			{
+				std::vector<std::unique_ptr<Expression> *> slots = { &loop.node->condition };
+				std::vector<Statement *> statements = { loop.node->body.get() };
+
+				auto statement = [&](Statement *stmt)
+				{
+					if(stmt) statements.push_back(stmt);
+				};
+				auto expression = [&](std::unique_ptr<Expression> &expr)
+				{
+					if(expr) slots.push_back(&expr);
+				};
+
+				while(!slots.empty() || !statements.empty())
+				{
+					if(!statements.empty())
+					{
+						auto stmt = statements.back();
+						statements.pop_back();
+						switch(stmt->kind)
+						{
+							case NodeKind::Block:
+								for(auto &child : static_cast<Block &>(*stmt).statements)
+									statement(child.get());
+								break;
+							case NodeKind::ExprStatement:
+								expression(static_cast<ExprStatement &>(*stmt).expr);
+								break;
+							case NodeKind::VariableDef:
+								expression(static_cast<VariableDef &>(*stmt).value);
+								break;
+							default:
+								break;
+						}
+						continue;
+					}
+
+					auto slot = slots.back();
+					slots.pop_back();
+					if(!visit(*slot)) continue;
+
+					auto &expr = **slot;
+					switch(expr.kind)
+					{
+						case NodeKind::InfixOperator:
+						{
+							auto &op = static_cast<InfixOperator &>(expr);
+							// the variable an assignment changes is no value
+							if(!Lang::is_assignment(op.token(tokens).value))
+								expression(op.left);
+							expression(op.right);
+							break;
+						}
+						case NodeKind::PrefixOperator:
+						{
+							auto &op = static_cast<PrefixOperator &>(expr);
+							auto sym = op.token(tokens).value;
+							if(sym != "++" && sym != "--")
+								expression(op.operand);
+							break;
+						}
+						case NodeKind::GroupExpr:
+							expression(static_cast<GroupExpr &>(expr).expr);
+							break;
+						case NodeKind::FunctionCall:
+							for(auto &arg : static_cast<FunctionCall &>(expr).arguments)
+								expression(arg);
+							break;
+						case NodeKind::ReturnExpr:
+							expression(static_cast<ReturnExpr &>(expr).value);
+							break;
+						case NodeKind::IfExpr:
+						{
+							auto &node = static_cast<IfExpr &>(expr);
+							expression(node.condition);
+							statement(node.if_branch.get());
+							statement(node.else_branch.get());
+							break;
+						}
+						case NodeKind::WhileExpr:
+						{
+							auto &node = static_cast<WhileExpr &>(expr);
+							expression(node.condition);
+							statement(node.body.get());
+							break;
+						}
+						default:
+							break;
+					}
+				}
+			}
+
+			bool integer_literal(Expression &node, std::int64_t &value) const
+			{
+				auto &expr = ungroup(node);
+				if(expr.kind != NodeKind::NumberLiteral) return false;
+				const auto &constant = constants[static_cast<NumberLiteral &>(expr).token(tokens).constant];
+				if(constant.kind != Constant::Kind::Integer) return false;
+				value = constant.integer;
+				return true;
+			}
+
+			// the variable a statement steps by a constant, and the step
+			Identifier *step_of(Statement &stmt, std::int64_t &step) const
+			{
+				if(stmt.kind != NodeKind::ExprStatement) return nullptr;
+				auto &expr = ungroup(*static_cast<ExprStatement &>(stmt).expr);
+
+				auto identifier = [](Expression &node) -> Identifier *
+				{
+					auto &bare = ungroup(node);
+					return bare.kind == NodeKind::Identifier ? static_cast<Identifier *>(&bare) : nullptr;
+				};
+				auto same = [](Identifier *a, Identifier *b)
+				{
+					return a && b && a->symbol && b->symbol && a->symbol->node && a->symbol->node == b->symbol->node;
+				};
+
+				if(expr.kind == NodeKind::PrefixOperator || expr.kind == NodeKind::PostfixOperator)
+				{
+					auto &op = static_cast<Operator &>(expr);
+					auto sym = op.token(tokens).value;
+					if(sym != "++" && sym != "--") return nullptr;
+					step = sym == "++" ? 1 : -1;
+					return identifier(expr.kind == NodeKind::PrefixOperator
+					                  ? *static_cast<PrefixOperator &>(expr).operand
+					                  : *static_cast<PostfixOperator &>(expr).operand);
+				}
+				if(expr.kind != NodeKind::InfixOperator) return nullptr;
+
+				// v = v + c, v = c + v or v = v - c
+				auto &assignment = static_cast<InfixOperator &>(expr);
+				if(assignment.token(tokens).value != "=") return nullptr;
+				auto variable = identifier(*assignment.left);
+				auto &value = ungroup(*assignment.right);
+				if(!variable || value.kind != NodeKind::InfixOperator) return nullptr;
+
+				auto &op = static_cast<InfixOperator &>(value);
+				auto sym = op.token(tokens).value;
+				std::int64_t constant;
+				if(sym == "+" && same(variable, identifier(*op.left)) && integer_literal(*op.right, constant))
+					step = constant;
+				else if(sym == "+" && same(variable, identifier(*op.right)) && integer_literal(*op.left, constant))
+					step = constant;
+				else if(sym == "-" && same(variable, identifier(*op.left)) && integer_literal(*op.right, constant) && constant != INT64_MIN)
+					step = -constant;
+				else
+					return nullptr;
+				return variable;
+			}
+
+			std::vector<Induction> find_induction(Loop &loop) const
+			{
+				std::vector<Induction> found;
+				if(loop.node->body->kind != NodeKind::Block) return found;
+				const auto &statements = static_cast<Block &>(*loop.node->body).statements;
+
+				for(size_t i = 0; i < statements.size(); i++)
+				{
+					std::int64_t step;
+					auto variable = step_of(*statements[i], step);
+					if(!variable || step == 0 || !variable->symbol || !variable->symbol->node) continue;
+
+					auto target = variable->symbol->node;
+					if(target->kind != NodeKind::Identifier || loop.assigned.at(target) != 1 || loop.defined.count(target)) continue;
+					if(symbol_type(*variable) != DataType::Integer) continue;
+					if(loop.calls && globals.count(target)) continue;
+					found.push_back({ variable, step, i });
+				}
+				return found;
+			}
+
+			TokenIndex token(TokenType type, std::string_view value, const Loop &loop)
+			{
+				return context.add_token(type, value, loop.location);
+			}
+
+			std::unique_ptr<Expression> number(std::int64_t value, const Loop &loop)
+			{
+				return std::make_unique<NumberLiteral>(context.add_token(TokenType::Number, std::to_string(value), loop.location, constants.integer(value)));
+			}
+
+			std::unique_ptr<Expression> infix(std::string_view op, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right, const Loop &loop)
+			{
+				return std::make_unique<InfixOperator>(token(TokenType::Operator, op, loop), std::move(left), std::move(right));
+			}
+
+			static std::unique_ptr<Expression> reference(const Identifier &node)
+			{
+				return std::make_unique<Identifier>(node.token_index, node.symbol);
+			}
+
+			// replaces the remainders and products of the induction variables
+			// by a constant with counters
+			void reduce(Loop &loop, std::vector<std::unique_ptr<Statement>> &before)
+			{
+				auto inductions = find_induction(loop);
+				if(inductions.empty()) return;
+				stats.induction += inductions.size();
+
+				std::unordered_map<const Node *, const Induction *> by_variable;
+				for(const auto &induction : inductions)
+					by_variable[induction.variable->symbol->node] = &induction;
+
+				// counters by variable, operator and constant, and the
+				// statements that update them after each step
+				std::map<std::tuple<const Node *, char, std::int64_t>, Identifier *> counters;
+				std::map<size_t, std::vector<std::unique_ptr<Statement>>> updates;
+
+				for_each_slot(loop, [&](std::unique_ptr<Expression> &slot)
+				{
+					if(slot->kind != NodeKind::InfixOperator) return true;
+					auto &op = static_cast<InfixOperator &>(*slot);
+					auto sym = op.token(tokens).value;
+					if(sym != "%" && sym != "*") return true;
+
+					auto induction = [&](Expression &node) -> const Induction *
+					{
+						auto &bare = ungroup(node);
+						if(bare.kind != NodeKind::Identifier) return nullptr;
+						const auto &symbol = static_cast<Identifier &>(bare).symbol;
+						if(!symbol || !symbol->node) return nullptr;
+						auto found = by_variable.find(symbol->node);
+						return found == by_variable.end() ? nullptr : found->second;
+					};
+
+					const Induction *variable = induction(*op.left);
+					std::int64_t constant;
+					if(!variable || !integer_literal(*op.right, constant))
+					{
+						// a product either way round
+						if(sym != "*" || !(variable = induction(*op.right)) || !integer_literal(*op.left, constant))
+							return true;
+					}
+
+					// a remainder is only counted up, by less than it wraps at
+					std::int64_t delta;
+					if(sym == "%")
+					{
+						if(constant < 2 || variable->step <= 0 || variable->step >= constant) return true;
+						delta = variable->step;
+					}
+					else
+					{
+						delta = static_cast<std::int64_t>(static_cast<std::uint64_t>(variable->step) * static_cast<std::uint64_t>(constant));
+						if(constant == 0 || constant == 1 || delta == 0 || delta == INT64_MIN) return true;
+					}
+
+					auto key = std::make_tuple(variable->variable->symbol->node, sym[0], constant);
+					auto &counter = counters[key];
+					if(!counter)
+					{
+						// starts as what it replaces, computed in front of the loop
+						auto name = std::make_unique<Identifier>(variable->variable->token_index, nullptr);
+						name->symbol = std::make_shared<SymbolData>(nullptr, 0, name.get(), DataType::Integer);
+						counter = name.get();
+						auto replacement = reference(*counter);
+						before.push_back(std::make_unique<VariableDef>(std::move(name), nullptr, std::move(slot)));
+						slot = std::move(replacement);
+
+						auto &after = updates[variable->index];
+						auto add = delta > 0
+						           ? infix("+", reference(*counter), number(delta, loop), loop)
+						           : infix("-", reference(*counter), number(-delta, loop), loop);
+						after.push_back(std::make_unique<ExprStatement>(infix("=", reference(*counter), std::move(add), loop)));
+						if(sym == "%")
+						{
+							// the variable was negative or overflowed before the
+							// step, which only a division gets right; otherwise
+							// the sum is less than twice the constant
+							auto negative = infix("<", reference(*variable->variable), number(delta, loop), loop);
+							auto remainder = infix("%", reference(*variable->variable), number(constant, loop), loop);
+							auto divide = std::make_unique<ExprStatement>(infix("=", reference(*counter), std::move(remainder), loop));
+
+							auto wrapped = infix(">=", reference(*counter), number(constant, loop), loop);
+							auto subtract = infix("-", reference(*counter), number(constant, loop), loop);
+							auto wrap = std::make_unique<ExprStatement>(infix("=", reference(*counter), std::move(subtract), loop));
+							auto otherwise = std::make_unique<ExprStatement>(std::make_unique<IfExpr>(token(TokenType::Keyword, "if", loop), std::move(wrapped), std::move(wrap), no_token, nullptr));
+
+							after.push_back(std::make_unique<ExprStatement>(std::make_unique<IfExpr>(token(TokenType::Keyword, "if", loop), std::move(negative), std::move(divide), token(TokenType::Keyword, "else", loop), std::move(otherwise))));
+						}
+						stats.counters++;
+					}
+					else
+						slot = reference(*counter);
+
+					stats.reduced++;
+					return false;
+				});
+
+				// from the back, so the indices of the steps stay where they are
+				auto &statements = static_cast<Block &>(*loop.node->body).statements;
+				for(auto update = updates.rbegin(); update != updates.rend(); update++)
+				{
+					auto position = statements.begin() + update->first + 1;
+					statements.insert(position, std::make_move_iterator(update->second.begin()), std::make_move_iterator(update->second.end()));
+				}
+			}
+		};
+	}
+
+	LoopStats optimize_loops(const std::vector<Build::Unit> &units)
+	{
+		LoopStats stats;
+		for(const auto &unit : units)
+		{
+			auto program = unit.context.syntax_tree();
+			if(!program) continue;
+			LoopOptimizer optimizer(unit.context, stats);
+			optimizer.run(*program);
+		}
+		return stats;
+	}
+}
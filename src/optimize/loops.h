@@ -0,0 +1,42 @@
+#pragma once
+
+#include "build.h"
+
+#include <cstddef>
+
+namespace Optimize
+{
+	// what optimize_loops did
+	struct LoopStats
+	{
+		// while loops that are statements of their own, the only ones looked at
+		size_t loops = 0;
+		// definitions and expressions moved in front of their loop
+		size_t hoisted = 0;
+		// variables stepped by a constant once per iteration
+		size_t induction = 0;
+		// counters that replace a remainder or product of one
+		size_t counters = 0;
+		// expressions the counters replaced
+		size_t reduced = 0;
+	};
+
+	// Makes while loops do less work per iteration, innermost loops first.
+	//
+	// An expression in a loop that has no effects and reads only variables
+	// the loop cannot change is computed once in front of it, into a new
+	// variable; so is a definition directly in the body whose value is such
+	// an expression, if the loop never assigns it. A loop that calls a
+	// function of the program may change any variable of the top level, so
+	// those are not invariant in it.
+	//
+	// A variable of type Int that one statement directly in the body steps
+	// by a constant, and nothing else in the loop assigns, is an induction
+	// variable. Its remainders and products by a constant are kept in
+	// counters the statement after the step updates by an addition; a
+	// remainder is computed again whenever the counter wraps or the variable
+	// could be negative, so it is always what the division would give.
+	//
+	// The units must have been checked by the tree passes.
+	LoopStats optimize_loops(const std::vector<Build::Unit> &units);
+}
@@ -0,0 +1,16 @@
+#include "optimize.h"
+
+namespace Optimize
+{
+	Stats optimize(const std::vector<Build::Unit> &units, unsigned level)
+	{
+		Stats stats;
+		stats.level = level;
+		if(level == 0) return stats;
+
+		stats.inlined = inline_functions(units, level);
+		stats.loops = optimize_loops(units);
+		stats.removed = eliminate_dead_code(units);
+		return stats;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "build.h"
+#include "deadcode.h"
+#include "inliner.h"
+#include "loops.h"
+
+namespace Optimize
+{
+	// optimization level when none is given
+	constexpr unsigned default_level = 1;
+
+	// what every pass did
+	struct Stats
+	{
+		unsigned level = 0;
+		InlineStats inlined;
+		LoopStats loops;
+		DeadCodeStats removed;
+	};
+
+	// Runs the passes over the checked trees of a build before code
+	// generation: at level 1 and up, inlining, then the loop optimizations,
+	// then dead code elimination, which also removes the functions inlining
+	// left without callers. Level 0 leaves the trees as they are.
+	Stats optimize(const std::vector<Build::Unit> &units, unsigned level);
+}
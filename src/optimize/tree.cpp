@@ -0,0 +1,73 @@
+#include "tree.h"
+
+#include "lang.h"
+
+namespace Optimize
+{
+	namespace
+	{
+		bool nonzero_literal(Expression &node, const std::vector<Token> &tokens, const ConstantPool &constants)
+		{
+			auto expr = &node;
+			while(expr->kind == NodeKind::GroupExpr)
+				expr = static_cast<GroupExpr *>(expr)->expr.get();
+			if(expr->kind != NodeKind::NumberLiteral) return false;
+
+			const auto &constant = constants[static_cast<NumberLiteral *>(expr)->token(tokens).constant];
+			return constant.kind == Constant::Kind::Float ? constant.real != 0 : constant.integer != 0;
+		}
+	}
+
+	size_t count_nodes(Node &root)
+	{
+		size_t count = 0;
+		std::vector<Node *> stack = { &root };
+		while(!stack.empty())
+		{
+			auto node = stack.back();
+			stack.pop_back();
+			count++;
+			for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+		}
+		return count;
+	}
+
+	bool has_effects(Expression &root, const std::vector<Token> &tokens, const ConstantPool &constants)
+	{
+		std::vector<Node *> stack = { &root };
+		while(!stack.empty())
+		{
+			auto node = stack.back();
+			stack.pop_back();
+			switch(node->kind)
+			{
+				case NodeKind::FunctionCall:
+				case NodeKind::PostfixOperator:
+				case NodeKind::ReturnExpr:
+				case NodeKind::WhileExpr:
+				// in the branch of an if
+				case NodeKind::VariableDef:
+				case NodeKind::FunctionDef:
+					return true;
+				case NodeKind::PrefixOperator:
+				{
+					auto op = static_cast<PrefixOperator &>(*node).token(tokens).value;
+					if(op == "++" || op == "--") return true;
+					break;
+				}
+				case NodeKind::InfixOperator:
+				{
+					auto &op = static_cast<InfixOperator &>(*node);
+					auto sym = op.token(tokens).value;
+					if(Lang::is_assignment(sym)) return true;
+					if((sym == "/" || sym == "%") && !nonzero_literal(*op.right, tokens, constants)) return true;
+					break;
+				}
+				default:
+					break;
+			}
+			for_each_child(*node, [&](Node &child) { stack.push_back(&child); });
+		}
+		return false;
+	}
+}
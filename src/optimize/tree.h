@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ast/node.h"
+#include "syntax/constant.h"
+#include "syntax/token.h"
+
+#include <cstddef>
+#include <vector>
+
+// Walks over checked trees shared by the passes.
+namespace Optimize
+{
+	// calls function with every child of the node that is set, in source
+	// order
+	template<typename F>
+	void for_each_child(Node &node, F &&function)
+	{
+		auto visit = [&](Node *child)
+		{
+			if(child) function(*child);
+		};
+
+		switch(node.kind)
+		{
+			case NodeKind::Program:
+				for(const auto &stmt : static_cast<Program &>(node).statements)
+					visit(stmt.get());
+				break;
+			case NodeKind::Block:
+				for(const auto &stmt : static_cast<Block &>(node).statements)
+					visit(stmt.get());
+				break;
+			case NodeKind::ExprStatement:
+				visit(static_cast<ExprStatement &>(node).expr.get());
+				break;
+			case NodeKind::VariableDef:
+			{
+				auto &def = static_cast<VariableDef &>(node);
+				visit(def.name.get());
+				visit(def.type.get());
+				visit(def.value.get());
+				break;
+			}
+			case NodeKind::FunctionDef:
+			{
+				auto &def = static_cast<FunctionDef &>(node);
+				visit(def.name.get());
+				for(const auto &param : def.parameters)
+					visit(param.get());
+				visit(def.return_type.get());
+				visit(def.body.get());
+				break;
+			}
+			case NodeKind::Parameter:
+			{
+				auto &param = static_cast<Parameter &>(node);
+				visit(param.name.get());
+				visit(param.type.get());
+				break;
+			}
+			case NodeKind::FunctionCall:
+			{
+				auto &call = static_cast<FunctionCall &>(node);
+				visit(call.name.get());
+				for(const auto &arg : call.arguments)
+					visit(arg.get());
+				break;
+			}
+			case NodeKind::InfixOperator:
+				visit(static_cast<InfixOperator &>(node).left.get());
+				visit(static_cast<InfixOperator &>(node).right.get());
+				break;
+			case NodeKind::PrefixOperator:
+				visit(static_cast<PrefixOperator &>(node).operand.get());
+				break;
+			case NodeKind::PostfixOperator:
+				visit(static_cast<PostfixOperator &>(node).operand.get());
+				break;
+			case NodeKind::GroupExpr:
+				visit(static_cast<GroupExpr &>(node).expr.get());
+				break;
+			case NodeKind::ReturnExpr:
+				visit(static_cast<ReturnExpr &>(node).value.get());
+				break;
+			case NodeKind::IfExpr:
+			{
+				auto &expr = static_cast<IfExpr &>(node);
+				visit(expr.condition.get());
+				visit(expr.if_branch.get());
+				visit(expr.else_branch.get());
+				break;
+			}
+			case NodeKind::WhileExpr:
+				visit(static_cast<WhileExpr &>(node).condition.get());
+				visit(static_cast<WhileExpr &>(node).body.get());
+				break;
+			default:
+				break;
+		}
+	}
+
+	// of the subtree, the root included
+	size_t count_nodes(Node &root);
+
+	// whether evaluating the expression could change anything or stop the
+	// program; a while, a return and a definition in the branch of an if
+	// count as having effects, and so does a division by anything but a
+	// number literal other than zero
+	bool has_effects(Expression &root, const std::vector<Token> &tokens, const ConstantPool &constants);
+}
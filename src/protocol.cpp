@@ -0,0 +1,196 @@
+#include "protocol.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Server
+{
+	namespace
+	{
+		bool write_all(int fd, const char *data, size_t size)
+		{
+			while(size > 0)
+			{
+				auto n = ::send(fd, data, size, MSG_NOSIGNAL);
+				if(n < 0)
+				{
+					if(errno == EINTR) continue;
+					return false;
+				}
+				data += n;
+				size -= n;
+			}
+			return true;
+		}
+
+		bool read_all(int fd, char *data, size_t size)
+		{
+			while(size > 0)
+			{
+				auto n = ::recv(fd, data, size, 0);
+				if(n < 0 && errno == EINTR) continue;
+				if(n <= 0) return false;
+				data += n;
+				size -= n;
+			}
+			return true;
+		}
+
+		bool read_stdin(Buffer &buffer)
+		{
+			while(true)
+			{
+				if(buffer.size == buffer.capacity && !buffer.reserve(buffer.capacity ? buffer.capacity * 2 : 1 << 16))
+					return false;
+				auto n = ::read(STDIN_FILENO, buffer.data + buffer.size, buffer.capacity - buffer.size);
+				if(n < 0 && errno == EINTR) continue;
+				if(n < 0) return false;
+				if(n == 0) return true;
+				buffer.size += n;
+			}
+		}
+	}
+
+	Buffer::~Buffer()
+	{
+		std::free(data);
+	}
+
+	bool Buffer::reserve(std::uint32_t capacity)
+	{
+		if(capacity <= this->capacity) return true;
+		auto grown = static_cast<char *>(std::realloc(data, capacity));
+		if(!grown) return false;
+		data = grown;
+		this->capacity = capacity;
+		return true;
+	}
+
+	std::string_view Buffer::view() const
+	{
+		return std::string_view(data, size);
+	}
+
+	void default_socket(char *path, size_t size)
+	{
+		auto runtime = std::getenv("XDG_RUNTIME_DIR");
+		if(runtime && *runtime)
+			std::snprintf(path, size, "%s/cygnus.sock", runtime);
+		else
+			std::snprintf(path, size, "/tmp/cygnus-%u/cygnus.sock", static_cast<unsigned>(::geteuid()));
+	}
+
+	bool trusted(const char *path)
+	{
+		struct stat status;
+		return ::lstat(path, &status) == 0 && S_ISSOCK(status.st_mode) && status.st_uid == ::geteuid() && (status.st_mode & 077) == 0;
+	}
+
+	bool same_user(int fd)
+	{
+		ucred credentials;
+		socklen_t size = sizeof(credentials);
+		return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == ::geteuid();
+	}
+
+	int connect_to(const char *path)
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if(std::strlen(path) >= sizeof(address.sun_path)) return -1;
+		std::strcpy(address.sun_path, path);
+		if(!trusted(path)) return -1;
+
+		// the socket can still be replaced after it was looked at, but not
+		// the process that accepted the connection
+		int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if(fd < 0) return -1;
+		if(::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || !same_user(fd))
+		{
+			::close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	bool write_frame(int fd, Frame type, std::string_view data)
+	{
+		char header[5];
+		header[0] = static_cast<char>(type);
+		std::uint32_t length = data.size();
+		std::memcpy(header + 1, &length, sizeof(length));
+		return write_all(fd, header, sizeof(header)) && write_all(fd, data.data(), data.size());
+	}
+
+	bool read_frame(int fd, Frame &type, Buffer &data)
+	{
+		char header[5];
+		if(!read_all(fd, header, sizeof(header))) return false;
+		type = static_cast<Frame>(header[0]);
+		std::uint32_t length;
+		std::memcpy(&length, header + 1, sizeof(length));
+		if(!data.reserve(length)) return false;
+		data.size = length;
+		return read_all(fd, data.data, length);
+	}
+
+	int forward(const char *path, const std::string_view *args, size_t count)
+	{
+		if(::access(path, F_OK) == 0 && !trusted(path))
+			std::fprintf(stderr, "cygnus: not using '%s', which is not a socket only this user can use\n", path);
+		int fd = connect_to(path);
+		if(fd < 0) return -1;
+
+		char directory[PATH_MAX];
+		bool sent = ::getcwd(directory, sizeof(directory)) && write_frame(fd, Frame::Directory, directory);
+		bool input = false;
+		for(size_t i = 0; i < count; i++)
+		{
+			sent = sent && write_frame(fd, Frame::Argument, args[i]);
+			if(args[i] == "-" && !input)
+			{
+				input = true;
+				Buffer source;
+				sent = sent && read_stdin(source) && write_frame(fd, Frame::Input, source.view());
+			}
+		}
+		sent = sent && write_frame(fd, Frame::End, "");
+		if(!sent)
+		{
+			::close(fd);
+			return -1;
+		}
+
+		int status = 1;
+		Frame type = Frame::End;
+		Buffer data;
+		while(read_frame(fd, type, data))
+		{
+			if(type == Frame::Output)
+			{
+				std::fwrite(data.data, 1, data.size, stdout);
+			}
+			else if(type == Frame::Status)
+			{
+				status = 0;
+				for(auto c : data.view())
+					status = status * 10 + (c - '0');
+				break;
+			}
+		}
+		std::fflush(stdout);
+		if(type != Frame::Status)
+			std::fputs("cygnus: lost the connection to the server\n", stderr);
+
+		::close(fd);
+		return status;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// The wire format between 'cygnus serve' and its clients. Every message is a
+// frame: a type byte, a 32-bit length and that many bytes. A request is a
+// Directory frame, one Argument frame per argument, an Input frame with stdin
+// if an argument is '-', and an End frame. The response is any number of
+// Output frames followed by a Status frame.
+//
+// Only libc is used here, so the thin client can be built without loading the
+// compiler library or the C++ runtime.
+namespace Server
+{
+	enum class Frame : char
+	{
+		// request
+		Directory = 'd',
+		Argument = 'a',
+		Input = 'i',
+		End = 'e',
+		// response
+		Output = 'o',
+		Status = 's'
+	};
+
+	// grows as needed; owns its memory
+	struct Buffer
+	{
+		char *data = nullptr;
+		std::uint32_t size = 0, capacity = 0;
+
+		Buffer() = default;
+		Buffer(const Buffer &) = delete;
+		Buffer &operator=(const Buffer &) = delete;
+		~Buffer();
+
+		bool reserve(std::uint32_t capacity);
+		std::string_view view() const;
+	};
+
+	// $XDG_RUNTIME_DIR/cygnus.sock, or cygnus.sock in /tmp/cygnus-<uid>, which
+	// the server creates for only the user to enter
+	void default_socket(char *path, size_t size);
+
+	// whether path is a socket owned by this user that no one else can
+	// connect to; nothing is sent to any other
+	bool trusted(const char *path);
+
+	// whether the process at the other end of a connection runs as this user
+	bool same_user(int fd);
+
+	// returns -1 if nothing this user trusts listens at path
+	int connect_to(const char *path);
+
+	bool write_frame(int fd, Frame type, std::string_view data);
+	bool read_frame(int fd, Frame &type, Buffer &data);
+
+	// runs args in the server listening at path and copies its output to stdout;
+	// returns the exit status, or -1 if no server is listening
+	int forward(const char *path, const std::string_view *args, size_t count);
+}
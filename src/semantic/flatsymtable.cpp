@@ -0,0 +1,290 @@
+#include "flatsymtable.h"
+
+#include "prelude.h"
+
+FlatSymbolTable::FlatSymbolTable(const FlatTree &tree, Util::DiagnosticEngine &diagnostics, const ModuleImports *imports)
+	: FlatVisitor(tree),
+	  symbols(tree.size(), no_node),
+	  scope_level(0),
+	  diagnostics(diagnostics),
+	  error(false),
+	  imports(imports),
+	  str(tree)
+{
+}
+
+bool FlatSymbolTable::failed() const
+{
+	return error;
+}
+
+size_t FlatSymbolTable::operations() const
+{
+	return steps;
+}
+
+void FlatSymbolTable::enter_scope()
+{
+	scope_begin.push_back(defined.size());
+	scope_level++;
+	tab_level++;
+}
+
+void FlatSymbolTable::exit_scope()
+{
+	// delete entries at current level
+	for(auto i = scope_begin.back(); i < defined.size(); i++)
+	{
+		steps++;
+		auto it = scopes.find(defined[i]);
+		it->second.pop_back();
+		if(it->second.empty())
+			scopes.erase(it);
+	}
+	defined.resize(scope_begin.back());
+	scope_begin.pop_back();
+
+	scope_level--;
+	tab_level--;
+}
+
+void FlatSymbolTable::define(NodeId id)
+{
+	const auto &token = tree.token(id, 0);
+	auto name = token.value;
+	TRACE(print("Define '", name, "' = ", str.stringify(id)));
+
+	steps++;
+	auto &entries = scopes[name];
+	if(!entries.empty() && entries.back().scope_level == scope_level)
+	{
+		error = true;
+		diagnostics.report_at(
+		    token,
+		    Util::DiagnosticCode::AlreadyDefined,
+		    name
+		);
+		return;
+	}
+
+	entries.push_back({ scope_level, id, nullptr });
+	defined.push_back(name);
+}
+
+NodeId FlatSymbolTable::find(NodeId id)
+{
+	const auto &token = tree.token(id, 0);
+	auto name = token.value;
+
+	steps++;
+	auto it = scopes.find(name);
+	if(it == scopes.end())
+	{
+		// typed like an imported name, without a defining node
+		if(auto builtin = Prelude::find(name))
+		{
+			TRACE(print("Find '", name, "' -> builtin"));
+			imported.insert_or_assign(id, builtin->type);
+			return no_node;
+		}
+
+		TRACE(print("Find '", name, "' -> undefined"));
+		error = true;
+		diagnostics.report_at(
+		    token,
+		    Util::DiagnosticCode::NotDefined,
+		    name
+		);
+		return no_node;
+	}
+
+	const auto &entry = it->second.back();
+	if(entry.type) imported.insert_or_assign(id, *entry.type);
+	auto node = entry.node;
+	TRACE(print("Find '", name, "' -> ", str.stringify(node)));
+	return node;
+}
+
+// main
+
+void FlatSymbolTable::visit(Flat::Program node)
+{
+	for(auto stmt : node.statements())
+	{
+		dispatch(stmt);
+	}
+}
+
+// statements
+
+void FlatSymbolTable::visit(Flat::ExprStatement node)
+{
+	dispatch(node.expr());
+}
+void FlatSymbolTable::visit(Flat::VariableDef node)
+{
+	if(node.value() != no_node) dispatch(node.value());
+	define(node.name());
+}
+void FlatSymbolTable::visit(Flat::FunctionDef node)
+{
+	define(node.name());
+	enter_scope();
+	for(auto param : node.parameters())
+	{
+		dispatch(param);
+	}
+	for(auto stmt : Flat::Block { tree, node.body() }.statements())
+	{
+		dispatch(stmt);
+	}
+	exit_scope();
+}
+
+void FlatSymbolTable::visit(Flat::Import node)
+{
+	if(scope_level > 0)
+	{
+		error = true;
+		diagnostics.report_at(node.import_keyword(), Util::DiagnosticCode::ImportNotTopLevel);
+		return;
+	}
+
+	auto module = node.name().value;
+	auto it = imports ? imports->find(module) : ModuleImports::const_iterator();
+	if(!imports || it == imports->end())
+	{
+		error = true;
+		diagnostics.report_at(node.name(), Util::DiagnosticCode::ModuleNotFound, module);
+		return;
+	}
+
+	for(const auto &symbol : it->second->exports)
+	{
+		std::string_view name = symbol.name;
+		TRACE(print("Define '", name, "' = ", str.stringify(node.id)));
+
+		steps++;
+		auto &entries = scopes[name];
+		if(!entries.empty())
+		{
+			error = true;
+			diagnostics.report_at(node.name(), Util::DiagnosticCode::ImportConflict, name, module);
+			continue;
+		}
+
+		entries.push_back({ scope_level, node.id, &symbol.type });
+		defined.push_back(name);
+	}
+}
+
+// expressions
+
+void FlatSymbolTable::visit(Flat::NumberLiteral node) {}
+void FlatSymbolTable::visit(Flat::StringLiteral node) {}
+void FlatSymbolTable::visit(Flat::BooleanLiteral node) {}
+void FlatSymbolTable::visit(Flat::UnitLiteral node) {}
+void FlatSymbolTable::visit(Flat::Identifier node)
+{
+	symbols[node.id] = find(node.id);
+}
+void FlatSymbolTable::visit(Flat::FunctionCall node)
+{
+	resolve_nested(node.id);
+}
+void FlatSymbolTable::visit(Flat::InfixOperator node)
+{
+	resolve_nested(node.id);
+}
+void FlatSymbolTable::visit(Flat::PrefixOperator node)
+{
+	resolve_nested(node.id);
+}
+void FlatSymbolTable::visit(Flat::PostfixOperator node)
+{
+	resolve_nested(node.id);
+}
+void FlatSymbolTable::visit(Flat::GroupExpr node)
+{
+	resolve_nested(node.id);
+}
+void FlatSymbolTable::visit(Flat::ReturnExpr node)
+{
+	if(node.value() != no_node) dispatch(node.value());
+}
+void FlatSymbolTable::visit(Flat::IfExpr node)
+{
+	dispatch(node.condition());
+	dispatch(node.if_branch());
+	if(node.else_branch() != no_node) dispatch(node.else_branch());
+}
+void FlatSymbolTable::visit(Flat::WhileExpr node)
+{
+	dispatch(node.condition());
+	dispatch(node.body());
+}
+
+// general
+
+void FlatSymbolTable::visit(Flat::Invalid node) {}
+void FlatSymbolTable::visit(Flat::Block node)
+{
+	enter_scope();
+	for(auto stmt : node.statements())
+	{
+		dispatch(stmt);
+	}
+	exit_scope();
+}
+void FlatSymbolTable::visit(Flat::Parameter node)
+{
+	define(node.name());
+}
+void FlatSymbolTable::visit(Flat::Type node) {}
+
+// operator chains, groups and calls can nest arbitrarily deep, so they are
+// walked with an explicit stack; operands are resolved left to right as before
+void FlatSymbolTable::resolve_nested(NodeId root)
+{
+	std::vector<NodeId> stack = { root };
+
+	while(!stack.empty())
+	{
+		auto id = stack.back();
+		stack.pop_back();
+
+		switch(tree.kinds[id])
+		{
+			case NodeKind::InfixOperator:
+			{
+				Flat::InfixOperator op{ tree, id };
+				stack.push_back(op.right());
+				stack.push_back(op.left());
+				break;
+			}
+			case NodeKind::PrefixOperator:
+				stack.push_back(Flat::PrefixOperator{ tree, id }.operand());
+				break;
+			case NodeKind::PostfixOperator:
+				stack.push_back(Flat::PostfixOperator{ tree, id }.operand());
+				break;
+			case NodeKind::GroupExpr:
+				stack.push_back(Flat::GroupExpr{ tree, id }.expr());
+				break;
+			case NodeKind::FunctionCall:
+			{
+				Flat::FunctionCall call{ tree, id };
+				auto arguments = call.arguments();
+				for(auto arg = arguments.end(); arg != arguments.begin();)
+				{
+					stack.push_back(*--arg);
+				}
+				stack.push_back(call.name());
+				break;
+			}
+			default:
+				dispatch(id);
+				break;
+		}
+	}
+}
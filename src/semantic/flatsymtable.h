@@ -0,0 +1,66 @@
+#pragma once
+
+#include "log.h"
+#include "util/flatstringifier.h"
+#include "util/diagnostic.h"
+#include "ast/flat.h"
+#include "semantic/module.h"
+
+#include <unordered_map>
+#include <vector>
+
+// SymbolTable over a FlatTree; resolutions are stored by node id instead of
+// in Identifier::symbol
+class FlatSymbolTable : public FlatVisitor<FlatSymbolTable>
+{
+public:
+#include "ast/flatincl"
+
+	FlatSymbolTable(const FlatTree &tree, Util::DiagnosticEngine &diagnostics, const ModuleImports *imports = nullptr);
+	bool failed() const;
+
+	void enter_scope();
+	void exit_scope();
+	void define(NodeId id);
+	NodeId find(NodeId id);
+
+	// scope entries looked up, added or removed so far
+	size_t operations() const;
+
+	// defining Identifier of every resolved Identifier, no_node elsewhere;
+	// the Import for an imported name, no_node for a built-in function
+	std::vector<NodeId> symbols;
+	// type of every Identifier that resolved to an imported name or a
+	// built-in function
+	std::unordered_map<NodeId, DataType> imported;
+
+private:
+	struct Entry
+	{
+		unsigned scope_level;
+		NodeId node;
+		// of an imported name, null otherwise
+		const DataType *type;
+	};
+	// innermost definition last
+	std::unordered_map<std::string_view, std::vector<Entry>> scopes;
+	// names defined in the open scopes, and where each scope's names begin
+	std::vector<std::string_view> defined;
+	std::vector<size_t> scope_begin;
+	unsigned scope_level;
+	size_t steps = 0;
+
+	Util::DiagnosticEngine &diagnostics;
+	bool error;
+	const ModuleImports *imports;
+
+	void resolve_nested(NodeId root);
+
+	Util::FlatStringifier str;
+	unsigned tab_level = 0;
+	template<typename... Args>
+	inline void print(Args &&... args) const
+	{
+		Logger::get().debug(std::string(3 * tab_level, ' '), std::forward<Args>(args)...);
+	}
+};
@@ -0,0 +1,601 @@
+#include "flattypecheck.h"
+
+#include "rules.h"
+#include "lang.h"
+
+#include <algorithm>
+
+FlatTypeChecker::FlatTypeChecker(const FlatTree &tree, const std::vector<NodeId> &symbols, Util::DiagnosticEngine &diagnostics, const ConstantPool &constants, const std::unordered_map<NodeId, DataType> *imported)
+	: FlatVisitor(tree),
+	  symbols(symbols),
+	  imported(imported),
+	  diagnostics(diagnostics),
+	  constants(constants),
+	  error(false),
+	  str(tree)
+{
+}
+
+bool FlatTypeChecker::failed() const
+{
+	return error;
+}
+
+// operator chains, groups and calls can nest arbitrarily deep, so they are checked with an
+// explicit stack, in the same order as TypeChecker::check_nested
+DataType FlatTypeChecker::check_nested(NodeId root)
+{
+	struct Frame
+	{
+		NodeId id;
+		// 0 before the operands are queued; for calls, 1 + number of checked arguments
+		size_t stage;
+	};
+	std::vector<Frame> stack = { { root, 0 } };
+	std::vector<DataType> types, signatures;
+
+	auto pop = [&types]()
+	{
+		auto type = std::move(types.back());
+		types.pop_back();
+		return type;
+	};
+
+	while(!stack.empty())
+	{
+		auto id = stack.back().id;
+		auto stage = stack.back().stage++;
+
+		switch(tree.kinds[id])
+		{
+			case NodeKind::InfixOperator:
+			{
+				Flat::InfixOperator op{ tree, id };
+				if(stage == 0)
+				{
+					TRACE(print(stringify(id)));
+					tab_level++;
+					stack.push_back({ op.right(), 0 });
+					stack.push_back({ op.left(), 0 });
+					continue;
+				}
+
+				auto right_type = pop();
+				auto left_type = pop();
+				auto type = check_infix(op, left_type, right_type);
+
+				tab_level--;
+				TRACE(print(": ", type));
+				types.push_back(type);
+				break;
+			}
+			case NodeKind::PrefixOperator:
+			{
+				Flat::PrefixOperator op{ tree, id };
+				if(stage == 0)
+				{
+					TRACE(print(stringify(id)));
+					tab_level++;
+					stack.push_back({ op.operand(), 0 });
+					continue;
+				}
+
+				auto type = check_prefix(op, pop());
+
+				tab_level--;
+				TRACE(print(": ", type));
+				types.push_back(type);
+				break;
+			}
+			case NodeKind::PostfixOperator:
+			{
+				Flat::PostfixOperator op{ tree, id };
+				if(stage == 0)
+				{
+					TRACE(print(stringify(id)));
+					tab_level++;
+					stack.push_back({ op.operand(), 0 });
+					continue;
+				}
+
+				auto type = check_postfix(op, pop());
+
+				tab_level--;
+				TRACE(print(": ", type));
+				types.push_back(type);
+				break;
+			}
+			case NodeKind::GroupExpr:
+			{
+				// the operand's type is passed through
+				if(stage == 0)
+				{
+					stack.push_back({ Flat::GroupExpr{ tree, id }.expr(), 0 });
+					continue;
+				}
+				break;
+			}
+			case NodeKind::FunctionCall:
+			{
+				Flat::FunctionCall call{ tree, id };
+				auto name = call.name();
+				auto arguments = call.arguments();
+				if(stage == 0)
+				{
+					TRACE(print(stringify(id)));
+					tab_level++;
+
+					auto signature = dispatch(name);
+					if(!signature.is_function)
+					{
+						error = true;
+						report(
+						    name,
+						    Util::DiagnosticCode::CallToNonFunction,
+						    tree.token(name, 0).value
+						);
+
+						tab_level--;
+						TRACE(print(": ", DataType::Invalid));
+						types.push_back(DataType::Invalid);
+						break;
+					}
+
+					if(arguments.size() != signature.parameter_types.size())
+					{
+						error = true;
+						report(
+						    id,
+						    Util::DiagnosticCode::ArgumentCount,
+						    tree.token(name, 0).value, signature.parameter_types.size(), arguments.size()
+						);
+					}
+
+					signatures.push_back(signature);
+					continue;
+				}
+
+				const auto &signature = signatures.back();
+				auto count = std::min(arguments.size(), signature.parameter_types.size());
+				auto checked = stage - 1;
+
+				if(checked > 0)
+				{
+					auto i = checked - 1;
+					auto arg = pop();
+					auto param = signature.parameter_types[i];
+
+					if(arg != DataType::Invalid && param != DataType::Invalid && arg != param)
+					{
+						error = true;
+						report(
+						    arguments[i],
+						    Util::DiagnosticCode::ArgumentType,
+						    tree.token(name, 0).value, param, arg
+						);
+					}
+				}
+
+				if(checked < count)
+				{
+					stack.push_back({ arguments[checked], 0 });
+					continue;
+				}
+
+				auto type = DataType::Variable(signature.value);
+				signatures.pop_back();
+
+				tab_level--;
+				TRACE(print(": ", type));
+				types.push_back(type);
+				break;
+			}
+			default:
+				types.push_back(dispatch(id));
+				break;
+		}
+
+		stack.pop_back();
+	}
+
+	return types.back();
+}
+
+DataType FlatTypeChecker::check_infix(Flat::InfixOperator op, const DataType &left_type, const DataType &right_type)
+{
+	auto sym = op.token().value;
+
+	if(Lang::is_assignment(sym) && tree.kinds[op.left()] != NodeKind::Identifier)
+	{
+		error = true;
+		report(
+		    op.left(),
+		    Util::DiagnosticCode::NotAssignable
+		);
+		return DataType::Invalid;
+	}
+
+	auto type = Rules::infix(sym, left_type, right_type);
+
+	if(type == DataType::Invalid && left_type != DataType::Invalid && right_type != DataType::Invalid)
+	{
+		error = true;
+		report(
+		    op.id,
+		    Util::DiagnosticCode::OperatorTypes,
+		    left_type, right_type, sym
+		);
+	}
+	return type;
+}
+
+DataType FlatTypeChecker::check_prefix(Flat::PrefixOperator op, const DataType &operand_type)
+{
+	auto sym = op.token().value;
+	auto type = Rules::prefix(sym, operand_type);
+
+	if(type == DataType::Invalid && operand_type != DataType::Invalid)
+	{
+		error = true;
+		report(
+		    op.id,
+		    Util::DiagnosticCode::OperatorType,
+		    operand_type, sym
+		);
+	}
+	return type;
+}
+
+DataType FlatTypeChecker::check_postfix(Flat::PostfixOperator op, const DataType &operand_type)
+{
+	auto sym = op.token().value;
+	auto type = Rules::postfix(sym, operand_type);
+
+	if(type == DataType::Invalid && operand_type != DataType::Invalid)
+	{
+		error = true;
+		report(
+		    op.id,
+		    Util::DiagnosticCode::OperatorType,
+		    operand_type, sym
+		);
+	}
+	return type;
+}
+
+void FlatTypeChecker::check_condition(NodeId condition)
+{
+	auto condition_type = dispatch(condition);
+	if(condition_type != DataType::Invalid && condition_type != DataType::Boolean)
+	{
+		error = true;
+		report(
+		    condition,
+		    Util::DiagnosticCode::ConditionType,
+		    DataType::Boolean, condition_type
+		);
+	}
+}
+
+// main
+
+DataType FlatTypeChecker::visit(Flat::Program node)
+{
+	for(auto stmt : node.statements())
+	{
+		dispatch(stmt);
+	}
+
+	return DataType::Invalid;
+}
+
+// statements
+
+DataType FlatTypeChecker::visit(Flat::ExprStatement node)
+{
+	TRACE(print(stringify(node.id)));
+	tab_level++;
+
+	auto type = dispatch(node.expr());
+
+	tab_level--;
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::VariableDef node)
+{
+	TRACE(print(stringify(node.id)));
+	tab_level++;
+
+	auto variable_type = node.type() != no_node
+	                     ? dispatch(node.type())
+	                     : dispatch(node.value());
+
+	auto type = variable_type;
+
+	if(node.type() != no_node && node.value() != no_node)
+	{
+		auto inferred_type = dispatch(node.value());
+		if(variable_type != DataType::Invalid && inferred_type != DataType::Invalid && variable_type != inferred_type)
+		{
+			error = true;
+			report(
+			    node.name(),
+			    Util::DiagnosticCode::InferredType,
+			    inferred_type, variable_type
+			);
+		}
+
+		type = variable_type != DataType::Invalid
+		       ? variable_type
+		       : inferred_type;
+	}
+
+	symbol_types.insert_or_assign(node.name(), type);
+
+	tab_level--;
+	TRACE(print(": ", type));
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::FunctionDef node)
+{
+	TRACE(print(stringify(node.id)));
+	tab_level++;
+
+	std::vector<DataType> parameter_types;
+
+	for(auto param : node.parameters())
+	{
+		auto param_type = dispatch(param);
+		symbol_types.insert_or_assign(Flat::Parameter { tree, param }.name(), param_type);
+		parameter_types.push_back(param_type);
+	}
+
+	auto return_type = node.return_type() != no_node
+	                   ? dispatch(node.return_type())
+	                   : DataType::Unit;
+
+	auto _type = DataType::Function(return_type, parameter_types);
+
+	symbol_types.insert_or_assign(node.name(), _type);
+
+	auto body_return_type = dispatch(node.body());
+	if(body_return_type != DataType::Invalid && return_type != DataType::Invalid && body_return_type != return_type)
+	{
+		error = true;
+		report(
+		    node.name(),
+		    Util::DiagnosticCode::ReturnType,
+		    body_return_type, return_type
+		);
+	}
+
+	tab_level--;
+	TRACE(print(": ", _type));
+	return _type;
+}
+
+DataType FlatTypeChecker::visit(Flat::Import node)
+{
+	TRACE(print(stringify(node.id)));
+	return DataType::Unit;
+}
+
+// expressions
+
+DataType FlatTypeChecker::visit(Flat::NumberLiteral node)
+{
+	auto type = constants[node.token().constant].kind == Constant::Kind::Float
+	            ? DataType::Float
+	            : DataType::Integer;
+
+	TRACE(print(stringify(node.id), " : ", type));
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::StringLiteral node)
+{
+	auto type = DataType::String;
+
+	TRACE(print(stringify(node.id), " : ", type));
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::BooleanLiteral node)
+{
+	auto type = DataType::Boolean;
+
+	TRACE(print(stringify(node.id), " : ", type));
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::UnitLiteral node)
+{
+	auto type = DataType::Unit;
+
+	TRACE(print(stringify(node.id), " : ", type));
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::Identifier node)
+{
+	// imported name, typed by its module, or built-in function
+	if(imported)
+	{
+		auto import = imported->find(node.id);
+		if(import != imported->end())
+		{
+			TRACE(print(stringify(node.id), " : ", import->second));
+			return import->second;
+		}
+	}
+
+	// defining identifier
+	auto it = symbol_types.find(node.id);
+	if(it != symbol_types.end())
+	{
+		auto type = it->second;
+		if(type.is_function || type != DataType::Invalid)
+		{
+			TRACE(print(stringify(node.id), " : ", type));
+			return type;
+		}
+	}
+	// reference
+	else if(symbols[node.id] != no_node)
+	{
+		TRACE(print(stringify(node.id)));
+		tab_level++;
+
+		auto type = dispatch(symbols[node.id]);
+
+		tab_level--;
+		TRACE(print(": ", type));
+		return type;
+	}
+
+	return DataType::Invalid;
+}
+DataType FlatTypeChecker::visit(Flat::FunctionCall node)
+{
+	return check_nested(node.id);
+}
+
+DataType FlatTypeChecker::visit(Flat::InfixOperator node)
+{
+	return check_nested(node.id);
+}
+DataType FlatTypeChecker::visit(Flat::PrefixOperator node)
+{
+	return check_nested(node.id);
+}
+DataType FlatTypeChecker::visit(Flat::PostfixOperator node)
+{
+	return check_nested(node.id);
+}
+DataType FlatTypeChecker::visit(Flat::GroupExpr node)
+{
+	return check_nested(node.id);
+}
+DataType FlatTypeChecker::visit(Flat::ReturnExpr node)
+{
+	TRACE(print(stringify(node.id)));
+	tab_level++;
+
+	auto type = node.value() != no_node
+	            ? dispatch(node.value())
+	            : DataType::Unit;
+
+	tab_level--;
+	TRACE(print(": ", type));
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::IfExpr node)
+{
+	TRACE(print(stringify(node.id)));
+	tab_level++;
+
+	check_condition(node.condition());
+
+	auto if_type = dispatch(node.if_branch());
+	auto _type = if_type;
+
+	if(node.else_branch() != no_node)
+	{
+		auto else_type = dispatch(node.else_branch());
+		if(if_type != else_type)
+		{
+			_type = DataType::Invalid;
+			error = true;
+			report(
+			    node.id,
+			    Util::DiagnosticCode::BranchTypes,
+			    if_type, else_type
+			);
+		}
+	}
+
+	tab_level--;
+	TRACE(print(": ", _type));
+	return _type;
+}
+DataType FlatTypeChecker::visit(Flat::WhileExpr node)
+{
+	TRACE(print(stringify(node.id)));
+	tab_level++;
+
+	check_condition(node.condition());
+
+	dispatch(node.body());
+
+	auto type = DataType::Unit;
+
+	tab_level--;
+	TRACE(print(": ", type));
+	return type;
+}
+
+// general
+
+DataType FlatTypeChecker::visit(Flat::Invalid node)
+{
+	auto type = DataType::Invalid;
+
+	TRACE(print(stringify(node.id), " : ", type));
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::Block node)
+{
+	auto return_type = DataType::Unit;
+	auto statements = node.statements();
+
+	if(statements.empty())
+	{
+		TRACE(print(stringify(node.id), " : ", return_type));
+		return return_type;
+	}
+
+	TRACE(print(stringify(node.id)));
+	tab_level++;
+
+	bool found = false;
+	for(auto stmt : statements)
+	{
+		// find return expression
+		if(tree.kinds[stmt] == NodeKind::ExprStatement && tree.kinds[tree.child(stmt, 0)] == NodeKind::ReturnExpr)
+		{
+			if(!found)
+				return_type = dispatch(tree.child(stmt, 0));
+			else dispatch(stmt);
+			found = true;
+		}
+		else dispatch(stmt);
+	}
+
+	tab_level--;
+	TRACE(print(": ", return_type));
+	return return_type;
+}
+DataType FlatTypeChecker::visit(Flat::Parameter node)
+{
+	TRACE(print(stringify(node.id)));
+	tab_level++;
+
+	auto type = dispatch(node.type());
+
+	tab_level--;
+	TRACE(print(": ", type));
+	return type;
+}
+DataType FlatTypeChecker::visit(Flat::Type node)
+{
+	auto type = Rules::named(node.token().value);
+
+	if(type == DataType::Invalid)
+	{
+		error = true;
+		report(
+		    node.id,
+		    Util::DiagnosticCode::InvalidType,
+		    node.token().value
+		);
+	}
+
+	TRACE(print(stringify(node.id), " : ", type));
+	return type;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "log.h"
+#include "util/flatnoderange.h"
+#include "util/flatstringifier.h"
+#include "util/diagnostic.h"
+#include "ast/flat.h"
+#include "semantic/type.h"
+#include "syntax/constant.h"
+
+#include <unordered_map>
+#include <vector>
+
+// TypeChecker over a FlatTree, using the resolutions of a FlatSymbolTable
+class FlatTypeChecker : public FlatVisitor<FlatTypeChecker, DataType>
+{
+public:
+#include "ast/flatincl"
+
+	// imported holds the type of every Identifier that resolved to an import
+	// or a built-in function
+	FlatTypeChecker(const FlatTree &tree, const std::vector<NodeId> &symbols, Util::DiagnosticEngine &diagnostics, const ConstantPool &constants, const std::unordered_map<NodeId, DataType> *imported = nullptr);
+	bool failed() const;
+
+	// type of every defining Identifier that has been checked
+	std::unordered_map<NodeId, DataType> symbol_types;
+
+private:
+	const std::vector<NodeId> &symbols;
+	const std::unordered_map<NodeId, DataType> *imported;
+
+	Util::DiagnosticEngine &diagnostics;
+	const ConstantPool &constants;
+	bool error;
+
+	DataType check_nested(NodeId root);
+	DataType check_infix(Flat::InfixOperator op, const DataType &left_type, const DataType &right_type);
+	DataType check_prefix(Flat::PrefixOperator op, const DataType &operand_type);
+	DataType check_postfix(Flat::PostfixOperator op, const DataType &operand_type);
+	void check_condition(NodeId condition);
+
+	// reports over the range of a node, as DiagnosticEngine does for Node
+	template<typename... Args>
+	void report(NodeId id, Util::DiagnosticCode code, Args &&... args)
+	{
+		Util::FlatNodeRange range(tree, id);
+		diagnostics.report(range.begin, range.end, code, std::forward<Args>(args)...);
+	}
+
+	Util::FlatStringifier str;
+	unsigned tab_level = 0;
+	template<typename... Args>
+	inline void print(Args &&... args) const
+	{
+		Logger::get().debug(std::string(3 * tab_level, ' '), std::forward<Args>(args)...);
+	}
+	std::string stringify(NodeId id)
+	{
+		return str.stringify(id);
+	}
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "semantic/type.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// What a module offers to the modules that import it: the name and type of
+// each top-level definition. Importers are checked against these alone, so a
+// module's bodies are never checked again for its dependents.
+struct ModuleSummary
+{
+	struct Export
+	{
+		std::string name;
+		DataType type;
+	};
+	std::vector<Export> exports;
+};
+
+// summaries of the modules a source may import, by the name it imports them
+// with; an import of a name missing here is reported as not found
+using ModuleImports = std::unordered_map<std::string_view, const ModuleSummary *>;
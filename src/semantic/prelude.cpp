@@ -0,0 +1,36 @@
+#include "prelude.h"
+
+#include <vector>
+
+namespace Prelude
+{
+	const ModuleSummary &summary()
+	{
+		static const ModuleSummary prelude =
+		{
+			{
+				// writes the string and a line break to the standard output
+				{ "print", DataType::Function(DataType::Unit, { DataType::String }) }
+			}
+		};
+		return prelude;
+	}
+
+	std::shared_ptr<SymbolData> find(std::string_view name)
+	{
+		static const auto symbols = []()
+		{
+			std::vector<std::shared_ptr<SymbolData>> result;
+			for(const auto &builtin : summary().exports)
+				result.push_back(std::make_shared<SymbolData>(nullptr, 0, nullptr, builtin.type));
+			return result;
+		}();
+
+		const auto &exports = summary().exports;
+		for(size_t i = 0; i < exports.size(); i++)
+		{
+			if(exports[i].name == name) return symbols[i];
+		}
+		return nullptr;
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "semantic/module.h"
+#include "semantic/symdata.h"
+
+#include <memory>
+#include <string_view>
+
+// Functions every module can call without defining or importing them. A
+// definition or import of the same name hides them, as if they were defined
+// in a scope around the top level. Their symbols have no node.
+namespace Prelude
+{
+	// the built-in functions and their types
+	const ModuleSummary &summary();
+	// null if there is no built-in function by that name
+	std::shared_ptr<SymbolData> find(std::string_view name);
+}
@@ -0,0 +1,76 @@
+#include "rules.h"
+
+#include "lang.h"
+
+namespace Rules
+{
+	DataType infix(std::string_view op, const DataType &left, const DataType &right)
+	{
+		if(Lang::is_arithmetic(op))
+		{
+			if(left == right && right == DataType::Integer)
+				return DataType::Integer;
+			else if(left == right && right == DataType::Float && op != "%")
+				return DataType::Float;
+			else if(op == "+" && (left == DataType::String || right == DataType::String))
+				return DataType::String;
+		}
+		else if(Lang::is_assignment(op))
+		{
+			if(left == right)
+				return left;
+		}
+		else if(Lang::is_boolean_op(op))
+		{
+			if(left == right)
+			{
+				if(op == "==" || op == "!=")
+					return DataType::Boolean;
+				else if((right == DataType::Integer || right == DataType::Float) && (op == ">" || op == ">=" || op == "<" || op == "<="))
+					return DataType::Boolean;
+				else if(right == DataType::Boolean)
+					return DataType::Boolean;
+			}
+		}
+
+		return DataType::Invalid;
+	}
+
+	DataType prefix(std::string_view op, const DataType &operand)
+	{
+		if(Lang::is_arithmetic(op))
+		{
+			if(operand == DataType::Integer || (operand == DataType::Float && op == "-"))
+				return operand;
+		}
+		else if(Lang::is_boolean_op(op))
+		{
+			if(operand == DataType::Boolean)
+				return operand;
+		}
+
+		return DataType::Invalid;
+	}
+
+	DataType postfix(std::string_view op, const DataType &operand)
+	{
+		if(Lang::is_arithmetic(op))
+		{
+			if(operand == DataType::Integer)
+				return operand;
+		}
+
+		return DataType::Invalid;
+	}
+
+	DataType named(std::string_view name)
+	{
+		// the unit type '()' is named by its '('
+		if(name == "(") return DataType::Unit;
+		else if(name == "Int") return DataType::Integer;
+		else if(name == "Float") return DataType::Float;
+		else if(name == "String") return DataType::String;
+		else if(name == "Bool") return DataType::Boolean;
+		else return DataType::Invalid;
+	}
+}
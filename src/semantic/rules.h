@@ -0,0 +1,16 @@
+#pragma once
+
+#include "semantic/type.h"
+
+#include <string_view>
+
+// typing rules shared by the type checkers; each returns DataType::Invalid
+// when the operands are not accepted, leaving diagnostics to the caller
+namespace Rules
+{
+	DataType infix(std::string_view op, const DataType &left, const DataType &right);
+	DataType prefix(std::string_view op, const DataType &operand);
+	DataType postfix(std::string_view op, const DataType &operand);
+
+	DataType named(std::string_view name);
+}
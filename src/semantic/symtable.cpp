@@ -1,12 +1,15 @@
 #include "symtable.h"
 
-#include "util/error.h"
+#include "prelude.h"
 
-SymbolTable::SymbolTable(std::string_view file, std::string_view source)
+SymbolTable::SymbolTable(Util::DiagnosticEngine &diagnostics, Util::ThreadPool *pool, const ModuleImports *imports)
 	: scope_level(0),
-	  file(file),
-	  source(source),
-	  error(false)
+	  diagnostics(diagnostics),
+	  tokens(diagnostics.tokens()),
+	  error(false),
+	  pool(pool),
+	  imports(imports),
+	  str(tokens)
 {
 }
 
@@ -15,8 +18,14 @@ bool SymbolTable::failed() const
 	return error;
 }
 
+size_t SymbolTable::operations() const
+{
+	return steps;
+}
+
 void SymbolTable::enter_scope()
 {
+	scope_begin.push_back(defined.size());
 	scope_level++;
 	tab_level++;
 }
@@ -24,24 +33,19 @@ void SymbolTable::enter_scope()
 void SymbolTable::exit_scope()
 {
 	// delete entries at current level
-	for(auto it = symbols.begin(); it != symbols.end();)
+	for(auto i = scope_begin.back(); i < defined.size(); i++)
 	{
-		if(it->second->scope_level == scope_level)
-		{
-			// replace entry with next
-			if(it->second->next)
-			{
-				it->second = it->second->next;
-			}
-			// erase entry
-			else
-			{
-				it = symbols.erase(it);
-				continue;
-			}
-		}
-		it++;
+		steps++;
+		auto it = symbols.find(defined[i]);
+		// replace entry with next
+		if(it->second->next)
+			it->second = it->second->next;
+		// erase entry
+		else
+			symbols.erase(it);
 	}
+	defined.resize(scope_begin.back());
+	scope_begin.pop_back();
 
 	scope_level--;
 	tab_level--;
@@ -50,17 +54,19 @@ void SymbolTable::exit_scope()
 void SymbolTable::define(Token token, Node *const node)
 {
 	auto id = token.value;
-	print("Define '", id, "' = ", str.stringify(*node));
+	TRACE(print("Define '", id, "' = ", str.stringify(*node)));
 
+	steps++;
 	auto it = symbols.find(id);
 
 	if(it != symbols.end() && it->second->scope_level == scope_level)
 	{
 		error = true;
-		Util::Error::At(
+		diagnostics.report_at(
 		    token,
-		    "symbol '", id, "' is already defined"
-		).print(file, source);
+		    Util::DiagnosticCode::AlreadyDefined,
+		    id
+		);
 		return;
 	}
 
@@ -71,25 +77,42 @@ void SymbolTable::define(Token token, Node *const node)
 	        scope_level,
 	        node
 	    );
+	defined.push_back(id);
 }
 
 std::shared_ptr<SymbolData> SymbolTable::find(Token token)
 {
 	auto id = token.value;
 
+	steps++;
 	auto it = symbols.find(id);
+	if(it == symbols.end() && top_level)
+	{
+		// a function body sees the top-level names defined before it
+		steps++;
+		auto index = top_level->top_level_index.find(id);
+		if(index != top_level->top_level_index.end() && index->second < visible)
+			return top_level->symbols.find(id)->second;
+	}
 	if(it == symbols.end())
 	{
-		print("Find '", id, "' -> undefined");
+		if(auto builtin = Prelude::find(id))
+		{
+			TRACE(print("Find '", id, "' -> builtin"));
+			return builtin;
+		}
+
+		TRACE(print("Find '", id, "' -> undefined"));
 		error = true;
-		Util::Error::At(
+		diagnostics.report_at(
 		    token,
-		    "symbol '", id, "' is not defined"
-		).print(file, source);
+		    Util::DiagnosticCode::NotDefined,
+		    id
+		);
 		return nullptr;
 	}
 
-	print("Find '", id, "' -> ", str.stringify(*it->second->node));
+	TRACE(print("Find '", id, "' -> ", str.stringify(*it->second->node)));
 	return it->second;
 }
 
@@ -97,9 +120,16 @@ std::shared_ptr<SymbolData> SymbolTable::find(Token token)
 
 void SymbolTable::visit(Program &node)
 {
+	// the trace follows the order of the source, so it is only written sequentially
+	if(pool && pool->size() > 1 && !Logger::get().tracing())
+	{
+		resolve_parallel(node);
+		return;
+	}
+
 	for(const auto &stmt : node.statements)
 	{
-		stmt->accept(*this);
+		dispatch(*stmt);
 	}
 }
 
@@ -107,28 +137,72 @@ void SymbolTable::visit(Program &node)
 
 void SymbolTable::visit(ExprStatement &node)
 {
-	node.expr->accept(*this);
+	dispatch(*node.expr);
 }
 void SymbolTable::visit(VariableDef &node)
 {
-	if(node.value) node.value->accept(*this);
-	define(node.name->token, node.name.get());
+	if(node.value) dispatch(*node.value);
+	define(node.name->token(tokens), node.name.get());
 }
 void SymbolTable::visit(FunctionDef &node)
 {
-	define(node.name->token, node.name.get());
+	define(node.name->token(tokens), node.name.get());
+	resolve_body(node);
+}
+void SymbolTable::resolve_body(FunctionDef &node)
+{
 	enter_scope();
 	for(const auto &param : node.parameters)
 	{
-		param->accept(*this);
+		dispatch(*param);
 	}
 	for(const auto &stmt : node.body->statements)
 	{
-		stmt->accept(*this);
+		dispatch(*stmt);
 	}
 	exit_scope();
 }
 
+void SymbolTable::visit(Import &node)
+{
+	if(scope_level > 0)
+	{
+		error = true;
+		diagnostics.report_at(node.import_keyword(tokens), Util::DiagnosticCode::ImportNotTopLevel);
+		return;
+	}
+
+	const auto &name = node.name(tokens);
+	auto module = name.value;
+	auto it = imports ? imports->find(module) : ModuleImports::const_iterator();
+	if(!imports || it == imports->end())
+	{
+		error = true;
+		diagnostics.report_at(name, Util::DiagnosticCode::ModuleNotFound, module);
+		return;
+	}
+
+	// exported names are defined at the top level, with the type they were
+	// checked with, so the type checker never looks into the module
+	for(const auto &symbol : it->second->exports)
+	{
+		std::string_view id = symbol.name;
+		TRACE(print("Define '", id, "' = ", str.stringify(node)));
+
+		steps++;
+		auto existing = symbols.find(id);
+		if(existing != symbols.end())
+		{
+			error = true;
+			diagnostics.report_at(name, Util::DiagnosticCode::ImportConflict, id, module);
+			continue;
+		}
+
+		symbols[id] = std::make_shared<SymbolData>(nullptr, scope_level, &node, symbol.type);
+		defined.push_back(id);
+	}
+}
+
 // expressions
 
 void SymbolTable::visit(NumberLiteral &node) {}
@@ -137,47 +211,42 @@ void SymbolTable::visit(BooleanLiteral &node) {}
 void SymbolTable::visit(UnitLiteral &node) {}
 void SymbolTable::visit(Identifier &node)
 {
-	node.symbol = find(node.token);
+	node.symbol = find(node.token(tokens));
 }
 void SymbolTable::visit(FunctionCall &node)
 {
-	node.name->accept(*this);
-	for(const auto &arg : node.arguments)
-	{
-		arg->accept(*this);
-	}
+	resolve_nested(node);
 }
 void SymbolTable::visit(InfixOperator &node)
 {
-	node.left->accept(*this);
-	node.right->accept(*this);
+	resolve_nested(node);
 }
 void SymbolTable::visit(PrefixOperator &node)
 {
-	node.operand->accept(*this);
+	resolve_nested(node);
 }
 void SymbolTable::visit(PostfixOperator &node)
 {
-	node.operand->accept(*this);
+	resolve_nested(node);
 }
 void SymbolTable::visit(GroupExpr &node)
 {
-	node.expr->accept(*this);
+	resolve_nested(node);
 }
 void SymbolTable::visit(ReturnExpr &node)
 {
-	if(node.value) node.value->accept(*this);
+	if(node.value) dispatch(*node.value);
 }
 void SymbolTable::visit(IfExpr &node)
 {
-	node.condition->accept(*this);
-	node.if_branch->accept(*this);
-	if(node.else_branch) node.else_branch->accept(*this);
+	dispatch(*node.condition);
+	dispatch(*node.if_branch);
+	if(node.else_branch) dispatch(*node.else_branch);
 }
 void SymbolTable::visit(WhileExpr &node)
 {
-	node.condition->accept(*this);
-	node.body->accept(*this);
+	dispatch(*node.condition);
+	dispatch(*node.body);
 }
 
 // general
@@ -188,12 +257,110 @@ void SymbolTable::visit(Block &node)
 	enter_scope();
 	for(const auto &stmt : node.statements)
 	{
-		stmt->accept(*this);
+		dispatch(*stmt);
 	}
 	exit_scope();
 }
 void SymbolTable::visit(Parameter &node)
 {
-	define(node.name->token, node.name.get());
+	define(node.name->token(tokens), node.name.get());
 }
 void SymbolTable::visit(Type &node) {}
+
+// operator chains, groups and calls can nest arbitrarily deep, so they are
+// walked with an explicit stack; operands are resolved left to right as before
+void SymbolTable::resolve_nested(Expression &root)
+{
+	std::vector<Expression *> stack = { &root };
+
+	while(!stack.empty())
+	{
+		auto node = stack.back();
+		stack.pop_back();
+
+		switch(node->kind)
+		{
+			case NodeKind::InfixOperator:
+			{
+				auto &op = static_cast<InfixOperator &>(*node);
+				stack.push_back(op.right.get());
+				stack.push_back(op.left.get());
+				break;
+			}
+			case NodeKind::PrefixOperator:
+				stack.push_back(static_cast<PrefixOperator &>(*node).operand.get());
+				break;
+			case NodeKind::PostfixOperator:
+				stack.push_back(static_cast<PostfixOperator &>(*node).operand.get());
+				break;
+			case NodeKind::GroupExpr:
+				stack.push_back(static_cast<GroupExpr &>(*node).expr.get());
+				break;
+			case NodeKind::FunctionCall:
+			{
+				auto &call = static_cast<FunctionCall &>(*node);
+				for(auto arg = call.arguments.rbegin(); arg != call.arguments.rend(); arg++)
+				{
+					stack.push_back(arg->get());
+				}
+				stack.push_back(call.name.get());
+				break;
+			}
+			default:
+				dispatch(*node);
+				break;
+		}
+	}
+}
+
+// The top level is resolved first, with function bodies only queued; each
+// body is then resolved by a table of its own that sees the top-level names
+// defined before the function. A body writes only to its own nodes, and its
+// diagnostics are merged back where the sequential walk would report them.
+void SymbolTable::resolve_parallel(Program &node)
+{
+	struct Body
+	{
+		FunctionDef *node;
+		size_t visible;
+	};
+	std::vector<Body> bodies;
+	std::vector<size_t> positions;
+
+	for(const auto &stmt : node.statements)
+	{
+		if(stmt->kind == NodeKind::FunctionDef)
+		{
+			auto &function = static_cast<FunctionDef &>(*stmt);
+			define(function.name->token(tokens), function.name.get());
+			bodies.push_back({ &function, defined.size() });
+			positions.push_back(diagnostics.diagnostics().size());
+		}
+		else dispatch(*stmt);
+	}
+
+	for(size_t i = 0; i < defined.size(); i++)
+	{
+		top_level_index.emplace(defined[i], i);
+	}
+
+	std::vector<Util::DiagnosticEngine> reports(bodies.size(), Util::DiagnosticEngine(diagnostics.file(), diagnostics.source(), tokens));
+	std::vector<size_t> body_steps(bodies.size());
+	std::vector<char> body_errors(bodies.size());
+	pool->for_each(bodies.size(), [&](size_t i)
+	{
+		SymbolTable body(reports[i]);
+		body.top_level = this;
+		body.visible = bodies[i].visible;
+		body.resolve_body(*bodies[i].node);
+		body_steps[i] = body.steps;
+		body_errors[i] = body.error;
+	});
+
+	diagnostics.merge(positions, reports);
+	for(size_t i = 0; i < bodies.size(); i++)
+	{
+		steps += body_steps[i];
+		error = error || body_errors[i];
+	}
+}
@@ -2,19 +2,26 @@
 
 #include "log.h"
 #include "util/stringifier.h"
-#include "ast/visitor.h"
+#include "util/diagnostic.h"
+#include "util/threadpool.h"
+#include "ast/dispatch.h"
 #include "ast/node.h"
 #include "symdata.h"
+#include "module.h"
 
 #include <unordered_map>
 #include <memory>
+#include <vector>
 
-class SymbolTable : public Visitor
+class SymbolTable : public StaticVisitor<SymbolTable>
 {
 public:
-#include "ast/visitorincl"
+#include "ast/dispatchincl"
 
-	SymbolTable(std::string_view file, std::string_view source);
+	// with a pool, top-level function bodies are resolved in parallel
+	// once the top level is; the results are the same. Imports are resolved
+	// against the given summaries.
+	SymbolTable(Util::DiagnosticEngine &diagnostics, Util::ThreadPool *pool = nullptr, const ModuleImports *imports = nullptr);
 	bool failed() const;
 
 	void enter_scope();
@@ -22,13 +29,34 @@ public:
 	void define(Token token, Node *const node);
 	std::shared_ptr<SymbolData> find(Token token);
 
+	// symbol entries looked up, added or removed so far
+	size_t operations() const;
+
 private:
 	std::unordered_map<std::string_view, std::shared_ptr<SymbolData>> symbols;
+	// names defined in the open scopes, and where each scope's names begin
+	std::vector<std::string_view> defined;
+	std::vector<size_t> scope_begin;
 	unsigned scope_level;
+	size_t steps = 0;
 
-	std::string_view file, source;
+	Util::DiagnosticEngine &diagnostics;
+	const std::vector<Token> &tokens;
 	bool error;
 
+	Util::ThreadPool *pool;
+	const ModuleImports *imports;
+	// for a table resolving one function body: the top level, and how many of
+	// its names were defined before the body
+	const SymbolTable *top_level = nullptr;
+	size_t visible = 0;
+	// where each top-level name is in defined
+	std::unordered_map<std::string_view, size_t> top_level_index;
+
+	void resolve_body(FunctionDef &node);
+	void resolve_parallel(Program &node);
+	void resolve_nested(Expression &root);
+
 	Util::Stringifier str;
 	unsigned tab_level = 0;
 	template<typename... Args>
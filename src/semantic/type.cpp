@@ -1,10 +1,11 @@
 #include "type.h"
 
-DataType DataType::Invalid = DataType::Variable("Invalid");
-DataType DataType::Unit = DataType::Variable("()");
-DataType DataType::Integer = DataType::Variable("Int");
-DataType DataType::String = DataType::Variable("String");
-DataType DataType::Boolean = DataType::Variable("Bool");
+const DataType DataType::Invalid = DataType::Variable("Invalid");
+const DataType DataType::Unit = DataType::Variable("()");
+const DataType DataType::Integer = DataType::Variable("Int");
+const DataType DataType::Float = DataType::Variable("Float");
+const DataType DataType::String = DataType::Variable("String");
+const DataType DataType::Boolean = DataType::Variable("Bool");
 
 DataType DataType::Variable(std::string value)
 {
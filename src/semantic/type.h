@@ -6,7 +6,8 @@
 class DataType
 {
 public:
-	static DataType Invalid, Unit, Integer, String, Boolean;
+	// built-in types; never modified, so any number of threads can share them
+	static const DataType Invalid, Unit, Integer, Float, String, Boolean;
 
 	static DataType Variable(std::string value);
 	static DataType Function(const DataType &return_type, const std::vector<DataType> &parameter_types);
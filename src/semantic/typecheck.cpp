@@ -1,13 +1,17 @@
 #include "typecheck.h"
 
-#include "util/error.h"
+#include "rules.h"
 #include "lang.h"
 
-TypeChecker::TypeChecker(std::string_view file, std::string_view source)
-	: file(file),
-	  source(source),
+#include <algorithm>
+
+TypeChecker::TypeChecker(Util::DiagnosticEngine &diagnostics, const ConstantPool &constants, Util::ThreadPool *pool)
+	: diagnostics(diagnostics),
+	  tokens(diagnostics.tokens()),
+	  constants(constants),
 	  error(false),
-	  type(DataType::Invalid)
+	  pool(pool),
+	  str(tokens)
 {
 }
 
@@ -16,158 +20,299 @@ bool TypeChecker::failed() const
 	return error;
 }
 
-DataType TypeChecker::get_type(Node &node)
-{
-	node.accept(*this);
-	auto temp = type;
-	type = DataType::Invalid;
-	return temp;
-}
-
-DataType TypeChecker::check_infix(InfixOperator *const op, Expression *const left, const DataType &left_type, Expression *const right, const DataType &right_type)
+// operator chains, groups and calls can nest arbitrarily deep, so they are checked with an
+// explicit stack; operands are still visited left to right, so traces and errors keep their order
+DataType TypeChecker::check_nested(Expression &root)
 {
-	auto sym = op->token.value;
-
-	if(Lang::is_arithmetic(sym))
+	struct Frame
 	{
-		if(left_type == right_type && right_type == DataType::Integer)
-			return DataType::Integer;
-		else if(sym == "+" && (left_type == DataType::String || right_type == DataType::String))
-			return DataType::String;
-	}
-	else if(Lang::is_assignment(sym))
+		Expression *node;
+		// 0 before the operands are queued; for calls, 1 + number of checked arguments
+		size_t stage;
+	};
+	std::vector<Frame> stack = { { &root, 0 } };
+	std::vector<DataType> types, signatures;
+
+	auto pop = [&types]()
 	{
-		if(!dynamic_cast<const Identifier *>(left))
+		auto type = std::move(types.back());
+		types.pop_back();
+		return type;
+	};
+
+	while(!stack.empty())
+	{
+		auto node = stack.back().node;
+		auto stage = stack.back().stage++;
+
+		switch(node->kind)
 		{
-			error = true;
-			Util::Error(
-			    left,
-			    "left-hand expression is not assignable"
-			).print(file, source);
-			return DataType::Invalid;
+			case NodeKind::InfixOperator:
+			{
+				auto &op = static_cast<InfixOperator &>(*node);
+				if(stage == 0)
+				{
+					TRACE(print(str.stringify(op)));
+					tab_level++;
+					stack.push_back({ op.right.get(), 0 });
+					stack.push_back({ op.left.get(), 0 });
+					continue;
+				}
+
+				auto right_type = pop();
+				auto left_type = pop();
+				auto type = check_infix(&op, op.left.get(), left_type, op.right.get(), right_type);
+
+				tab_level--;
+				TRACE(print(": ", type));
+				types.push_back(type);
+				break;
+			}
+			case NodeKind::PrefixOperator:
+			{
+				auto &op = static_cast<PrefixOperator &>(*node);
+				if(stage == 0)
+				{
+					TRACE(print(str.stringify(op)));
+					tab_level++;
+					stack.push_back({ op.operand.get(), 0 });
+					continue;
+				}
+
+				auto type = check_prefix(&op, op.operand.get(), pop());
+
+				tab_level--;
+				TRACE(print(": ", type));
+				types.push_back(type);
+				break;
+			}
+			case NodeKind::PostfixOperator:
+			{
+				auto &op = static_cast<PostfixOperator &>(*node);
+				if(stage == 0)
+				{
+					TRACE(print(str.stringify(op)));
+					tab_level++;
+					stack.push_back({ op.operand.get(), 0 });
+					continue;
+				}
+
+				auto type = check_postfix(&op, op.operand.get(), pop());
+
+				tab_level--;
+				TRACE(print(": ", type));
+				types.push_back(type);
+				break;
+			}
+			case NodeKind::GroupExpr:
+			{
+				// the operand's type is passed through
+				if(stage == 0)
+				{
+					stack.push_back({ static_cast<GroupExpr &>(*node).expr.get(), 0 });
+					continue;
+				}
+				break;
+			}
+			case NodeKind::FunctionCall:
+			{
+				auto &call = static_cast<FunctionCall &>(*node);
+				if(stage == 0)
+				{
+					TRACE(print(str.stringify(call)));
+					tab_level++;
+
+					auto signature = dispatch(*call.name);
+					if(!signature.is_function)
+					{
+						error = true;
+						diagnostics.report(
+						    call.name.get(),
+						    Util::DiagnosticCode::CallToNonFunction,
+						    call.name->token(tokens).value
+						);
+
+						tab_level--;
+						TRACE(print(": ", DataType::Invalid));
+						types.push_back(DataType::Invalid);
+						break;
+					}
+
+					if(call.arguments.size() != signature.parameter_types.size())
+					{
+						error = true;
+						diagnostics.report(
+						    &call,
+						    Util::DiagnosticCode::ArgumentCount,
+						    call.name->token(tokens).value, signature.parameter_types.size(), call.arguments.size()
+						);
+					}
+
+					signatures.push_back(signature);
+					continue;
+				}
+
+				const auto &signature = signatures.back();
+				auto count = std::min(call.arguments.size(), signature.parameter_types.size());
+				auto checked = stage - 1;
+
+				if(checked > 0)
+				{
+					auto i = checked - 1;
+					auto arg = pop();
+					auto param = signature.parameter_types[i];
+
+					if(arg != DataType::Invalid && param != DataType::Invalid && arg != param)
+					{
+						error = true;
+						diagnostics.report(
+						    call.arguments[i].get(),
+						    Util::DiagnosticCode::ArgumentType,
+						    call.name->token(tokens).value, param, arg
+						);
+					}
+				}
+
+				if(checked < count)
+				{
+					stack.push_back({ call.arguments[checked].get(), 0 });
+					continue;
+				}
+
+				auto type = DataType::Variable(signature.value);
+				signatures.pop_back();
+
+				tab_level--;
+				TRACE(print(": ", type));
+				types.push_back(type);
+				break;
+			}
+			default:
+				types.push_back(dispatch(*node));
+				break;
 		}
 
-		if(left_type == right_type)
-			return left_type;
+		stack.pop_back();
 	}
-	else if(Lang::is_boolean_op(sym))
+
+	return types.back();
+}
+
+DataType TypeChecker::check_infix(InfixOperator *const op, Expression *const left, const DataType &left_type, Expression *const right, const DataType &right_type)
+{
+	auto sym = op->token(tokens).value;
+
+	if(Lang::is_assignment(sym) && left->kind != NodeKind::Identifier)
 	{
-		if(left_type == right_type)
-		{
-			if(sym == "==" || sym == "!=")
-				return DataType::Boolean;
-			else if(right_type == DataType::Integer && (sym == ">" || sym == ">=" || sym == "<" || sym == "<="))
-				return DataType::Boolean;
-			else if(right_type == DataType::Boolean)
-				return DataType::Boolean;
-		}
+		error = true;
+		diagnostics.report(
+		    left,
+		    Util::DiagnosticCode::NotAssignable
+		);
+		return DataType::Invalid;
 	}
 
-	if(left_type != DataType::Invalid && right_type != DataType::Invalid)
+	auto type = Rules::infix(sym, left_type, right_type);
+
+	if(type == DataType::Invalid && left_type != DataType::Invalid && right_type != DataType::Invalid)
 	{
 		error = true;
-		Util::Error(
+		diagnostics.report(
 		    op,
-		    "mismatched types '", left_type,
-		    "' and '", right_type,
-		    "' for operator '", sym, "'"
-		).print(file, source);
+		    Util::DiagnosticCode::OperatorTypes,
+		    left_type, right_type, sym
+		);
 	}
-	return DataType::Invalid;
+	return type;
 }
 
 DataType TypeChecker::check_prefix(PrefixOperator *const op, Expression *const operand, const DataType &operand_type)
 {
-	auto sym = op->token.value;
-
-	if(Lang::is_arithmetic(sym))
-	{
-		if(operand_type == DataType::Integer)
-			return operand_type;
-	}
-	else if(Lang::is_boolean_op(sym))
-	{
-		if(operand_type == DataType::Boolean)
-			return operand_type;
-	}
+	auto sym = op->token(tokens).value;
+	auto type = Rules::prefix(sym, operand_type);
 
-	if(operand_type != DataType::Invalid)
+	if(type == DataType::Invalid && operand_type != DataType::Invalid)
 	{
 		error = true;
-		Util::Error(
+		diagnostics.report(
 		    op,
-		    "mismatched type '", operand_type,
-		    "' for operator '", sym, "'"
-		).print(file, source);
+		    Util::DiagnosticCode::OperatorType,
+		    operand_type, sym
+		);
 	}
-	return DataType::Invalid;
+	return type;
 }
 
 DataType TypeChecker::check_postfix(PostfixOperator *const op, Expression *const operand, const DataType &operand_type)
 {
-	auto sym = op->token.value;
+	auto sym = op->token(tokens).value;
+	auto type = Rules::postfix(sym, operand_type);
 
-	if(Lang::is_arithmetic(sym))
-	{
-		if(operand_type == DataType::Integer)
-			return operand_type;
-	}
-
-	if(operand_type != DataType::Invalid)
+	if(type == DataType::Invalid && operand_type != DataType::Invalid)
 	{
 		error = true;
-		Util::Error(
+		diagnostics.report(
 		    op,
-		    "mismatched type '", operand_type,
-		    "' for operator '", sym, "'"
-		).print(file, source);
+		    Util::DiagnosticCode::OperatorType,
+		    operand_type, sym
+		);
 	}
-	return DataType::Invalid;
+	return type;
 }
 
 // main
 
-void TypeChecker::visit(Program &node)
+DataType TypeChecker::visit(Program &node)
 {
+	// the trace follows the order of the source, so it is only written sequentially
+	if(pool && pool->size() > 1 && !Logger::get().tracing())
+	{
+		check_parallel(node);
+		return DataType::Invalid;
+	}
+
 	for(const auto &stmt : node.statements)
 	{
-		stmt->accept(*this);
+		dispatch(*stmt);
 	}
+
+	return DataType::Invalid;
 }
 
 // statements
 
-void TypeChecker::visit(ExprStatement &node)
+DataType TypeChecker::visit(ExprStatement &node)
 {
-	print(str.stringify(node));
+	TRACE(print(str.stringify(node)));
 	tab_level++;
 
-	node.expr->accept(*this);
+	auto type = dispatch(*node.expr);
 
 	tab_level--;
+	return type;
 }
-void TypeChecker::visit(VariableDef &node)
+DataType TypeChecker::visit(VariableDef &node)
 {
-	print(str.stringify(node));
+	TRACE(print(str.stringify(node)));
 	tab_level++;
 
 	auto variable_type = node.type
-	                     ? get_type(*node.type)
-	                     : get_type(*node.value);
+	                     ? dispatch(*node.type)
+	                     : dispatch(*node.value);
 
-	type = variable_type;
+	auto type = variable_type;
 
 	if(node.type && node.value)
 	{
-		auto inferred_type = get_type(*node.value);
+		auto inferred_type = dispatch(*node.value);
 		if(variable_type != DataType::Invalid && inferred_type != DataType::Invalid && variable_type != inferred_type)
 		{
 			error = true;
-			Util::Error(
+			diagnostics.report(
 			    node.name.get(),
-			    "inferred type '", inferred_type,
-			    "' does not match explicit type '", variable_type, "'"
-			).print(file, source);
+			    Util::DiagnosticCode::InferredType,
+			    inferred_type, variable_type
+			);
 		}
 
 		type = variable_type != DataType::Invalid
@@ -185,18 +330,28 @@ void TypeChecker::visit(VariableDef &node)
 	    );
 
 	tab_level--;
-	print(": ", type);
+	TRACE(print(": ", type));
+	return type;
 }
-void TypeChecker::visit(FunctionDef &node)
+DataType TypeChecker::visit(FunctionDef &node)
 {
-	print(str.stringify(node));
+	TRACE(print(str.stringify(node)));
 	tab_level++;
 
+	auto _type = check_signature(node);
+	check_body(node, DataType::Variable(_type.value));
+
+	tab_level--;
+	TRACE(print(": ", _type));
+	return _type;
+}
+DataType TypeChecker::check_signature(FunctionDef &node)
+{
 	std::vector<DataType> parameter_types;
 
 	for(const auto &param : node.parameters)
 	{
-		auto param_type = get_type(*param);
+		auto param_type = dispatch(*param);
 		param->name->symbol =
 		    std::make_shared<SymbolData>
 		    (
@@ -209,7 +364,7 @@ void TypeChecker::visit(FunctionDef &node)
 	}
 
 	auto return_type = node.return_type
-	                   ? get_type(*node.return_type)
+	                   ? dispatch(*node.return_type)
 	                   : DataType::Unit;
 
 	auto _type = DataType::Function(return_type, parameter_types);
@@ -222,317 +377,292 @@ void TypeChecker::visit(FunctionDef &node)
 	        node.name.get(),
 	        _type
 	    );
-
-	auto body_return_type = get_type(*node.body);
+	return _type;
+}
+void TypeChecker::check_body(FunctionDef &node, const DataType &return_type)
+{
+	auto body_return_type = dispatch(*node.body);
 	if(body_return_type != DataType::Invalid && return_type != DataType::Invalid && body_return_type != return_type)
 	{
 		error = true;
-		Util::Error(
+		diagnostics.report(
 		    node.name.get(),
-		    "body return type '", body_return_type,
-		    "' does not match signature return type '", return_type, "'"
-		).print(file, source);
+		    Util::DiagnosticCode::ReturnType,
+		    body_return_type, return_type
+		);
 	}
+}
 
-	type = _type;
-
-	tab_level--;
-	print(": ", type);
+DataType TypeChecker::visit(Import &node)
+{
+	TRACE(print(str.stringify(node)));
+	return DataType::Unit;
 }
 
 // expressions
-void TypeChecker::visit(NumberLiteral &node)
+DataType TypeChecker::visit(NumberLiteral &node)
 {
-	type = DataType::Integer;
+	auto type = constants[node.token(tokens).constant].kind == Constant::Kind::Float
+	            ? DataType::Float
+	            : DataType::Integer;
 
-	print(str.stringify(node), " : ", type);
+	TRACE(print(str.stringify(node), " : ", type));
+	return type;
 }
-void TypeChecker::visit(StringLiteral &node)
+DataType TypeChecker::visit(StringLiteral &node)
 {
-	type = DataType::String;
+	auto type = DataType::String;
 
-	print(str.stringify(node), " : ", type);
+	TRACE(print(str.stringify(node), " : ", type));
+	return type;
 }
-void TypeChecker::visit(BooleanLiteral &node)
+DataType TypeChecker::visit(BooleanLiteral &node)
 {
-	type = DataType::Boolean;
+	auto type = DataType::Boolean;
 
-	print(str.stringify(node), " : ", type);
+	TRACE(print(str.stringify(node), " : ", type));
+	return type;
 }
-void TypeChecker::visit(UnitLiteral &node)
+DataType TypeChecker::visit(UnitLiteral &node)
 {
-	type = DataType::Unit;
+	auto type = DataType::Unit;
 
-	print(str.stringify(node), " : ", type);
+	TRACE(print(str.stringify(node), " : ", type));
+	return type;
 }
-void TypeChecker::visit(Identifier &node)
+DataType TypeChecker::visit(Identifier &node)
 {
 	if(node.symbol->type.is_function || node.symbol->type != DataType::Invalid)
 	{
-		type = node.symbol->type;
+		auto type = node.symbol->type;
 
-		print(str.stringify(node), " : ", type);
+		TRACE(print(str.stringify(node), " : ", type));
+		return type;
 	}
 	else if(&node != node.symbol->node)
 	{
-		print(str.stringify(node));
+		TRACE(print(str.stringify(node)));
 		tab_level++;
 
-		type = get_type(*node.symbol->node);
+		auto type = dispatch(*node.symbol->node);
 
 		tab_level--;
-		print(": ", type);
+		TRACE(print(": ", type));
+		return type;
 	}
+
+	return DataType::Invalid;
 }
-void TypeChecker::visit(FunctionCall &node)
+DataType TypeChecker::visit(FunctionCall &node)
 {
-	print(str.stringify(node));
-	tab_level++;
-
-	auto signature = get_type(*node.name);
-
-	if(!signature.is_function)
-	{
-		type = DataType::Invalid;
-
-		error = true;
-		Util::Error(
-		    node.name.get(),
-		    "call to non-function type '", node.name->token.value, "'"
-		).print(file, source);
-	}
-	else
-	{
-		if(node.arguments.size() != signature.parameter_types.size())
-		{
-			error = true;
-			Util::Error(
-			    &node,
-			    "mismatched number of arguments to '", node.name->token.value,
-			    "': expected ", signature.parameter_types.size(),
-			    ", found ", node.arguments.size()
-			).print(file, source);
-		}
-
-		for(size_t i = 0; i < (node.arguments.size() < signature.parameter_types.size() ? node.arguments.size() : signature.parameter_types.size()); i++)
-		{
-			auto arg = get_type(*node.arguments[i]);
-			auto param = signature.parameter_types[i];
-
-			if(arg != DataType::Invalid && param != DataType::Invalid && arg != param)
-			{
-				error = true;
-				Util::Error(
-				    node.arguments[i].get(),
-				    "mismatched argument types for '", node.name->token.value,
-				    "': expected '", param,
-				    "', found '", arg, "'"
-				).print(file, source);
-			}
-		}
-
-		type = DataType::Variable(signature.value);
-	}
-
-	tab_level--;
-	print(": ", type);
+	return check_nested(node);
 }
 
-void TypeChecker::visit(InfixOperator &node)
+DataType TypeChecker::visit(InfixOperator &node)
 {
-	print(str.stringify(node));
-	tab_level++;
-
-	auto left_type = get_type(*node.left);
-	auto right_type = get_type(*node.right);
-
-	type = check_infix(&node, node.left.get(), left_type, node.right.get(), right_type);
-
-	tab_level--;
-	print(": ", type);
+	return check_nested(node);
 }
-void TypeChecker::visit(PrefixOperator &node)
+DataType TypeChecker::visit(PrefixOperator &node)
 {
-	print(str.stringify(node));
-	tab_level++;
-
-	auto operand_type = get_type(*node.operand);
-	type = check_prefix(&node, node.operand.get(), operand_type);
-
-	tab_level--;
-	print(": ", type);
-
+	return check_nested(node);
 }
-void TypeChecker::visit(PostfixOperator &node)
+DataType TypeChecker::visit(PostfixOperator &node)
 {
-	print(str.stringify(node));
-	tab_level++;
-
-	auto operand_type = get_type(*node.operand);
-	type = check_postfix(&node, node.operand.get(), operand_type);
-
-	tab_level--;
-	print(": ", type);
+	return check_nested(node);
 }
-void TypeChecker::visit(GroupExpr &node)
+DataType TypeChecker::visit(GroupExpr &node)
 {
-	// print(str.stringify(node));
-	// tab_level++;
-
-	type = get_type(*node.expr);
-
-	// tab_level--;
-	// print(": ", type);
+	return check_nested(node);
 }
-void TypeChecker::visit(ReturnExpr &node)
+DataType TypeChecker::visit(ReturnExpr &node)
 {
-	print(str.stringify(node));
+	TRACE(print(str.stringify(node)));
 	tab_level++;
 
-	type = node.value
-	       ? get_type(*node.value)
-	       : DataType::Unit;
+	auto type = node.value
+	            ? dispatch(*node.value)
+	            : DataType::Unit;
 
 	tab_level--;
-	print(": ", type);
+	TRACE(print(": ", type));
+	return type;
 }
-void TypeChecker::visit(IfExpr &node)
+DataType TypeChecker::visit(IfExpr &node)
 {
-	print(str.stringify(node));
+	TRACE(print(str.stringify(node)));
 	tab_level++;
 
-	auto condition_type = get_type(*node.condition);
+	auto condition_type = dispatch(*node.condition);
 	if(condition_type != DataType::Invalid && condition_type != DataType::Boolean)
 	{
 		error = true;
-		Util::Error(
+		diagnostics.report(
 		    node.condition.get(),
-		    "mismatched type for condition",
-		    ": expected '", DataType::Boolean,
-		    "', found '", condition_type, "'"
-		).print(file, source);
+		    Util::DiagnosticCode::ConditionType,
+		    DataType::Boolean, condition_type
+		);
 	}
 
-	auto if_type = get_type(*node.if_branch);
+	auto if_type = dispatch(*node.if_branch);
 	auto _type = if_type;
 
 	if(node.else_branch)
 	{
-		auto else_type = get_type(*node.else_branch);
+		auto else_type = dispatch(*node.else_branch);
 		if(if_type != else_type)
 		{
 			_type = DataType::Invalid;
 			error = true;
-			Util::Error(
+			diagnostics.report(
 			    &node,
-			    "mismatched types '", if_type,
-			    "' and '", else_type,
-			    "' for if/else branches"
-			).print(file, source);
+			    Util::DiagnosticCode::BranchTypes,
+			    if_type, else_type
+			);
 		}
 	}
 
-	type = _type;
-
 	tab_level--;
-	print(": ", type);
+	TRACE(print(": ", _type));
+	return _type;
 }
-void TypeChecker::visit(WhileExpr &node)
+DataType TypeChecker::visit(WhileExpr &node)
 {
-	print(str.stringify(node));
+	TRACE(print(str.stringify(node)));
 	tab_level++;
 
-	auto condition_type = get_type(*node.condition);
+	auto condition_type = dispatch(*node.condition);
 	if(condition_type != DataType::Invalid && condition_type != DataType::Boolean)
 	{
 		error = true;
-		Util::Error(
+		diagnostics.report(
 		    node.condition.get(),
-		    "mismatched type for condition",
-		    ": expected '", DataType::Boolean,
-		    "', found '", condition_type, "'"
-		).print(file, source);
+		    Util::DiagnosticCode::ConditionType,
+		    DataType::Boolean, condition_type
+		);
 	}
 
-	node.body->accept(*this);
+	dispatch(*node.body);
 
-	type = DataType::Unit;
+	auto type = DataType::Unit;
 
 	tab_level--;
-	print(": ", type);
+	TRACE(print(": ", type));
+	return type;
 }
 
 // general
 
-void TypeChecker::visit(Invalid &node)
+DataType TypeChecker::visit(Invalid &node)
 {
-	type = DataType::Invalid;
+	auto type = DataType::Invalid;
 
-	print(str.stringify(node), " : ", type);
+	TRACE(print(str.stringify(node), " : ", type));
+	return type;
 }
-void TypeChecker::visit(Block &node)
+DataType TypeChecker::visit(Block &node)
 {
 	auto return_type = DataType::Unit;
 
 	if(node.statements.empty())
 	{
-		type = return_type;
-		print(str.stringify(node), " : ", type);
-		return;
+		TRACE(print(str.stringify(node), " : ", return_type));
+		return return_type;
 	}
 
-	print(str.stringify(node));
+	TRACE(print(str.stringify(node)));
 	tab_level++;
 
 	bool found = false;
 	for(const auto &stmt : node.statements)
 	{
 		// find return expression
-		if(auto expr_stmt = dynamic_cast<ExprStatement *>(stmt.get()))
+		if(stmt->kind == NodeKind::ExprStatement)
 		{
-			if(auto ret_expr = dynamic_cast<ReturnExpr *>(expr_stmt->expr.get()))
+			auto &expr = static_cast<ExprStatement &>(*stmt).expr;
+			if(expr->kind == NodeKind::ReturnExpr)
 			{
 				if(!found)
-					return_type = get_type(*ret_expr);
-				else stmt->accept(*this);
+					return_type = dispatch(*expr);
+				else dispatch(*stmt);
 				found = true;
 			}
-			else stmt->accept(*this);
+			else dispatch(*stmt);
 		}
-		else stmt->accept(*this);
+		else dispatch(*stmt);
 	}
 
-	type = return_type;
-
 	tab_level--;
-	print(": ", type);
+	TRACE(print(": ", return_type));
+	return return_type;
 }
-void TypeChecker::visit(Parameter &node)
+DataType TypeChecker::visit(Parameter &node)
 {
-	print(str.stringify(node));
+	TRACE(print(str.stringify(node)));
 	tab_level++;
 
-	type = get_type(*node.type);
+	auto type = dispatch(*node.type);
 
 	tab_level--;
-	print(": ", type);
+	TRACE(print(": ", type));
+	return type;
 }
-void TypeChecker::visit(Type &node)
+DataType TypeChecker::visit(Type &node)
 {
-	if(node.token.value == "()") type = DataType::Unit;
-	else if(node.token.value == "Int") type = DataType::Integer;
-	else if(node.token.value == "String") type = DataType::String;
-	else if(node.token.value == "Bool") type = DataType::Boolean;
-	else
-	{
-		type = DataType::Invalid;
+	auto type = Rules::named(node.token(tokens).value);
 
+	if(type == DataType::Invalid)
+	{
 		error = true;
-		Util::Error(
+		diagnostics.report(
 		    &node,
-		    "invalid type '", node.token.value, "'"
-		).print(file, source);
+		    Util::DiagnosticCode::InvalidType,
+		    node.token(tokens).value
+		);
 	}
 
-	print(str.stringify(node), " : ", type);
+	TRACE(print(str.stringify(node), " : ", type));
+	return type;
+}
+
+// The top level is checked first, with function bodies only queued. A body
+// depends on nothing but the signatures and globals defined before it, which
+// are typed by then, and writes only to its own nodes, so the bodies are then
+// checked in parallel; their diagnostics are merged back where the sequential
+// walk would report them.
+void TypeChecker::check_parallel(Program &node)
+{
+	struct Body
+	{
+		FunctionDef *node;
+		DataType return_type;
+	};
+	std::vector<Body> bodies;
+	std::vector<size_t> positions;
+
+	for(const auto &stmt : node.statements)
+	{
+		if(stmt->kind == NodeKind::FunctionDef)
+		{
+			auto &function = static_cast<FunctionDef &>(*stmt);
+			auto signature = check_signature(function);
+			bodies.push_back({ &function, DataType::Variable(signature.value) });
+			positions.push_back(diagnostics.diagnostics().size());
+		}
+		else dispatch(*stmt);
+	}
+
+	std::vector<Util::DiagnosticEngine> reports(bodies.size(), Util::DiagnosticEngine(diagnostics.file(), diagnostics.source(), tokens));
+	std::vector<char> body_errors(bodies.size());
+	pool->for_each(bodies.size(), [&](size_t i)
+	{
+		TypeChecker body(reports[i], constants);
+		body.check_body(*bodies[i].node, bodies[i].return_type);
+		body_errors[i] = body.error;
+	});
+
+	diagnostics.merge(positions, reports);
+	for(auto body_error : body_errors)
+	{
+		error = error || body_error;
+	}
 }
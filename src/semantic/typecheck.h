@@ -2,24 +2,37 @@
 
 #include "log.h"
 #include "util/stringifier.h"
-#include "ast/visitor.h"
+#include "util/diagnostic.h"
+#include "util/threadpool.h"
+#include "ast/dispatch.h"
 #include "ast/node.h"
 #include "semantic/type.h"
+#include "syntax/constant.h"
 
-class TypeChecker : public Visitor
+#include <vector>
+
+class TypeChecker : public StaticVisitor<TypeChecker, DataType>
 {
 public:
-#include "ast/visitorincl"
+#include "ast/dispatchincl"
 
-	TypeChecker(std::string_view file, std::string_view source);
+	// with a pool, top-level function bodies are checked in parallel once
+	// the top level is; the results are the same
+	TypeChecker(Util::DiagnosticEngine &diagnostics, const ConstantPool &constants, Util::ThreadPool *pool = nullptr);
 	bool failed() const;
 
 private:
-	std::string_view file, source;
+	Util::DiagnosticEngine &diagnostics;
+	const std::vector<Token> &tokens;
+	const ConstantPool &constants;
 	bool error;
+	Util::ThreadPool *pool;
+
+	DataType check_signature(FunctionDef &node);
+	void check_body(FunctionDef &node, const DataType &return_type);
+	void check_parallel(Program &node);
 
-	DataType type;
-	DataType get_type(Node &node);
+	DataType check_nested(Expression &root);
 	DataType check_infix(InfixOperator *const op, Expression *const left, const DataType &left_type, Expression *const right, const DataType &right_type);
 	DataType check_prefix(PrefixOperator *const op, Expression *const operand, const DataType &operand_type);
 	DataType check_postfix(PostfixOperator *const op, Expression *const operand, const DataType &operand_type);
@@ -0,0 +1,235 @@
+#include "server.h"
+
+#include "protocol.h"
+#include "cli.h"
+#include "log.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace Server
+{
+	namespace
+	{
+		volatile std::sig_atomic_t stopping = 0;
+
+		void stop(int)
+		{
+			stopping = 1;
+		}
+
+		// log output of a request is sent to the client as Output frames
+		ssize_t write_output(void *cookie, const char *data, size_t size)
+		{
+			int fd = *static_cast<int *>(cookie);
+			return write_frame(fd, Frame::Output, std::string_view(data, size)) ? size : -1;
+		}
+
+		// a request only compiles and checks its inputs; running programs,
+		// serving, and the log of the server are for its own command line
+		bool allowed(std::string_view arg, bool first)
+		{
+			if(arg.size() < 2 || arg[0] != '-')
+				return !first || (arg != "run" && arg != "serve");
+
+			constexpr std::string_view flags[] = { "-h", "--help", "--flat-ast", "--emit-c", "-O0", "-O1", "-O2", "--stats" };
+			constexpr std::string_view values[] = { "--output=", "--max-errors=", "--threads=" };
+			for(auto flag : flags)
+				if(arg == flag) return true;
+			for(auto value : values)
+				if(arg.substr(0, value.size()) == value) return true;
+			return false;
+		}
+
+		// the directory of the socket is created for only this user; one that
+		// another user could replace the socket in is refused
+		bool private_directory(const std::filesystem::path &socket_path)
+		{
+			auto directory = socket_path.parent_path();
+			if(directory.empty())
+				directory = ".";
+			::mkdir(directory.c_str(), 0700);
+
+			struct stat status;
+			if(::lstat(directory.c_str(), &status) != 0 || !S_ISDIR(status.st_mode))
+			{
+				Logger::get().error("'", directory.string(), "' is not a directory");
+				return false;
+			}
+			bool own = status.st_uid == ::geteuid() && (status.st_mode & 022) == 0;
+			bool shared = status.st_uid == 0 && ((status.st_mode & 022) == 0 || (status.st_mode & S_ISVTX));
+			if(!own && !shared)
+			{
+				Logger::get().error("'", directory.string(), "' can be changed by other users");
+				return false;
+			}
+			return true;
+		}
+
+		void handle(int client)
+		{
+			std::string directory;
+			std::vector<std::string> arguments;
+			std::optional<std::string> input;
+
+			Frame type;
+			Buffer data;
+			while(true)
+			{
+				if(!read_frame(client, type, data)) return;
+				if(type == Frame::End) break;
+
+				switch(type)
+				{
+					case Frame::Directory:
+						directory = data.view();
+						break;
+					case Frame::Argument:
+						arguments.emplace_back(data.view());
+						break;
+					case Frame::Input:
+						input = std::string(data.view());
+						break;
+					default:
+						return;
+				}
+			}
+
+			CLI::Console console;
+			cookie_io_functions_t functions = { nullptr, write_output, nullptr, nullptr };
+			console.out = fopencookie(&client, "w", functions);
+			console.in = std::move(input);
+			if(!console.out) return;
+
+			int status = 1;
+			auto refused = std::find_if(arguments.begin(), arguments.end(), [&](const std::string &arg)
+			{
+				return !allowed(arg, &arg == &arguments.front());
+			});
+
+			std::error_code error;
+			auto previous = std::filesystem::current_path(error);
+			if(refused == arguments.end())
+				std::filesystem::current_path(directory, error);
+			if(refused != arguments.end())
+			{
+				Logger::get().set_output(LogFormat::Terminal, "", console.out);
+				Logger::get().error("'", *refused, "' is not taken by a server, which only compiles and checks");
+			}
+			else if(error)
+			{
+				Logger::get().set_output(LogFormat::Terminal, "", console.out);
+				Logger::get().error("unable to enter directory '", directory, "'");
+			}
+			else
+			{
+				std::vector<std::string_view> args(arguments.begin(), arguments.end());
+				try
+				{
+					status = CLI::execute(args, console);
+				}
+				catch(std::exception &e)
+				{
+					Logger::get().error("internal error: ", e.what());
+				}
+			}
+
+			// nothing of a request carries over to the next one
+			Logger::get().set_output(LogFormat::Terminal);
+			Logger::get().set_level(LogLevel::Info);
+			std::filesystem::current_path(previous, error);
+
+			std::fclose(console.out);
+			write_frame(client, Frame::Status, std::to_string(status));
+		}
+	}
+
+	std::string default_socket()
+	{
+		char path[PATH_MAX];
+		Server::default_socket(path, sizeof(path));
+		return path;
+	}
+
+	int serve(const std::string &socket_path)
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if(socket_path.size() >= sizeof(address.sun_path))
+		{
+			Logger::get().error("socket path '", socket_path, "' is too long");
+			return 1;
+		}
+		std::strcpy(address.sun_path, socket_path.c_str());
+
+		// a socket left behind by a server that died is replaced, a live one is not
+		if(int fd = connect_to(socket_path.c_str()); fd >= 0)
+		{
+			::close(fd);
+			Logger::get().error("a server is already listening on '", socket_path, "'");
+			return 1;
+		}
+		if(!private_directory(socket_path))
+			return 1;
+		::unlink(socket_path.c_str());
+
+		// only this user can connect, from the moment the socket exists
+		int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		auto mask = ::umask(077);
+		bool bound = listener >= 0 && ::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+		::umask(mask);
+		if(!bound || ::listen(listener, 64) < 0)
+		{
+			Logger::get().error("unable to listen on '", socket_path, "': ", std::strerror(errno));
+			if(listener >= 0) ::close(listener);
+			return 1;
+		}
+
+		// no SA_RESTART, so a signal interrupts accept()
+		struct sigaction action = {};
+		action.sa_handler = stop;
+		sigemptyset(&action.sa_mask);
+		::sigaction(SIGINT, &action, nullptr);
+		::sigaction(SIGTERM, &action, nullptr);
+
+		Logger::get().info("Listening on '", socket_path, "'");
+		Logger::get().flush();
+
+		while(!stopping)
+		{
+			int client = ::accept(listener, nullptr, nullptr);
+			if(client < 0)
+			{
+				if(errno == EINTR) continue;
+				Logger::get().error("unable to accept a connection: ", std::strerror(errno));
+				break;
+			}
+			if(!same_user(client))
+			{
+				Logger::get().warn("refused a connection from another user");
+				::close(client);
+				continue;
+			}
+
+			handle(client);
+			::close(client);
+		}
+
+		::close(listener);
+		::unlink(socket_path.c_str());
+		return 0;
+	}
+}
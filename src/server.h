@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+// A long-running compiler process, so a build that compiles many small files
+// pays for loading the compiler once. The server accepts one request at a time
+// on a Unix socket and runs it like the command line would, in the client's
+// working directory; the log output is streamed back while the request runs.
+// The wire format and the client side are in protocol.h.
+namespace Server
+{
+	// $XDG_RUNTIME_DIR/cygnus.sock, or /tmp/cygnus-<uid>.sock
+	std::string default_socket();
+
+	// serves requests until interrupted; returns the exit status
+	int serve(const std::string &socket_path);
+}
@@ -0,0 +1,73 @@
+#include "constant.h"
+
+#include <cstring>
+
+ConstantId ConstantPool::integer(std::int64_t value)
+{
+	auto [it, added] = integers.emplace(value, constants.size());
+	if(added)
+	{
+		Constant constant = { Constant::Kind::Integer, {}, {} };
+		constant.integer = value;
+		constants.push_back(constant);
+	}
+	return it->second;
+}
+
+ConstantId ConstantPool::real(double value)
+{
+	std::uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	auto [it, added] = reals.emplace(bits, constants.size());
+	if(added)
+	{
+		Constant constant = { Constant::Kind::Float, {}, {} };
+		constant.real = value;
+		constants.push_back(constant);
+	}
+	return it->second;
+}
+
+ConstantId ConstantPool::string(std::string_view value)
+{
+	auto [it, added] = strings.emplace(value, constants.size());
+	if(added)
+	{
+		Constant constant = { Constant::Kind::String, {}, value };
+		constants.push_back(constant);
+	}
+	return it->second;
+}
+
+const Constant &ConstantPool::operator[](ConstantId id) const
+{
+	return constants[id];
+}
+
+size_t ConstantPool::size() const
+{
+	return constants.size();
+}
+
+std::vector<ConstantId> ConstantPool::merge(const ConstantPool &other)
+{
+	std::vector<ConstantId> ids;
+	ids.reserve(other.size());
+	for(const auto &constant : other.constants)
+	{
+		switch(constant.kind)
+		{
+			case Constant::Kind::Integer:
+				ids.push_back(integer(constant.integer));
+				break;
+			case Constant::Kind::Float:
+				ids.push_back(real(constant.real));
+				break;
+			case Constant::Kind::String:
+				ids.push_back(string(constant.text));
+				break;
+		}
+	}
+	return ids;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using ConstantId = std::uint32_t;
+constexpr ConstantId no_constant = UINT32_MAX;
+
+// the value of a literal, decoded once by the lexer
+struct Constant
+{
+	enum class Kind : std::uint8_t
+	{
+		Integer,
+		Float,
+		String
+	} kind;
+
+	union
+	{
+		std::int64_t integer;
+		double real;
+	};
+	// of a string, the characters between the quotes
+	std::string_view text;
+};
+
+// The constants of one compilation, each value stored once. Literal tokens
+// refer to their constant by index, so later stages never parse literal text.
+class ConstantPool
+{
+public:
+	ConstantId integer(std::int64_t value);
+	ConstantId real(double value);
+	ConstantId string(std::string_view value);
+
+	const Constant &operator[](ConstantId id) const;
+	size_t size() const;
+
+	// adds the constants of other that are not in this pool yet, and returns
+	// the index each of other's constants has here
+	std::vector<ConstantId> merge(const ConstantPool &other);
+
+private:
+	std::vector<Constant> constants;
+	std::unordered_map<std::int64_t, ConstantId> integers;
+	// by bit pattern, so 0.0 and -0.0 stay apart
+	std::unordered_map<std::uint64_t, ConstantId> reals;
+	std::unordered_map<std::string_view, ConstantId> strings;
+};
@@ -1,13 +1,14 @@
 #include "lexer.h"
 
-#include "util/error.h"
 #include "lang.h"
 
 #include <cctype>
+#include <charconv>
 
-Lexer::Lexer(std::string_view file, std::string_view source)
-	: file(file),
-	  source(source),
+Lexer::Lexer(std::string_view source, Util::DiagnosticEngine &diagnostics, unsigned first_line)
+	: source(source),
+	  first_line(first_line),
+	  diagnostics(diagnostics),
 	  error(false)
 {
 }
@@ -30,10 +31,11 @@ Token Lexer::tokenize_string_literal(std::string_view::const_iterator &it, std::
 		if(*it == '\n')
 		{
 			error = true;
-			Util::Error(
-			    initial_quote, { line, column + 1 },
-			    "unterminated string literal"
-			).print(file, source);
+			diagnostics.report(
+			    initial_quote,
+			    { line, column + 1 },
+			    Util::DiagnosticCode::UnterminatedString
+			);
 
 			line++;
 			column = 0;
@@ -49,10 +51,12 @@ Token Lexer::tokenize_string_literal(std::string_view::const_iterator &it, std::
 	// closing quotation mark
 	column++;
 
+	auto value = std::string_view(begin, length);
 	return
 	{
 		.type = TokenType::String,
-		.value = std::string_view(begin, length),
+		.constant = constants.string(value),
+		.value = value,
 		.location = initial_quote
 	};
 }
@@ -126,11 +130,42 @@ Token Lexer::tokenize_number_literal(std::string_view::const_iterator &it, std::
 	it--;
 	column--;
 
+	auto value = std::string_view(begin, length);
+	Util::FileLocation location = { line, column - length + 1 };
+
+	// decimals are floats; a trailing point is read as ".0"
+	auto first = value.data(), last = first + value.size();
+	auto constant = no_constant;
+	if(value.find('.') == std::string_view::npos)
+	{
+		std::int64_t integer = 0;
+		if(std::from_chars(first, last, integer).ec == std::errc())
+			constant = constants.integer(integer);
+		else
+		{
+			error = true;
+			diagnostics.report(location, { line, column + 1 }, Util::DiagnosticCode::IntegerOverflow, value);
+		}
+	}
+	else
+	{
+		if(value.back() == '.') last--;
+		double real = 0;
+		if(std::from_chars(first, last, real, std::chars_format::fixed).ec == std::errc())
+			constant = constants.real(real);
+		else
+		{
+			error = true;
+			diagnostics.report(location, { line, column + 1 }, Util::DiagnosticCode::FloatOverflow, value);
+		}
+	}
+
 	return
 	{
 		.type = TokenType::Number,
-		.value = std::string_view(begin, length),
-		.location = { line, column - length + 1 }
+		.constant = constant,
+		.value = value,
+		.location = location
 	};
 }
 
@@ -172,9 +207,24 @@ std::vector<Token> Lexer::tokenize()
 {
 	std::vector<Token> tokens;
 
-	unsigned line = 1;
+	unsigned line = first_line;
 	unsigned column = 0;
 
+	// a chunk after the first starts on a line of its own
+	bool newline = first_line > 1;
+	auto push = [&](const Token &token)
+	{
+		tokens.push_back(
+		{
+			.type = token.type,
+			.newline = newline,
+			.constant = token.constant,
+			.value = token.value,
+			.location = token.location
+		});
+		newline = false;
+	};
+
 	const auto &end = source.cend();
 	for(auto it = source.cbegin(); it != end; it++)
 	{
@@ -185,12 +235,7 @@ std::vector<Token> Lexer::tokenize()
 		{
 			if(*it == '\n')
 			{
-				tokens.push_back(
-				{
-					.type = TokenType::Separator,
-					.value = "\n",
-					.location = { line, column }
-				});
+				newline = true;
 				line++;
 				column = 0;
 			}
@@ -209,12 +254,7 @@ std::vector<Token> Lexer::tokenize()
 				it++;
 				column++;
 			}
-			tokens.push_back(
-			{
-				.type = TokenType::Separator,
-				.value = "\n",
-				.location = { line, column }
-			});
+			newline = true;
 			line++;
 			column = 0;
 		}
@@ -222,7 +262,7 @@ std::vector<Token> Lexer::tokenize()
 		// string literal
 		else if(*it == '"')
 		{
-			tokens.push_back(tokenize_string_literal(it, end, line, column));
+			push(tokenize_string_literal(it, end, line, column));
 		}
 
 		// operator/separator
@@ -232,37 +272,101 @@ std::vector<Token> Lexer::tokenize()
 			if(token.type == TokenType::Invalid)
 			{
 				error = true;
-				Util::Error(
+				diagnostics.report(
 				    token.location,
-				    "unexpected symbol '", *it, "'"
-				).print(file, source);
+				    Util::DiagnosticCode::UnexpectedSymbol,
+				    *it
+				);
 			}
 
-			tokens.push_back(token);
+			push(token);
 		}
 
 		// number literal
 		else if(isdigit(*it))
 		{
-			tokens.push_back(tokenize_number_literal(it, end, line, column));
+			push(tokenize_number_literal(it, end, line, column));
 		}
 
 		// identifier/keyword/word operator
 		else if(isalpha(*it) || *it == '_')
 		{
-			tokens.push_back(tokenize_identifier_keyword(it, end, line, column));
+			push(tokenize_identifier_keyword(it, end, line, column));
 		}
 
 		// invalid
 		else
 		{
 			error = true;
-			Util::Error(
-			{ line, column },
-			"unexpected symbol '", *it, "'"
-			).print(file, source);
+			diagnostics.report(
+			    { line, column },
+			    Util::DiagnosticCode::UnexpectedSymbol,
+			    *it
+			);
 		}
 	}
 
 	return tokens;
 }
+
+// Strings and comments end at the end of their line, so every line starts
+// outside of them; a line is at the top level if the braces and parentheses
+// before it are balanced. Only lines starting with a definition are used, so
+// the statement before a split can't continue past it.
+std::vector<Lexer::Split> Lexer::split(std::string_view source, size_t count)
+{
+	std::vector<Split> splits;
+	if(count < 2) return splits;
+
+	auto starts_definition = [&](size_t i)
+	{
+		while(i < source.size() && (source[i] == ' ' || source[i] == '\t')) i++;
+		for(std::string_view keyword : { "func", "var" })
+		{
+			auto after = i + keyword.size();
+			if(source.compare(i, keyword.size(), keyword) == 0
+			   && after < source.size() && !isalnum(source[after]) && source[after] != '_')
+				return true;
+		}
+		return false;
+	};
+
+	size_t target = source.size() / count;
+	long depth = 0;
+	unsigned line = 1;
+	bool quoted = false;
+	for(size_t i = 0; i < source.size(); i++)
+	{
+		switch(source[i])
+		{
+			case '\n':
+				line++;
+				quoted = false;
+				if(depth == 0 && i + 1 >= target && i + 1 < source.size() && starts_definition(i + 1))
+				{
+					splits.push_back({ i + 1, line });
+					if(splits.size() == count - 1) return splits;
+					target = source.size() / count * (splits.size() + 1);
+				}
+				break;
+			case '"':
+				quoted = !quoted;
+				break;
+			case '#':
+				if(!quoted)
+				{
+					while(i + 1 < source.size() && source[i + 1] != '\n') i++;
+				}
+				break;
+			case '{':
+			case '(':
+				if(!quoted) depth++;
+				break;
+			case '}':
+			case ')':
+				if(!quoted) depth--;
+				break;
+		}
+	}
+	return splits;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "util/diagnostic.h"
 #include "token.h"
+#include "constant.h"
 
 #include <string_view>
 #include <vector>
@@ -8,13 +10,29 @@
 class Lexer
 {
 public:
-	Lexer(std::string_view file, std::string_view source);
+	// source may be part of a file, starting at the beginning of first_line
+	Lexer(std::string_view source, Util::DiagnosticEngine &diagnostics, unsigned first_line = 1);
 	bool failed() const;
 
 	std::vector<Token> tokenize();
 
+	// the values of the literals tokenized so far
+	ConstantPool constants;
+
+	// the beginning of a top-level 'func' or 'var' line, where a file can be
+	// cut and both sides lexed and parsed on their own
+	struct Split
+	{
+		size_t offset;
+		unsigned line;
+	};
+	// up to count - 1 splits, spread as evenly as the source allows
+	static std::vector<Split> split(std::string_view source, size_t count);
+
 private:
-	std::string_view file, source;
+	std::string_view source;
+	unsigned first_line;
+	Util::DiagnosticEngine &diagnostics;
 	bool error;
 
 	Token tokenize_string_literal(std::string_view::const_iterator &it, std::string_view::const_iterator end, unsigned &line, unsigned &column);
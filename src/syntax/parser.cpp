@@ -4,15 +4,22 @@
 
 #include <type_traits>
 
-using Util::Error;
+Parser::Parser(const std::vector<Token> &tokens, Util::DiagnosticEngine &diagnostics, unsigned max_errors)
+	: Parser(tokens, 0, tokens.size(), diagnostics, max_errors)
+{
+}
 
-Parser::Parser(const std::vector<Token> &tokens, std::string_view file, std::string_view source)
-	: it(tokens.cbegin()),
-	  begin(tokens.cbegin()),
-	  end(tokens.cend()),
-	  file(file),
-	  source(source),
-	  error(false)
+Parser::Parser(const std::vector<Token> &tokens, size_t first, size_t last, Util::DiagnosticEngine &diagnostics, unsigned max_errors)
+	: tokens(tokens),
+	  it(tokens.cbegin() + first),
+	  begin(tokens.cbegin() + first),
+	  end(tokens.cbegin() + last),
+	  line_breaks(first == last ? 0 : tokens[first].location.line - 1),
+	  diagnostics(diagnostics),
+	  error(false),
+	  panicking(false),
+	  errors(0),
+	  max_errors(max_errors)
 {
 }
 
@@ -21,6 +28,11 @@ bool Parser::failed() const
 	return error;
 }
 
+size_t Parser::operations() const
+{
+	return steps;
+}
+
 template<typename Base, typename Derived>
 std::unique_ptr<Derived> cast(typename std::remove_reference<std::unique_ptr<Base> &>::type p)
 {
@@ -40,14 +52,13 @@ std::unique_ptr<Program> Parser::program()
 {
 	auto statements = statement_list();
 
-	if(it < end)
+	while(it < end)
 	{
-		error = true;
-		Error::At(*it, "unexpected symbol '", it->value, "'").print(file, source);
+		report_at(*it, Util::DiagnosticCode::UnexpectedSymbol, it->value);
 
 		// find more errors
 		advance();
-		program();
+		statement_list();
 	}
 
 	return std::make_unique<Program>(std::move(statements));
@@ -57,25 +68,22 @@ std::unique_ptr<Program> Parser::program()
 
 std::unique_ptr<Statement> Parser::statement()
 {
-	std::unique_ptr<Statement> stmt;
-	try
-	{
-		if
-		(
-		    (stmt = variable_def()) ||
-		    (stmt = function_def()) ||
-		    (stmt = expr_statement()) ||
-		    (stmt = block())
-		) return stmt;
-	}
-	catch(Util::Error &e)
+	while(true)
 	{
-		error = true;
-		e.print(file, source);
-		return panic();
-	}
+		auto start = position();
 
-	return nullptr;
+		std::unique_ptr<Statement> stmt = variable_def();
+		if(!stmt && !panicking) stmt = function_def();
+		if(!stmt && !panicking) stmt = import_decl();
+		if(!stmt && !panicking) stmt = expr_statement();
+		if(!stmt && !panicking) stmt = block();
+
+		if(!panicking) return stmt;
+
+		// skip the rest of the broken statement and try again
+		panicking = false;
+		synchronize(start);
+	}
 }
 
 std::unique_ptr<Statement> Parser::expr_statement()
@@ -95,21 +103,23 @@ std::unique_ptr<VariableDef> Parser::variable_def()
 	{
 		auto name_token = match(TokenType::Identifier);
 		if(!name_token)
-			expect("name");
-		auto name = std::make_unique<Identifier>(*name_token, nullptr);
+			return expect("name");
+		auto name = std::make_unique<Identifier>(index(*name_token), nullptr);
 
 		auto typ = type_annotation();
+		if(panicking) return nullptr;
 
 		std::unique_ptr<Expression> value;
 		if(match("="))
 		{
 			value = expression();
+			if(panicking) return nullptr;
 			if(!value)
-				expect("expression");
+				return expect("expression");
 		}
 
 		if(!value && !typ)
-			expect("'=' or type annotation");
+			return expect("'=' or type annotation");
 
 		return std::make_unique<VariableDef>(std::move(name), std::move(typ), std::move(value));
 	}
@@ -117,17 +127,31 @@ std::unique_ptr<VariableDef> Parser::variable_def()
 	return nullptr;
 }
 
+std::unique_ptr<Import> Parser::import_decl()
+{
+	if(auto keyword = match("import"))
+	{
+		auto name = match(TokenType::Identifier);
+		if(!name)
+			return expect("module name");
+
+		return std::make_unique<Import>(index(*keyword), index(*name));
+	}
+
+	return nullptr;
+}
+
 std::unique_ptr<FunctionDef> Parser::function_def()
 {
 	if(match("func"))
 	{
 		auto name_token = match(TokenType::Identifier);
 		if(!name_token)
-			expect("name");
-		auto name = std::make_unique<Identifier>(*name_token, nullptr);
+			return expect("name");
+		auto name = std::make_unique<Identifier>(index(*name_token), nullptr);
 
 		if(!match("("))
-			expect("'('");
+			return expect("'('");
 
 		std::vector<std::unique_ptr<Parameter>> parameters;
 
@@ -136,30 +160,32 @@ std::unique_ptr<FunctionDef> Parser::function_def()
 			if(token().value == ")" && last_token().value != ",") break;
 
 			auto param = parameter();
+			if(panicking) return nullptr;
 			if(!param)
-				expect(last_token().value == "," ? "parameter" : "parameter or ')'");
+				return expect(last_token().value == "," ? "parameter" : "parameter or ')'");
 			parameters.push_back(std::move(param));
 
 			if(token().value != ")" && token().value != ",")
-				expect("')' or ','");
+				return expect("')' or ','");
 
 			match(",");
 		}
 
 		if(!match(")"))
-			expect("')'");
+			return expect("')'");
 
 		std::unique_ptr<Type> typ;
 		if(match("->"))
 		{
 			typ = type();
 			if(!typ)
-				expect("type");
+				return expect("type");
 		}
 
 		auto body = block();
+		if(panicking) return nullptr;
 		if(!body)
-			expect("'{'");
+			return expect("'{'");
 
 		return std::make_unique<FunctionDef>(std::move(name), std::move(parameters), std::move(typ), std::move(body));
 	}
@@ -169,25 +195,140 @@ std::unique_ptr<FunctionDef> Parser::function_def()
 
 // expressions
 
+// Pratt parser driven by an explicit stack of pending operators, groups and calls,
+// so arbitrarily deep nesting does not consume native stack
 std::unique_ptr<Expression> Parser::expression(int rbp)
 {
-	trim();
-	if(Lang::null_precedence(token()) == -1)
-		return nullptr;
+	std::vector<Frame> frames;
 
-	auto const &first = token();
-	advance();
-	trim();
+	while(true)
+	{
+		auto tree = operand(frames);
+		if(panicking) return nullptr;
+
+		if(!tree)
+		{
+			if(frames.empty())
+				return nullptr;
+
+			auto &frame = frames.back();
+			switch(frame.type)
+			{
+				case Frame::Type::Group:
+				{
+					// unit
+					tree = literal(*frame.token);
+					if(!tree)
+						return expect("expression or ')'");
+
+					frames.pop_back();
+					break;
+				}
+
+				case Frame::Type::Call:
+					return expect(last_token().value == "," ? "expression" : "expression or ')'");
+
+				default:
+					return expect("expression");
+			}
+		}
+
+		// extend the operand with operators, reducing frames until one needs another operand
+		bool need_operand = false;
+		while(!need_operand)
+		{
+			int bp = frames.empty() ? rbp : frames.back().rbp;
+
+			if(it < end && bp < Lang::left_precedence(token()))
+			{
+				auto const &next = token();
+				advance();
+
+				if(next.type == TokenType::Separator)
+				{
+					tree = call_expr(frames, next, std::move(tree));
+					if(panicking) return nullptr;
+					need_operand = !tree;
+				}
+				else if(Lang::is_postfix(next))
+				{
+					tree = std::make_unique<PostfixOperator>(index(next), std::move(tree));
+				}
+				else
+				{
+					int prec = Lang::left_precedence(next);
+					frames.push_back({Frame::Type::Infix, &next, Lang::is_right_associative(next) ? prec - 1 : prec, std::move(tree)});
+					need_operand = true;
+				}
+				continue;
+			}
+
+			if(frames.empty())
+				return tree;
+
+			auto &frame = frames.back();
+			switch(frame.type)
+			{
+				case Frame::Type::Prefix:
+					tree = std::make_unique<PrefixOperator>(index(*frame.token), std::move(tree));
+					break;
+
+				case Frame::Type::Infix:
+					tree = std::make_unique<InfixOperator>(index(*frame.token), std::move(frame.left), std::move(tree));
+					break;
+
+				case Frame::Type::Group:
+				{
+					auto rparen = match(")");
+					if(!rparen)
+						return expect("')'");
+
+					tree = std::make_unique<GroupExpr>(index(*frame.token), std::move(tree), index(*rparen));
+					break;
+				}
 
-	auto tree = null_denotation(first);
+				case Frame::Type::Call:
+				{
+					frame.arguments.push_back(std::move(tree));
+
+					if(token().value != ")" && token().value != ",")
+						return expect("')' or ','");
+
+					match(",");
+					if(token().value != ")" || last_token().value == ",")
+					{
+						need_operand = true;
+						continue;
+					}
+
+					auto rparen = match(")");
+					tree = std::make_unique<FunctionCall>(cast<Expression, Identifier>(std::move(frame.left)), std::move(frame.arguments), index(*rparen));
+					break;
+				}
+			}
+			frames.pop_back();
+		}
+	}
+}
 
-	while(it < end && rbp < Lang::left_precedence(token()))
+// prefix operators and opening parentheses are pushed as frames; returns the first primary expression
+std::unique_ptr<Expression> Parser::operand(std::vector<Frame> &frames)
+{
+	while(true)
 	{
-		auto const &next = token();
+		trim();
+		if(Lang::null_precedence(token()) == -1)
+			return nullptr;
+
+		auto const &first = token();
 		advance();
-		tree = left_denotation(next, std::move(tree));
+		trim();
+
+		if(first.type == TokenType::Operator || first.type == TokenType::Separator)
+			frames.push_back({first.type == TokenType::Operator ? Frame::Type::Prefix : Frame::Type::Group, &first, Lang::null_precedence(first)});
+		else
+			return null_denotation(first);
 	}
-	return tree;
 }
 
 std::unique_ptr<Expression> Parser::null_denotation(const Token &tok)
@@ -213,157 +354,53 @@ std::unique_ptr<Expression> Parser::null_denotation(const Token &tok)
 		}
 
 		case TokenType::Identifier:
-			return std::make_unique<Identifier>(tok, nullptr);
-
-		case TokenType::Operator:
-			return prefix_operator_expr(tok);
-
-		case TokenType::Separator:
-		{
-			if(tok.value == "(")
-			{
-				auto expr = group_expr(tok);
-
-				// unit
-				if(!expr)
-					expr = literal(tok);
-
-				if(!expr)
-					expect("expression or ')'");
-
-				return std::move(expr);
-			}
-			else
-				return nullptr;
-		}
-
-		default:
-			return nullptr;
-	}
-}
-
-std::unique_ptr<Expression> Parser::left_denotation(const Token &tok, std::unique_ptr<Expression> left)
-{
-	switch(tok.type)
-	{
-		case TokenType::Operator:
-		{
-			if(Lang::is_postfix(tok))
-				return postfix_operator_expr(tok, std::move(left));
-			else
-				return infix_operator_expr(tok, std::move(left));
-		}
-
-		case TokenType::Separator:
-		{
-			if(tok.value == "(")
-				return call_expr(tok, std::move(left));
-			else
-				return nullptr;
-		}
+			return std::make_unique<Identifier>(index(tok), nullptr);
 
 		default:
 			return nullptr;
 	}
 }
 
-
-std::unique_ptr<Expression> Parser::prefix_operator_expr(const Token &tok)
-{
-	int prec = Lang::null_precedence(tok);
-
-	auto operand = expression(prec);
-	if(!operand)
-		expect("expression");
-
-	return std::make_unique<PrefixOperator>(tok, std::move(operand));
-}
-
-std::unique_ptr<Expression> Parser::infix_operator_expr(const Token &tok, std::unique_ptr<Expression> left)
-{
-	int prec = Lang::left_precedence(tok);
-
-	auto right = expression(Lang::is_right_associative(tok) ? prec - 1 : prec);
-	if(!right)
-		expect("expression");
-
-	return std::make_unique<InfixOperator>(tok, std::move(left), std::move(right));
-}
-
-std::unique_ptr<Expression> Parser::postfix_operator_expr(const Token &tok, std::unique_ptr<Expression> left)
-{
-	return std::make_unique<PostfixOperator>(tok, std::move(left));
-}
-
-std::unique_ptr<Expression> Parser::call_expr(const Token &tok, std::unique_ptr<Expression> left)
+// returns the finished call if it has no arguments, otherwise pushes a frame for them
+std::unique_ptr<Expression> Parser::call_expr(std::vector<Frame> &frames, const Token &tok, std::unique_ptr<Expression> left)
 {
 	// prevent calls on invalid tokens
 	if(is_valid_index(-2))
 	{
-		if((it - 2)->type != TokenType::Identifier)
+		if((it - 1)->newline || (it - 2)->type != TokenType::Identifier)
 		{
-			error = true;
-			Error::At(*(it - 1), "unexpected symbol '", last_token().value, "'").print(file, source);
+			report_at(*(it - 1), Util::DiagnosticCode::UnexpectedSymbol, last_token().value);
 		}
 	}
 
-	std::vector<std::unique_ptr<Expression>> arguments;
-
-	while(true)
+	if(token().value != ")")
 	{
-		if(token().value == ")" && last_token().value != ",") break;
-
-		auto arg = expression(0);
-		if(!arg)
-			expect(last_token().value == "," ? "expression" : "expression or ')'");
-		arguments.push_back(std::move(arg));
-
-		if(token().value != ")" && token().value != ",")
-			expect("')' or ','");
-
-		match(",");
+		frames.push_back({Frame::Type::Call, &tok, Lang::null_precedence(tok), std::move(left)});
+		return nullptr;
 	}
 
 	auto rparen = match(")");
-	if(!rparen)
-		expect("')'");
-
-	return std::make_unique<FunctionCall>(cast<Expression, Identifier>(std::move(left)), std::move(arguments), std::move(*rparen));
-}
-
-std::unique_ptr<Expression> Parser::group_expr(const Token &tok)
-{
-	int prec = Lang::null_precedence(tok);
-
-	auto expr = expression(prec);
-	if(expr)
-	{
-		auto rparen = match(")");
-		if(!rparen)
-			expect("')'");
-
-		return std::make_unique<GroupExpr>(tok, std::move(expr), *rparen);
-	}
-
-	return nullptr;
+	return std::make_unique<FunctionCall>(cast<Expression, Identifier>(std::move(left)), std::vector<std::unique_ptr<Expression>>{}, index(*rparen));
 }
 
 std::unique_ptr<Expression> Parser::return_expr(const Token &tok)
 {
 	auto value = expression();
+	if(panicking) return nullptr;
 
-	return std::make_unique<ReturnExpr>(tok, std::move(value));
+	return std::make_unique<ReturnExpr>(index(tok), std::move(value));
 }
 
 std::unique_ptr<Expression> Parser::if_expr(const Token &tok)
 {
 	auto condition = expression();
+	if(panicking) return nullptr;
 	if(!condition)
-		expect("expression");
+		return expect("expression");
 
 	auto if_branch = statement();
 	if(!if_branch)
-		expect("'{' or statement");
+		return expect("'{' or statement");
 
 	auto else_keyword = match("else");
 	std::unique_ptr<Statement> else_branch;
@@ -371,23 +408,24 @@ std::unique_ptr<Expression> Parser::if_expr(const Token &tok)
 	{
 		else_branch = statement();
 		if(!else_branch)
-			expect("'{' or statement");
+			return expect("'{' or statement");
 	}
 
-	return std::make_unique<IfExpr>(tok, std::move(condition), std::move(if_branch), std::move(*else_keyword), std::move(else_branch));
+	return std::make_unique<IfExpr>(index(tok), std::move(condition), std::move(if_branch), index(else_keyword), std::move(else_branch));
 }
 
 std::unique_ptr<Expression> Parser::while_expr(const Token &tok)
 {
 	auto condition = expression();
+	if(panicking) return nullptr;
 	if(!condition)
-		expect("expression");
+		return expect("expression");
 
 	auto body = statement();
 	if(!body)
-		expect("'{' or statement");
+		return expect("'{' or statement");
 
-	return std::make_unique<WhileExpr>(tok, std::move(condition), std::move(body));
+	return std::make_unique<WhileExpr>(index(tok), std::move(condition), std::move(body));
 }
 
 std::unique_ptr<Expression> Parser::literal(const Token &tok)
@@ -395,15 +433,15 @@ std::unique_ptr<Expression> Parser::literal(const Token &tok)
 	switch(tok.type)
 	{
 		case TokenType::Number:
-			return std::make_unique<NumberLiteral>(tok);
+			return std::make_unique<NumberLiteral>(index(tok));
 
 		case TokenType::String:
-			return std::make_unique<StringLiteral>(tok);
+			return std::make_unique<StringLiteral>(index(tok));
 
 		case TokenType::Keyword:
 		{
 			if(Lang::is_boolean(tok.value))
-				return std::make_unique<BooleanLiteral>(tok);
+				return std::make_unique<BooleanLiteral>(index(tok));
 			else
 				return nullptr;
 		}
@@ -415,12 +453,7 @@ std::unique_ptr<Expression> Parser::literal(const Token &tok)
 			{
 				if(match(")"))
 				{
-					return std::make_unique<UnitLiteral>(Token
-					{
-						.type = TokenType::Separator,
-						.value = "()",
-						.location = tok.location
-					});
+					return std::make_unique<UnitLiteral>(index(tok));
 				}
 
 				return nullptr;
@@ -446,39 +479,39 @@ std::vector<std::unique_ptr<Statement>> Parser::statement_list()
 		statements.push_back(std::move(stmt));
 
 		// semicolon separation
-		if(it->value == ";")
+		if(token().value == ";")
 		{
 			auto semi = it;
-			if((it - 1)->value == "\n" || (it + 1)->value == "\n")
-			{
-				it = semi;
+			// the end of the file counts as a line break
+			if(semi->newline || it + 1 == end || (it + 1)->newline)
 				continue;
-			}
-			it++;
+			advance();
 			stmt = statement();
 			if(!stmt)
 			{
-				error = true;
-				Error::At(*semi, "unexpected symbol '", semi->value, "'").print(file, source);
+				report_at(*semi, Util::DiagnosticCode::UnexpectedSymbol, semi->value);
 			}
 		}
 		// newline separation
 		else
 		{
-			auto sep = (it - 1);
+			// the next statement starts after a line break that was stepped
+			// over; standing on one, as after a postfix operator, is not enough
+			auto sep = position();
 			stmt = statement();
-			if(stmt && sep->value != "\n")
+			if(stmt && (sep.line_breaks || !sep.it->newline))
 			{
-				it = sep + 1;
-				error = true;
-				Error::After(*sep, "expected newline or ';'").print(file, source);
+				it = sep.it;
+				line_breaks = sep.line_breaks;
+				report_after(*(it - 1), Util::DiagnosticCode::ExpectedNewline);
 				advance();
-				stmt = panic();
+				synchronize(position());
+				stmt = statement();
 			}
 		}
 	}
 
-	return std::move(statements);
+	return statements;
 }
 
 std::unique_ptr<Block> Parser::block()
@@ -490,9 +523,9 @@ std::unique_ptr<Block> Parser::block()
 
 		auto rbrace = match("}");
 		if(!rbrace)
-			expect("'}'");
+			return expect("'}'");
 
-		return std::make_unique<Block>(std::move(*lbrace), std::move(statements), std::move(*rbrace));
+		return std::make_unique<Block>(index(*lbrace), std::move(statements), index(*rbrace));
 	}
 
 	return nullptr;
@@ -503,11 +536,12 @@ std::unique_ptr<Parameter> Parser::parameter()
 	auto name_token = match(TokenType::Identifier);
 	if(name_token)
 	{
-		auto name = std::make_unique<Identifier>(*name_token, nullptr);
+		auto name = std::make_unique<Identifier>(index(*name_token), nullptr);
 
 		auto type = type_annotation();
+		if(panicking) return nullptr;
 		if(!type)
-			expect("type annotation");
+			return expect("type annotation");
 
 		return std::make_unique<Parameter>(std::move(name), std::move(type));
 	}
@@ -521,7 +555,7 @@ std::unique_ptr<Type> Parser::type_annotation()
 	{
 		auto typ = type();
 		if(!typ)
-			expect("type");
+			return expect("type");
 
 		return typ;
 	}
@@ -535,7 +569,7 @@ std::unique_ptr<Type> Parser::type()
 	auto name_token = match(TokenType::Identifier);
 	if(name_token)
 	{
-		return std::make_unique<Type>(*name_token);
+		return std::make_unique<Type>(index(*name_token));
 	}
 	// unit
 	else
@@ -545,16 +579,10 @@ std::unique_ptr<Type> Parser::type()
 		{
 			if(!match(")"))
 			{
-				error = true;
-				Error::At(*(it - 1), "unexpected symbol '('");
+				report_at(*lparen, Util::DiagnosticCode::UnexpectedSymbol, "(");
 			}
 
-			return std::make_unique<Type>(Token
-			{
-				.type = TokenType::Separator,
-				.value = "()",
-				.location = lparen->location
-			});
+			return std::make_unique<Type>(index(*lparen));
 		}
 	}
 	return nullptr;
@@ -564,7 +592,9 @@ std::unique_ptr<Type> Parser::type()
 
 const Token &Parser::token() const
 {
-	static Token inv;
+	static const Token inv;
+	static const Token newline = { .type = TokenType::Separator, .value = "\n" };
+	if(line_breaks) return newline;
 	if(it == end) return inv;
 
 	return *it;
@@ -572,15 +602,35 @@ const Token &Parser::token() const
 
 const Token &Parser::last_token() const
 {
-	unsigned offset = 1;
-	while((it - offset)->type == TokenType::Separator && (it - offset)->value == "\n")
-		offset++;
-	return *(it - offset);
+	return *(it - 1);
 }
 
 void Parser::advance()
 {
+	steps++;
+	if(line_breaks)
+	{
+		line_breaks--;
+		return;
+	}
 	it++;
+	// one per line, as tokens never span lines
+	line_breaks = it < end && it->newline ? it->location.line - (it - 1)->location.line : 0;
+}
+
+Parser::Position Parser::position() const
+{
+	return { it, line_breaks };
+}
+
+TokenIndex Parser::index(const Token &token) const
+{
+	return &token - tokens.data();
+}
+
+TokenIndex Parser::index(const Token *token) const
+{
+	return token ? index(*token) : no_token;
 }
 
 bool Parser::is_valid_index(int n) const
@@ -588,61 +638,59 @@ bool Parser::is_valid_index(int n) const
 	return it + n >= begin && it + n <= end;
 }
 
-std::optional<const Token> Parser::match(TokenType type)
+const Token *Parser::match(TokenType type)
 {
+	trim();
 	if(it == end)
-		return {};
+		return nullptr;
 
-	trim();
 	if(it->type == type)
 	{
 		auto old = it;
 		advance();
 		trim();
-		return *old;
+		return &*old;
 	}
 
-	return {};
+	return nullptr;
 }
 
-std::optional<const Token> Parser::match(std::string_view value)
+const Token *Parser::match(std::string_view value)
 {
+	trim();
 	if(it == end)
-		return {};
+		return nullptr;
 
-	trim();
 	if(it->value == value)
 	{
 		auto old = it;
 		advance();
 		trim();
-		return *old;
+		return &*old;
 	}
 
-	return {};
+	return nullptr;
 }
 
-std::optional<const Token> Parser::match(TokenType type, std::string_view value)
+const Token *Parser::match(TokenType type, std::string_view value)
 {
 	trim();
-	if(it->value == value) return match(type);
-	else return {};
+	if(it < end && it->value == value) return match(type);
+	else return nullptr;
 }
 
 void Parser::trim()
 {
-	while(it->type == TokenType::Separator && it->value == "\n")
-		advance();
+	line_breaks = 0;
 }
 
-Util::Error Parser::expect(std::string_view expect, bool _throw)
+std::nullptr_t Parser::expect(std::string_view expect)
 {
-	error = true;
-
 	trim();
 
-	std::string value = "'" + std::string(it->value) + "'";
-	switch(it->type)
+	const auto &tok = token();
+	std::string value = "'" + std::string(tok.value) + "'";
+	switch(tok.type)
 	{
 		case TokenType::Keyword:
 			value = "keyword " + value;
@@ -654,26 +702,67 @@ Util::Error Parser::expect(std::string_view expect, bool _throw)
 			break;
 	}
 
-	auto error =
-	    it->type == TokenType::Invalid
-	    ? Error::After(*(it - 2), "expected ", expect)
-	    : Error::At(*it, "expected ", expect, ", found ", value);
-
-	if(_throw)
-		throw error;
+	if(tok.type == TokenType::Invalid)
+		report_after(*(it - 1), Util::DiagnosticCode::Expected, expect);
 	else
-		return error;
+		report_at(tok, Util::DiagnosticCode::ExpectedFound, expect, value);
+	panicking = true;
+
+	return nullptr;
 }
 
-std::unique_ptr<Statement> Parser::panic()
+void Parser::count_error()
 {
-	std::unique_ptr<Statement> stmt;
+	error = true;
+	errors++;
 
-	while(!(it->type == TokenType::Separator && (it->value == "\n" || it->value == ";")) && it < end)
-		advance();
-	if(it->value == ";")
+	// give up on the rest of the file
+	if(max_errors != 0 && errors >= max_errors && !gave_up)
+	{
+		gave_up = true;
+		diagnostics.report_general(Util::DiagnosticCode::TooManyErrors, diagnostics.file());
+		it = end;
+		line_breaks = 0;
+	}
+}
+
+void Parser::synchronize(Position start)
+{
+	// always make progress
+	if(position() == start && it < end)
 		advance();
 
-	stmt = statement();
-	return stmt;
+	// braces opened while skipping are skipped as a whole
+	unsigned depth = 0;
+	while(it < end)
+	{
+		if(line_breaks)
+		{
+			if(depth == 0)
+				return;
+			advance();
+			continue;
+		}
+
+		if(it->type == TokenType::Separator)
+		{
+			if(it->value == "{")
+				depth++;
+			else if(it->value == "}")
+			{
+				if(depth == 0)
+					return;
+				depth--;
+			}
+			else if(depth == 0 && it->value == ";")
+			{
+				advance();
+				return;
+			}
+		}
+		else if(depth == 0 && it->type == TokenType::Keyword && Lang::is_statement_keyword(it->value))
+			return;
+
+		advance();
+	}
 }
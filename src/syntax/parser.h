@@ -1,28 +1,57 @@
 #pragma once
 
-#include "util/error.h"
+#include "util/diagnostic.h"
 #include "ast/node.h"
 #include "token.h"
 
 #include <vector>
 #include <memory>
 #include <string_view>
-#include <optional>
+#include <cstddef>
 
 class Parser
 {
 public:
-	Parser(const std::vector<Token> &tokens, std::string_view file, std::string_view source);
+	Parser(const std::vector<Token> &tokens, Util::DiagnosticEngine &diagnostics, unsigned max_errors = 100);
+	// parses tokens[first, last) on their own; the nodes refer to tokens by
+	// their index in the whole list
+	Parser(const std::vector<Token> &tokens, size_t first, size_t last, Util::DiagnosticEngine &diagnostics, unsigned max_errors = 100);
 	bool failed() const;
 
 	std::unique_ptr<Program> parse();
 
+	// tokens stepped over so far, counting every revisit
+	size_t operations() const;
+
 private:
+	const std::vector<Token> &tokens;
 	std::vector<Token>::const_iterator it;
 	const std::vector<Token>::const_iterator begin, end;
+	// line breaks before *it that are still to be stepped over: advance steps
+	// over one at a time, trim and match over all of them, and a statement
+	// ends on one
+	unsigned line_breaks;
+
+	struct Position
+	{
+		std::vector<Token>::const_iterator it;
+		unsigned line_breaks;
+
+		bool operator==(const Position &other) const
+		{
+			return it == other.it && line_breaks == other.line_breaks;
+		}
+	};
+	Position position() const;
 
-	std::string_view file, source;
+	Util::DiagnosticEngine &diagnostics;
 	bool error;
+	// set when a syntax error was reported and the current statement should be abandoned
+	bool panicking;
+	// 0 for no limit
+	unsigned errors, max_errors;
+	bool gave_up = false;
+	mutable size_t steps = 0;
 
 	std::unique_ptr<Program> program();
 	std::unique_ptr<Statement> statement();
@@ -31,17 +60,23 @@ private:
 	// statements
 	std::unique_ptr<VariableDef> variable_def();
 	std::unique_ptr<FunctionDef> function_def();
+	std::unique_ptr<Import> import_decl();
 
 	// expressions
+	// operator, group or call whose (next) operand is still being parsed
+	struct Frame
+	{
+		enum class Type { Prefix, Infix, Group, Call } type;
+		const Token *token;
+		int rbp;
+		std::unique_ptr<Expression> left = nullptr;
+		std::vector<std::unique_ptr<Expression>> arguments = {};
+	};
+
 	std::unique_ptr<Expression> expression(int rbp = 0);
+	std::unique_ptr<Expression> operand(std::vector<Frame> &frames);
 	std::unique_ptr<Expression> null_denotation(const Token &token);
-	std::unique_ptr<Expression> left_denotation(const Token &token, std::unique_ptr<Expression> left);
-
-	std::unique_ptr<Expression> prefix_operator_expr(const Token &token);
-	std::unique_ptr<Expression> infix_operator_expr(const Token &token, std::unique_ptr<Expression> left);
-	std::unique_ptr<Expression> postfix_operator_expr(const Token &token, std::unique_ptr<Expression> left);
-	std::unique_ptr<Expression> group_expr(const Token &token);
-	std::unique_ptr<Expression> call_expr(const Token &token, std::unique_ptr<Expression> left);
+	std::unique_ptr<Expression> call_expr(std::vector<Frame> &frames, const Token &token, std::unique_ptr<Expression> left);
 	std::unique_ptr<Expression> return_expr(const Token &token);
 	std::unique_ptr<Expression> if_expr(const Token &token);
 	std::unique_ptr<Expression> while_expr(const Token &token);
@@ -59,10 +94,31 @@ private:
 	const Token &last_token() const;
 	void advance();
 	bool is_valid_index(int n) const;
-	std::optional<const Token> match(TokenType type);
-	std::optional<const Token> match(std::string_view value);
-	std::optional<const Token> match(TokenType type, std::string_view value);
+	TokenIndex index(const Token &token) const;
+	TokenIndex index(const Token *token) const;
+	// the matched token, or null
+	const Token *match(TokenType type);
+	const Token *match(std::string_view value);
+	const Token *match(TokenType type, std::string_view value);
 	void trim();
-	Util::Error expect(std::string_view expect, bool _throw = true);
-	std::unique_ptr<Statement> panic();
+	std::nullptr_t expect(std::string_view expect);
+	void count_error();
+	// syntax errors past max_errors are counted but not recorded
+	bool recording() const
+	{
+		return max_errors == 0 || errors < max_errors;
+	}
+	template<typename... Args>
+	void report_at(const Token &token, Util::DiagnosticCode code, Args &&... args)
+	{
+		if(recording()) diagnostics.report_at(token, code, std::forward<Args>(args)...);
+		count_error();
+	}
+	template<typename... Args>
+	void report_after(const Token &token, Util::DiagnosticCode code, Args &&... args)
+	{
+		if(recording()) diagnostics.report_after(token, code, std::forward<Args>(args)...);
+		count_error();
+	}
+	void synchronize(Position start);
 };
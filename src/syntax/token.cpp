@@ -1,19 +1,6 @@
 #include "token.h"
 
 #include <ostream>
-#include <regex>
-
-Token::Token(TokenType type, std::string_view value, Util::FileLocation location)
-	: type(type),
-	  value(value),
-	  location(location)
-{}
-
-Token::Token()
-	: type(TokenType::Invalid),
-	  value(""),
-	  location({})
-{}
 
 constexpr const char *type_to_string(TokenType type)
 {
@@ -40,5 +27,20 @@ constexpr const char *type_to_string(TokenType type)
 
 std::ostream &operator<<(std::ostream &stream, const Token &token)
 {
-	return stream << "[" << type_to_string(token.type) << "] " << std::regex_replace(std::string(token.value), std::regex("\n"), "\\n");
+	if(token.newline) stream << "\\n ";
+	stream << "[" << type_to_string(token.type) << "] ";
+	// line breaks in strings are escaped
+	for(auto c : token.value)
+	{
+		if(c == '\n') stream << "\\n";
+		else stream << c;
+	}
+	return stream;
+}
+
+const Token &token_at(const std::vector<Token> &tokens, TokenIndex index)
+{
+	static const Token invalid;
+	if(index == no_token) return invalid;
+	return tokens[index];
 }
@@ -1,10 +1,13 @@
 #pragma once
 
 #include "util/util.h"
+#include "constant.h"
 
+#include <cstdint>
 #include <string_view>
+#include <vector>
 
-enum class TokenType
+enum class TokenType : std::uint8_t
 {
 	Invalid,
 	Number,
@@ -18,12 +21,21 @@ enum class TokenType
 class Token
 {
 public:
-	Token(TokenType type, std::string_view value, Util::FileLocation loc);
-	Token();
-
-	const TokenType type;
-	const std::string_view value;
-	const Util::FileLocation location;
+	const TokenType type = TokenType::Invalid;
+	// a line break comes between this token and the one before it; line
+	// breaks are not tokens of their own
+	const bool newline = false;
+	// of a literal, its value in the lexer's constant pool
+	const ConstantId constant = no_constant;
+	const std::string_view value = "";
+	const Util::FileLocation location = {};
 
 	friend std::ostream &operator<<(std::ostream &stream, const Token &token);
 };
+
+// position of a token in the token list of its file
+using TokenIndex = std::uint32_t;
+constexpr TokenIndex no_token = UINT32_MAX;
+
+// an invalid token for no_token
+const Token &token_at(const std::vector<Token> &tokens, TokenIndex index);
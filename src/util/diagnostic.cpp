@@ -0,0 +1,605 @@
+#include "diagnostic.h"
+
+#include "log.h"
+#include "util/noderange.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <stdexcept>
+#include <climits>
+#include <unordered_map>
+#include <utility>
+
+namespace Util
+{
+	namespace
+	{
+		constexpr unsigned outer_radius = 1,
+		                   inner_radius_top = 3,
+		                   inner_radius_bottom = 1,
+		                   arrow_padding = 3;
+		constexpr char sym_pointer = '^',
+		               sym_arrow_h = '_',
+		               sym_arrow_v = '|',
+		               sym_arrow_d = '/',
+		               sym_separator = '|';
+
+		constexpr auto reset = "\033[0m";
+		constexpr auto normal = "\033[22m";
+		constexpr auto bold = "\033[1m";
+		constexpr auto color1 = "\033[31m";
+		constexpr auto color2 = "\033[34m";
+
+		unsigned count_spaces(const std::string &str)
+		{
+			unsigned spaces = 0;
+			while(isspace(str[spaces++]));
+			return --spaces;
+		}
+
+		std::pair<unsigned, unsigned> subtract(unsigned a, unsigned b)
+		{
+			if(a >= b) return {a - b, 0};
+			else return {0, b - a};
+		}
+
+		// formats the source lines around one diagnostic
+		class Excerpt
+		{
+		public:
+			Excerpt(FileLocation begin, FileLocation end, std::string message)
+				: begin(begin),
+				  end(end),
+				  message(std::move(message))
+			{
+			}
+
+			const FileLocation begin, end;
+			const std::string message;
+
+			unsigned min_line_index = 0,
+			         max_line_index = 0;
+			std::unordered_map<unsigned, std::pair<std::string, std::string>> modifiers;
+
+			template<typename... Args>
+			void add_modifier(std::unordered_map<unsigned, std::pair<std::string, std::string>> &modifiers, size_t i, const char *prefix, Args &&... args)
+			{
+				std::stringstream stream;
+				(stream << ... << args);
+				modifiers[i] = {prefix, stream.str()};
+			}
+
+			void format_single(std::vector<std::string> &lines);
+			void format_single_error(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length);
+			void format_single_normal(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length);
+
+			void format_multi(std::vector<std::string> &lines);
+			void format_multi_start(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length);
+			void format_multi_mid(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length);
+			void format_multi_end(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length);
+			void format_multi_normal(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length);
+
+			void format_line_numbers(std::vector<std::string> &lines);
+		};
+
+		// single line
+
+		void Excerpt::format_single(std::vector<std::string> &lines)
+		{
+			std::stringstream stream;
+
+			unsigned outer_space = UINT_MAX;
+			for(size_t i = 0; i < lines.size(); i++)
+			{
+				if(lines[i].empty()) continue;
+				const unsigned spaces = count_spaces(lines[i]);
+				if(spaces < outer_space) outer_space = spaces;
+			}
+
+			unsigned inner_space = UINT_MAX;
+			if(!lines[min_line_index].empty())
+			{
+				const unsigned spaces = count_spaces(lines[min_line_index]);
+				if(spaces < inner_space) inner_space = spaces;
+			}
+			else inner_space = outer_space;
+
+			auto shift_length = outer_space;
+			if(shift_length > inner_space) shift_length = inner_space;
+
+			for(size_t i = 0; i < lines.size(); i++)
+			{
+				auto &line = lines[i];
+
+				if(min_line_index == max_line_index)
+				{
+					// error line
+					if(i == min_line_index)
+						format_single_error(stream, line, i, shift_length);
+
+					//normal line
+					else
+						format_single_normal(stream, line, i, shift_length);
+				}
+
+				line = stream.str();
+				stream.str(std::string());
+				stream.clear();
+			}
+		}
+
+		void Excerpt::format_single_error(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length)
+		{
+			if(line != "")
+			{
+				const auto str1 = line.substr(0, begin.column - 1).substr(shift_length),
+				           str2 = line.substr(begin.column - 1, end.column - begin.column),
+				           str3 = line.substr(end.column - 1);
+				stream << str1 << bold << color1 << str2 << reset << str3;
+			}
+
+			const auto pointer = std::string(end.column - begin.column, sym_pointer);
+			add_modifier(modifiers, i, "", color1, std::setw(end.column - 1 - shift_length), pointer, " ", normal, message, reset);
+		}
+
+		void Excerpt::format_single_normal(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length)
+		{
+			if(line != "")
+				stream << line.substr(shift_length);
+		}
+
+		// multiline
+
+		void Excerpt::format_multi(std::vector<std::string> &lines)
+		{
+			std::stringstream stream;
+
+			unsigned outer_space = UINT_MAX;
+			for(size_t i = 0; i < lines.size(); i++)
+			{
+				if(lines[i].empty()) continue;
+				const unsigned spaces = count_spaces(lines[i]);
+				if(spaces < outer_space) outer_space = spaces;
+			}
+
+			unsigned inner_space = UINT_MAX;
+			for(size_t i = min_line_index; i <= max_line_index; i++)
+			{
+				if(lines[i].empty()) continue;
+				const unsigned spaces = count_spaces(lines[i]);
+				if(spaces < inner_space) inner_space = spaces;
+			}
+
+			auto shift_length = 1 + arrow_padding + outer_space;
+			if(shift_length > inner_space) shift_length = inner_space;
+
+			for(size_t i = 0; i < lines.size(); i++)
+			{
+				auto &line = lines[i];
+
+				// first error line
+				if(i == min_line_index)
+					format_multi_start(stream, line, i, shift_length);
+
+				// mid error line
+				else if(i > min_line_index && i < max_line_index)
+					format_multi_mid(stream, line, i, shift_length);
+
+				// last error line
+				else if(i == max_line_index)
+					format_multi_end(stream, line, i, shift_length);
+
+				// normal line
+				else
+					format_multi_normal(stream, line, i, shift_length);
+
+				line = stream.str();
+				stream.str(std::string());
+				stream.clear();
+			}
+		}
+
+		void Excerpt::format_multi_start(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length)
+		{
+			const auto sub = subtract(arrow_padding, shift_length);
+
+			const bool error_in_front = begin.column <= 1 + count_spaces(line); // begin.column - spaces <= 1
+
+			if(error_in_front)
+			{
+				const auto arrow = sym_arrow_d + std::string(sub.first, ' ');
+				if(line != "")
+				{
+					const auto str = line.substr(sub.second);
+					stream << color1 << arrow << bold << color1 << str << reset;
+				}
+				else
+				{
+					stream << color1 << arrow;
+				}
+			}
+			else
+			{
+				if(line != "")
+				{
+					const auto padding = std::string(1 + sub.first, ' ');
+					if(line != "")
+					{
+						const auto str1 = line.substr(0, begin.column - 1).substr(sub.second),
+						           str2 = line.substr(begin.column - 1);
+						stream << color1 << padding << reset << str1 << bold << color1 << str2 << reset;
+					}
+				}
+
+				const auto arrow = " " + std::string(begin.column - 1 + sub.first - sub.second, sym_arrow_h);
+				add_modifier(modifiers, i, "", color1, arrow, sym_pointer, reset);
+			}
+		}
+
+		void Excerpt::format_multi_mid(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length)
+		{
+			const auto sub = subtract(arrow_padding, shift_length);
+
+			// within radius
+			if(
+			    (i > min_line_index && i <= min_line_index + inner_radius_top) ||
+			    (i >= max_line_index - inner_radius_bottom && i < max_line_index))
+			{
+				const auto arrow = sym_arrow_v + std::string(sub.first, ' ');
+				if(line != "")
+				{
+					const auto str = line.substr(sub.second);
+					stream << color1 << arrow << bold << str << reset;
+				}
+				else
+				{
+					stream << color1 << arrow;
+				}
+
+				if(i == min_line_index + inner_radius_top)
+				{
+					add_modifier(modifiers, i, "...", color1, sym_arrow_v, reset);
+				}
+			}
+			// outside of radius
+			else if(i > min_line_index + inner_radius_top && i < max_line_index - inner_radius_bottom)
+			{
+				add_modifier(modifiers, i, "\b", "");
+			}
+		}
+
+		void Excerpt::format_multi_end(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length)
+		{
+			const auto sub = subtract(arrow_padding, shift_length);
+
+			auto arrow = sym_arrow_v + std::string(sub.first, ' ');
+			if(line != "")
+			{
+				const auto str1 = line.substr(0, end.column - 1).substr(sub.second),
+				           str2 = line.substr(end.column - 1);
+				stream << color1 << arrow << bold << str1 << reset << str2 << reset;
+			}
+			else
+			{
+				stream << color1 << arrow << reset;
+			}
+
+			arrow = sym_arrow_v + std::string(end.column - 2 + sub.first - sub.second, sym_arrow_h);
+			add_modifier(modifiers, i, "", color1, arrow, sym_pointer, " ", normal, message, reset);
+
+		}
+
+		void Excerpt::format_multi_normal(std::stringstream &stream, const std::string &line, size_t i, unsigned shift_length)
+		{
+			if(line != "")
+			{
+				const auto sub = subtract(1 + arrow_padding, shift_length);
+				const auto str = line.substr(sub.second);
+				stream << std::string(sub.first, ' ') << str;
+			}
+		}
+
+		void Excerpt::format_line_numbers(std::vector<std::string> &lines)
+		{
+			std::stringstream stream;
+
+			unsigned side_width = std::to_string(end.line + 1 + outer_radius).length();
+			for(auto &p : modifiers)
+			{
+				const auto width = p.second.first.length();
+				if(width > side_width) side_width = width;
+			}
+
+			for(size_t i = 0; i < lines.size(); i++)
+			{
+				auto &line = lines[i];
+
+				if(modifiers[i].first != "\b")
+				{
+					const auto line_number = (i + begin.line - min_line_index);
+					stream << color2 << std::setw(side_width) << line_number;
+					stream << " " << sym_separator << " " << reset << line;
+
+					// special line
+					if(modifiers.find(i) != modifiers.end() && modifiers[i].second != "")
+					{
+						const auto &prefix = modifiers[i].first;
+						const auto &line = modifiers[i].second;
+
+						stream << "\n";
+						stream << color2 << std::setw(side_width) << prefix;
+						stream << " " << sym_separator << " " << reset << line;
+					}
+				}
+
+				line = stream.str();
+				stream.str(std::string());
+				stream.clear();
+			}
+
+			stream << color2 << std::setw(side_width + 2) << sym_separator << reset;
+			lines.insert(lines.begin(), stream.str());
+			stream.str(std::string());
+			stream.clear();
+
+			stream << color2 << std::setw(side_width + 2) << sym_separator << reset;
+			lines.push_back(stream.str());
+			stream.str(std::string());
+			stream.clear();
+		}
+	}
+
+	// message templates, indexed by DiagnosticCode; '{}' is replaced by the next argument
+	constexpr const char *templates[] =
+	{
+		// lexer
+		"unterminated string literal",
+		"unexpected symbol '{}'",
+		"integer literal '{}' does not fit in 64 bits",
+		"float literal '{}' is out of range",
+
+		// parser
+		"expected {}",
+		"expected {}, found {}",
+		"expected newline or ';'",
+		"too many errors in '{}', stopping",
+
+		// symbol table
+		"symbol '{}' is already defined",
+		"symbol '{}' is not defined",
+		"no module named '{}'",
+		"symbol '{}' imported from '{}' is already defined",
+		"imports must be at the top level",
+
+		// type checker
+		"call to non-function type '{}'",
+		"mismatched number of arguments to '{}': expected {}, found {}",
+		"mismatched argument types for '{}': expected '{}', found '{}'",
+		"left-hand expression is not assignable",
+		"mismatched types '{}' and '{}' for operator '{}'",
+		"mismatched type '{}' for operator '{}'",
+		"mismatched type for condition: expected '{}', found '{}'",
+		"inferred type '{}' does not match explicit type '{}'",
+		"body return type '{}' does not match signature return type '{}'",
+		"mismatched types '{}' and '{}' for if/else branches",
+		"invalid type '{}'",
+
+		// C backend
+		"{} is not supported when compiling to C",
+
+		// interpreter
+		"{} is not supported when running a program"
+	};
+	static_assert(std::size(templates) == static_cast<size_t>(DiagnosticCode::NotRunnable) + 1);
+
+	DiagnosticEngine::DiagnosticEngine(std::string_view file, std::string_view source, const std::vector<Token> &tokens)
+		: file_name(file),
+		  source_text(source),
+		  token_list(&tokens)
+	{
+	}
+
+	std::string_view DiagnosticEngine::file() const
+	{
+		return file_name;
+	}
+
+	std::string_view DiagnosticEngine::source() const
+	{
+		return source_text;
+	}
+
+	const std::vector<Token> &DiagnosticEngine::tokens() const
+	{
+		return *token_list;
+	}
+
+	const std::vector<Diagnostic> &DiagnosticEngine::diagnostics() const
+	{
+		return records;
+	}
+
+	bool DiagnosticEngine::empty() const
+	{
+		return records.empty();
+	}
+
+	void DiagnosticEngine::merge(const std::vector<size_t> &positions, std::vector<DiagnosticEngine> &parts)
+	{
+		size_t added = 0;
+		for(const auto &part : parts)
+			added += part.records.size();
+		if(added == 0) return;
+
+		std::vector<Diagnostic> merged;
+		merged.reserve(records.size() + added);
+		size_t next = 0;
+		for(size_t i = 0; i < parts.size(); i++)
+		{
+			merged.insert(merged.end(), records.begin() + next, records.begin() + positions[i]);
+			next = positions[i];
+
+			auto offset = static_cast<std::uint32_t>(arguments.size());
+			for(auto diagnostic : parts[i].records)
+			{
+				diagnostic.first_argument += offset;
+				merged.push_back(diagnostic);
+			}
+			std::move(parts[i].arguments.begin(), parts[i].arguments.end(), std::back_inserter(arguments));
+		}
+		merged.insert(merged.end(), records.begin() + next, records.end());
+		records = std::move(merged);
+	}
+
+	const std::vector<size_t> &DiagnosticEngine::line_table() const
+	{
+		if(line_offsets.empty())
+		{
+			text_length = source_text.size();
+			line_offsets.push_back(0);
+			for(size_t i = 0; i < source_text.size(); i++)
+			{
+				if(source_text[i] == '\n')
+					line_offsets.push_back(i + 1);
+				else if(source_text[i] == '\0' && text_length == source_text.size())
+					text_length = i;
+			}
+			steps += source_text.size();
+		}
+		return line_offsets;
+	}
+
+	size_t DiagnosticEngine::operations() const
+	{
+		return steps;
+	}
+
+	std::string DiagnosticEngine::message(const Diagnostic &diagnostic) const
+	{
+		std::string message;
+
+		auto arg = arguments.begin() + diagnostic.first_argument;
+		for(auto c = templates[static_cast<size_t>(diagnostic.code)]; *c; c++)
+		{
+			if(c[0] == '{' && c[1] == '}')
+			{
+				message += *arg++;
+				c++;
+			}
+			else
+				message += *c;
+		}
+
+		return message;
+	}
+
+	FileLocation DiagnosticEngine::location(const Diagnostic &diagnostic) const
+	{
+		if(diagnostic.node) return NodeRange(diagnostic.node, *token_list).begin;
+		return diagnostic.begin;
+	}
+
+	std::string DiagnosticEngine::excerpt(const Diagnostic &diagnostic) const
+	{
+		FileLocation begin = diagnostic.begin,
+		             end = diagnostic.end;
+		if(diagnostic.node)
+		{
+			NodeRange range(diagnostic.node, *token_list);
+			begin = range.begin;
+			end = range.end;
+		}
+
+		if(begin.line <= 0 || begin.column <= 0 || end.line <= 0 || end.column <= 0)
+		{
+			throw std::out_of_range("line or column is 0");
+		}
+		else if(end.column == 1)
+		{
+			throw std::out_of_range("end column shorter than line");
+		}
+
+		Excerpt excerpt(begin, end, message(diagnostic));
+
+		// 1. get lines around the span; lines are numbered from 1, the source is
+		// cut at the first null character and a trailing newline ends the last line
+		const auto &offsets = line_table();
+		const auto text = source_text.substr(0, text_length);
+
+		std::vector<std::string> lines;
+		for(unsigned n = begin.line > outer_radius + 1 ? begin.line - outer_radius - 1 : 0; n <= end.line + outer_radius - 1; n++)
+		{
+			if(n >= offsets.size() || offsets[n] >= text.size()) break;
+
+			auto line_end = n + 1 < offsets.size() ? offsets[n + 1] - 1 : source_text.size();
+			if(line_end > text.size()) line_end = text.size();
+
+			// standardize tab size
+			std::string line;
+			steps += line_end - offsets[n];
+			for(auto c : text.substr(offsets[n], line_end - offsets[n]))
+			{
+				if(c == '\t') line += "    ";
+				else line += c;
+			}
+
+			if(n == begin.line - 1)
+			{
+				excerpt.min_line_index = lines.size();
+				// add whitespace to end
+				if(begin.column > line.length())
+					line += std::string(begin.column - line.length(), ' ');
+			}
+			if(n == end.line - 1)
+			{
+				excerpt.max_line_index = lines.size();
+				// add whitespace to end
+				if(end.column > line.length())
+					line += std::string(end.column - line.length(), ' ');
+			}
+			lines.push_back(std::move(line));
+		}
+
+		// 2. format error
+		if(excerpt.min_line_index == excerpt.max_line_index)
+			excerpt.format_single(lines);
+		else
+			excerpt.format_multi(lines);
+
+		// 3. add line numbers
+		excerpt.format_line_numbers(lines);
+
+		std::stringstream stream;
+		stream << bold << " " << file_name << ":" << begin.line << ":" << begin.column << reset << "\n";
+		for(const auto &line : lines)
+		{
+			stream << line << "\n";
+		}
+		stream << "\n";
+		return stream.str();
+	}
+
+	void DiagnosticEngine::print(const Diagnostic &diagnostic) const
+	{
+		auto message = this->message(diagnostic);
+		if(message.empty()) return;
+
+		// not tied to a location
+		if(!diagnostic.node && diagnostic.begin.line <= 0 && diagnostic.begin.column <= 0)
+		{
+			Logger::get().error(message);
+			return;
+		}
+
+		Logger::get().error_with(excerpt(diagnostic), message);
+	}
+
+	void DiagnosticEngine::print()
+	{
+		for(; printed < records.size(); printed++)
+		{
+			print(records[printed]);
+		}
+	}
+}
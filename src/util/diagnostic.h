@@ -0,0 +1,202 @@
+#pragma once
+
+#include "util.h"
+#include "syntax/token.h"
+#include "ast/node.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+using Util::FileLocation;
+
+namespace Util
+{
+	enum class DiagnosticCode : std::uint8_t
+	{
+		// lexer
+		UnterminatedString,
+		UnexpectedSymbol,
+		IntegerOverflow,
+		FloatOverflow,
+
+		// parser
+		Expected,
+		ExpectedFound,
+		ExpectedNewline,
+		TooManyErrors,
+
+		// symbol table
+		AlreadyDefined,
+		NotDefined,
+		ModuleNotFound,
+		ImportConflict,
+		ImportNotTopLevel,
+
+		// type checker
+		CallToNonFunction,
+		ArgumentCount,
+		ArgumentType,
+		NotAssignable,
+		OperatorTypes,
+		OperatorType,
+		ConditionType,
+		InferredType,
+		ReturnType,
+		BranchTypes,
+		InvalidType,
+
+		// C backend
+		Unsupported,
+
+		// interpreter
+		NotRunnable
+	};
+
+	// a reported error; the message and source excerpt are only built when rendered
+	struct Diagnostic
+	{
+		// if set, the span is the range of this node, computed when rendered
+		Node *node;
+		FileLocation begin, end;
+		DiagnosticCode code;
+		std::uint8_t argument_count;
+		std::uint32_t first_argument;
+	};
+
+	// collects the diagnostics of one file; rendering fills caches, so an
+	// engine is used by one thread at a time
+	class DiagnosticEngine
+	{
+	public:
+		// tokens is the token list the reported nodes refer to
+		DiagnosticEngine(std::string_view file, std::string_view source, const std::vector<Token> &tokens);
+
+		std::string_view file() const;
+		std::string_view source() const;
+		const std::vector<Token> &tokens() const;
+
+		template<typename... Args>
+		void report(Node *const node, DiagnosticCode code, Args &&... args)
+		{
+			add(node, {}, {}, code, std::forward<Args>(args)...);
+		}
+
+		template<typename... Args>
+		void report(FileLocation begin, FileLocation end, DiagnosticCode code, Args &&... args)
+		{
+			add(nullptr, begin, end, code, std::forward<Args>(args)...);
+		}
+
+		template<typename... Args>
+		void report(FileLocation begin, DiagnosticCode code, Args &&... args)
+		{
+			add(nullptr, begin, { begin.line, begin.column + 1 }, code, std::forward<Args>(args)...);
+		}
+
+		// spans the token
+		template<typename... Args>
+		void report_at(const Token &token, DiagnosticCode code, Args &&... args)
+		{
+			FileLocation end
+			(
+			    token.location.line,
+			    token.location.column + token.value.length() + (token.type == TokenType::String ? 2 : 0)
+			);
+
+			report(token.location, end, code, std::forward<Args>(args)...);
+		}
+
+		// points just past the token
+		template<typename... Args>
+		void report_after(const Token &token, DiagnosticCode code, Args &&... args)
+		{
+			unsigned column = 0;
+			switch(token.type)
+			{
+				case TokenType::Invalid:
+					column = token.location.column;
+					break;
+				case TokenType::String:
+					column = token.location.column + token.value.length() + 2;
+					break;
+				default:
+					column = token.location.column + token.value.length();
+					break;
+			}
+
+			report(FileLocation(token.location.line, column), code, std::forward<Args>(args)...);
+		}
+
+		// not tied to a location; rendered as a single line
+		template<typename... Args>
+		void report_general(DiagnosticCode code, Args &&... args)
+		{
+			add(nullptr, {}, {}, code, std::forward<Args>(args)...);
+		}
+
+		const std::vector<Diagnostic> &diagnostics() const;
+		bool empty() const;
+
+		// inserts what each part reported before the diagnostic at its position,
+		// as if it had been reported there; positions are ascending
+		void merge(const std::vector<size_t> &positions, std::vector<DiagnosticEngine> &parts);
+
+		std::string message(const Diagnostic &diagnostic) const;
+		// where the diagnostic starts; 0:0 if it is not tied to a location
+		FileLocation location(const Diagnostic &diagnostic) const;
+		// the source excerpt shown below the message
+		std::string excerpt(const Diagnostic &diagnostic) const;
+
+		// prints everything reported since the last call
+		void print();
+
+		// source bytes scanned while rendering so far
+		size_t operations() const;
+
+	private:
+		std::string_view file_name, source_text;
+		const std::vector<Token> *token_list;
+
+		std::vector<Diagnostic> records;
+		std::vector<std::string> arguments;
+		size_t printed = 0;
+
+		// start offset of every line and the length of the source up to the
+		// first null character, built on first render
+		mutable std::vector<size_t> line_offsets;
+		mutable size_t text_length = 0;
+		mutable size_t steps = 0;
+		const std::vector<size_t> &line_table() const;
+
+		void print(const Diagnostic &diagnostic) const;
+
+		template<typename... Args>
+		void add(Node *const node, FileLocation begin, FileLocation end, DiagnosticCode code, Args &&... args)
+		{
+			Diagnostic diagnostic = { node, begin, end, code, sizeof...(Args), static_cast<std::uint32_t>(arguments.size()) };
+			(arguments.push_back(argument(std::forward<Args>(args))), ...);
+			records.push_back(diagnostic);
+		}
+
+		static std::string argument(std::string_view value) { return std::string(value); }
+		static std::string argument(const std::string &value) { return value; }
+		static std::string argument(const char *value) { return value; }
+		static std::string argument(char value) { return std::string(1, value); }
+		template<typename T>
+		static std::string argument(const T &value)
+		{
+			if constexpr(std::is_integral_v<T>)
+				return std::to_string(value);
+			else
+			{
+				std::stringstream stream;
+				stream << value;
+				return stream.str();
+			}
+		}
+	};
+}
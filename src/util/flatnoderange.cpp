@@ -0,0 +1,169 @@
+#include "flatnoderange.h"
+
+#include "syntax/token.h"
+
+namespace Util
+{
+	// the tree is walked with an explicit stack, as operator chains, groups
+	// and calls can nest arbitrarily deep
+	FlatNodeRange::FlatNodeRange(const FlatTree &tree, NodeId id)
+		: FlatVisitor(tree)
+	{
+		stack.push_back(id);
+		while(!stack.empty())
+		{
+			auto next = stack.back();
+			stack.pop_back();
+			dispatch(next);
+		}
+	}
+
+	void FlatNodeRange::token_range(const Token &token)
+	{
+		bool is_string = token.type == TokenType::String;
+
+		Util::FileLocation _begin
+		(
+		    token.location.line,
+		    token.location.column
+		);
+		begin = _begin < begin ? _begin : begin;
+
+		Util::FileLocation _end
+		(
+		    token.location.line,
+		    token.location.column + token.value.length() + (is_string ? 2 : 0)
+		);
+		end = _end > end ? _end : end;
+	}
+
+	void FlatNodeRange::add(NodeId id)
+	{
+		if(id != no_node)
+			stack.push_back(id);
+	}
+
+	// main
+
+	void FlatNodeRange::visit(Flat::Program node)
+	{
+		for(auto stmt : node.statements())
+		{
+			add(stmt);
+		}
+	}
+
+	// statements
+
+	void FlatNodeRange::visit(Flat::ExprStatement node)
+	{
+		add(node.expr());
+	}
+	void FlatNodeRange::visit(Flat::VariableDef node)
+	{
+	}
+	void FlatNodeRange::visit(Flat::FunctionDef node)
+	{
+	}
+	void FlatNodeRange::visit(Flat::Import node)
+	{
+		token_range(node.import_keyword());
+		token_range(node.name());
+	}
+
+	// expressions
+
+	void FlatNodeRange::visit(Flat::NumberLiteral node)
+	{
+		token_range(node.token());
+	}
+	void FlatNodeRange::visit(Flat::StringLiteral node)
+	{
+		token_range(node.token());
+	}
+	void FlatNodeRange::visit(Flat::BooleanLiteral node)
+	{
+		token_range(node.token());
+	}
+	void FlatNodeRange::visit(Flat::UnitLiteral node)
+	{
+		// from '(' to ')'
+		token_range(node.token());
+		token_range((*tree.source)[tree.token_index(node.id, 0) + 1]);
+	}
+	void FlatNodeRange::visit(Flat::Identifier node)
+	{
+		token_range(node.token());
+	}
+	void FlatNodeRange::visit(Flat::FunctionCall node)
+	{
+		token_range(node.rparen());
+		add(node.name());
+	}
+	void FlatNodeRange::visit(Flat::InfixOperator node)
+	{
+		add(node.left());
+		add(node.right());
+	}
+	void FlatNodeRange::visit(Flat::PrefixOperator node)
+	{
+		token_range(node.token());
+		add(node.operand());
+	}
+	void FlatNodeRange::visit(Flat::PostfixOperator node)
+	{
+		token_range(node.token());
+		add(node.operand());
+	}
+	void FlatNodeRange::visit(Flat::GroupExpr node)
+	{
+		token_range(node.lparen());
+		token_range(node.rparen());
+		add(node.expr());
+	}
+	void FlatNodeRange::visit(Flat::ReturnExpr node)
+	{
+		token_range(node.return_keyword());
+		add(node.value());
+	}
+	void FlatNodeRange::visit(Flat::IfExpr node)
+	{
+		token_range(node.if_keyword());
+		add(node.if_branch());
+		if(node.else_branch() != no_node)
+		{
+			token_range(node.else_keyword());
+			add(node.else_branch());
+		}
+	}
+	void FlatNodeRange::visit(Flat::WhileExpr node)
+	{
+		token_range(node.while_keyword());
+		add(node.body());
+	}
+
+	// general
+
+	void FlatNodeRange::visit(Flat::Invalid node)
+	{
+	}
+	void FlatNodeRange::visit(Flat::Block node)
+	{
+		token_range(node.lbrace());
+		token_range(node.rbrace());
+	}
+	void FlatNodeRange::visit(Flat::Parameter node)
+	{
+		add(node.name());
+		add(node.type());
+	}
+	void FlatNodeRange::visit(Flat::Type node)
+	{
+		token_range(node.token());
+		// the unit type, from '(' to ')' if it is there
+		const auto &source = *tree.source;
+		auto next = tree.token_index(node.id, 0) + 1;
+		if(node.token().value == "(" && next < source.size() && source[next].value == ")")
+			token_range(source[next]);
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "ast/flat.h"
+
+#include <climits>
+#include <vector>
+
+namespace Util
+{
+	// NodeRange over a FlatTree
+	class FlatNodeRange : public FlatVisitor<FlatNodeRange>
+	{
+	public:
+#include "ast/flatincl"
+
+		FlatNodeRange(const FlatTree &tree, NodeId id);
+
+		Util::FileLocation begin = { UINT_MAX, UINT_MAX };
+		Util::FileLocation end = { 0, 0 };
+
+	private:
+		// nodes whose range is still to be added
+		std::vector<NodeId> stack;
+
+		void token_range(const Token &token);
+		void add(NodeId id);
+	};
+}
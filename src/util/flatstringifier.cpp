@@ -0,0 +1,116 @@
+#include "flatstringifier.h"
+
+namespace Util
+{
+	FlatStringifier::FlatStringifier(const FlatTree &tree)
+		: FlatVisitor(tree)
+	{
+	}
+
+	std::string FlatStringifier::stringify(NodeId id)
+	{
+		return dispatch(id);
+	}
+
+	// main
+
+	std::string FlatStringifier::visit(Flat::Program node)
+	{
+		return "Program";
+	}
+
+	// statements
+
+	std::string FlatStringifier::visit(Flat::ExprStatement node)
+	{
+		return "Expression statement";
+	}
+	std::string FlatStringifier::visit(Flat::VariableDef node)
+	{
+		return "Variable definition '" + std::string(tree.token(node.name(), 0).value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::FunctionDef node)
+	{
+		return "Function definition '" + std::string(tree.token(node.name(), 0).value) + "'";
+	}
+
+	std::string FlatStringifier::visit(Flat::Import node)
+	{
+		return "Import '" + std::string(node.name().value) + "'";
+	}
+
+	// expressions
+
+	std::string FlatStringifier::visit(Flat::NumberLiteral node)
+	{
+		return "Number '" + std::string(node.token().value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::StringLiteral node)
+	{
+		return "String '" + std::string(node.token().value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::BooleanLiteral node)
+	{
+		return "Boolean '" + std::string(node.token().value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::UnitLiteral node)
+	{
+		return "Unit '()'";
+	}
+	std::string FlatStringifier::visit(Flat::Identifier node)
+	{
+		return "Identifier '" + std::string(node.token().value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::FunctionCall node)
+	{
+		return "Function call '" + std::string(tree.token(node.name(), 0).value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::InfixOperator node)
+	{
+		return "Infix operator '" + std::string(node.token().value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::PrefixOperator node)
+	{
+		return "Prefix operator '" + std::string(node.token().value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::PostfixOperator node)
+	{
+		return "Postfix operator '" + std::string(node.token().value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::GroupExpr node)
+	{
+		return "Group expression";
+	}
+	std::string FlatStringifier::visit(Flat::ReturnExpr node)
+	{
+		return "Return expression";
+	}
+	std::string FlatStringifier::visit(Flat::IfExpr node)
+	{
+		return "If expression";
+	}
+	std::string FlatStringifier::visit(Flat::WhileExpr node)
+	{
+		return "While expression";
+	}
+
+	// general
+
+	std::string FlatStringifier::visit(Flat::Invalid node)
+	{
+		return "Invalid";
+	}
+	std::string FlatStringifier::visit(Flat::Block node)
+	{
+		return "Block";
+	}
+	std::string FlatStringifier::visit(Flat::Parameter node)
+	{
+		return "Parameter '" + std::string(tree.token(node.name(), 0).value) + "'";
+	}
+	std::string FlatStringifier::visit(Flat::Type node)
+	{
+		auto name = node.token().value;
+		return "Type '" + std::string(name == "(" ? "()" : name) + "'";
+	}
+}
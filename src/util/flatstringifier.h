@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ast/flat.h"
+
+#include <string>
+
+namespace Util
+{
+	// Stringifier over a FlatTree
+	class FlatStringifier : public FlatVisitor<FlatStringifier, std::string>
+	{
+	public:
+#include "ast/flatincl"
+
+		explicit FlatStringifier(const FlatTree &tree);
+
+		std::string stringify(NodeId id);
+	};
+}
@@ -3,16 +3,14 @@
 #include "syntax/token.h"
 
 #include <iostream>
+#include <vector>
 
 namespace Util
 {
-	NodeRange::NodeRange()
+	NodeRange::NodeRange(Node *const node, const std::vector<Token> &tokens)
+		: tokens(tokens)
 	{
-	}
-
-	NodeRange::NodeRange(Node *const node)
-	{
-		node->accept(*this);
+		dispatch(*node);
 	}
 
 	void NodeRange::token_range(const Token &token)
@@ -34,13 +32,68 @@ namespace Util
 		end = _end > end ? _end : end;
 	}
 
+	// operator chains, groups and calls can nest arbitrarily deep, so they are walked with an explicit stack
+	void NodeRange::nested_range(Expression &root)
+	{
+		std::vector<Expression *> stack = { &root };
+
+		while(!stack.empty())
+		{
+			auto node = stack.back();
+			stack.pop_back();
+
+			switch(node->kind)
+			{
+				case NodeKind::InfixOperator:
+				{
+					auto &op = static_cast<InfixOperator &>(*node);
+					stack.push_back(op.left.get());
+					stack.push_back(op.right.get());
+					break;
+				}
+				case NodeKind::PrefixOperator:
+				{
+					auto &op = static_cast<PrefixOperator &>(*node);
+					token_range(op.token(tokens));
+					stack.push_back(op.operand.get());
+					break;
+				}
+				case NodeKind::PostfixOperator:
+				{
+					auto &op = static_cast<PostfixOperator &>(*node);
+					token_range(op.token(tokens));
+					stack.push_back(op.operand.get());
+					break;
+				}
+				case NodeKind::GroupExpr:
+				{
+					auto &group = static_cast<GroupExpr &>(*node);
+					token_range(group.lparen(tokens));
+					token_range(group.rparen(tokens));
+					stack.push_back(group.expr.get());
+					break;
+				}
+				case NodeKind::FunctionCall:
+				{
+					auto &call = static_cast<FunctionCall &>(*node);
+					token_range(call.rparen(tokens));
+					stack.push_back(call.name.get());
+					break;
+				}
+				default:
+					dispatch(*node);
+					break;
+			}
+		}
+	}
+
 	// main
 
 	void NodeRange::visit(Program &node)
 	{
 		for(const auto &stmt : node.statements)
 		{
-			stmt->accept(*this);
+			dispatch(*stmt);
 		}
 	}
 
@@ -48,7 +101,7 @@ namespace Util
 
 	void NodeRange::visit(ExprStatement &node)
 	{
-		node.expr->accept(*this);
+		dispatch(*node.expr);
 	}
 	void NodeRange::visit(VariableDef &node)
 	{
@@ -56,75 +109,76 @@ namespace Util
 	void NodeRange::visit(FunctionDef &node)
 	{
 	}
+	void NodeRange::visit(Import &node)
+	{
+		token_range(node.import_keyword(tokens));
+		token_range(node.name(tokens));
+	}
 
 	// expressions
 
 	void NodeRange::visit(NumberLiteral &node)
 	{
-		token_range(node.token);
+		token_range(node.token(tokens));
 	}
 	void NodeRange::visit(StringLiteral &node)
 	{
-		token_range(node.token);
+		token_range(node.token(tokens));
 	}
 	void NodeRange::visit(BooleanLiteral &node)
 	{
-		token_range(node.token);
+		token_range(node.token(tokens));
 	}
 	void NodeRange::visit(UnitLiteral &node)
 	{
-		token_range(node.token);
+		// from '(' to ')'
+		token_range(node.token(tokens));
+		token_range(tokens[node.token_index + 1]);
 	}
 	void NodeRange::visit(Identifier &node)
 	{
-		token_range(node.token);
+		token_range(node.token(tokens));
 	}
 	void NodeRange::visit(FunctionCall &node)
 	{
-		node.name->accept(*this);
-		token_range(node.rparen);
+		nested_range(node);
 	}
 	void NodeRange::visit(InfixOperator &node)
 	{
-		node.left->accept(*this);
-		node.right->accept(*this);
+		nested_range(node);
 	}
 	void NodeRange::visit(PrefixOperator &node)
 	{
-		token_range(node.token);
-		node.operand->accept(*this);
+		nested_range(node);
 	}
 	void NodeRange::visit(PostfixOperator &node)
 	{
-		token_range(node.token);
-		node.operand->accept(*this);
+		nested_range(node);
 	}
 	void NodeRange::visit(GroupExpr &node)
 	{
-		token_range(node.lparen);
-		node.expr->accept(*this);
-		token_range(node.rparen);
+		nested_range(node);
 	}
 	void NodeRange::visit(ReturnExpr &node)
 	{
-		token_range(node.return_keyword);
+		token_range(node.return_keyword(tokens));
 		if(node.value)
-			node.value->accept(*this);
+			dispatch(*node.value);
 	}
 	void NodeRange::visit(IfExpr &node)
 	{
-		token_range(node.if_keyword);
-		node.if_branch->accept(*this);
+		token_range(node.if_keyword(tokens));
+		dispatch(*node.if_branch);
 		if(node.else_branch)
 		{
-			token_range(node.else_keyword);
-			node.else_branch->accept(*this);
+			token_range(node.else_keyword(tokens));
+			dispatch(*node.else_branch);
 		}
 	}
 	void NodeRange::visit(WhileExpr &node)
 	{
-		token_range(node.while_keyword);
-		node.body->accept(*this);
+		token_range(node.while_keyword(tokens));
+		dispatch(*node.body);
 	}
 
 	// general
@@ -134,16 +188,20 @@ namespace Util
 	}
 	void NodeRange::visit(Block &node)
 	{
-		token_range(node.lbrace);
-		token_range(node.rbrace);
+		token_range(node.lbrace(tokens));
+		token_range(node.rbrace(tokens));
 	}
 	void NodeRange::visit(Parameter &node)
 	{
-		node.name->accept(*this);
-		node.type->accept(*this);
+		dispatch(*node.name);
+		dispatch(*node.type);
 	}
 	void NodeRange::visit(Type &node)
 	{
-		token_range(node.token);
+		token_range(node.token(tokens));
+		// the unit type, from '(' to ')' if it is there
+		auto next = node.token_index + 1;
+		if(node.token(tokens).value == "(" && next < tokens.size() && tokens[next].value == ")")
+			token_range(tokens[next]);
 	}
 }
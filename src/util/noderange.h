@@ -1,24 +1,28 @@
 #pragma once
 
-#include "ast/visitor.h"
+#include "ast/dispatch.h"
 #include "ast/node.h"
 
 #include <climits>
+#include <vector>
 
 namespace Util
 {
-	class NodeRange : public Visitor
+	class NodeRange : public StaticVisitor<NodeRange>
 	{
 	public:
-#include "ast/visitorincl"
+#include "ast/dispatchincl"
 
-		NodeRange();
-		explicit NodeRange(Node *const node);
+		// tokens is the token list the nodes refer to
+		NodeRange(Node *const node, const std::vector<Token> &tokens);
 
 		Util::FileLocation begin = { UINT_MAX, UINT_MAX };
 		Util::FileLocation end = { 0, 0 };
 
 	private:
+		const std::vector<Token> &tokens;
+
 		void token_range(const Token &token);
+		void nested_range(Expression &root);
 	};
 }
@@ -2,107 +2,115 @@
 
 namespace Util
 {
+	Stringifier::Stringifier(const std::vector<Token> &tokens)
+		: tokens(tokens)
+	{
+	}
+
 	std::string Stringifier::stringify(Node &node)
 	{
-		node.accept(*this);
-		auto temp = value.str();
-		value.str(std::string());
-		return temp;
+		return dispatch(node);
 	}
 
 	// main
 
-	void Stringifier::visit(Program &node)
+	std::string Stringifier::visit(Program &node)
 	{
-		value << "Program";
+		return "Program";
 	}
 
 	// statements
 
-	void Stringifier::visit(ExprStatement &node)
+	std::string Stringifier::visit(ExprStatement &node)
 	{
-		value << "Expression statement";
+		return "Expression statement";
 	}
-	void Stringifier::visit(VariableDef &node)
+	std::string Stringifier::visit(VariableDef &node)
 	{
-		value << "Variable definition '" << node.name->token.value << "'";
+		return "Variable definition '" + std::string(node.name->token(tokens).value) + "'";
 	}
-	void Stringifier::visit(FunctionDef &node)
+	std::string Stringifier::visit(FunctionDef &node)
+	{
+		return "Function definition '" + std::string(node.name->token(tokens).value) + "'";
+	}
+
+	std::string Stringifier::visit(Import &node)
 	{
-		value << "Function definition '" << node.name->token.value << "'";
+		return "Import '" + std::string(node.name(tokens).value) + "'";
 	}
 
 	// expressions
 
-	void Stringifier::visit(NumberLiteral &node)
+	std::string Stringifier::visit(NumberLiteral &node)
 	{
-		value << "Number '" << node.token.value << "'";
+		return "Number '" + std::string(node.token(tokens).value) + "'";
 	}
-	void Stringifier::visit(StringLiteral &node)
+	std::string Stringifier::visit(StringLiteral &node)
 	{
-		value << "String '" << node.token.value << "'";
+		return "String '" + std::string(node.token(tokens).value) + "'";
 	}
-	void Stringifier::visit(BooleanLiteral &node)
+	std::string Stringifier::visit(BooleanLiteral &node)
 	{
-		value << "Boolean '" << node.token.value << "'";
+		return "Boolean '" + std::string(node.token(tokens).value) + "'";
 	}
-	void Stringifier::visit(UnitLiteral &node)
+	std::string Stringifier::visit(UnitLiteral &node)
 	{
-		value << "Unit '" << node.token.value << "'";
+		return "Unit '()'";
 	}
-	void Stringifier::visit(Identifier &node)
+	std::string Stringifier::visit(Identifier &node)
 	{
-		value << "Identifier '" << node.token.value << "'";
+		return "Identifier '" + std::string(node.token(tokens).value) + "'";
 	}
-	void Stringifier::visit(FunctionCall &node)
+	std::string Stringifier::visit(FunctionCall &node)
 	{
-		value << "Function call '" << node.name->token.value << "'";
+		return "Function call '" + std::string(node.name->token(tokens).value) + "'";
 	}
-	void Stringifier::visit(InfixOperator &node)
+	std::string Stringifier::visit(InfixOperator &node)
 	{
-		value << "Infix operator '" << node.token.value << "'";
+		return "Infix operator '" + std::string(node.token(tokens).value) + "'";
 	}
-	void Stringifier::visit(PrefixOperator &node)
+	std::string Stringifier::visit(PrefixOperator &node)
 	{
-		value << "Prefix operator '" << node.token.value << "'";
+		return "Prefix operator '" + std::string(node.token(tokens).value) + "'";
 	}
-	void Stringifier::visit(PostfixOperator &node)
+	std::string Stringifier::visit(PostfixOperator &node)
 	{
-		value << "Postfix operator '" << node.token.value << "'";
+		return "Postfix operator '" + std::string(node.token(tokens).value) + "'";
 	}
-	void Stringifier::visit(GroupExpr &node)
+	std::string Stringifier::visit(GroupExpr &node)
 	{
-		value << "Group expression";
+		return "Group expression";
 	}
-	void Stringifier::visit(ReturnExpr &node)
+	std::string Stringifier::visit(ReturnExpr &node)
 	{
-		value << "Return expression";
+		return "Return expression";
 	}
-	void Stringifier::visit(IfExpr &node)
+	std::string Stringifier::visit(IfExpr &node)
 	{
-		value << "If expression";
+		return "If expression";
 	}
-	void Stringifier::visit(WhileExpr &node)
+	std::string Stringifier::visit(WhileExpr &node)
 	{
-		value << "While expression";
+		return "While expression";
 	}
 
 	// general
 
-	void Stringifier::visit(Invalid &node)
+	std::string Stringifier::visit(Invalid &node)
 	{
-		value << "Invalid";
+		return "Invalid";
 	}
-	void Stringifier::visit(Block &node)
+	std::string Stringifier::visit(Block &node)
 	{
-		value << "Block";
+		return "Block";
 	}
-	void Stringifier::visit(Parameter &node)
+	std::string Stringifier::visit(Parameter &node)
 	{
-		value << "Parameter '" << node.name->token.value << "'";
+		return "Parameter '" + std::string(node.name->token(tokens).value) + "'";
 	}
-	void Stringifier::visit(Type &node)
+	std::string Stringifier::visit(Type &node)
 	{
-		value << "Type '" << node.token.value << "'";
+		auto name = node.token(tokens).value;
+		return "Type '" + std::string(name == "(" ? "()" : name) + "'";
 	}
 }
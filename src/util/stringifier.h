@@ -1,22 +1,25 @@
 #pragma once
 
 #include "log.h"
-#include "ast/visitor.h"
+#include "ast/dispatch.h"
 #include "ast/node.h"
 
 #include <string>
-#include <sstream>
+#include <vector>
 
 namespace Util
 {
-	class Stringifier : public Visitor
+	class Stringifier : public StaticVisitor<Stringifier, std::string>
 	{
 	public:
-#include "ast/visitorincl"
+#include "ast/dispatchincl"
+
+		// tokens is the token list the nodes refer to
+		explicit Stringifier(const std::vector<Token> &tokens);
 
 		std::string stringify(Node &node);
 
 	private:
-		std::stringstream value;
+		const std::vector<Token> &tokens;
 	};
 }
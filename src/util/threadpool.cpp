@@ -0,0 +1,138 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+namespace Util
+{
+	ThreadPool::ThreadPool(unsigned threads)
+		: thread_count(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+	{
+		shares = std::make_unique<Share[]>(thread_count);
+		// the calling thread is thread 0
+		for(unsigned i = 1; i < thread_count; i++)
+		{
+			workers.emplace_back([this, i] { work(i); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(auto &worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	unsigned ThreadPool::size() const
+	{
+		return thread_count;
+	}
+
+	void ThreadPool::for_each(size_t count, const std::function<void(size_t)> &task)
+	{
+		if(count == 0) return;
+
+		for(unsigned i = 0; i < thread_count; i++)
+		{
+			std::lock_guard lock(shares[i].mutex);
+			shares[i].begin = count * i / thread_count;
+			shares[i].end = count * (i + 1) / thread_count;
+		}
+
+		{
+			std::lock_guard lock(mutex);
+			this->task = &task;
+			failure = nullptr;
+			running = thread_count - 1;
+			generation++;
+		}
+		wake.notify_all();
+
+		run(0);
+
+		std::unique_lock lock(mutex);
+		done.wait(lock, [this] { return running == 0; });
+		this->task = nullptr;
+		if(failure) std::rethrow_exception(failure);
+	}
+
+	void ThreadPool::work(unsigned self)
+	{
+		size_t seen = 0;
+		while(true)
+		{
+			{
+				std::unique_lock lock(mutex);
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if(stopping) return;
+				seen = generation;
+			}
+
+			run(self);
+
+			{
+				std::lock_guard lock(mutex);
+				running--;
+			}
+			done.notify_one();
+		}
+	}
+
+	void ThreadPool::run(unsigned self)
+	{
+		size_t index;
+		while(next(self, index))
+		{
+			try
+			{
+				(*task)(index);
+			}
+			catch(...)
+			{
+				std::lock_guard lock(mutex);
+				if(!failure) failure = std::current_exception();
+			}
+		}
+	}
+
+	bool ThreadPool::next(unsigned self, size_t &index)
+	{
+		auto &own = shares[self];
+		{
+			std::lock_guard lock(own.mutex);
+			if(own.begin < own.end)
+			{
+				index = own.begin++;
+				return true;
+			}
+		}
+
+		// steal the back half of the first share that has anything left;
+		// tasks don't add work, so once every share is empty the loop is done
+		for(unsigned offset = 1; offset < thread_count; offset++)
+		{
+			auto &victim = shares[(self + offset) % thread_count];
+			size_t begin, end;
+			{
+				std::lock_guard lock(victim.mutex);
+				if(victim.begin >= victim.end) continue;
+				begin = victim.begin + (victim.end - victim.begin) / 2;
+				end = victim.end;
+				victim.end = begin;
+			}
+
+			// the first stolen index is run right away
+			std::lock_guard lock(own.mutex);
+			index = begin;
+			own.begin = begin + 1;
+			own.end = end;
+			return true;
+		}
+		return false;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Util
+{
+	// Runs the iterations of a loop on a fixed set of threads. Each thread
+	// starts with its own contiguous share of the indices and takes them from
+	// the front; a thread that runs out steals the back half of another
+	// thread's remaining share, so uneven iterations still keep all busy.
+	class ThreadPool
+	{
+	public:
+		// threads includes the calling thread; 0 means one per core
+		explicit ThreadPool(unsigned threads);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		unsigned size() const;
+
+		// calls task(i) for every i < count and returns once all are done;
+		// the first exception thrown by a task is rethrown here
+		void for_each(size_t count, const std::function<void(size_t)> &task);
+
+	private:
+		// the indices [begin, end) a thread has left
+		struct Share
+		{
+			std::mutex mutex;
+			size_t begin = 0, end = 0;
+		};
+
+		std::vector<std::thread> workers;
+		std::unique_ptr<Share[]> shares;
+		unsigned thread_count;
+
+		std::mutex mutex;
+		std::condition_variable wake, done;
+		const std::function<void(size_t)> *task = nullptr;
+		// bumped for every for_each, so workers notice a new loop
+		size_t generation = 0;
+		unsigned running = 0;
+		bool stopping = false;
+		std::exception_ptr failure;
+
+		void work(unsigned self);
+		void run(unsigned self);
+		bool next(unsigned self, size_t &index);
+	};
+}
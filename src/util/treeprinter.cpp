@@ -2,6 +2,11 @@
 
 namespace Util
 {
+	TreePrinter::TreePrinter(const std::vector<Token> &tokens)
+		: str(tokens)
+	{
+	}
+
 	// main
 
 	void TreePrinter::visit(Program &node)
@@ -10,7 +15,7 @@ namespace Util
 		tab_level++;
 		for(const auto &stmt : node.statements)
 		{
-			stmt->accept(*this);
+			dispatch(*stmt);
 		}
 		tab_level--;
 	}
@@ -21,15 +26,15 @@ namespace Util
 	{
 		print(str.stringify(node));
 		tab_level++;
-		node.expr->accept(*this);
+		dispatch(*node.expr);
 		tab_level--;
 	}
 	void TreePrinter::visit(VariableDef &node)
 	{
 		print(str.stringify(node));
 		tab_level++;
-		if(node.type) node.type->accept(*this);
-		if(node.value) node.value->accept(*this);
+		if(node.type) dispatch(*node.type);
+		if(node.value) dispatch(*node.value);
 		tab_level--;
 	}
 	void TreePrinter::visit(FunctionDef &node)
@@ -38,13 +43,18 @@ namespace Util
 		tab_level++;
 		for(const auto &param : node.parameters)
 		{
-			param->accept(*this);
+			dispatch(*param);
 		}
-		if(node.return_type) node.return_type->accept(*this);
-		node.body->accept(*this);
+		if(node.return_type) dispatch(*node.return_type);
+		dispatch(*node.body);
 		tab_level--;
 	}
 
+	void TreePrinter::visit(Import &node)
+	{
+		print(str.stringify(node));
+	}
+
 	// expressions
 
 	void TreePrinter::visit(NumberLiteral &node)
@@ -66,16 +76,16 @@ namespace Util
 	void TreePrinter::visit(Identifier &node)
 	{
 		print(str.stringify(node));
-		if(node.symbol) print("  -> ", str.stringify(*node.symbol->node));
+		if(node.symbol && node.symbol->node) print("  -> ", str.stringify(*node.symbol->node));
 	}
 	void TreePrinter::visit(FunctionCall &node)
 	{
 		print(str.stringify(node));
-		if(node.name->symbol) print("  -> ", str.stringify(*node.name->symbol->node));
+		if(node.name->symbol && node.name->symbol->node) print("  -> ", str.stringify(*node.name->symbol->node));
 		tab_level++;
 		for(const auto &arg : node.arguments)
 		{
-			arg->accept(*this);
+			dispatch(*arg);
 		}
 		tab_level--;
 	}
@@ -83,53 +93,53 @@ namespace Util
 	{
 		print(str.stringify(node));
 		tab_level++;
-		node.left->accept(*this);
-		node.right->accept(*this);
+		dispatch(*node.left);
+		dispatch(*node.right);
 		tab_level--;
 	}
 	void TreePrinter::visit(PrefixOperator &node)
 	{
 		print(str.stringify(node));
 		tab_level++;
-		node.operand->accept(*this);
+		dispatch(*node.operand);
 		tab_level--;
 	}
 	void TreePrinter::visit(PostfixOperator &node)
 	{
 		print(str.stringify(node));
 		tab_level++;
-		node.operand->accept(*this);
+		dispatch(*node.operand);
 		tab_level--;
 	}
 	void TreePrinter::visit(GroupExpr &node)
 	{
 		// print(str.stringify(node));
 		// tab_level++;
-		node.expr->accept(*this);
+		dispatch(*node.expr);
 		// tab_level--;
 	}
 	void TreePrinter::visit(ReturnExpr &node)
 	{
 		print(str.stringify(node));
 		tab_level++;
-		if(node.value) node.value->accept(*this);
+		if(node.value) dispatch(*node.value);
 		tab_level--;
 	}
 	void TreePrinter::visit(IfExpr &node)
 	{
 		print(str.stringify(node));
 		tab_level++;
-		node.condition->accept(*this);
-		node.if_branch->accept(*this);
-		if(node.else_branch) node.else_branch->accept(*this);
+		dispatch(*node.condition);
+		dispatch(*node.if_branch);
+		if(node.else_branch) dispatch(*node.else_branch);
 		tab_level--;
 	}
 	void TreePrinter::visit(WhileExpr &node)
 	{
 		print(str.stringify(node));
 		tab_level++;
-		node.condition->accept(*this);
-		node.body->accept(*this);
+		dispatch(*node.condition);
+		dispatch(*node.body);
 		tab_level--;
 	}
 
@@ -145,7 +155,7 @@ namespace Util
 		tab_level++;
 		for(const auto &stmt : node.statements)
 		{
-			stmt->accept(*this);
+			dispatch(*stmt);
 		}
 		tab_level--;
 	}
@@ -153,7 +163,7 @@ namespace Util
 	{
 		print(str.stringify(node));
 		tab_level++;
-		node.type->accept(*this);
+		dispatch(*node.type);
 		tab_level--;
 	}
 	void TreePrinter::visit(Type &node)
@@ -2,17 +2,20 @@
 
 #include "log.h"
 #include "stringifier.h"
-#include "ast/visitor.h"
+#include "ast/dispatch.h"
 #include "ast/node.h"
 
 #include <string>
+#include <vector>
 
 namespace Util
 {
-	class TreePrinter : public Visitor
+	class TreePrinter : public StaticVisitor<TreePrinter>
 	{
 	public:
-#include "ast/visitorincl"
+#include "ast/dispatchincl"
+
+		explicit TreePrinter(const std::vector<Token> &tokens);
 
 	private:
 		Stringifier str;
@@ -21,7 +24,7 @@ namespace Util
 		template<typename... Args>
 		inline void print(Args &&... args) const
 		{
-			Logger::get().debug(std::string(3 * tab_level, ' '), std::forward<Args>(args)...);
+		Logger::get().debug(std::string(3 * tab_level, ' '), std::forward<Args>(args)...);
 		}
 	};
 }
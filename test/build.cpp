@@ -0,0 +1,150 @@
+#include "doctest.h"
+#include "support.h"
+
+#include "build.h"
+#include "compiler.h"
+#include "log.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Imports are resolved against the summary of the imported module; these
+// tests check sources against summaries directly, then build small projects
+// with the driver on one and on several threads.
+
+namespace
+{
+	const char *const math = "func sq(a: Int) -> Int\n{\n    return a * a\n}\nvar base = 3\n";
+
+	std::vector<std::string> messages(const Compiler::Context &context)
+	{
+		std::vector<std::string> texts;
+		const auto &engine = context.diagnostics();
+		for(const auto &diagnostic : engine.diagnostics())
+			texts.push_back(engine.message(diagnostic));
+		return texts;
+	}
+}
+
+TEST_CASE("imported names are checked against the summary of their module")
+{
+	Compiler::Context module;
+	REQUIRE(module.check("math.cy", math) == Compiler::Status::Ok);
+	const auto &exports = module.summary().exports;
+	REQUIRE(exports.size() == 2);
+	CHECK(exports[0].name == "sq");
+	CHECK(exports[0].type == DataType::Function(DataType::Integer, { DataType::Integer }));
+	CHECK(exports[1].name == "base");
+	CHECK(exports[1].type == DataType::Integer);
+
+	ModuleImports imports = { { "math", &module.summary() } };
+	for(bool flat : { false, true })
+	{
+		INFO("flat " << flat);
+		Compiler::Context context({ flat });
+
+		CHECK(context.check("ok.cy", "import math\nfunc f() -> Int\n{\n    return sq(base)\n}\nvar g = f() + base\n", imports) == Compiler::Status::Ok);
+		CHECK(context.summary().exports.size() == 2);
+
+		CHECK(context.check("type.cy", "import math\nvar s: String = sq(2)\n", imports) == Compiler::Status::TypeError);
+		CHECK(messages(context) == std::vector<std::string> { "inferred type 'Int' does not match explicit type 'String'" });
+
+		CHECK(context.check("symbol.cy", "import math\nimport nope\nimport math\nfunc f() { import math }\n", imports) == Compiler::Status::SymbolError);
+		CHECK(messages(context) == std::vector<std::string>
+		{
+			"no module named 'nope'",
+			"symbol 'sq' imported from 'math' is already defined",
+			"symbol 'base' imported from 'math' is already defined",
+			"imports must be at the top level"
+		});
+
+		// without summaries nothing can be imported
+		CHECK(context.check("none.cy", "import math\n") == Compiler::Status::SymbolError);
+		CHECK(context.imports().size() == 1);
+	}
+}
+
+namespace
+{
+	struct Project
+	{
+		Test::TemporaryDirectory temporary;
+		const std::filesystem::path &directory = temporary.path;
+
+		explicit Project(const std::string &name)
+			: temporary(name)
+		{}
+
+		void write(const std::string &name, const std::string &source) const
+		{
+			std::ofstream(directory / name) << source;
+		}
+
+		// builds the given file and returns everything printed
+		std::vector<std::string> build(const std::string &name, unsigned threads, Build::Report &report) const
+		{
+			std::vector<std::string> lines;
+			Logger::get().set_sink(std::make_unique<Test::CaptureSink>(lines));
+
+			auto path = (directory / name).string();
+			Compiler::Options options;
+			options.threads = threads;
+			std::ifstream file(path);
+			std::string source((std::istreambuf_iterator<char>(file)), {});
+			report = Build::build({ { path, source, true } }, options);
+
+			Logger::get().flush();
+			Logger::get().set_output(LogFormat::Terminal);
+			return lines;
+		}
+	};
+}
+
+TEST_CASE("a project builds the same on one thread and on several")
+{
+	Project project("cygnus-build-test");
+
+	// a chain and a diamond, with one module rejected and one cycle
+	std::string main;
+	for(int i = 0; i < 40; i++)
+	{
+		auto id = std::to_string(i);
+		std::string source;
+		if(i > 0) source += "import m" + std::to_string(i - 1) + "\n";
+		if(i > 1) source += "import m" + std::to_string(i / 2 - 1) + "\n";
+		source += "func f" + id + "(a: Int) -> Int\n{\n    return a + " + (i > 0 ? "f" + std::to_string(i - 1) + "(a)" : "1") + "\n}\n";
+		if(i == 30) source += "var wrong: Bool = f30(1)\n";
+		project.write("m" + id + ".cy", source);
+		main += "import m" + id + "\n";
+	}
+	project.write("c0.cy", "import c1\nvar x = 1\n");
+	project.write("c1.cy", "import c0\nvar y = 1\n");
+	project.write("lone.cy", "import missing\n");
+	project.write("main.cy", main + "import c0\nimport lone\nvar result = f29(1)\n");
+
+	Build::Report sequential, parallel;
+	auto expected = project.build("main.cy", 1, sequential);
+	auto actual = project.build("main.cy", 4, parallel);
+
+	CHECK(actual == expected);
+	CHECK(sequential.modules == 44);
+	CHECK(parallel.modules == 44);
+	// m30 to m39, the cycle, lone and main
+	CHECK(sequential.failed == 14);
+	CHECK(parallel.failed == 14);
+
+	auto printed = [&](const std::string &text)
+	{
+		return std::any_of(expected.begin(), expected.end(), [&](const auto &line)
+		{
+			return line.find(text) != std::string::npos;
+		});
+	};
+	CHECK(printed("import cycle: '" + (project.directory / "c0.cy").string() + "' -> '"));
+	CHECK(printed("imported module '" + (project.directory / "m30.cy").string() + "' was rejected"));
+	CHECK(printed("inferred type 'Int' does not match explicit type 'Bool'"));
+	CHECK(printed("no module named 'missing'"));
+}
@@ -0,0 +1,482 @@
+#include "doctest.h"
+#include "support.h"
+
+#include "compiler.h"
+#include "cygnus.h"
+#include "log.h"
+#include "util/treeprinter.h"
+#include "util/noderange.h"
+#include "syntax/lexer.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Contexts are meant to be used from many threads at once. These tests check
+// sources in parallel, each thread with its own context, and compare every
+// diagnostic with the result of checking the same source alone.
+
+namespace
+{
+	const char *const sources[] =
+	{
+		// valid
+		"func f(a: Int) -> Int\n{\n    var x = a * 2\n    if x > 3 {\n        x = x - 1\n    }\n    return x\n}\nvar y = f(4)\n",
+		// lexer
+		"var s = \"abc\n",
+		// parser
+		"var a = (1 + \nvar b = 2 *\nvar c = 3\n",
+		// symbol table
+		"var a = b\nfunc f() {}\nfunc f() {}\n",
+		// type checker
+		"func f(a: Int, s: String)\n{\n    var e = s - a\n    if a {\n    }\n}\n"
+	};
+	constexpr size_t source_count = std::size(sources);
+
+	// everything a check reports, rendered
+	struct Outcome
+	{
+		Compiler::Status status;
+		std::vector<std::string> diagnostics;
+
+		bool operator==(const Outcome &rhs) const
+		{
+			return status == rhs.status && diagnostics == rhs.diagnostics;
+		}
+	};
+
+	Outcome check(Compiler::Context &context, size_t index)
+	{
+		Outcome outcome;
+		outcome.status = context.check("test" + std::to_string(index) + ".cy", sources[index]);
+		const auto &engine = context.diagnostics();
+		for(const auto &diagnostic : engine.diagnostics())
+		{
+			auto location = engine.location(diagnostic);
+			auto text = std::to_string(location.line) + ":" + std::to_string(location.column) + " " + engine.message(diagnostic);
+			if(location.line > 0) text += "\n" + engine.excerpt(diagnostic);
+			outcome.diagnostics.push_back(text);
+		}
+		return outcome;
+	}
+}
+
+TEST_CASE("each phase reports through the context")
+{
+	Compiler::Context context;
+	CHECK(check(context, 0).status == Compiler::Status::Ok);
+	CHECK(check(context, 1).status == Compiler::Status::LexError);
+	CHECK(check(context, 2).status == Compiler::Status::SyntaxError);
+	CHECK(check(context, 3).status == Compiler::Status::SymbolError);
+	CHECK(check(context, 4).status == Compiler::Status::TypeError);
+	CHECK(context.diagnostics().diagnostics().size() == 2);
+
+	// the next check starts over
+	CHECK(check(context, 0).diagnostics.empty());
+}
+
+TEST_CASE("parsing stops after the set number of syntax errors")
+{
+	// one syntax error in each of five statements
+	std::string source;
+	for(int i = 0; i < 5; i++)
+		source += "var a" + std::to_string(i) + " = (1 +\n";
+
+	auto messages = [&](unsigned max_errors)
+	{
+		Compiler::Options options;
+		options.max_errors = max_errors;
+		Compiler::Context context(options);
+		CHECK(context.check("limit.cy", source) == Compiler::Status::SyntaxError);
+		std::vector<std::string> result;
+		for(const auto &diagnostic : context.diagnostics().diagnostics())
+			result.push_back(context.diagnostics().message(diagnostic));
+		return result;
+	};
+	auto stopped = [](const std::vector<std::string> &messages)
+	{
+		return std::count_if(messages.begin(), messages.end(), [](const std::string &message) { return message.find("too many errors") != std::string::npos; });
+	};
+
+	auto all = messages(100);
+	CHECK(all.size() == 5);
+	CHECK(stopped(all) == 0);
+
+	auto two = messages(2);
+	CHECK(two.size() == 3);
+	CHECK(stopped(two) == 1);
+	CHECK(two.back().find("too many errors in 'limit.cy'") != std::string::npos);
+
+	auto one = messages(1);
+	CHECK(one.size() == 2);
+	CHECK(stopped(one) == 1);
+
+	// no limit
+	CHECK(messages(0) == all);
+}
+
+TEST_CASE("the flat AST gives the same diagnostics")
+{
+	Compiler::Context tree, flat({ true });
+	for(size_t i = 0; i < source_count; i++)
+	{
+		CHECK(check(tree, i) == check(flat, i));
+	}
+}
+
+TEST_CASE("contexts in parallel threads give the same results as alone")
+{
+	std::vector<Outcome> expected;
+	{
+		Compiler::Context context;
+		for(size_t i = 0; i < source_count; i++)
+			expected.push_back(check(context, i));
+	}
+
+	constexpr size_t thread_count = 8, rounds = 50;
+	std::vector<size_t> mismatches(thread_count, 0);
+	std::vector<std::thread> threads;
+	for(size_t t = 0; t < thread_count; t++)
+	{
+		threads.emplace_back([&, t]
+		{
+			Compiler::Context context({ t % 2 == 1 });
+			for(size_t r = 0; r < rounds; r++)
+			{
+				// every thread walks the sources in a different order
+				size_t i = (r + t) % source_count;
+				if(!(check(context, i) == expected[i]))
+					mismatches[t]++;
+			}
+		});
+	}
+	for(auto &thread : threads)
+		thread.join();
+
+	for(size_t t = 0; t < thread_count; t++)
+	{
+		INFO("thread " << t);
+		CHECK(mismatches[t] == 0);
+	}
+}
+
+namespace
+{
+	// n functions between globals; every kind of symbol error, including
+	// names used in a body before they are defined at the top level
+	std::string symbol_errors(size_t n)
+	{
+		std::string source;
+		for(size_t i = 0; i < n; i++)
+		{
+			auto id = std::to_string(i);
+			source += "var g" + id + " = " + id + "\n";
+			source += "func f" + id + "(a: Int, a: Int) -> Int\n{\n";
+			source += "    var g" + id + " = a + g" + id + "\n";
+			source += "    var x = f" + id + "(a, a) + g" + std::to_string(i + 1) + "\n";
+			source += "    var x = y" + id + "\n";
+			source += "    return x\n}\n";
+			if(i % 3 == 0) source += "var h" + id + " = undefined" + id + "\n";
+			if(i % 5 == 0) source += "func f" + id + "() {}\n";
+		}
+		return source;
+	}
+
+	// n functions between globals, with type errors in signatures, bodies
+	// and the top level
+	std::string type_errors(size_t n)
+	{
+		std::string source;
+		for(size_t i = 0; i < n; i++)
+		{
+			auto id = std::to_string(i);
+			source += "var g" + id + " = \"" + id + "\"\n";
+			source += "func f" + id + "(a: Int, s: Strin) -> " + (i % 2 ? "Int" : "Bool") + "\n{\n";
+			source += "    var x = a * g" + id + "\n";
+			source += "    if a { x = s }\n";
+			if(i > 0) source += "    var y = f" + std::to_string(i - 1) + "(a, s, a)\n";
+			source += "    return a\n}\n";
+			source += "var h" + id + ": Int = f" + id + "(1, \"\") + g" + id + "\n";
+		}
+		return source;
+	}
+
+	std::vector<std::string> rendered(const Compiler::Context &context)
+	{
+		std::vector<std::string> texts;
+		const auto &engine = context.diagnostics();
+		for(const auto &diagnostic : engine.diagnostics())
+			texts.push_back(engine.message(diagnostic) + "\n" + engine.excerpt(diagnostic));
+		return texts;
+	}
+}
+
+TEST_CASE("function bodies checked in parallel give the same diagnostics in the same order")
+{
+	Compiler::Options sequential, parallel;
+	parallel.threads = 4;
+
+	for(auto input : { symbol_errors, type_errors })
+	{
+		auto source = input(200);
+		Compiler::Context expected(sequential), actual(parallel);
+		auto expected_status = expected.check("test.cy", source);
+		auto actual_status = actual.check("test.cy", source);
+
+		CHECK(expected_status != Compiler::Status::Ok);
+		CHECK(actual_status == expected_status);
+		CHECK(expected.diagnostics().diagnostics().size() > 200);
+		CHECK(rendered(actual) == rendered(expected));
+	}
+}
+
+TEST_CASE("the flat AST reports type errors over the same ranges")
+{
+	// an error on each kind of node the type checker reports
+	std::string source =
+	    "func f(a: Int, s: String) -> Int\n{\n"
+	    "    var b = -s\n"
+	    "    var c = (s + (a * 2)) * \"x\"\n"
+	    "    var d = f(s, a)\n"
+	    "    var e = a(1)\n"
+	    "    while s { }\n"
+	    "    var u: () = if a > 1 { 1 } else { \"two\" }\n"
+	    "    var v: Int = ()\n"
+	    "    return s\n}\n"
+	    "func g() -> () { return 1 }\n"
+	    "var t: Foo = f(1, \"\")\n";
+	source += type_errors(20);
+
+	Compiler::Options flat;
+	flat.flat_ast = true;
+	Compiler::Context expected, actual(flat);
+	CHECK(expected.check("test.cy", source) == Compiler::Status::TypeError);
+	CHECK(actual.check("test.cy", source) == Compiler::Status::TypeError);
+	CHECK(expected.diagnostics().diagnostics().size() > 40);
+	CHECK(rendered(actual) == rendered(expected));
+}
+
+namespace
+{
+	// definitions, with lines inside blocks, strings and comments that look
+	// like the start of a top-level definition
+	std::string mixed(size_t n)
+	{
+		std::string source = "# var commented = 1\n";
+		for(size_t i = 0; i < n; i++)
+		{
+			auto id = std::to_string(i);
+			source += "var s" + id + " = \"{ (\" # }\n";
+			source += "func f" + id + "(a: Int) -> Int\n{\n";
+			source += "var x = a + " + id + "\n";
+			source += "\tif x > 2 {\n\t\tx = x - 1; x = x * 2\n\t}\n";
+			source += "return x\n}\n";
+			source += "if s" + id + " == \"\" {\nvar t = 1\nfunc g() {}\n}\n";
+			source += "var y" + id + " = f" + id + "(\n" + id + ")\n\n";
+		}
+		return source;
+	}
+
+	// definitions with a syntax error every few
+	std::string syntax_errors(size_t n)
+	{
+		std::string source;
+		for(size_t i = 0; i < n; i++)
+		{
+			auto id = std::to_string(i);
+			source += "var a" + id + " = " + id + "\n";
+			if(i % 7 == 3) source += "var b" + id + " = a" + id + " *\n";
+			source += "func f" + id + "() {}\n";
+		}
+		return source;
+	}
+
+	// the tree as --debug prints it, with the source range of every statement
+	std::vector<std::string> dump(const Compiler::Context &context)
+	{
+		std::vector<std::string> lines;
+		auto program = context.syntax_tree();
+		if(!program) return lines;
+
+		Logger::get().set_sink(std::make_unique<Test::CaptureSink>(lines));
+		Logger::get().set_level(LogLevel::Debug);
+		Util::TreePrinter printer(context.token_list());
+		printer.dispatch(*program);
+		Logger::get().set_level(LogLevel::Info);
+		Logger::get().set_output(LogFormat::Terminal);
+
+		for(const auto &stmt : program->statements)
+		{
+			Util::NodeRange range(stmt.get(), context.token_list());
+			lines.push_back(std::to_string(range.begin.line) + ":" + std::to_string(range.begin.column) + "-"
+			                + std::to_string(range.end.line) + ":" + std::to_string(range.end.column));
+		}
+		return lines;
+	}
+
+	bool same_tokens(const std::vector<Token> &a, const std::vector<Token> &b)
+	{
+		if(a.size() != b.size()) return false;
+		for(size_t i = 0; i < a.size(); i++)
+		{
+			if(a[i].type != b[i].type || a[i].newline != b[i].newline || a[i].constant != b[i].constant || a[i].value != b[i].value || a[i].location != b[i].location)
+				return false;
+		}
+		return true;
+	}
+
+	bool same_constants(const ConstantPool &a, const ConstantPool &b)
+	{
+		if(a.size() != b.size()) return false;
+		for(ConstantId id = 0; id < a.size(); id++)
+		{
+			if(a[id].kind != b[id].kind) return false;
+			switch(a[id].kind)
+			{
+				case Constant::Kind::Integer:
+					if(a[id].integer != b[id].integer) return false;
+					break;
+				case Constant::Kind::Float:
+					if(a[id].real != b[id].real) return false;
+					break;
+				case Constant::Kind::String:
+					if(a[id].text != b[id].text) return false;
+					break;
+			}
+		}
+		return true;
+	}
+}
+
+TEST_CASE("a file parsed in chunks gives the same tokens, tree and diagnostics")
+{
+	Compiler::Options sequential, chunked;
+	chunked.threads = 4;
+	chunked.chunk_size = 64;
+
+	for(auto input : { mixed, symbol_errors, type_errors, syntax_errors })
+	{
+		auto source = input(100);
+		Compiler::Context expected(sequential), actual(chunked);
+		auto expected_status = expected.check("test.cy", source);
+		auto actual_status = actual.check("test.cy", source);
+
+		CHECK(actual_status == expected_status);
+		CHECK(same_tokens(actual.token_list(), expected.token_list()));
+		CHECK(same_constants(actual.constant_pool(), expected.constant_pool()));
+		CHECK(dump(actual) == dump(expected));
+		CHECK(rendered(actual) == rendered(expected));
+	}
+
+	// the splits fall where a sequential lexer would start a definition line
+	auto source = mixed(100);
+	auto splits = Lexer::split(source, 16);
+	CHECK(splits.size() == 15);
+	for(const auto &split : splits)
+	{
+		INFO("split at line " << split.line);
+		CHECK((source.compare(split.offset, 4, "var ") == 0 || source.compare(split.offset, 5, "func ") == 0));
+		CHECK(split.line == 1 + std::count(source.begin(), source.begin() + split.offset, '\n'));
+	}
+}
+
+TEST_CASE("literals are decoded once into the constant pool")
+{
+	Compiler::Context context;
+	auto source = "var a = 12 + 12\nvar b = 1.5 * 2.\nvar c = \"x\" + \"x\"\nvar d = 9223372036854775807\n";
+	REQUIRE(context.check("test.cy", source) == Compiler::Status::Ok);
+
+	const auto &constants = context.constant_pool();
+	REQUIRE(constants.size() == 5);
+	CHECK(constants[0].kind == Constant::Kind::Integer);
+	CHECK(constants[0].integer == 12);
+	CHECK(constants[1].kind == Constant::Kind::Float);
+	CHECK(constants[1].real == 1.5);
+	CHECK(constants[2].real == 2.0);
+	CHECK(constants[3].kind == Constant::Kind::String);
+	CHECK(constants[3].text == "x");
+	CHECK(constants[4].integer == INT64_MAX);
+
+	// equal literals share a constant
+	std::vector<ConstantId> ids;
+	for(const auto &token : context.token_list())
+	{
+		if(token.type == TokenType::Number || token.type == TokenType::String)
+			ids.push_back(token.constant);
+	}
+	CHECK(ids == std::vector<ConstantId> { 0, 0, 1, 2, 3, 3, 4 });
+
+	// decimals are floats
+	for(bool flat : { false, true })
+	{
+		Compiler::Context typed({ flat });
+		CHECK(typed.check("test.cy", "var x: Float = 1.5 * 2.0 - 0.5\nvar y = x < 3.0\nvar z = -x\n") == Compiler::Status::Ok);
+		CHECK(typed.check("test.cy", "var x = 1.5 + 1\n") == Compiler::Status::TypeError);
+		CHECK(typed.check("test.cy", "var x: Int = 1.5\n") == Compiler::Status::TypeError);
+	}
+
+	CHECK(context.check("test.cy", "var a = 9223372036854775808\nvar b = 1" + std::string(400, '0') + ".5\n") == Compiler::Status::LexError);
+	REQUIRE(context.diagnostics().diagnostics().size() == 2);
+	const auto &engine = context.diagnostics();
+	CHECK(engine.message(engine.diagnostics()[0]) == "integer literal '9223372036854775808' does not fit in 64 bits");
+	CHECK(engine.location(engine.diagnostics()[1]).column == 9);
+}
+
+TEST_CASE("line breaks are recorded on the token after them")
+{
+	Compiler::Context context;
+	REQUIRE(context.check("test.cy", "\nvar a = 1 # one\n\nvar b = a;a\nb\n") == Compiler::Status::Ok);
+
+	std::string lines;
+	for(const auto &token : context.token_list())
+		lines += std::string(token.newline ? "\n" : " ") + std::string(token.value);
+	CHECK(lines == "\nvar a = 1\nvar b = a ; a\nb");
+
+	auto messages = [&](const char *source)
+	{
+		context.check("test.cy", source);
+		std::vector<std::string> texts;
+		const auto &engine = context.diagnostics();
+		for(const auto &diagnostic : engine.diagnostics())
+		{
+			auto location = engine.location(diagnostic);
+			texts.push_back(std::to_string(location.line) + ":" + std::to_string(location.column) + " " + engine.message(diagnostic));
+		}
+		return texts;
+	};
+	CHECK(messages("var a = 1 var b = 2\n") == std::vector<std::string> { "1:10 expected newline or ';'" });
+	CHECK(messages("var a = 1;\nvar b = 2\n") == std::vector<std::string> { "1:10 unexpected symbol ';'" });
+	CHECK(messages("var a = 1 +\n\n2\nvar b = (\n") == std::vector<std::string> { "4:10 expected expression or ')'" });
+}
+
+TEST_CASE("C interface")
+{
+	auto context = cygnus_context_new();
+	REQUIRE(context);
+
+	std::string source = sources[4];
+	CHECK(cygnus_check(context, "test.cy", source.data(), source.size()) == CYGNUS_TYPE_ERROR);
+	REQUIRE(cygnus_diagnostic_count(context) == 2);
+
+	unsigned line = 0, column = 0;
+	CHECK(cygnus_diagnostic_location(context, 0, &line, &column));
+	CHECK(line == 3);
+	CHECK(column == 13);
+	CHECK(!cygnus_diagnostic_location(context, 2, &line, &column));
+
+	char message[16];
+	auto length = cygnus_diagnostic_message(context, 0, message, sizeof(message));
+	CHECK(length > sizeof(message));
+	CHECK(std::string(message) == "mismatched type");
+
+	std::string excerpt(cygnus_diagnostic_excerpt(context, 0, nullptr, 0), '\0');
+	cygnus_diagnostic_excerpt(context, 0, excerpt.data(), excerpt.size() + 1);
+	CHECK(excerpt.find("var e = ") != std::string::npos);
+
+	// the source does not need a terminator
+	CHECK(cygnus_check(context, "test.cy", "var x = 1\nvar y = 2", 9) == CYGNUS_OK);
+	CHECK(cygnus_diagnostic_count(context) == 0);
+
+	cygnus_context_free(context);
+}
@@ -0,0 +1,165 @@
+#include "doctest.h"
+#include "support.h"
+
+#include "build.h"
+#include "compiler.h"
+#include "log.h"
+#include "codegen/cemitter.h"
+#include "optimize/optimize.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Every program in test/lang with a '.out' file next to it is compiled to C,
+// built with the system C compiler and run at every optimization level; what
+// it prints must match the file. The tests are skipped where no C compiler
+// can be run.
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	std::string run(const std::string &command)
+	{
+		std::string output;
+		auto pipe = popen(command.c_str(), "r");
+		if(!pipe) return output;
+
+		char buffer[4096];
+		for(size_t count; (count = std::fread(buffer, 1, sizeof buffer, pipe)) > 0;)
+			output.append(buffer, count);
+		pclose(pipe);
+		return output;
+	}
+
+	bool have_compiler()
+	{
+		return std::system((CodeGen::c_compiler() + " --version > /dev/null 2>&1").c_str()) == 0;
+	}
+
+	struct Result
+	{
+		bool built;
+		// what the build printed, or the program's output if it was built
+		std::vector<std::string> log;
+		std::string output;
+	};
+
+	Result compile_and_run(const std::string &name, const std::string &source, const fs::path &executable, unsigned level = 0)
+	{
+		Result result = { false, {}, {} };
+		Logger::get().set_sink(std::make_unique<Test::CaptureSink>(result.log));
+
+		Build::build({ { name, source, true } }, {}, [&](const std::vector<Build::Unit> &units)
+		{
+			Optimize::optimize(units, level);
+			result.built = CodeGen::build_executable(units, executable.string());
+		});
+
+		Logger::get().flush();
+		Logger::get().set_output(LogFormat::Terminal);
+
+		if(result.built)
+			result.output = run(executable.string());
+		return result;
+	}
+}
+
+TEST_CASE("compiled programs print what they are expected to")
+{
+	if(!have_compiler())
+	{
+		MESSAGE("no C compiler; skipped");
+		return;
+	}
+
+	Test::TemporaryDirectory temporary("cygnus-emit");
+	const auto &directory = temporary.path;
+
+	size_t count = 0;
+	for(const auto &entry : fs::directory_iterator(CYGNUS_LANG_DIR))
+	{
+		auto path = entry.path();
+		auto expected = path;
+		expected.replace_extension(".out");
+		if(path.extension() != ".cy" || !fs::exists(expected)) continue;
+
+		auto file = path.filename().string();
+		for(unsigned level : { 0, 1, 2 })
+		{
+			INFO("program " << file << ", optimization level " << level);
+			auto result = compile_and_run(path.string(), Test::read(path), directory / path.stem(), level);
+			CHECK(result.log == std::vector<std::string> {});
+			REQUIRE(result.built);
+			CHECK(result.output == Test::read(expected));
+		}
+		count++;
+	}
+	CHECK(count >= 5);
+
+}
+
+TEST_CASE("loop optimizations do not change what a program prints")
+{
+	if(!have_compiler())
+	{
+		MESSAGE("no C compiler; skipped");
+		return;
+	}
+
+	Test::TemporaryDirectory temporary("cygnus-emit-loops");
+	const auto &directory = temporary.path;
+
+	const std::vector<std::string> programs =
+	{
+		// remainders of a variable that starts negative
+		"var i = -7\nvar s = \"\"\nwhile i < 8 {\n    s = s + (i % 3) + \",\" + (i % 5) + \" \"\n    i = i + 2\n}\nprint(s)\n",
+		// and of one that overflows
+		"var i = 9223372036854775805\nvar n = 0\nwhile n < 6 {\n    print(\"\" + (i % 4) + \" \" + (i * 3) + \" \" + (5 * i))\n    n = n + 1\n    i++\n}\n",
+		// counted down
+		"var i = 10\nwhile i > -10 {\n    print(\"\" + (i % 3) + \" \" + (i * 7))\n    i = i - 3\n}\n",
+		// a call in the loop changes a variable of the top level
+		"var scale = 2\nfunc grow() -> Int\n{\n    scale = scale + 1\n    return scale\n}\nvar i = 0\nwhile i < 4 {\n    print(\"\" + (scale * 10) + \" \" + grow())\n    i++\n}\n",
+		// nested loops, with a definition the inner loop never changes
+		"func table(n: Int, m: Int)\n{\n    var i = 0\n    while i < n {\n        var j = 0\n        var row = \"\"\n        while j < m {\n            var w = n * m + 1\n            row = row + (i * m + j) % w + \" \" + (j % 2 == 0)\n            j++\n        }\n        print(row + (n * 2 + i % 2))\n        i++\n    }\n}\ntable(3, 4)\n",
+		// a loop that never runs evaluates nothing it would have
+		"var i = 5\nvar d = 0\nwhile i < 5 {\n    print(\"\" + (i % 2) + (10 / d))\n    i++\n}\nprint(\"done\")\n"
+	};
+
+	for(size_t i = 0; i < programs.size(); i++)
+	{
+		INFO("program " << i << ":\n" << programs[i]);
+		auto name = (directory / ("loop" + std::to_string(i) + ".cy")).string();
+		auto plain = compile_and_run(name, programs[i], directory / "plain", 0);
+		auto optimized = compile_and_run(name, programs[i], directory / "optimized", 2);
+		REQUIRE(plain.built);
+		REQUIRE(optimized.built);
+		CHECK(!plain.output.empty());
+		CHECK(optimized.output == plain.output);
+	}
+
+}
+
+TEST_CASE("what C cannot express is reported")
+{
+	if(!have_compiler())
+	{
+		MESSAGE("no C compiler; skipped");
+		return;
+	}
+
+	Test::TemporaryDirectory temporary("cygnus-emit-unsupported");
+	const auto &directory = temporary.path;
+	auto path = (directory / "closure.cy").string();
+
+	auto result = compile_and_run(path, "func outer(n: Int) -> Int\n{\n    func inner() -> Int\n    {\n        return n\n    }\n    return inner()\n}\nprint(\"\" + outer(1))\n", directory / "closure");
+	CHECK(!result.built);
+	CHECK(!fs::exists(directory / "closure.c"));
+	REQUIRE(result.log.size() >= 2);
+	CHECK(result.log.front().find("using a variable of an enclosing function is not supported when compiling to C") != std::string::npos);
+
+}
@@ -0,0 +1,500 @@
+#include "doctest.h"
+#include "support.h"
+
+#include "build.h"
+#include "compiler.h"
+#include "log.h"
+#include "interp/bytecode.h"
+#include "interp/interpreter.h"
+#include "interp/lower.h"
+#include "interp/perfmap.h"
+#include "interp/profiler.h"
+#include "interp/tier.h"
+#include "optimize/optimize.h"
+#include "codegen/cemitter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Every program in test/lang with a '.out' file next to it is run by the
+// interpreter at every optimization level; what it prints must match the
+// file, as it must for the executable the C backend builds.
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	struct Result
+	{
+		bool lowered = false;
+		bool ran = false;
+		std::vector<std::string> log;
+		std::string output;
+		// with a profile
+		std::vector<std::string> report;
+		std::string collapsed;
+		// with a tier
+		size_t compiled = 0;
+	};
+
+	Result interpret(const std::string &name, const std::string &source, unsigned level = 0, std::optional<Interp::ProfileMode> profile = {}, std::optional<Interp::JitMode> jit = {})
+	{
+		Result result;
+		Logger::get().set_sink(std::make_unique<Test::CaptureSink>(result.log));
+
+		Build::build({ { name, source, true } }, {}, [&](const std::vector<Build::Unit> &units)
+		{
+			Optimize::optimize(units, level);
+			Interp::Program program;
+			result.lowered = Interp::lower(units, program);
+			if(!result.lowered) return;
+
+			std::optional<Interp::Profiler> profiler;
+			if(profile)
+				profiler.emplace(program, *profile);
+			std::optional<Interp::Tier> tier;
+			if(jit)
+			{
+				tier.emplace(program, *jit);
+				CHECK(tier->start());
+			}
+
+			auto out = std::tmpfile();
+			REQUIRE(out);
+			Interp::Interpreter interpreter(program, out, profiler ? &*profiler : nullptr, tier ? &*tier : nullptr);
+			result.ran = interpreter.run();
+			if(tier)
+			{
+				tier->stop();
+				result.compiled = tier->stats().compiled;
+				CHECK(tier->stats().failed == 0);
+			}
+
+			std::rewind(out);
+			char buffer[4096];
+			for(size_t count; (count = std::fread(buffer, 1, sizeof buffer, out)) > 0;)
+				result.output.append(buffer, count);
+			std::fclose(out);
+
+			if(profiler)
+			{
+				result.report = profiler->report();
+				result.collapsed = profiler->collapsed();
+			}
+		});
+
+		Logger::get().flush();
+		Logger::get().set_output(LogFormat::Terminal);
+		return result;
+	}
+
+	// the line of the report that ends with the site
+	std::string row(const std::vector<std::string> &report, const std::string &site)
+	{
+		for(const auto &line : report)
+		{
+			if(line.size() >= site.size() && line.compare(line.size() - site.size(), site.size(), site) == 0)
+				return line;
+		}
+		return {};
+	}
+
+	bool have_compiler()
+	{
+		return std::system((CodeGen::c_compiler() + " --version > /dev/null 2>&1").c_str()) == 0;
+	}
+}
+
+TEST_CASE("interpreted programs print what they are expected to")
+{
+	size_t count = 0;
+	for(const auto &entry : fs::directory_iterator(CYGNUS_LANG_DIR))
+	{
+		auto path = entry.path();
+		auto expected = path;
+		expected.replace_extension(".out");
+		if(path.extension() != ".cy" || !fs::exists(expected)) continue;
+
+		auto file = path.filename().string();
+		for(unsigned level : { 0, 1, 2 })
+		{
+			INFO("program " << file << ", optimization level " << level);
+			auto result = interpret(path.string(), Test::read(path), level);
+			CHECK(result.log == std::vector<std::string> {});
+			REQUIRE(result.lowered);
+			CHECK(result.ran);
+			CHECK(result.output == Test::read(expected));
+		}
+		count++;
+	}
+	CHECK(count >= 5);
+}
+
+TEST_CASE("an error stops the interpreted program where it happens")
+{
+	auto result = interpret("/tmp/error.cy", "func divide(a: Int, b: Int) -> Int\n{\n    return a / b\n}\nprint(\"before\")\nprint(\"\" + divide(1, 0))\nprint(\"after\")\n");
+	REQUIRE(result.lowered);
+	CHECK(!result.ran);
+	CHECK(result.output == "before\n");
+	REQUIRE(result.log.size() == 1);
+	CHECK(result.log[0] == "division by zero at /tmp/error.cy:3:14");
+
+	result = interpret("/tmp/deep.cy", "func down(n: Int) -> Int\n{\n    return down(n + 1) + 1\n}\nprint(\"\" + down(0))\n");
+	CHECK(!result.ran);
+	REQUIRE(result.log.size() == 1);
+	CHECK(result.log[0].find("stack overflow at /tmp/deep.cy:3:12") == 0);
+}
+
+TEST_CASE("deeply nested expressions are lowered and run")
+{
+#if defined(__SANITIZE_THREAD__) || defined(__SANITIZE_ADDRESS__)
+	// the interpreter runs on a much smaller stack under the sanitizers
+	constexpr size_t depth = 2000;
+#else
+	constexpr size_t depth = 100000;
+#endif
+	auto repeat = [](const std::string &text, size_t n)
+	{
+		std::string result;
+		for(size_t i = 0; i < n; i++) result += text;
+		return result;
+	};
+
+	auto result = interpret("/tmp/infix.cy", "var x = 1\nvar y = " + repeat("(x + ", depth) + "x" + repeat(")", depth) + "\nprint(\"\" + y)\n", 1);
+	CHECK(result.ran);
+	CHECK(result.output == std::to_string(depth + 1) + "\n");
+
+	result = interpret("/tmp/prefix.cy", "var x = 1\nvar y = " + repeat("- ", depth + 1) + "x\nprint(\"\" + y)\n", 1);
+	CHECK(result.ran);
+	CHECK(result.output == "-1\n");
+
+	result = interpret("/tmp/assign.cy", "var x = 1\n" + repeat("x = ", depth) + "2\nprint(\"\" + x)\n", 1);
+	CHECK(result.ran);
+	CHECK(result.output == "2\n");
+}
+
+TEST_CASE("what the interpreter cannot run is reported")
+{
+	auto result = interpret("/tmp/closure.cy", "func outer(n: Int) -> Int\n{\n    func inner() -> Int\n    {\n        return n\n    }\n    return inner()\n}\nprint(\"\" + outer(1))\n");
+	CHECK(!result.lowered);
+	REQUIRE(result.log.size() >= 2);
+	CHECK(result.log.front().find("using a variable of an enclosing function is not supported when running a program") != std::string::npos);
+}
+
+TEST_CASE("the profile counts calls and iterations and charges time along chains of calls")
+{
+	const std::string source =
+	    "func square(n: Int) -> Int\n{\n    return n * n\n}\n"
+	    "func sum(n: Int) -> Int\n{\n"
+	    "    var total = 0\n"
+	    "    var i = 0\n"
+	    "    while i < n {\n"
+	    "        total = total + square(i)\n"
+	    "        i++\n"
+	    "    }\n"
+	    "    return total\n"
+	    "}\n"
+	    "var j = 0\n"
+	    "while j < 3 {\n"
+	    "    print(\"\" + sum(1000))\n"
+	    "    j++\n"
+	    "}\n";
+
+	for(auto mode : { Interp::ProfileMode::Instrument, Interp::ProfileMode::Sample })
+	{
+		std::string name = mode == Interp::ProfileMode::Sample ? "sample" : "instrument";
+		INFO("mode " << name);
+		auto result = interpret("/tmp/profile.cy", source, 0, mode);
+		REQUIRE(result.ran);
+		CHECK(result.output == "332833500\n332833500\n332833500\n");
+
+		// calls, and entries and iterations of loops
+		auto square = row(result.report, "square (profile.cy:1)");
+		auto sum = row(result.report, "sum (profile.cy:5)");
+		auto inner = row(result.report, "while (profile.cy:9)");
+		auto outer = row(result.report, "while (profile.cy:16)");
+		CHECK(square.find("  3000  ") != std::string::npos);
+		CHECK(sum.find("  3  ") != std::string::npos);
+		CHECK(inner.find("  3  ") != std::string::npos);
+		CHECK(inner.find("  3000  ") != std::string::npos);
+		CHECK(outer.find("  1  ") != std::string::npos);
+		CHECK(outer.find("  3  ") != std::string::npos);
+		CHECK(row(result.report, "profile.cy").find("  1  ") != std::string::npos);
+
+		// every line of the collapsed stacks is a chain from the top level
+		// and a count of microseconds
+		for(size_t begin = 0, end; begin < result.collapsed.size(); begin = end + 1)
+		{
+			end = result.collapsed.find('\n', begin);
+			REQUIRE(end != std::string::npos);
+			auto line = result.collapsed.substr(begin, end - begin);
+			CHECK(line.find("profile.cy") == 0);
+			auto space = line.find_last_of(' ');
+			REQUIRE(space != std::string::npos);
+			CHECK(std::stoll(line.substr(space + 1)) > 0);
+		}
+	}
+
+	// the square calls are timed in the chain they are made in
+	auto result = interpret("/tmp/profile.cy", source, 0, Interp::ProfileMode::Instrument);
+	CHECK(result.collapsed.find("profile.cy;while (profile.cy:16);sum (profile.cy:5);while (profile.cy:9);square (profile.cy:1) ") != std::string::npos);
+}
+
+TEST_CASE("bytecode files run what was saved until a source changes")
+{
+	Test::TemporaryDirectory temporary("cygnus-bytecode");
+	const auto &directory = temporary.path;
+
+	auto lib = directory / "lib.cy";
+	std::ofstream(lib) << "func twice(n: Int) -> Int\n{\n    return n * 2\n}\nvar greeting = \"hi \"\n";
+	const std::string main = "import lib\nprint(greeting + twice(21))\nprint(\"\" + 1.5 * 3.0)\nprint(\"\" + 1 / (twice(1) - 2))\n";
+	auto path = (directory / "main.cy").string();
+	auto bytecode = (directory / "main.cyc").string();
+
+	std::vector<std::string> log;
+	Logger::get().set_sink(std::make_unique<Test::CaptureSink>(log));
+	Interp::Program saved;
+	Build::build({ { path, main, true } }, {}, [&](const std::vector<Build::Unit> &units)
+	{
+		Optimize::optimize(units, 1);
+		REQUIRE(Interp::lower(units, saved));
+		std::vector<std::string_view> sources;
+		for(const auto &unit : units)
+			sources.push_back(unit.context.diagnostics().source());
+		CHECK(Interp::save(saved, sources, 1, bytecode));
+	});
+	std::ofstream(path) << main;
+
+	// read back as it was written
+	Interp::Program program;
+	REQUIRE(Interp::load(bytecode, true, 1, program) == Interp::LoadStatus::Loaded);
+	CHECK(program.files == saved.files);
+	CHECK(program.strings == saved.strings);
+	CHECK(program.lists == saved.lists);
+	CHECK(program.numbers == saved.numbers);
+	CHECK(program.modules == saved.modules);
+	CHECK(program.globals == saved.globals);
+	REQUIRE(program.ops.size() == saved.ops.size());
+	CHECK(program.lines == saved.lines);
+	REQUIRE(program.functions.size() == saved.functions.size());
+	for(size_t i = 0; i < program.functions.size(); i++)
+	{
+		CHECK(program.functions[i].name == saved.functions[i].name);
+		CHECK(program.functions[i].location == saved.functions[i].location);
+		CHECK(program.functions[i].body == saved.functions[i].body);
+		CHECK(program.functions[i].slots == saved.functions[i].slots);
+	}
+
+	// the ops are run from the file, which a copy of the program keeps
+	CHECK(program.storage);
+	auto kept = program;
+	program = {};
+
+	auto out = std::tmpfile();
+	REQUIRE(out);
+	CHECK(!Interp::Interpreter(kept, out, nullptr).run());
+	std::rewind(out);
+	char buffer[256] = {};
+	CHECK(std::string(buffer, std::fread(buffer, 1, sizeof buffer - 1, out)) == "hi 42\n4.5\n");
+	std::fclose(out);
+	Logger::get().flush();
+	REQUIRE(!log.empty());
+	CHECK(log.back() == "division by zero at " + path + ":4:14");
+
+	// another level, or a source that changed, is stale unless not checked
+	CHECK(Interp::load(bytecode, true, 2, program) == Interp::LoadStatus::Stale);
+	std::ofstream(lib, std::ios::app) << "var more = 1\n";
+	CHECK(Interp::load(bytecode, true, 1, program) == Interp::LoadStatus::Stale);
+	CHECK(Interp::load(bytecode, false, 1, program) == Interp::LoadStatus::Loaded);
+	fs::remove(lib);
+	CHECK(Interp::load(bytecode, true, 1, program) == Interp::LoadStatus::Stale);
+
+	// damage anywhere is found
+	auto contents = Test::read(bytecode);
+	contents[contents.size() / 2] ^= 1;
+	std::ofstream(bytecode, std::ios::binary | std::ios::trunc) << contents;
+	CHECK(Interp::load(bytecode, false, 1, program) == Interp::LoadStatus::Invalid);
+	std::ofstream(bytecode, std::ios::binary | std::ios::trunc) << contents.substr(0, 100);
+	CHECK(Interp::load(bytecode, false, 1, program) == Interp::LoadStatus::Invalid);
+	CHECK(Interp::load((directory / "none.cyc").string(), false, 1, program) == Interp::LoadStatus::Missing);
+
+	Logger::get().set_output(LogFormat::Terminal);
+}
+
+TEST_CASE("native code prints and fails as the interpreter does")
+{
+	if(!have_compiler())
+	{
+		MESSAGE("no C compiler; skipped");
+		return;
+	}
+
+	for(const auto &entry : fs::directory_iterator(CYGNUS_LANG_DIR))
+	{
+		auto path = entry.path();
+		auto expected = path;
+		expected.replace_extension(".out");
+		if(path.extension() != ".cy" || !fs::exists(expected)) continue;
+
+		for(unsigned level : { 0, 2 })
+		{
+			auto file = path.filename().string();
+			INFO("program " << file << ", optimization level " << level);
+			auto result = interpret(path.string(), Test::read(path), level, {}, Interp::JitMode::Eager);
+			CHECK(result.log == std::vector<std::string> {});
+			CHECK(result.ran);
+			CHECK(result.output == Test::read(expected));
+			CHECK(result.compiled > 0);
+		}
+	}
+
+	auto result = interpret("/tmp/error.cy", "func divide(a: Int, b: Int) -> Int\n{\n    return a / b\n}\nprint(\"before\")\nprint(\"\" + divide(1, 0))\nprint(\"after\")\n", 0, {}, Interp::JitMode::Eager);
+	CHECK(!result.ran);
+	CHECK(result.output == "before\n");
+	REQUIRE(result.log.size() == 1);
+	CHECK(result.log[0] == "division by zero at /tmp/error.cy:3:14");
+
+	result = interpret("/tmp/deep.cy", "func down(n: Int) -> Int\n{\n    return down(n + 1) + down(0)\n}\nprint(\"\" + down(0))\n", 0, {}, Interp::JitMode::Eager);
+	CHECK(!result.ran);
+	REQUIRE(result.log.size() == 1);
+	CHECK(result.log[0].find("stack overflow at /tmp/deep.cy:3:12") == 0);
+}
+
+TEST_CASE("hot functions and loops continue in native code")
+{
+	if(!have_compiler())
+	{
+		MESSAGE("no C compiler; skipped");
+		return;
+	}
+
+	// the loop runs long enough to be compiled and entered in the middle,
+	// with its variables and strings carried over
+	const std::string source =
+		"func step(n: Int) -> Int\n{\n    return n % 7 + 1\n}\n"
+		"var i = 0\nvar total = 0\nvar text = \"\"\n"
+		"while i < 3000000 {\n    total = total + step(i)\n    if i % 1000000 == 0 {\n        text = text + i + \";\"\n    }\n    i++\n}\n"
+		"print(text + total)\n";
+	auto interpreted = interpret("/tmp/hot.cy", source);
+	auto result = interpret("/tmp/hot.cy", source, 0, {}, Interp::JitMode::Tiered);
+	CHECK(result.log == std::vector<std::string> {});
+	CHECK(result.ran);
+	CHECK(result.output == "0;1000000;2000000;11999994\n");
+	CHECK(result.output == interpreted.output);
+	CHECK(result.compiled > 0);
+}
+
+TEST_CASE("perf is told the name, size and line of native code")
+{
+	if(!have_compiler())
+	{
+		MESSAGE("no C compiler; skipped");
+		return;
+	}
+
+	Test::TemporaryDirectory temporary("cygnus-perf");
+	const auto &directory = temporary.path;
+	const std::string path = "/tmp/perf.cy";
+	const std::string source = "func twice(n: Int) -> Int\n{\n    return n * 2\n}\nvar i = 0\nwhile i < 3 {\n    print(\"\" + twice(i))\n    i++\n}\n";
+
+	std::vector<std::string> log;
+	Logger::get().set_sink(std::make_unique<Test::CaptureSink>(log));
+	std::string map_path, dump_path;
+	Build::build({ { path, source, true } }, {}, [&](const std::vector<Build::Unit> &units)
+	{
+		Interp::Program program;
+		REQUIRE(Interp::lower(units, program));
+		Interp::PerfMap perf(Interp::PerfFormat::Jitdump, directory.string());
+		REQUIRE(perf.open());
+		map_path = perf.map_path();
+		dump_path = perf.dump_path();
+
+		Interp::Tier tier(program, Interp::JitMode::Eager, &perf);
+		REQUIRE(tier.start());
+		auto out = std::tmpfile();
+		REQUIRE(out);
+		CHECK(Interp::Interpreter(program, out, nullptr, &tier).run());
+		std::fclose(out);
+
+		// perf looks up only anonymous code in the map
+		std::istringstream map(Test::read(map_path)), mappings(Test::read("/proc/self/maps"));
+		std::vector<std::string> regions;
+		for(std::string line; std::getline(mappings, line);)
+			regions.push_back(line);
+		for(std::string line; std::getline(map, line);)
+		{
+			auto address = std::stoull(line, nullptr, 16);
+			auto region = std::find_if(regions.begin(), regions.end(), [&](const std::string &region)
+			{
+				auto dash = region.find('-');
+				return std::stoull(region, nullptr, 16) <= address && address < std::stoull(region.substr(dash + 1), nullptr, 16);
+			});
+			REQUIRE(region != regions.end());
+			INFO(*region);
+			// the permissions, and no path after the inode
+			std::istringstream fields(*region);
+			std::string range, permissions, offset, device, inode, name;
+			fields >> range >> permissions >> offset >> device >> inode >> name;
+			CHECK(permissions.find('x') != std::string::npos);
+			CHECK(name.empty());
+		}
+	});
+	Logger::get().flush();
+	Logger::get().set_output(LogFormat::Terminal);
+	CHECK(log == std::vector<std::string> {});
+
+	// every line is the address, the size and the name
+	std::vector<std::string> names;
+	std::istringstream map(Test::read(map_path));
+	for(std::string line; std::getline(map, line);)
+	{
+		std::istringstream fields(line);
+		std::string address, size;
+		fields >> address >> size;
+		CHECK(std::stoull(address, nullptr, 16) > 0);
+		CHECK(std::stoull(size, nullptr, 16) > 0);
+		names.push_back(line.substr(address.size() + size.size() + 2));
+	}
+	CHECK(std::find(names.begin(), names.end(), "twice (/tmp/perf.cy:1:6)") != names.end());
+	CHECK(std::find(names.begin(), names.end(), "while (/tmp/perf.cy:6:1) in perf.cy") != names.end());
+
+	// a header, then for each of them its line and its code, then the end
+	auto dump = Test::read(dump_path);
+	auto field = [&](size_t offset)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, dump.data() + offset, sizeof value);
+		return value;
+	};
+	REQUIRE(dump.size() >= 40);
+	CHECK(field(0) == 0x4A695444);
+	size_t offset = field(8), loads = 0, lines = 0;
+	std::uint32_t last = 0;
+	while(offset + 16 <= dump.size())
+	{
+		last = field(offset);
+		if(last == 0)
+		{
+			CHECK(dump.c_str() + offset + 56 == names[loads]);
+			loads++;
+		}
+		else if(last == 2)
+		{
+			CHECK(dump.c_str() + offset + 48 == path);
+			lines++;
+		}
+		offset += field(offset + 4);
+	}
+	CHECK(offset == dump.size());
+	CHECK(last == 3);
+	CHECK(loads == names.size());
+	CHECK(lines == loads);
+}
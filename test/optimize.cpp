@@ -0,0 +1,205 @@
+#include "doctest.h"
+#include "support.h"
+
+#include "build.h"
+#include "compiler.h"
+#include "log.h"
+#include "optimize/optimize.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// The passes that run between checking and code generation, on small
+// projects built with the driver.
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	class NullSink : public LogSink
+	{
+	public:
+		void write(std::string_view, const LogRecord &) override {}
+		void flush() override {}
+	};
+
+	// names of the definitions in a list of statements
+	std::vector<std::string> defined(const std::vector<std::unique_ptr<Statement>> &statements, const std::vector<Token> &tokens)
+	{
+		std::vector<std::string> names;
+		for(const auto &stmt : statements)
+		{
+			if(stmt->kind == NodeKind::FunctionDef)
+				names.emplace_back(static_cast<FunctionDef &>(*stmt).name->token(tokens).value);
+			else if(stmt->kind == NodeKind::VariableDef)
+				names.emplace_back(static_cast<VariableDef &>(*stmt).name->token(tokens).value);
+		}
+		return names;
+	}
+}
+
+TEST_CASE("dead code is removed across modules")
+{
+	Test::TemporaryDirectory temporary("cygnus-deadcode");
+	const auto &directory = temporary.path;
+
+	std::ofstream(directory / "lib.cy") <<
+	    "var shared = 2\n"
+	    "var other = shared + 5\n"
+	    "func unused() {}\n";
+	const std::string main =
+	    "import lib\n"
+	    "func helper(a: Int) -> Int\n{\n    return a * 2\n}\n"
+	    "func dead(a: Int) -> Int\n{\n    return helper(a)\n}\n"
+	    "func live(a: Int) -> Int\n{\n"
+	    "    var unused = a / 2\n"
+	    "    var guarded = a / 0\n"
+	    "    var called = print(\"x\")\n"
+	    "    return helper(a) + shared\n"
+	    "    print(\"never\")\n"
+	    "    var after = 1\n"
+	    "}\n"
+	    "var pure = 3 * 4\n"
+	    "var result = live(1)\n"
+	    "print(\"\" + result)\n";
+	auto path = (directory / "main.cy").string();
+
+	bool ran = false;
+	Logger::get().set_sink(std::make_unique<NullSink>());
+	Build::build({ { path, main, true } }, {}, [&](const std::vector<Build::Unit> &units)
+	{
+		ran = true;
+		auto stats = Optimize::eliminate_dead_code(units);
+		CHECK(stats.functions == 2);
+		CHECK(stats.variables == 3);
+		CHECK(stats.statements == 2);
+		CHECK(stats.nodes > 0);
+
+		REQUIRE(units.size() == 2);
+		const auto &lib = units[0].context;
+		CHECK(defined(lib.syntax_tree()->statements, lib.token_list()) == std::vector<std::string> { "shared" });
+
+		const auto &context = units[1].context;
+		const auto &statements = context.syntax_tree()->statements;
+		CHECK(defined(statements, context.token_list()) == std::vector<std::string> { "helper", "live", "result" });
+
+		// an initializer that may stop the program stays
+		for(const auto &stmt : statements)
+		{
+			if(stmt->kind != NodeKind::FunctionDef) continue;
+			auto &live = static_cast<FunctionDef &>(*stmt);
+			if(live.name->token(context.token_list()).value != "live") continue;
+			CHECK(defined(live.body->statements, context.token_list()) == std::vector<std::string> { "guarded", "called" });
+			CHECK(live.body->statements.size() == 3);
+		}
+	});
+	Logger::get().flush();
+	Logger::get().set_output(LogFormat::Terminal);
+	CHECK(ran);
+
+}
+
+TEST_CASE("small functions are inlined into their callers")
+{
+	const std::string source =
+	    "func square(x: Int) -> Int\n{\n    return x * x\n}\n"
+	    "func twice(x: Int) -> Int\n{\n    return square(x) + square(x)\n}\n"
+	    "func fact(n: Int) -> Int\n{\n    if n <= 1 { return 1 }\n    return n * fact(n - 1)\n}\n"
+	    "func big(x: Int) -> Int\n{\n    return x * 2 + x * 3 + x * 4 + x * 5\n}\n"
+	    "var a = twice(3)\n"
+	    "var r = fact(4)\n"
+	    "var b = big(2)\n"
+	    "print(\"\" + a + r + b)\n";
+
+	for(unsigned level : { 0, 1, 2 })
+	{
+		INFO("optimization level " << level);
+		bool ran = false;
+		Logger::get().set_sink(std::make_unique<NullSink>());
+		Build::build({ { "inline.cy", source, true } }, {}, [&](const std::vector<Build::Unit> &units)
+		{
+			ran = true;
+			auto stats = Optimize::optimize(units, level);
+			const auto &inlined = stats.inlined;
+			const auto &context = units[0].context;
+			auto names = defined(context.syntax_tree()->statements, context.token_list());
+
+			if(level == 0)
+			{
+				CHECK(inlined.calls == 0);
+				CHECK(names.size() == 7);
+				return;
+			}
+
+			// square into twice, then twice into a; big only fits at level 2
+			CHECK(inlined.calls == (level == 1 ? 3 : 4));
+			CHECK(inlined.functions == (level == 1 ? 2 : 3));
+			CHECK(inlined.recursive == 1);
+			CHECK(inlined.too_large == (level == 1 ? 1 : 0));
+			if(level == 1)
+				CHECK(names == std::vector<std::string> { "fact", "big", "a", "r", "b" });
+			else
+				CHECK(names == std::vector<std::string> { "fact", "a", "r", "b" });
+
+			for(const auto &stmt : context.syntax_tree()->statements)
+			{
+				if(stmt->kind != NodeKind::VariableDef) continue;
+				auto &def = static_cast<VariableDef &>(*stmt);
+				if(def.name->token(context.token_list()).value == "a")
+					CHECK(def.value->kind == NodeKind::InfixOperator);
+			}
+		});
+		Logger::get().flush();
+		Logger::get().set_output(LogFormat::Terminal);
+		CHECK(ran);
+	}
+}
+
+TEST_CASE("loop invariants are hoisted and remainders counted")
+{
+	const std::string source =
+	    "func f(n: Int) -> Int\n{\n"
+	    "    var i = 0\n"
+	    "    var total = 0\n"
+	    "    while i < n * 2 {\n"
+	    "        var limit = n + 1\n"
+	    "        total = total + i % 3 + limit\n"
+	    "        i++\n"
+	    "    }\n"
+	    "    return total\n"
+	    "}\n"
+	    "print(\"\" + f(5))\n";
+
+	bool ran = false;
+	Logger::get().set_sink(std::make_unique<NullSink>());
+	Build::build({ { "loops.cy", source, true } }, {}, [&](const std::vector<Build::Unit> &units)
+	{
+		ran = true;
+		auto stats = Optimize::optimize_loops(units);
+		CHECK(stats.loops == 1);
+		CHECK(stats.hoisted == 2);
+		CHECK(stats.induction == 1);
+		CHECK(stats.counters == 1);
+		CHECK(stats.reduced == 1);
+
+		const auto &context = units[0].context;
+		auto &f = static_cast<FunctionDef &>(*context.syntax_tree()->statements[0]);
+		const auto &statements = f.body->statements;
+		// the definition, the bound of the loop and the counter come first,
+		// each named after what it reads
+		CHECK(defined(statements, context.token_list()) == std::vector<std::string> { "i", "total", "limit", "n", "i" });
+		REQUIRE(statements.size() == 7);
+
+		// the step is followed by the update of the counter
+		auto &loop = static_cast<WhileExpr &>(*static_cast<ExprStatement &>(*statements[5]).expr);
+		const auto &body = static_cast<Block &>(*loop.body).statements;
+		REQUIRE(body.size() == 4);
+		CHECK(static_cast<ExprStatement &>(*body[2]).expr->kind == NodeKind::InfixOperator);
+		CHECK(static_cast<ExprStatement &>(*body[3]).expr->kind == NodeKind::IfExpr);
+	});
+	Logger::get().flush();
+	Logger::get().set_output(LogFormat::Terminal);
+	CHECK(ran);
+}
@@ -0,0 +1,305 @@
+#include "doctest.h"
+
+#include "util/diagnostic.h"
+#include "syntax/lexer.h"
+#include "syntax/parser.h"
+#include "semantic/symtable.h"
+#include "semantic/typecheck.h"
+#include "semantic/flatsymtable.h"
+#include "ast/flat.h"
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+// Each test runs a phase on a generated input and on one twice its size,
+// and checks that the work done at most doubles, with some slack for fixed
+// costs. Work is measured with allocation counts and the passes' operation
+// counters rather than wall time, so the results do not depend on the machine.
+
+static std::atomic<size_t> allocations = 0;
+
+// every form of new and delete is replaced, so that whatever the library
+// allocates with is counted and freed the same way
+namespace
+{
+	void *allocate(size_t size, size_t alignment = 0) noexcept
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		if(size == 0) size = 1;
+		if(alignment <= alignof(std::max_align_t)) return std::malloc(size);
+		// aligned_alloc takes a multiple of the alignment
+		return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+	}
+
+	void *allocate_or_throw(size_t size, size_t alignment = 0)
+	{
+		if(auto p = allocate(size, alignment)) return p;
+		throw std::bad_alloc();
+	}
+}
+
+void *operator new(size_t size) { return allocate_or_throw(size); }
+void *operator new[](size_t size) { return allocate_or_throw(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new(size_t size, std::align_val_t alignment) { return allocate_or_throw(size, static_cast<size_t>(alignment)); }
+void *operator new[](size_t size, std::align_val_t alignment) { return allocate_or_throw(size, static_cast<size_t>(alignment)); }
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return allocate(size, static_cast<size_t>(alignment)); }
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return allocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+
+namespace
+{
+	// work counted while running f
+	template<typename F>
+	size_t allocations_in(F &&f)
+	{
+		size_t before = allocations.load();
+		f();
+		return allocations.load() - before;
+	}
+
+	void check_linear(size_t small, size_t large)
+	{
+		INFO("work for n = " << small << ", for 2n = " << large);
+		CHECK(small > 0);
+		CHECK(large <= small * 5 / 2);
+	}
+
+	// inputs
+
+	// n globals and n functions, each with its own parameters, locals and blocks
+	std::string blocks(size_t n)
+	{
+		std::string source = "func print(s: String) {}\n";
+		for(size_t i = 0; i < n; i++)
+		{
+			auto id = std::to_string(i);
+			source += "var g" + id + " = " + id + "\n";
+		}
+		for(size_t i = 0; i < n; i++)
+		{
+			auto id = std::to_string(i);
+			source += "func f" + id + "(a: Int, b: Int) -> Int\n";
+			source += "{\n";
+			source += "    var x = a * g" + id + "\n";
+			source += "    if x > b {\n";
+			source += "        var y = x - b\n";
+			source += "        x = y\n";
+			source += "    }\n";
+			source += "    while x < 10 {\n";
+			source += "        x = x + 1\n";
+			source += "    }\n";
+			source += "    print(\"x: \" + x)\n";
+			source += "    return x\n";
+			source += "}\n";
+		}
+		return source;
+	}
+
+	// n statements with a syntax error each, between valid ones
+	std::string syntax_errors(size_t n)
+	{
+		std::string source;
+		for(size_t i = 0; i < n; i++)
+		{
+			auto id = std::to_string(i);
+			source += "var a" + id + " = " + id + "\n";
+			source += "var b" + id + " = (a" + id + " + \n";
+		}
+		return source;
+	}
+
+	// n statements with a type error each
+	std::string type_errors(size_t n)
+	{
+		std::string source = "func f(a: Int, s: String, t: Bool)\n{\n";
+		for(size_t i = 0; i < n; i++)
+		{
+			source += "    var e" + std::to_string(i) + " = s - a\n";
+			source += "    if a {\n";
+			source += "    }\n";
+		}
+		source += "}\n";
+		return source;
+	}
+
+	// a chain of n nested groups and operators
+	std::string nested(size_t n)
+	{
+		std::string source = "var x = 1\nvar y = ";
+		for(size_t i = 0; i < n; i++) source += "(x + ";
+		source += "x";
+		for(size_t i = 0; i < n; i++) source += ")";
+		return source + "\n";
+	}
+
+	// one file taken through the phases
+	struct Unit
+	{
+		std::string source;
+		std::vector<Token> tokens;
+		Util::DiagnosticEngine diagnostics;
+		ConstantPool constants;
+		std::unique_ptr<Program> ast;
+
+		explicit Unit(std::string text)
+			: source(std::move(text)), diagnostics("test.cy", source, tokens)
+		{}
+
+		void lex()
+		{
+			Lexer lexer(source, diagnostics);
+			tokens = lexer.tokenize();
+			constants = std::move(lexer.constants);
+			REQUIRE(!lexer.failed());
+		}
+
+		size_t parse()
+		{
+			Parser parser(tokens, diagnostics, UINT_MAX);
+			ast = parser.parse();
+			return parser.operations();
+		}
+	};
+
+	struct Work
+	{
+		size_t allocations, operations;
+	};
+
+	template<typename Phase>
+	void check_phase(std::string (*input)(size_t), size_t n, Phase phase)
+	{
+		Unit small(input(n)), large(input(2 * n));
+		Work small_work, large_work;
+		small_work.allocations = allocations_in([&] { small_work.operations = phase(small); });
+		large_work.allocations = allocations_in([&] { large_work.operations = phase(large); });
+
+		check_linear(small_work.allocations, large_work.allocations);
+		if(small_work.operations || large_work.operations)
+			check_linear(small_work.operations, large_work.operations);
+	}
+
+	size_t lex(Unit &unit)
+	{
+		unit.lex();
+		return 0;
+	}
+
+	size_t parse(Unit &unit)
+	{
+		unit.lex();
+		return unit.parse();
+	}
+
+	size_t resolve(Unit &unit)
+	{
+		SymbolTable sym(unit.diagnostics);
+		sym.dispatch(*unit.ast);
+		REQUIRE(!sym.failed());
+		return sym.operations();
+	}
+}
+
+TEST_CASE("lexer scales linearly")
+{
+	check_phase(blocks, 500, lex);
+}
+
+TEST_CASE("parser scales linearly")
+{
+	check_phase(blocks, 500, parse);
+	check_phase(nested, 2000, parse);
+}
+
+TEST_CASE("parser recovers from syntax errors in linear time")
+{
+	check_phase(syntax_errors, 500, [](Unit &unit)
+	{
+		auto operations = parse(unit);
+		CHECK(unit.diagnostics.diagnostics().size() > 0);
+		return operations;
+	});
+}
+
+TEST_CASE("symbol table scales linearly with the number of blocks")
+{
+	check_phase(blocks, 500, [](Unit &unit)
+	{
+		parse(unit);
+		return resolve(unit);
+	});
+}
+
+TEST_CASE("flat symbol table scales linearly with the number of blocks")
+{
+	check_phase(blocks, 500, [](Unit &unit)
+	{
+		parse(unit);
+		FlatTree tree(*unit.ast, unit.tokens);
+		FlatSymbolTable sym(tree, unit.diagnostics);
+		sym.dispatch(tree.root());
+		REQUIRE(!sym.failed());
+		return sym.operations();
+	});
+}
+
+TEST_CASE("type checker scales linearly")
+{
+	check_phase(blocks, 500, [](Unit &unit)
+	{
+		parse(unit);
+		resolve(unit);
+		TypeChecker type_checker(unit.diagnostics, unit.constants);
+		type_checker.dispatch(*unit.ast);
+		CHECK(!type_checker.failed());
+		return size_t(0);
+	});
+	check_phase(nested, 2000, [](Unit &unit)
+	{
+		parse(unit);
+		resolve(unit);
+		TypeChecker type_checker(unit.diagnostics, unit.constants);
+		type_checker.dispatch(*unit.ast);
+		return size_t(0);
+	});
+}
+
+TEST_CASE("rendering diagnostics scales linearly with the error count")
+{
+	auto check = [](Unit &unit)
+	{
+		parse(unit);
+		resolve(unit);
+		TypeChecker type_checker(unit.diagnostics, unit.constants);
+		type_checker.dispatch(*unit.ast);
+		REQUIRE(type_checker.failed());
+
+		size_t length = 0;
+		for(const auto &diagnostic : unit.diagnostics.diagnostics())
+		{
+			length += unit.diagnostics.message(diagnostic).size();
+			length += unit.diagnostics.excerpt(diagnostic).size();
+		}
+		CHECK(length > 0);
+		return unit.diagnostics.operations();
+	};
+	check_phase(type_errors, 500, check);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "log.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Helpers shared by the tests.
+
+namespace Test
+{
+	// collects the text of everything logged
+	class CaptureSink : public LogSink
+	{
+	public:
+		explicit CaptureSink(std::vector<std::string> &lines)
+			: lines(lines)
+		{}
+
+		void write(std::string_view, const LogRecord &record) override
+		{
+			lines.push_back(record.text);
+		}
+		void flush() override {}
+
+	private:
+		std::vector<std::string> &lines;
+	};
+
+	// a new directory under the temporary path, which nothing else uses,
+	// removed with everything in it when this is destroyed
+	class TemporaryDirectory
+	{
+	public:
+		explicit TemporaryDirectory(const std::string &prefix)
+		{
+			auto pattern = (std::filesystem::temp_directory_path() / (prefix + "-XXXXXX")).string();
+			if(!mkdtemp(pattern.data()))
+				throw std::filesystem::filesystem_error("unable to create a temporary directory", pattern, std::error_code(errno, std::generic_category()));
+			path = pattern;
+		}
+		~TemporaryDirectory()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(path, error);
+		}
+
+		TemporaryDirectory(const TemporaryDirectory &) = delete;
+		TemporaryDirectory &operator=(const TemporaryDirectory &) = delete;
+
+		std::filesystem::path path;
+	};
+
+	inline std::string read(const std::filesystem::path &path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::string((std::istreambuf_iterator<char>(file)), {});
+	}
+}
@@ -0,0 +1,45 @@
+#!/usr/bin/python3
+
+# Compares two bench.json files written by the 'bench' target.
+#
+#   benchcmp.py old.json new.json
+
+import json
+import sys
+
+
+def load(path):
+    with open(path, "r") as file:
+        return {workload["name"]: workload for workload in json.load(file)["workloads"]}
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: benchcmp.py old.json new.json")
+
+    old = load(sys.argv[1])
+    new = load(sys.argv[2])
+
+    print(f"{'workload':<20} {'phase':<14} {'old ms':>10} {'new ms':>10} {'change':>8}")
+    for name, workload in new.items():
+        if name not in old:
+            continue
+        for phase, result in workload["phases"].items():
+            if phase not in old[name]["phases"]:
+                continue
+            before = old[name]["phases"][phase]["best_ms"]
+            after = result["best_ms"]
+            change = (after - before) / before * 100 if before else 0
+            print(f"{name:<20} {phase:<14} {before:>10.3f} {after:>10.3f} {change:>+7.1f}%")
+
+    # AST memory, if both runs report it
+    sizes = [(name, old[name]["ast"], workload["ast"]) for name, workload in new.items() if name in old and "ast" in workload and "ast" in old[name]]
+    if sizes:
+        print()
+        print(f"{'workload':<20} {'old bytes':>12} {'new bytes':>12} {'change':>8}")
+        for name, before, after in sizes:
+            change = (after["node_bytes"] - before["node_bytes"]) / before["node_bytes"] * 100 if before["node_bytes"] else 0
+            print(f"{name:<20} {before['node_bytes']:>12} {after['node_bytes']:>12} {change:>+7.1f}%")
+
+
+main()
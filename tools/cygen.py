@@ -0,0 +1,320 @@
+#!/usr/bin/python3
+
+# Generates deterministic .cy workloads for benchmarking the front end.
+#
+#   cygen.py <shape> [--size N] [--seed S] [-o FILE]
+#   cygen.py --suite DIR
+#   cygen.py --project DIR [--size N] [--width W] [--seed S]
+#
+# The same shape, size and seed always produce the same program.
+
+import argparse
+import pathlib
+import random
+import sys
+
+operators = ["+", "-", "*", "/", "%"]
+comparisons = ["<", "<=", ">", ">=", "==", "!="]
+
+
+def name(rng, prefix, length):
+    letters = "abcdefghijklmnopqrstuvwxyz"
+    return prefix + "".join(rng.choice(letters) for _ in range(length))
+
+
+def arithmetic(rng, terms, width):
+    # a flat chain of integer operations over the given terms
+    parts = [rng.choice(terms)]
+    for _ in range(width - 1):
+        op = rng.choice(operators)
+        term = rng.choice(terms)
+        # keep divisions well defined for later interpreters
+        if op in ("/", "%"):
+            term = str(rng.randint(1, 9))
+        parts.append(f"{op} {term}")
+    return " ".join(parts)
+
+
+def condition(rng, terms):
+    return f"{rng.choice(terms)} {rng.choice(comparisons)} {rng.randint(0, 99)}"
+
+
+def helpers():
+    return [
+        "func print(s: String) {}",
+        "",
+        "func clamp(a: Int, lo: Int, hi: Int) -> Int",
+        "{",
+        "    if a < lo {",
+        "        return lo",
+        "    }",
+        "    if a > hi {",
+        "        return hi",
+        "    }",
+        "    return a",
+        "}",
+        "",
+    ]
+
+
+# functions whose bodies nest if/while blocks and parenthesized expressions
+def shape_nested(rng, size, depth):
+    out = helpers()
+    for f in range(size):
+        out.append(f"func nested{f}(a: Int, b: Int) -> Int")
+        out.append("{")
+        out.append("    var x = a")
+        indent = "    "
+        for level in range(depth):
+            keyword = "while" if level % 3 == 2 else "if"
+            out.append(f"{indent}{keyword} {condition(rng, ['x', 'a', 'b'])} {{")
+            indent += "    "
+            out.append(f"{indent}x = {arithmetic(rng, ['x', 'a', 'b', str(level)], 3)}")
+        for level in range(depth):
+            indent = indent[4:]
+            out.append(f"{indent}}}")
+        groups = rng.randint(depth, depth * 4)
+        out.append("    x = " + "(" * groups + "x + a" + ") * b" * groups)
+        out.append("    return clamp(x, 0, 1000)")
+        out.append("}")
+        out.append("")
+    return out
+
+
+# a few functions with very many statements and locals
+def shape_wide(rng, size, width):
+    out = helpers()
+    functions = max(1, size // width)
+    for f in range(functions):
+        out.append(f"func wide{f}(a: Int, b: Int) -> Int")
+        out.append("{")
+        locals = ["a", "b"]
+        for i in range(width):
+            kind = rng.random()
+            if kind < 0.5 or len(locals) < 4:
+                local = f"v{i}"
+                out.append(f"    var {local} = {arithmetic(rng, locals[-8:], 3)}")
+                locals.append(local)
+            elif kind < 0.8:
+                out.append(f"    {rng.choice(locals[2:])} = {arithmetic(rng, locals[-8:], 4)}")
+            elif kind < 0.9:
+                out.append(f"    print(\"{i}: \" + {rng.choice(locals)})")
+            else:
+                local = rng.choice(locals[2:])
+                out.append(f"    {local} = {local} + 1")
+        out.append(f"    return {locals[-1]}")
+        out.append("}")
+        out.append("")
+    return out
+
+
+# long operator chains, boolean chains and calls with long argument lists
+def shape_expr(rng, size, width):
+    out = helpers()
+    params = ", ".join(f"p{i}: Int" for i in range(16))
+    out.append(f"func sum({params}) -> Int")
+    out.append("{")
+    out.append("    return " + " + ".join(f"p{i}" for i in range(16)))
+    out.append("}")
+    out.append("")
+    out.append("func exprs(a: Int, b: Int, c: Int) -> Int")
+    out.append("{")
+    out.append("    var r = 0")
+    for i in range(size):
+        kind = i % 3
+        if kind == 0:
+            out.append(f"    r = r + {arithmetic(rng, ['a', 'b', 'c', 'r', str(i)], width)}")
+        elif kind == 1:
+            terms = []
+            for _ in range(width // 4 + 1):
+                terms.append(condition(rng, ["a", "b", "c", "r"]))
+            chained = " and ".join(terms[: len(terms) // 2 + 1]) + " or " + " or ".join(terms[len(terms) // 2 :])
+            out.append(f"    if {chained} {{")
+            out.append("        r++")
+            out.append("    }")
+        else:
+            args = ", ".join(arithmetic(rng, ["a", "b", "c", "r"], 2) for _ in range(16))
+            out.append(f"    r = r - sum({args})")
+    out.append("    return r")
+    out.append("}")
+    out.append("")
+    return out
+
+
+# many distinct global and local identifiers with long names
+def shape_idents(rng, size, width):
+    out = helpers()
+    globals = []
+    seen = set()
+    for i in range(size):
+        global_name = name(rng, "g", rng.randint(8, 24))
+        while global_name in seen:
+            global_name = name(rng, "g", rng.randint(8, 24))
+        seen.add(global_name)
+        out.append(f"var {global_name} = {rng.randint(0, 1000)}")
+        globals.append(global_name)
+    out.append("")
+    for f in range(max(1, size // width)):
+        out.append(f"func {name(rng, 'f', 12)}{f}(x: Int) -> Int")
+        out.append("{")
+        locals = ["x"]
+        for i in range(width):
+            local = f"{name(rng, 'l', rng.randint(8, 24))}{i}"
+            terms = [rng.choice(globals) for _ in range(3)] + [rng.choice(locals)]
+            out.append(f"    var {local} = {arithmetic(rng, terms, 4)}")
+            locals.append(local)
+        out.append(f"    return {locals[-1]}")
+        out.append("}")
+        out.append("")
+    return out
+
+
+def corrupt(rng, line):
+    # breaks a statement so the parser has to recover; the lexer still accepts it
+    kind = rng.randint(0, 3)
+    if kind == 0:
+        return line + " )"
+    elif kind == 1:
+        return line.replace("=", "= (", 1)
+    elif kind == 2:
+        return line.replace("var ", "var 1", 1) if "var " in line else line + " ,"
+    else:
+        return line.replace("=", "= =", 1)
+
+
+# syntax errors scattered through valid code, one in every `width` statements
+def shape_syntax_errors(rng, size, width):
+    out = []
+    for line in shape_wide(rng, size, 200):
+        stripped = line.strip()
+        if stripped.startswith("var ") or (stripped and stripped[0] == "v" and "=" in stripped):
+            if rng.randint(1, width) == 1:
+                line = corrupt(rng, line)
+        out.append(line)
+    return out
+
+
+# well formed code full of type errors
+def shape_type_errors(rng, size, width):
+    out = helpers()
+    for f in range(max(1, size // width)):
+        out.append(f"func bad{f}(a: Int, s: String, t: Bool) -> Int")
+        out.append("{")
+        for i in range(width):
+            kind = rng.randint(0, 7)
+            if kind == 0:
+                out.append(f"    var e{i}: Int = s")
+            elif kind == 1:
+                out.append(f"    if a {{")
+                out.append("        print(s)")
+                out.append("    }")
+            elif kind == 2:
+                out.append(f"    print(a)")
+            elif kind == 3:
+                out.append(f"    var e{i} = s - {rng.randint(0, 9)}")
+            elif kind == 4:
+                out.append(f"    var e{i} = not a")
+            elif kind == 5:
+                out.append(f"    clamp(a, s, t)")
+            elif kind == 6:
+                out.append(f"    var e{i} = a + {rng.randint(0, 9)}")
+            else:
+                out.append(f"    a = t")
+        out.append("    return s")
+        out.append("}")
+        out.append("")
+    return out
+
+
+shapes = {
+    "nested": (shape_nested, 400, 24),
+    "wide": (shape_wide, 20000, 2000),
+    "expr": (shape_expr, 3000, 64),
+    "idents": (shape_idents, 4000, 400),
+    "syntax-errors": (shape_syntax_errors, 20000, 20),
+    "type-errors": (shape_type_errors, 8000, 400),
+}
+
+
+# a project of modules that import up to three earlier ones, and a main.cy
+# that imports every module nothing else imports; each module exports a few
+# functions with bodies like those of the wide shape
+def project(rng, size, width):
+    modules = {}
+    imported = set()
+    for m in range(size):
+        imports = sorted(rng.sample(range(m), min(m, rng.randint(0, 3))))
+        imported.update(imports)
+        out = [f"import m{i}" for i in imports] + [""]
+        for f in range(3):
+            out.append(f"func m{m}f{f}(a: Int, b: Int) -> Int")
+            out.append("{")
+            locals = ["a", "b"] + [f"m{i}f{rng.randint(0, 2)}(a, b)" for i in imports]
+            for i in range(width):
+                out.append(f"    var v{i} = {arithmetic(rng, locals[-6:], 3)}")
+                locals.append(f"v{i}")
+            out.append(f"    return {locals[-1]}")
+            out.append("}")
+            out.append("")
+        modules[f"m{m}.cy"] = out
+    roots = [m for m in range(size) if m not in imported]
+    modules["main.cy"] = [f"import m{m}" for m in roots] + ["var result = " + " + ".join(f"m{m}f0(1, 2)" for m in roots)]
+    return modules
+
+
+def write_project(directory, size, width, seed):
+    directory = pathlib.Path(directory)
+    directory.mkdir(parents=True, exist_ok=True)
+    rng = random.Random(f"project:{seed}")
+    for name, lines in project(rng, size or 1000, width or 40).items():
+        with open(directory / name, "w") as file:
+            file.write("\n".join(lines) + "\n")
+    print(f"Wrote {size or 1000} modules and main.cy to '{directory}'")
+
+
+def generate(shape, size=None, width=None, seed=1):
+    function, default_size, default_width = shapes[shape]
+    rng = random.Random(f"{shape}:{seed}")
+    lines = function(rng, size or default_size, width or default_width)
+    return "\n".join(lines) + "\n"
+
+
+def write_suite(directory, seed):
+    directory = pathlib.Path(directory)
+    directory.mkdir(parents=True, exist_ok=True)
+    for shape in shapes:
+        path = directory / f"{shape}.cy"
+        print(f"Writing to '{path}'")
+        with open(path, "w") as file:
+            file.write(generate(shape, seed=seed))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate .cy benchmark workloads")
+    parser.add_argument("shape", nargs="?", choices=list(shapes))
+    parser.add_argument("--size", type=int, help="number of functions, statements or identifiers")
+    parser.add_argument("--width", type=int, help="depth, expression length or statements per function")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("-o", "--output", help="output file (default stdout)")
+    parser.add_argument("--suite", metavar="DIR", help="write every shape at its default size to DIR")
+    parser.add_argument("--project", metavar="DIR", help="write a project of --size modules (default 1000) that import each other to DIR")
+    args = parser.parse_args()
+
+    if args.suite:
+        write_suite(args.suite, args.seed)
+        return
+    if args.project:
+        write_project(args.project, args.size, args.width, args.seed)
+        return
+    if not args.shape:
+        parser.error("a shape or --suite is required")
+
+    program = generate(args.shape, args.size, args.width, args.seed)
+    if args.output:
+        with open(args.output, "w") as file:
+            file.write(program)
+    else:
+        sys.stdout.write(program)
+
+
+main()
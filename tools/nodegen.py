@@ -9,6 +9,12 @@ node_header_path = root_dir / "src/ast/node.h"
 node_source_path = root_dir / "src/ast/node.cpp"
 visitor_header_path = root_dir / "src/ast/visitor.h"
 visitor_include_path = root_dir / "src/ast/visitorincl"
+kind_header_path = root_dir / "src/ast/nodekind.h"
+dispatch_header_path = root_dir / "src/ast/dispatch.h"
+dispatch_include_path = root_dir / "src/ast/dispatchincl"
+flat_header_path = root_dir / "src/ast/flat.h"
+flat_source_path = root_dir / "src/ast/flat.cpp"
+flat_include_path = root_dir / "src/ast/flatincl"
 
 structs = {}
 
@@ -54,6 +60,24 @@ def get_all_fields(struct):
     )
 
 
+def concrete_structs():
+    return [struct for struct in structs.values() if not struct.abstract]
+
+
+def member_name(field):
+    # a token index is stored under its own name; the field's name is the
+    # accessor that looks the token up
+    if field_category(field) == "token index":
+        return f"{field[1]}_index"
+    return field[1]
+
+
+def constructor_params(struct):
+    # abstract structs receive the kind of the concrete node being built
+    params = ["NodeKind kind"] if struct.abstract else []
+    return params + list(map(" ".join, get_all_fields(struct)))
+
+
 def write_node_header():
     print(f"Writing to '{node_header_path}'")
     with open(node_header_path, "w") as file:
@@ -62,9 +86,11 @@ def write_node_header():
         file.write("#pragma once\n")
         file.write("\n")
         file.write('#include "visitor.h"\n')
+        file.write('#include "nodekind.h"\n')
         file.write('#include "syntax/token.h"\n')
         file.write('#include "semantic/symdata.h"\n')
         file.write("\n")
+        file.write("#include <cstddef>\n")
         file.write("#include <string_view>\n")
         file.write("#include <memory>\n")
         file.write("#include <vector>\n")
@@ -75,7 +101,6 @@ def write_node_header():
             parent = struct.parent
             abstract = struct.abstract
             fields = struct.fields
-            all_fields = get_all_fields(struct)
 
             # derived
             if parent:
@@ -85,23 +110,27 @@ def write_node_header():
                 file.write(f"struct {name}\n")
             file.write("{\n")
 
+            # node kind tag
+            if name == "Node":
+                file.write("\tconst NodeKind kind;\n")
+
             # fields
-            for field in map(" ".join, fields):
-                file.write(f"\t{field};\n")
+            for field in fields:
+                file.write(f"\t{field[0]} {member_name(field)};\n")
 
             # constructor
-            if name != "Node":
-                # automatic constructor
-                if not fields:
-                    # not necessary to add constructor when parents have no fields
-                    if struct.parent in structs and get_all_fields(
-                        structs[struct.parent]
-                    ):
-                        file.write(f"\tusing {parent}::{parent};\n")
-                # manual constructor
-                else:
-                    joined_fields = map(" ".join, all_fields)
-                    file.write(f"\t{name}({', '.join(joined_fields)});\n")
+            file.write(f"\t{'explicit ' if len(constructor_params(struct)) == 1 else ''}{name}({', '.join(constructor_params(struct))});\n")
+
+            # token accessors
+            for field in fields:
+                if field_category(field) == "token index":
+                    file.write(f"\tconst Token &{field[1]}(const std::vector<Token> &tokens) const {{ return token_at(tokens, {member_name(field)}); }}\n")
+
+            # destructor; children are released iteratively so deep trees cannot overflow the stack
+            if name == "Node":
+                file.write("\tvirtual ~Node();\n")
+            elif owned_children(struct):
+                file.write(f"\t~{name}() override;\n")
 
             # define 'accept' for Node
             if name == "Node":
@@ -110,11 +139,20 @@ def write_node_header():
             elif not abstract:
                 file.write("\tvoid accept(Visitor &v) override;\n")
 
+            if name == "Node":
+                file.write("\n")
+                file.write("protected:\n")
+                file.write("\tstatic void release(std::unique_ptr<Node> node);\n")
+
             file.write("};\n")
 
         for struct in structs.values():
             write_struct(struct)
 
+        file.write("\n")
+        file.write("// bytes of a node of the given kind, not counting what its fields own\n")
+        file.write("size_t node_size(NodeKind kind);\n")
+
 
 def write_node_source():
     print(f"Writing to '{node_source_path}'")
@@ -127,7 +165,7 @@ def write_node_source():
         def init_field(field):
             type = field[0]
             name = field[1]
-            if "unique_ptr" in type:
+            if "unique_ptr" in type or "vector" in type:
                 return f"std::move({name})"
             else:
                 return f"{name}"
@@ -139,40 +177,51 @@ def write_node_source():
             all_fields = get_all_fields(struct)
 
             # implement constructor
-            if fields:
-                # inherited fields
-                parent_fields = [p for p in all_fields if p not in fields]
-                # fields unique to current struct
-                unique_fields = [p for p in all_fields if p in fields]
-
-                # signature
-                joined_params = list(
-                    map(" ".join, parent_fields + unique_fields)
-                )
-                file.write(f"{name}::{name}({', '.join(joined_params)})\n")
-
-                # initializer list
-                parent_arguments = list(map(init_field, parent_fields))
-                unique_arguments = list(map(init_field, unique_fields))
-
-                initializer_list = []
-                initializer_list.extend(
-                    [
-                        f"{struct.parent}({arg})"
-                        for arg in parent_arguments
-                    ]
-                )
-                initializer_list.extend(
-                    [
-                        f"{field[1]}({arg})"
-                        for (field, arg) in zip(unique_fields, unique_arguments)
-                    ]
+            # inherited fields
+            parent_fields = [p for p in all_fields if p not in fields]
+            # fields unique to current struct
+            unique_fields = [p for p in all_fields if p in fields]
+
+            # signature
+            file.write(f"{name}::{name}({', '.join(constructor_params(struct))})\n")
+
+            # initializer list
+            kind = "kind" if abstract else f"NodeKind::{name}"
+            initializer_list = []
+            if struct.parent:
+                parent_arguments = [kind] + list(map(init_field, parent_fields))
+                initializer_list.append(
+                    f"{struct.parent}({', '.join(parent_arguments)})"
                 )
-                file.write(f"\t: {', '.join(initializer_list)}\n")
+            else:
+                initializer_list.append(f"kind({kind})")
+            initializer_list.extend(
+                [
+                    f"{member_name(field)}({init_field(field)})"
+                    for field in unique_fields
+                ]
+            )
+            file.write(f"\t: {', '.join(initializer_list)}\n")
+
+            # body
+            file.write("{\n")
+            file.write("}\n")
 
-                # body
+            # implement destructor
+            if name == "Node":
+                file.write("Node::~Node()\n")
                 file.write("{\n")
                 file.write("}\n")
+            elif owned_children(struct):
+                file.write(f"{name}::~{name}()\n")
+                file.write("{\n")
+                for field in owned_children(struct):
+                    if field_category(field) == "children":
+                        file.write(f"\tfor(auto &child : {field[1]})\n")
+                        file.write("\t\trelease(std::move(child));\n")
+                    else:
+                        file.write(f"\trelease(std::move({field[1]}));\n")
+                file.write("}\n")
 
             # implement 'accept'
             if not abstract:
@@ -184,6 +233,38 @@ def write_node_source():
         for struct in structs.values():
             write_struct(struct)
 
+        # destroying a node queues its children instead of destroying them
+        # recursively; the outermost release drains the queue
+        file.write("void Node::release(std::unique_ptr<Node> node)\n")
+        file.write("{\n")
+        file.write("\tthread_local std::vector<std::unique_ptr<Node>> pending;\n")
+        file.write("\tthread_local bool draining = false;\n")
+        file.write("\n")
+        file.write("\tif(!node) return;\n")
+        file.write("\tpending.push_back(std::move(node));\n")
+        file.write("\tif(draining) return;\n")
+        file.write("\n")
+        file.write("\tdraining = true;\n")
+        file.write("\twhile(!pending.empty())\n")
+        file.write("\t{\n")
+        file.write("\t\tauto next = std::move(pending.back());\n")
+        file.write("\t\tpending.pop_back();\n")
+        file.write("\t\tnext.reset();\n")
+        file.write("\t}\n")
+        file.write("\tdraining = false;\n")
+        file.write("}\n")
+
+        file.write("size_t node_size(NodeKind kind)\n")
+        file.write("{\n")
+        file.write("\tswitch(kind)\n")
+        file.write("\t{\n")
+        for struct in concrete_structs():
+            file.write(f"\t\tcase NodeKind::{struct.name}:\n")
+            file.write(f"\t\t\treturn sizeof({struct.name});\n")
+        file.write("\t}\n")
+        file.write("\t__builtin_unreachable();\n")
+        file.write("}\n")
+
 
 def write_visitor_header():
     print(f"Writing to '{visitor_header_path}'")
@@ -229,6 +310,340 @@ def write_visitor_include_header():
             write_struct(struct)
 
 
+def write_kind_header():
+    print(f"Writing to '{kind_header_path}'")
+    with open(kind_header_path, "w") as file:
+        file.write("// generated by nodegen.py; do not edit\n")
+        file.write("\n")
+        file.write("#pragma once\n")
+        file.write("\n")
+        file.write("enum class NodeKind : unsigned char\n")
+        file.write("{\n")
+        for struct in concrete_structs():
+            file.write(f"\t{struct.name},\n")
+        file.write("};\n")
+
+
+def write_dispatch_header():
+    print(f"Writing to '{dispatch_header_path}'")
+    with open(dispatch_header_path, "w") as file:
+        file.write("// generated by nodegen.py; do not edit\n")
+        file.write("\n")
+        file.write("#pragma once\n")
+        file.write("\n")
+        file.write('#include "node.h"\n')
+        file.write("\n")
+        file.write("// statically dispatched alternative to Visitor: switches on Node::kind\n")
+        file.write("// and calls Derived::visit directly, so visits can be inlined and may\n")
+        file.write("// return a value\n")
+        file.write("template<typename Derived, typename R = void>\n")
+        file.write("class StaticVisitor\n")
+        file.write("{\n")
+        file.write("public:\n")
+        file.write("\tusing Result = R;\n")
+        file.write("\n")
+        file.write("\tResult dispatch(Node &node)\n")
+        file.write("\t{\n")
+        file.write("\t\tauto &self = static_cast<Derived &>(*this);\n")
+        file.write("\t\tswitch(node.kind)\n")
+        file.write("\t\t{\n")
+        for struct in concrete_structs():
+            file.write(f"\t\t\tcase NodeKind::{struct.name}:\n")
+            file.write(f"\t\t\t\treturn self.visit(static_cast<{struct.name} &>(node));\n")
+        file.write("\t\t}\n")
+        file.write("\t\t__builtin_unreachable();\n")
+        file.write("\t}\n")
+        file.write("};\n")
+
+
+def write_dispatch_include_header():
+    print(f"Writing to '{dispatch_include_path}'")
+    with open(dispatch_include_path, "w") as file:
+        file.write("// generated by nodegen.py; do not edit\n")
+        file.write("\n")
+
+        for struct in concrete_structs():
+            file.write(f"Result visit({struct.name} &node);\n")
+
+
+def field_category(field):
+    type = field[0]
+    if "std::vector" in type:
+        return "children"
+    elif "unique_ptr" in type:
+        return "child"
+    elif type == "Token":
+        return "token"
+    elif type == "TokenIndex":
+        return "token index"
+    else:
+        return None
+
+
+def owned_children(struct):
+    # child fields declared directly on the struct
+    return [f for f in struct.fields if field_category(f) in ("child", "children")]
+
+
+def flat_layout(struct):
+    # child slots are laid out in field order; at most one vector field, so
+    # fields after it are addressed from the end of the node's child range
+    fields = get_all_fields(struct)
+    nodes = [f for f in fields if field_category(f) in ("child", "children")]
+    tokens = [f for f in fields if field_category(f) == "token index"]
+    if any(field_category(f) == "token" for f in fields):
+        raise Exception(f"'{struct.name}' stores a token instead of its index")
+    vectors = [f for f in nodes if field_category(f) == "children"]
+    if len(vectors) > 1:
+        raise Exception(f"'{struct.name}' has more than one vector field")
+    return nodes, tokens
+
+
+def write_flat_header():
+    print(f"Writing to '{flat_header_path}'")
+    with open(flat_header_path, "w") as file:
+        file.write("// generated by nodegen.py; do not edit\n")
+        file.write("\n")
+        file.write("#pragma once\n")
+        file.write("\n")
+        file.write('#include "node.h"\n')
+        file.write('#include "syntax/token.h"\n')
+        file.write("\n")
+        file.write("#include <cstdint>\n")
+        file.write("#include <climits>\n")
+        file.write("#include <vector>\n")
+        file.write("\n")
+        file.write("using NodeId = std::uint32_t;\n")
+        file.write("constexpr NodeId no_node = UINT32_MAX;\n")
+        file.write("\n")
+        file.write("struct NodeIdRange\n")
+        file.write("{\n")
+        file.write("\tconst NodeId *first, *last;\n")
+        file.write("\tconst NodeId *begin() const { return first; }\n")
+        file.write("\tconst NodeId *end() const { return last; }\n")
+        file.write("\tsize_t size() const { return last - first; }\n")
+        file.write("\tbool empty() const { return first == last; }\n")
+        file.write("\tNodeId operator[](size_t i) const { return first[i]; }\n")
+        file.write("};\n")
+        file.write("\n")
+        file.write("// struct-of-arrays form of an AST; node ids are assigned in pre-order,\n")
+        file.write("// so the root is always 0 and every subtree is a contiguous id range\n")
+        file.write("class FlatTree\n")
+        file.write("{\n")
+        file.write("public:\n")
+        file.write("\t// source is the token list of the file the tree was parsed from, which\n")
+        file.write("\t// must outlive the tree\n")
+        file.write("\tFlatTree(Node &root, const std::vector<Token> &source);\n")
+        file.write("\n")
+        file.write("\tNodeId root() const { return 0; }\n")
+        file.write("\tsize_t size() const { return kinds.size(); }\n")
+        file.write("\n")
+        file.write("\tNodeId child(NodeId id, unsigned i) const { return children[first_child[id] + i]; }\n")
+        file.write("\tNodeId child_from_end(NodeId id, unsigned i) const { return children[first_child[id] + child_count[id] - i]; }\n")
+        file.write("\tNodeIdRange child_range(NodeId id, unsigned front, unsigned back) const\n")
+        file.write("\t{\n")
+        file.write("\t\tconst NodeId *first = children.data() + first_child[id];\n")
+        file.write("\t\treturn { first + front, first + child_count[id] - back };\n")
+        file.write("\t}\n")
+        file.write("\tTokenIndex token_index(NodeId id, unsigned i) const { return tokens[first_token[id] + i]; }\n")
+        file.write("\tconst Token &token(NodeId id, unsigned i) const { return token_at(*source, token_index(id, i)); }\n")
+        file.write("\n")
+        file.write("\t// per node\n")
+        file.write("\tstd::vector<NodeKind> kinds;\n")
+        file.write("\tstd::vector<std::uint32_t> first_token;\n")
+        file.write("\tstd::vector<std::uint32_t> first_child;\n")
+        file.write("\tstd::vector<std::uint32_t> child_count;\n")
+        file.write("\n")
+        file.write("\t// shared\n")
+        file.write("\tstd::vector<NodeId> children;\n")
+        file.write("\t// indices into source\n")
+        file.write("\tstd::vector<TokenIndex> tokens;\n")
+        file.write("\tconst std::vector<Token> *source;\n")
+        file.write("};\n")
+        file.write("\n")
+        file.write("namespace Flat\n")
+        file.write("{\n")
+
+        def write_view(struct):
+            nodes, tokens = flat_layout(struct)
+            file.write(f"\tstruct {struct.name}\n")
+            file.write("\t{\n")
+            file.write("\t\tconst FlatTree &tree;\n")
+            file.write("\t\tconst NodeId id;\n")
+
+            vector_index = next(
+                (i for (i, f) in enumerate(nodes) if field_category(f) == "children"),
+                None,
+            )
+            for (i, field) in enumerate(nodes):
+                name = field[1]
+                if field_category(field) == "children":
+                    back = len(nodes) - i - 1
+                    file.write(f"\t\tNodeIdRange {name}() const {{ return tree.child_range(id, {i}, {back}); }}\n")
+                elif vector_index is not None and i > vector_index:
+                    file.write(f"\t\tNodeId {name}() const {{ return tree.child_from_end(id, {len(nodes) - i}); }}\n")
+                else:
+                    file.write(f"\t\tNodeId {name}() const {{ return tree.child(id, {i}); }}\n")
+            for (i, field) in enumerate(tokens):
+                file.write(f"\t\tconst Token &{field[1]}() const {{ return tree.token(id, {i}); }}\n")
+            file.write("\t};\n")
+
+        for struct in concrete_structs():
+            write_view(struct)
+
+        file.write("}\n")
+        file.write("\n")
+        file.write("// statically dispatched visitor over a FlatTree\n")
+        file.write("template<typename Derived, typename R = void>\n")
+        file.write("class FlatVisitor\n")
+        file.write("{\n")
+        file.write("public:\n")
+        file.write("\tusing Result = R;\n")
+        file.write("\n")
+        file.write("\texplicit FlatVisitor(const FlatTree &tree)\n")
+        file.write("\t\t: tree(tree)\n")
+        file.write("\t{\n")
+        file.write("\t}\n")
+        file.write("\n")
+        file.write("\tResult dispatch(NodeId id)\n")
+        file.write("\t{\n")
+        file.write("\t\tauto &self = static_cast<Derived &>(*this);\n")
+        file.write("\t\tswitch(tree.kinds[id])\n")
+        file.write("\t\t{\n")
+        for struct in concrete_structs():
+            file.write(f"\t\t\tcase NodeKind::{struct.name}:\n")
+            file.write(f"\t\t\t\treturn self.visit(Flat::{struct.name} {{ tree, id }});\n")
+        file.write("\t\t}\n")
+        file.write("\t\t__builtin_unreachable();\n")
+        file.write("\t}\n")
+        file.write("\n")
+        file.write("protected:\n")
+        file.write("\tconst FlatTree &tree;\n")
+        file.write("};\n")
+
+
+def write_flat_source():
+    print(f"Writing to '{flat_source_path}'")
+    with open(flat_source_path, "w") as file:
+        file.write("// generated by nodegen.py; do not edit\n")
+        file.write("\n")
+        file.write('#include "flat.h"\n')
+        file.write('#include "dispatch.h"\n')
+        file.write("\n")
+        file.write("namespace\n")
+        file.write("{\n")
+        file.write("\tclass FlatBuilder : public StaticVisitor<FlatBuilder, NodeId>\n")
+        file.write("\t{\n")
+        file.write("\tpublic:\n")
+        file.write("#include \"dispatchincl\"\n")
+        file.write("\n")
+        file.write("\t\texplicit FlatBuilder(FlatTree &tree)\n")
+        file.write("\t\t\t: tree(tree)\n")
+        file.write("\t\t{\n")
+        file.write("\t\t}\n")
+        file.write("\n")
+        file.write("\t\t// builds with an explicit stack so deep trees cannot overflow the native one\n")
+        file.write("\t\tvoid build(Node &root)\n")
+        file.write("\t\t{\n")
+        file.write("\t\t\tstruct Entry\n")
+        file.write("\t\t\t{\n")
+        file.write("\t\t\t\tNodeId id;\n")
+        file.write("\t\t\t\tsize_t mark, first, next;\n")
+        file.write("\t\t\t};\n")
+        file.write("\t\t\tstd::vector<Entry> stack;\n")
+        file.write("\n")
+        file.write("\t\t\tauto open = [&](Node &node)\n")
+        file.write("\t\t\t{\n")
+        file.write("\t\t\t\tauto mark = pending.size();\n")
+        file.write("\t\t\t\tauto first = queued.size();\n")
+        file.write("\t\t\t\tstack.push_back({ dispatch(node), mark, first, first });\n")
+        file.write("\t\t\t};\n")
+        file.write("\n")
+        file.write("\t\t\topen(root);\n")
+        file.write("\t\t\twhile(!stack.empty())\n")
+        file.write("\t\t\t{\n")
+        file.write("\t\t\t\tauto &top = stack.back();\n")
+        file.write("\t\t\t\tif(top.next < queued.size())\n")
+        file.write("\t\t\t\t{\n")
+        file.write("\t\t\t\t\tauto child = queued[top.next++];\n")
+        file.write("\t\t\t\t\tif(child) open(*child);\n")
+        file.write("\t\t\t\t\telse pending.push_back(no_node);\n")
+        file.write("\t\t\t\t\tcontinue;\n")
+        file.write("\t\t\t\t}\n")
+        file.write("\n")
+        file.write("\t\t\t\t// all children built\n")
+        file.write("\t\t\t\ttree.first_child[top.id] = tree.children.size();\n")
+        file.write("\t\t\t\ttree.child_count[top.id] = pending.size() - top.mark;\n")
+        file.write("\t\t\t\ttree.children.insert(tree.children.end(), pending.begin() + top.mark, pending.end());\n")
+        file.write("\t\t\t\tpending.resize(top.mark);\n")
+        file.write("\t\t\t\tqueued.resize(top.first);\n")
+        file.write("\n")
+        file.write("\t\t\t\tauto id = top.id;\n")
+        file.write("\t\t\t\tstack.pop_back();\n")
+        file.write("\t\t\t\tif(!stack.empty()) pending.push_back(id);\n")
+        file.write("\t\t\t}\n")
+        file.write("\t\t}\n")
+        file.write("\n")
+        file.write("\tprivate:\n")
+        file.write("\t\tFlatTree &tree;\n")
+        file.write("\t\t// child ids of the nodes currently being built\n")
+        file.write("\t\tstd::vector<NodeId> pending;\n")
+        file.write("\t\t// children waiting to be built, in field order\n")
+        file.write("\t\tstd::vector<Node *> queued;\n")
+        file.write("\n")
+        file.write("\t\tNodeId add(Node &node)\n")
+        file.write("\t\t{\n")
+        file.write("\t\t\tNodeId id = tree.kinds.size();\n")
+        file.write("\t\t\ttree.kinds.push_back(node.kind);\n")
+        file.write("\t\t\ttree.first_token.push_back(tree.tokens.size());\n")
+        file.write("\t\t\ttree.first_child.push_back(0);\n")
+        file.write("\t\t\ttree.child_count.push_back(0);\n")
+        file.write("\t\t\treturn id;\n")
+        file.write("\t\t}\n")
+        file.write("\t\tvoid queue(Node *node)\n")
+        file.write("\t\t{\n")
+        file.write("\t\t\tqueued.push_back(node);\n")
+        file.write("\t\t}\n")
+        file.write("\t};\n")
+        file.write("\n")
+
+        def write_visit(struct):
+            nodes, tokens = flat_layout(struct)
+            file.write(f"\tNodeId FlatBuilder::visit({struct.name} &node)\n")
+            file.write("\t{\n")
+            file.write("\t\tauto id = add(node);\n")
+            for field in tokens:
+                file.write(f"\t\ttree.tokens.push_back(node.{member_name(field)});\n")
+            for field in nodes:
+                if field_category(field) == "children":
+                    file.write(f"\t\tfor(const auto &child : node.{field[1]}) queue(child.get());\n")
+                else:
+                    file.write(f"\t\tqueue(node.{field[1]}.get());\n")
+            file.write("\t\treturn id;\n")
+            file.write("\t}\n")
+
+        for struct in concrete_structs():
+            write_visit(struct)
+
+        file.write("}\n")
+        file.write("\n")
+        file.write("FlatTree::FlatTree(Node &root, const std::vector<Token> &source)\n")
+        file.write("\t: source(&source)\n")
+        file.write("{\n")
+        file.write("\tFlatBuilder(*this).build(root);\n")
+        file.write("}\n")
+
+
+def write_flat_include_header():
+    print(f"Writing to '{flat_include_path}'")
+    with open(flat_include_path, "w") as file:
+        file.write("// generated by nodegen.py; do not edit\n")
+        file.write("\n")
+
+        for struct in concrete_structs():
+            file.write(f"Result visit(Flat::{struct.name} node);\n")
+
+
 sections = get_sections(template_path)
 for section in sections:
     parse_section(section)
@@ -238,3 +653,9 @@ write_node_header()
 write_node_source()
 write_visitor_header()
 write_visitor_include_header()
+write_kind_header()
+write_dispatch_header()
+write_dispatch_include_header()
+write_flat_header()
+write_flat_source()
+write_flat_include_header()